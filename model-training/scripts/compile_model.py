@@ -0,0 +1,648 @@
+#!/usr/bin/env python3
+"""
+Ahead-of-Time Model Compiler for the ESP32 Sleep Classifier
+============================================================
+
+Turns the quantized sleep_model.tflite plus scaler_params.h into a C++
+header (model_compiled.h) that runs the MLP with no interpreter, no
+flatbuffer parsing at boot and no heap:
+
+    - weights, biases and requantization multipliers as constexpr arrays
+    - one generated function per dense layer with compile-time sizes, so
+      the 4-way unrolled dotInt8() (AVX2 on x86) is specialized per layer
+    - FEATURE_MEAN / FEATURE_SCALE folded into the first layer's input
+      quantization: q = round(x * mul[i] + offset[i]), straight from raw
+      features, and the input zero point folded into the first bias
+
+The arithmetic is the TFLM int8 FULLY_CONNECTED reference (the same as
+firmware/src/processing/int8_mlp.h), re-implemented here in exact integer
+Python, which also produces golden vectors for the firmware test
+test/test_compiled_model.
+
+Usage:
+    python compile_model.py \\
+        --tflite ../models/tflite_4class/sleep_model.tflite \\
+        --scaler ../models/tflite_4class/scaler_params.h \\
+        --output ../../wearable-prototype/firmware/include/model_compiled.h \\
+        --golden ../../wearable-prototype/firmware/test/test_compiled_model/golden_vectors.h
+"""
+
+import argparse
+import math
+import random
+import re
+import struct
+import zlib
+from pathlib import Path
+
+
+# ============================================================================
+# TFLite Flatbuffer Reader (schema v3, subset; mirrors tflite_reader.h)
+# ============================================================================
+
+OP_DEQUANTIZE = 6
+OP_FULLY_CONNECTED = 9
+OP_RELU = 19
+OP_RESHAPE = 22
+OP_SOFTMAX = 25
+OP_QUANTIZE = 114
+
+TYPE_INT8 = 9
+TYPE_INT32 = 2
+
+ACT_NONE = 0
+ACT_RELU = 1
+ACT_RELU6 = 3
+
+
+class FlatbufferReader:
+    """Read-only accessors for flatbuffer tables and vectors by byte offset."""
+
+    def __init__(self, data: bytes):
+        if len(data) < 16 or data[4:8] != b'TFL3':
+            raise ValueError("not a TFLite flatbuffer")
+        self.data = data
+
+    def u32(self, pos):
+        return struct.unpack_from('<I', self.data, pos)[0]
+
+    def root(self):
+        return self.u32(0)
+
+    def field(self, table, index):
+        if table is None:
+            return None
+        vtable = table - struct.unpack_from('<i', self.data, table)[0]
+        vtable_size = struct.unpack_from('<H', self.data, vtable)[0]
+        entry = 4 + 2 * index
+        if entry + 2 > vtable_size:
+            return None
+        offset = struct.unpack_from('<H', self.data, vtable + entry)[0]
+        return table + offset if offset else None
+
+    def scalar(self, table, index, fmt, default):
+        pos = self.field(table, index)
+        return struct.unpack_from('<' + fmt, self.data, pos)[0] if pos is not None else default
+
+    def child(self, table, index):
+        pos = self.field(table, index)
+        return pos + self.u32(pos) if pos is not None else None
+
+    def vector(self, vec, fmt):
+        if vec is None:
+            return []
+        n = self.u32(vec)
+        return list(struct.unpack_from('<%d%s' % (n, fmt), self.data, vec + 4))
+
+    def tables(self, vec):
+        if vec is None:
+            return []
+        return [vec + 4 + 4 * i + self.u32(vec + 4 + 4 * i) for i in range(self.u32(vec))]
+
+
+def load_tflite(path):
+    """
+    Extract the dense-layer chain from an int8 .tflite model.
+
+    Returns a dict with the input quantization, the list of layers
+    (weights, bias, per-channel filter scales, output quantization,
+    activation) and the softmax beta (None if the graph has no softmax).
+    """
+    data = Path(path).read_bytes()
+    r = FlatbufferReader(data)
+    if r.scalar(r.root(), 0, 'I', 0) != 3:
+        raise ValueError("unsupported TFLite schema version")
+
+    model = r.root()
+    codes = r.tables(r.child(model, 1))
+    subgraphs = r.tables(r.child(model, 2))
+    buffers = r.tables(r.child(model, 4))
+    if len(subgraphs) != 1:
+        raise ValueError("expected exactly one subgraph")
+
+    graph = subgraphs[0]
+    tensors = r.tables(r.child(graph, 0))
+
+    def quantization(t):
+        q = r.child(tensors[t], 4)
+        scales = r.vector(r.child(q, 2), 'f')
+        zero_points = r.vector(r.child(q, 3), 'q')
+        if not scales:
+            raise ValueError("tensor %d has no quantization parameters" % t)
+        return scales, zero_points or [0]
+
+    def tensor_type(t):
+        return r.scalar(tensors[t], 1, 'b', 0)
+
+    def tensor_bytes(t):
+        buffer = buffers[r.scalar(tensors[t], 2, 'I', 0)]
+        return bytes(r.vector(r.child(buffer, 0), 'B'))
+
+    current = r.vector(r.child(graph, 1), 'i')[0]
+    layers = []
+    input_quant = None
+    softmax_beta = None
+
+    for op in r.tables(r.child(graph, 3)):
+        code = codes[r.scalar(op, 0, 'I', 0)]
+        # Old converters only set the deprecated int8 code
+        opcode = max(r.scalar(code, 3, 'i', 0), r.scalar(code, 0, 'b', 0))
+        inputs = r.vector(r.child(op, 1), 'i')
+        output = r.vector(r.child(op, 2), 'i')[0]
+        if inputs[0] != current:
+            raise ValueError("graph is not a single chain")
+        if softmax_beta is not None and opcode != OP_DEQUANTIZE:
+            raise ValueError("operator after SOFTMAX")
+
+        if opcode == OP_QUANTIZE:
+            if layers:
+                raise ValueError("QUANTIZE inside the graph")
+        elif opcode == OP_RESHAPE:
+            pass
+        elif opcode == OP_FULLY_CONNECTED:
+            x, w, b = inputs[0], inputs[1], inputs[2] if len(inputs) > 2 else -1
+            if tensor_type(x) != TYPE_INT8 or tensor_type(w) != TYPE_INT8:
+                raise ValueError("FULLY_CONNECTED is not int8 (float model?)")
+            outputs, n_in = r.vector(r.child(tensors[w], 0), 'i')
+            in_scales, in_zps = quantization(x)
+            w_scales, w_zps = quantization(w)
+            out_scales, out_zps = quantization(output)
+            if any(w_zps):
+                raise ValueError("asymmetric weights")
+            if len(w_scales) not in (1, outputs):
+                raise ValueError("bad filter scales")
+            if not layers:
+                input_quant = (in_scales[0], in_zps[0])
+
+            weights = list(struct.unpack('<%db' % (outputs * n_in), tensor_bytes(w)))
+            bias = [0] * outputs
+            if b >= 0:
+                if tensor_type(b) != TYPE_INT32:
+                    raise ValueError("bias is not int32")
+                bias = list(struct.unpack('<%di' % outputs, tensor_bytes(b)))
+
+            options = r.child(op, 4)
+            activation = r.scalar(options, 0, 'B', ACT_NONE)
+            if activation not in (ACT_NONE, ACT_RELU, ACT_RELU6):
+                raise ValueError("unsupported fused activation")
+            layers.append({
+                'inputs': n_in, 'outputs': outputs,
+                'weights': weights, 'bias': bias,
+                'input_scale': in_scales[0], 'input_zero_point': in_zps[0],
+                'filter_scales': w_scales * (outputs if len(w_scales) == 1 else 1),
+                'output_scale': out_scales[0], 'output_zero_point': out_zps[0],
+                'activation': activation,
+            })
+        elif opcode == OP_RELU:
+            if not layers:
+                raise ValueError("RELU before any layer")
+            if layers[-1]['activation'] == ACT_NONE:
+                layers[-1]['activation'] = ACT_RELU
+        elif opcode == OP_SOFTMAX:
+            if not layers:
+                raise ValueError("SOFTMAX before any layer")
+            softmax_beta = r.scalar(r.child(op, 4), 0, 'f', 1.0)
+        elif opcode == OP_DEQUANTIZE:
+            pass
+        else:
+            raise ValueError("unsupported operator %d" % opcode)
+        current = output
+
+    if not layers:
+        raise ValueError("no FULLY_CONNECTED layers")
+
+    return {
+        'input_scale': input_quant[0],
+        'input_zero_point': input_quant[1],
+        'layers': layers,
+        'softmax_beta': softmax_beta,
+        'crc32': zlib.crc32(data) & 0xFFFFFFFF,
+    }
+
+
+def load_scaler(path):
+    """Read FEATURE_MEAN / FEATURE_SCALE from a generated scaler_params.h."""
+    text = Path(path).read_text()
+
+    def array(name):
+        match = re.search(name + r'\s*\[[^\]]*\]\s*=\s*\{([^}]*)\}', text)
+        if not match:
+            raise ValueError("%s not found in %s" % (name, path))
+        return [float(v.rstrip('fF')) for v in re.findall(r'[-+0-9.eE]+[fF]?', match.group(1))]
+
+    return array('FEATURE_MEAN'), array('FEATURE_SCALE')
+
+
+# ============================================================================
+# Integer Reference (TFLite fixed-point semantics, bit-exact with the C++)
+# ============================================================================
+
+INT32_MIN = -(1 << 31)
+INT32_MAX = (1 << 31) - 1
+
+
+def f32(x):
+    """Round a Python float to the nearest float32."""
+    return struct.unpack('<f', struct.pack('<f', x))[0]
+
+
+def round_half_away(x):
+    """C round()/roundf()."""
+    return math.floor(x + 0.5) if x >= 0 else -math.floor(-x + 0.5)
+
+
+def quantize_multiplier(real):
+    if real == 0.0:
+        return 0, 0
+    q, shift = math.frexp(real)
+    fixed = round_half_away(q * (1 << 31))
+    if fixed == (1 << 31):
+        fixed //= 2
+        shift += 1
+    if shift < -31:
+        return 0, 0
+    return fixed, shift
+
+
+def saturating_rounding_doubling_high_mul(a, b):
+    if a == b == INT32_MIN:
+        return INT32_MAX
+    ab = a * b
+    t = ab + ((1 << 30) if ab >= 0 else 1 - (1 << 30))
+    q = abs(t) >> 31
+    return q if t >= 0 else -q
+
+
+def rounding_divide_by_pot(x, exponent):
+    mask = (1 << exponent) - 1
+    remainder = x & mask
+    threshold = (mask >> 1) + (1 if x < 0 else 0)
+    return (x >> exponent) + (1 if remainder > threshold else 0)
+
+
+def multiply_by_quantized_multiplier(x, multiplier, shift):
+    left = shift if shift > 0 else 0
+    right = 0 if shift > 0 else -shift
+    return rounding_divide_by_pot(
+        saturating_rounding_doubling_high_mul(x << left, multiplier), right)
+
+
+def prepare(model, mean, scale):
+    """Fold the scaler and zero points; compute per-channel multipliers."""
+    n_features = model['layers'][0]['inputs']
+    if len(mean) != n_features or len(scale) != n_features:
+        raise ValueError("scaler has %d/%d features, model expects %d"
+                         % (len(mean), len(scale), n_features))
+
+    # scaled = (x - mean) / scale;  q = round(scaled / s_in) + zp
+    #   =>  q = round(x * mul + offset)
+    s_in = model['input_scale']
+    zp_in = model['input_zero_point']
+    input_mul = [f32(1.0 / (s * s_in)) for s in scale]
+    input_offset = [f32(zp_in - m / (s * s_in)) for m, s in zip(mean, scale)]
+
+    layers = []
+    for layer in model['layers']:
+        n_in, n_out = layer['inputs'], layer['outputs']
+        w = layer['weights']
+        zp_out = layer['output_zero_point']
+        act_min, act_max = -128, 127
+        if layer['activation'] in (ACT_RELU, ACT_RELU6):
+            act_min = max(zp_out, -128)
+        if layer['activation'] == ACT_RELU6:
+            act_max = min(zp_out + round_half_away(f32(6.0 / layer['output_scale'])), 127)
+
+        bias, multiplier, shift = [], [], []
+        for o in range(n_out):
+            row_sum = sum(w[o * n_in:(o + 1) * n_in])
+            bias.append(layer['bias'][o] - layer['input_zero_point'] * row_sum)
+            real = layer['input_scale'] * layer['filter_scales'][o] / layer['output_scale']
+            m, s = quantize_multiplier(real)
+            multiplier.append(m)
+            shift.append(s)
+
+        layers.append({
+            'inputs': n_in, 'outputs': n_out, 'weights': w, 'bias': bias,
+            'multiplier': multiplier, 'shift': shift,
+            'zero_point': zp_out, 'act_min': act_min, 'act_max': act_max,
+        })
+
+    return {
+        'input_mul': input_mul, 'input_offset': input_offset,
+        'layers': layers,
+        'logit_scale': model['layers'][-1]['output_scale'],
+        'logit_zero_point': model['layers'][-1]['output_zero_point'],
+        'softmax_beta': model['softmax_beta'] if model['softmax_beta'] is not None else 1.0,
+        'crc32': model['crc32'],
+    }
+
+
+def reference_quantize(compiled, features):
+    q = []
+    for x, mul, offset in zip(features, compiled['input_mul'], compiled['input_offset']):
+        v = f32(f32(f32(x) * mul) + offset)
+        q.append(max(-128, min(127, round_half_away(v))))
+    return q
+
+
+def reference_invoke(compiled, features):
+    x = reference_quantize(compiled, features)
+    for layer in compiled['layers']:
+        n_in = layer['inputs']
+        w = layer['weights']
+        y = []
+        for o in range(layer['outputs']):
+            acc = layer['bias'][o] + sum(w[o * n_in + i] * x[i] for i in range(n_in))
+            acc = multiply_by_quantized_multiplier(acc, layer['multiplier'][o], layer['shift'][o])
+            acc += layer['zero_point']
+            y.append(max(layer['act_min'], min(layer['act_max'], acc)))
+        x = y
+    return x
+
+
+# ============================================================================
+# Code Generation
+# ============================================================================
+
+def c_float(v):
+    text = '%.9g' % f32(v)
+    if 'e' not in text and '.' not in text and 'n' not in text:
+        text += '.0'
+    return text + 'f'
+
+
+def c_array(ctype, name, values, per_line, fmt=str):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('    ' + ', '.join(fmt(v) for v in values[i:i + per_line]) + ',')
+    if lines:
+        lines[-1] = lines[-1][:-1]
+    return 'constexpr %s %s[%d] = {\n%s\n};\n' % (ctype, name, len(values), '\n'.join(lines))
+
+
+def emit_layer(l, layer):
+    n_in, n_out = layer['inputs'], layer['outputs']
+    p = 'MODEL_L%d_' % l
+
+    code = []
+    code.append('// Layer %d: %d -> %d' % (l, n_in, n_out))
+    code.append(c_array('int8_t', p + 'WEIGHTS', layer['weights'], 16))
+    code.append(c_array('int32_t', p + 'BIAS', layer['bias'], 8))
+    code.append(c_array('int32_t', p + 'MULTIPLIER', layer['multiplier'], 6))
+    code.append(c_array('int8_t', p + 'SHIFT', layer['shift'], 16))
+
+    body = []
+    body.append('static inline void compiledLayer%d(const int8_t* x, int8_t* y) {' % l)
+    body.append('    for (int o = 0; o < %d; o++) {' % n_out)
+    body.append('        int32_t acc = %sBIAS[o] + dotInt8(%sWEIGHTS + o * %d, x, %d);'
+                % (p, p, n_in, n_in))
+    body.append('        y[o] = compiledRequantize(acc, %sMULTIPLIER[o], %sSHIFT[o], %d, %d, %d);'
+                % (p, p, layer['zero_point'], layer['act_min'], layer['act_max']))
+    body.append('    }')
+    body.append('}')
+    code.append('\n'.join(body) + '\n')
+    return '\n'.join(code)
+
+
+def generate_header(compiled, source_name):
+    layers = compiled['layers']
+    n_in = layers[0]['inputs']
+    n_out = layers[-1]['outputs']
+    max_width = max(max(l['inputs'], l['outputs']) for l in layers)
+    beta_scale = compiled['softmax_beta'] * compiled['logit_scale']
+    exp_table = [math.exp(-d * beta_scale) for d in range(256)]
+    sizes = ' -> '.join([str(n_in)] + [str(l['outputs']) for l in layers])
+
+    out = []
+    out.append('''/**
+ * Compiled Sleep Stage Model (generated - do not edit)
+ * ====================================================
+ *
+ * Generated by model-training/scripts/compile_model.py from %s
+ * (CRC32 0x%08X) and scaler_params.h. Network: %s.
+ *
+ * Weights and requantization parameters are constexpr (flash only); the
+ * feature scaler is folded into the input quantization and the input zero
+ * point into the first layer's bias. Working memory is two stack buffers.
+ */
+
+#ifndef MODEL_COMPILED_H
+#define MODEL_COMPILED_H
+
+#include <stdint.h>
+#include <math.h>
+#include "processing/int8_mlp.h"   // Fixed-point helpers, dotInt8()
+
+#define COMPILED_MODEL_AVAILABLE    1
+#define COMPILED_MODEL_CRC32        0x%08XUL
+#define COMPILED_MODEL_INPUTS       %d
+#define COMPILED_MODEL_OUTPUTS      %d
+#define COMPILED_MODEL_LAYERS       %d
+#define COMPILED_MODEL_MAX_WIDTH    %d
+
+
+static inline int8_t compiledRequantize(int32_t acc, int32_t multiplier, int shift,
+                                        int32_t zeroPoint, int32_t actMin, int32_t actMax) {
+    acc = multiplyByQuantizedMultiplier(acc, multiplier, shift) + zeroPoint;
+    if (acc < actMin) acc = actMin;
+    if (acc > actMax) acc = actMax;
+    return (int8_t)acc;
+}
+
+// Input: q = round(feature * MUL + OFFSET), i.e. the scaler and the input
+// quantization in one multiply-add''' % (source_name, compiled['crc32'], sizes, compiled['crc32'],
+       n_in, n_out, len(layers), max_width))
+
+    out.append(c_array('float', 'MODEL_INPUT_MUL', compiled['input_mul'], 6, c_float))
+    out.append(c_array('float', 'MODEL_INPUT_OFFSET', compiled['input_offset'], 6, c_float))
+    out.append('''static inline void compiledModelQuantize(const float* features, int8_t* q) {
+    for (int i = 0; i < COMPILED_MODEL_INPUTS; i++) {
+        int32_t v = (int32_t)roundf(features[i] * MODEL_INPUT_MUL[i] + MODEL_INPUT_OFFSET[i]);
+        q[i] = (int8_t)(v < -128 ? -128 : (v > 127 ? 127 : v));
+    }
+}
+''')
+
+    for l, layer in enumerate(layers):
+        out.append(emit_layer(l, layer))
+
+    out.append('// Softmax: exp(-d * beta * logitScale) for logit differences d = 0..255')
+    out.append(c_array('float', 'MODEL_SOFTMAX_EXP', exp_table, 6, c_float))
+
+    calls = []
+    for l in range(len(layers)):
+        src = 'a' if l % 2 == 0 else 'b'
+        dst = 'b' if l % 2 == 0 else 'a'
+        if l == len(layers) - 1:
+            dst = 'logits'
+        calls.append('    compiledLayer%d(%s, %s);' % (l, src, dst))
+
+    out.append('''/**
+ * Run the network on one epoch of raw (unscaled) features.
+ *
+ * @param features COMPILED_MODEL_INPUTS raw feature values
+ * @param logits Output, COMPILED_MODEL_OUTPUTS int8 logits
+ */
+static inline void compiledModelInvoke(const float* features, int8_t* logits) {
+    int8_t a[COMPILED_MODEL_MAX_WIDTH];
+    int8_t b[COMPILED_MODEL_MAX_WIDTH];
+    compiledModelQuantize(features, a);
+%s
+    (void)b;
+}
+
+static inline int compiledModelArgmax(const int8_t* logits) {
+    int best = 0;
+    for (int i = 1; i < COMPILED_MODEL_OUTPUTS; i++) {
+        if (logits[i] > logits[best]) best = i;
+    }
+    return best;
+}
+
+static inline void compiledModelSoftmax(const int8_t* logits, float* probabilities) {
+    int8_t maxLogit = logits[compiledModelArgmax(logits)];
+    float sum = 0.0f;
+    for (int i = 0; i < COMPILED_MODEL_OUTPUTS; i++) {
+        probabilities[i] = MODEL_SOFTMAX_EXP[maxLogit - logits[i]];
+        sum += probabilities[i];
+    }
+    for (int i = 0; i < COMPILED_MODEL_OUTPUTS; i++) {
+        probabilities[i] /= sum;
+    }
+}
+
+#endif // MODEL_COMPILED_H
+''' % '\n'.join(calls))
+
+    return '\n'.join(out)
+
+
+def generate_golden(compiled, mean, scale, count, seed):
+    """Random in-distribution feature vectors and their expected logits."""
+    rng = random.Random(seed)
+    n_in = compiled['layers'][0]['inputs']
+    n_out = compiled['layers'][-1]['outputs']
+
+    features, logits = [], []
+    for _ in range(count):
+        x = [f32(m + s * rng.gauss(0.0, 1.5)) for m, s in zip(mean, scale)]
+        features.extend(x)
+        logits.extend(reference_invoke(compiled, x))
+
+    return '''/**
+ * Golden Vectors for model_compiled.h (generated - do not edit)
+ * =============================================================
+ *
+ * Generated by model-training/scripts/compile_model.py together with
+ * include/model_compiled.h (model CRC32 0x%08X). Logits come from the
+ * compiler's exact integer reference implementation.
+ */
+
+#ifndef GOLDEN_VECTORS_H
+#define GOLDEN_VECTORS_H
+
+#include <stdint.h>
+
+#define GOLDEN_MODEL_CRC32      0x%08XUL
+#define GOLDEN_VECTOR_COUNT     %d
+#define GOLDEN_INPUTS           %d
+#define GOLDEN_OUTPUTS          %d
+
+%s
+%s
+#endif // GOLDEN_VECTORS_H
+''' % (compiled['crc32'], compiled['crc32'], count, n_in, n_out,
+       c_array('float', 'GOLDEN_FEATURES', features, 6, c_float),
+       c_array('int8_t', 'GOLDEN_LOGITS', logits, n_out))
+
+
+def check_against_tflite(tflite_path, compiled, mean, scale, count=200, seed=1):
+    """Compare argmax with the TFLite interpreter, when TensorFlow is installed."""
+    try:
+        import numpy as np
+        import tensorflow as tf
+    except ImportError:
+        print("  (TensorFlow not installed - skipping interpreter cross-check)")
+        return
+
+    interpreter = tf.lite.Interpreter(model_path=str(tflite_path))
+    interpreter.allocate_tensors()
+    inp = interpreter.get_input_details()[0]
+    out = interpreter.get_output_details()[0]
+    rng = random.Random(seed)
+
+    agree = 0
+    for _ in range(count):
+        x = [f32(m + s * rng.gauss(0.0, 1.5)) for m, s in zip(mean, scale)]
+        scaled = np.array([[(v - m) / s for v, m, s in zip(x, mean, scale)]], dtype=np.float32)
+        if inp['dtype'] == np.int8:
+            s_in, zp_in = inp['quantization']
+            scaled = np.clip(np.round(scaled / s_in) + zp_in, -128, 127).astype(np.int8)
+        interpreter.set_tensor(inp['index'], scaled)
+        interpreter.invoke()
+        expected = int(np.argmax(interpreter.get_tensor(out['index'])[0]))
+        logits = reference_invoke(compiled, x)
+        agree += int(expected == logits.index(max(logits)))
+    print("  Argmax agreement with tf.lite.Interpreter: %d/%d" % (agree, count))
+
+
+# ============================================================================
+# Entry Point
+# ============================================================================
+
+def compile_model(tflite_path, scaler_path, output_path, golden_path=None,
+                  n_golden=32, seed=0):
+    model = load_tflite(tflite_path)
+    mean, scale = load_scaler(scaler_path)
+    compiled = prepare(model, mean, scale)
+
+    output_path = Path(output_path)
+    output_path.parent.mkdir(parents=True, exist_ok=True)
+    output_path.write_text(generate_header(compiled, Path(tflite_path).name))
+
+    sizes = [compiled['layers'][0]['inputs']] + [l['outputs'] for l in compiled['layers']]
+    flash = sum(l['inputs'] * l['outputs'] + 9 * l['outputs'] for l in compiled['layers'])
+    print("Compiled %s: %s, ~%.1f KB of constants -> %s"
+          % (Path(tflite_path).name, ' -> '.join(map(str, sizes)), flash / 1024.0, output_path))
+
+    if golden_path:
+        golden_path = Path(golden_path)
+        golden_path.parent.mkdir(parents=True, exist_ok=True)
+        golden_path.write_text(generate_golden(compiled, mean, scale, n_golden, seed))
+        print("  %d golden vectors -> %s" % (n_golden, golden_path))
+
+    check_against_tflite(tflite_path, compiled, mean, scale)
+    return compiled
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Compile sleep_model.tflite into a C++ header for the ESP32'
+    )
+    parser.add_argument(
+        '--tflite', type=str, required=True,
+        help='Quantized (int8) TFLite model'
+    )
+    parser.add_argument(
+        '--scaler', type=str, required=True,
+        help='scaler_params.h from the same training run'
+    )
+    parser.add_argument(
+        '--output', type=str, default='model_compiled.h',
+        help='Generated model header'
+    )
+    parser.add_argument(
+        '--golden', type=str, default=None,
+        help='Generated golden-vector header for test/test_compiled_model'
+    )
+    parser.add_argument(
+        '--n_golden', type=int, default=32,
+        help='Number of golden vectors'
+    )
+    parser.add_argument(
+        '--seed', type=int, default=0,
+        help='Random seed for the golden vectors'
+    )
+
+    args = parser.parse_args()
+    compile_model(args.tflite, args.scaler, args.output, args.golden, args.n_golden, args.seed)
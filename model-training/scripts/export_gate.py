@@ -0,0 +1,240 @@
+#!/usr/bin/env python3
+"""
+Export the IMU-Only Gate for the Firmware Classification Cascade
+=================================================================
+
+Trains the first stage of the firmware cascade
+(firmware/src/processing/imu_gate.h): a multinomial logistic regression
+on the 50 IMU features only. On device, an epoch whose gate probability
+reaches GATE_THRESHOLD is decided there; the PPG/HRV features and the
+full model run only for the rest.
+
+The threshold is the lowest one at which the epochs the gate decides on
+held-out training nights are still classified at least as accurately as
+--target_accuracy, so the cheap path takes as many epochs as it can
+without costing accuracy. The StandardScaler is folded into the weights
+(w / scale, b - w . mean / scale) so the firmware feeds raw features.
+
+evaluate_cascade() replays test nights through gate + full model and
+reports the fraction of epochs gated, the cascade accuracy and, given
+per-path costs measured on device ([CASCADE] log line), the CPU saving.
+
+Usage (CSV of per-epoch features in firmware order plus Sleep_Stage):
+    python export_gate.py \\
+        --features ../models/tflite_4class/train_features.csv \\
+        --output ../models/tflite_4class/gate_params.h
+"""
+
+import argparse
+from pathlib import Path
+
+import numpy as np
+
+from export_transitions import CLASS_NAMES, STAGE_TO_CLASS
+
+
+# IMU block of the firmware feature vector (EpochFeatures::IDX_PPG_START)
+N_GATE_FEATURES = 50
+
+
+def to_class_array(labels):
+    """Stage labels ('W', 'N1', ...) or class ids -> int array."""
+    return np.array([STAGE_TO_CLASS[s] if isinstance(s, str) else int(s) for s in labels])
+
+
+def fit_gate(X, y, seed=42):
+    """
+    Fit the gate; returns (weights, bias) with the scaler folded in.
+    weights: (classes, features), applied to raw features.
+    """
+    from sklearn.linear_model import LogisticRegression
+    from sklearn.preprocessing import StandardScaler
+
+    scaler = StandardScaler().fit(X)
+    clf = LogisticRegression(max_iter=2000, random_state=seed)
+    clf.fit(scaler.transform(X), y)
+
+    scale = np.where(scaler.scale_ > 0, scaler.scale_, 1.0)
+    weights = clf.coef_ / scale
+    bias = clf.intercept_ - weights @ scaler.mean_
+    return weights, bias
+
+
+def gate_probabilities(weights, bias, X):
+    """Softmax over the gate logits, exactly as IMUGate::classify()."""
+    logits = X @ weights.T + bias
+    logits -= logits.max(axis=1, keepdims=True)
+    p = np.exp(logits)
+    return p / p.sum(axis=1, keepdims=True)
+
+
+def choose_threshold(probs, y, target_accuracy, min_fraction=0.01):
+    """
+    Lowest threshold whose gated epochs reach target_accuracy.
+    Returns 2.0 (gate never fires) if none does.
+    """
+    confidence = probs.max(axis=1)
+    correct = probs.argmax(axis=1) == y
+    for threshold in np.arange(0.50, 1.00, 0.01):
+        gated = confidence >= threshold
+        if gated.mean() < min_fraction:
+            break
+        if correct[gated].mean() >= target_accuracy:
+            return float(round(threshold, 2))
+    return 2.0
+
+
+def evaluate_cascade(weights, bias, threshold, X_imu, y, full_predictions=None,
+                     gate_cost_ms=None, full_cost_ms=None):
+    """
+    Replay epochs through the cascade.
+
+    Parameters
+    ----------
+    X_imu : (n, 50) IMU features
+    y : class ids
+    full_predictions : full-model class ids for the same epochs (optional)
+    gate_cost_ms, full_cost_ms : per-epoch CPU time of each path on device
+
+    Returns dict with gated_fraction, gate_accuracy and, when available,
+    cascade_accuracy, full_accuracy and cpu_saving.
+    """
+    probs = gate_probabilities(weights, bias, X_imu)
+    gated = probs.max(axis=1) >= threshold
+    gate_pred = probs.argmax(axis=1)
+
+    result = {
+        'gated_fraction': float(gated.mean()),
+        'gate_accuracy': float((gate_pred[gated] == y[gated]).mean()) if gated.any() else float('nan'),
+    }
+    if full_predictions is not None:
+        cascade = np.where(gated, gate_pred, full_predictions)
+        result['cascade_accuracy'] = float((cascade == y).mean())
+        result['full_accuracy'] = float((full_predictions == y).mean())
+    if gate_cost_ms and full_cost_ms:
+        # Gated epochs cost the IMU path only; the rest pay for both
+        spent = gate_cost_ms + (1.0 - result['gated_fraction']) * full_cost_ms
+        result['cpu_saving'] = 1.0 - spent / full_cost_ms
+    return result
+
+
+def generate_header(weights, bias, threshold, n_train):
+    k, n = weights.shape
+
+    def row(values):
+        return ', '.join('%.8ef' % v for v in values)
+
+    lines = [
+        '/**',
+        ' * IMU Gate Parameters',
+        ' * ===================',
+        ' * ',
+        ' * Generated by model-training/scripts/export_gate.py from %d training' % n_train,
+        ' * epochs. Used by processing/imu_gate.h.',
+        ' * ',
+        ' * Linear softmax over the %d IMU features, scaler folded in.' % n,
+        ' * Order: ' + ', '.join(CLASS_NAMES),
+        ' */',
+        '',
+        '#ifndef GATE_PARAMS_H',
+        '#define GATE_PARAMS_H',
+        '',
+        '#define GATE_N_FEATURES %d' % n,
+        '#define GATE_N_CLASSES %d' % k,
+        '',
+        '#define GATE_THRESHOLD %.2ff' % threshold,
+        '',
+        'const float GATE_WEIGHTS[GATE_N_CLASSES * GATE_N_FEATURES] = {',
+    ]
+    for c in range(k):
+        lines.append('    // %s' % CLASS_NAMES[c])
+        for i in range(0, n, 5):
+            lines.append('    %s,' % row(weights[c, i:i + 5]))
+    lines += [
+        '};',
+        '',
+        'const float GATE_BIAS[GATE_N_CLASSES] = {%s};' % row(bias),
+        '',
+        '#endif // GATE_PARAMS_H',
+        '',
+    ]
+    return '\n'.join(lines)
+
+
+def export_gate(X_train, y_train, output_path, target_accuracy=0.90,
+                validation_fraction=0.2, seed=42):
+    """
+    Fit the gate, pick its threshold on a held-out split and write
+    gate_params.h.
+
+    Parameters
+    ----------
+    X_train : (n, >= 50) features in firmware order; only the IMU block is used
+    y_train : stage labels or class ids
+
+    Returns (weights, bias, threshold).
+    """
+    X = np.asarray(X_train, dtype=np.float64)[:, :N_GATE_FEATURES]
+    y = to_class_array(y_train)
+
+    rng = np.random.RandomState(seed)
+    order = rng.permutation(len(y))
+    n_val = int(len(y) * validation_fraction)
+    val, fit = order[:n_val], order[n_val:]
+
+    weights, bias = fit_gate(X[fit], y[fit], seed)
+    threshold = choose_threshold(gate_probabilities(weights, bias, X[val]), y[val],
+                                 target_accuracy)
+
+    # Refit on everything; the threshold stays
+    weights, bias = fit_gate(X, y, seed)
+    Path(output_path).write_text(generate_header(weights, bias, threshold, len(y)))
+
+    print("IMU gate (%d epochs, threshold %.2f, target accuracy %.0f%%) -> %s"
+          % (len(y), threshold, target_accuracy * 100, output_path))
+    if threshold > 1.0:
+        print("  Gate never reaches the target; every epoch runs the full model")
+    return weights, bias, threshold
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Export the IMU-only gate for the firmware cascade'
+    )
+    parser.add_argument(
+        '--features', type=str, required=True,
+        help='CSV of per-epoch features (firmware order) with a Sleep_Stage column'
+    )
+    parser.add_argument(
+        '--output', type=str, default='gate_params.h',
+        help='Output header'
+    )
+    parser.add_argument(
+        '--target_accuracy', type=float, default=0.90,
+        help='Minimum accuracy on the epochs the gate decides'
+    )
+    parser.add_argument(
+        '--gate_cost_ms', type=float, default=None,
+        help='Per-epoch CPU time of the IMU path on device (for the saving estimate)'
+    )
+    parser.add_argument(
+        '--full_cost_ms', type=float, default=None,
+        help='Per-epoch CPU time of the full path on device'
+    )
+
+    args = parser.parse_args()
+    import pandas as pd
+    df = pd.read_csv(args.features)
+    df = df[df['Sleep_Stage'].isin(list(STAGE_TO_CLASS))]
+    feature_cols = [c for c in df.columns if c not in ('Sleep_Stage', 'participant')]
+    X = df[feature_cols].values
+    weights, bias, threshold = export_gate(X, df['Sleep_Stage'].values, args.output,
+                                           args.target_accuracy)
+
+    stats = evaluate_cascade(weights, bias, threshold, X[:, :N_GATE_FEATURES],
+                             to_class_array(df['Sleep_Stage'].values),
+                             gate_cost_ms=args.gate_cost_ms, full_cost_ms=args.full_cost_ms)
+    print("  Gated: %.1f%% of epochs, gate accuracy %.1f%%"
+          % (stats['gated_fraction'] * 100, stats['gate_accuracy'] * 100))
+    if 'cpu_saving' in stats:
+        print("  Estimated CPU saving: %.0f%%" % (stats['cpu_saving'] * 100))
@@ -0,0 +1,275 @@
+#!/usr/bin/env python3
+"""
+Train and Export the GRU Sequence Model for the Firmware
+=========================================================
+
+The MLP classifies each 30 s epoch on its own. This trains a small GRU
+over whole nights instead. On the device it runs one step per epoch, and
+the hidden state carries the night so far. Nothing is re-run over a
+history window.
+
+    features (72) -> GRU(units, reset_after=True) -> Dense(4, softmax)
+
+Nights are cut into chunks of --chunk epochs for truncated
+backpropagation. Padding is masked out of the loss.
+
+Exports:
+
+    sequence_params.h   Weights for INFERENCE_ENGINE_SEQUENCE
+                        (firmware/src/processing/gru_step.h), Keras layout,
+                        with the StandardScaler folded into the kernel and
+                        input bias
+    sequence_step.tflite  The same model as a single step for
+                        INFERENCE_ENGINE_TFLM:
+                          inputs  (features[72] scaled, state[units])
+                          outputs (probabilities[4], state[units])
+                        The firmware feeds output 1 back into input 1 each
+                        epoch.
+    sequence_scaler.h   The step model's scaler, for package_model.py
+                        --scaler
+
+Usage (CSV of per-epoch features in firmware order, with participant and
+Sleep_Stage columns, rows in recorded order):
+    python export_sequence_model.py \\
+        --features ../models/tflite_4class/train_features.csv \\
+        --units 24 --output_dir ../models/tflite_4class
+"""
+
+import argparse
+import zlib
+from pathlib import Path
+
+import numpy as np
+
+from export_transitions import CLASS_NAMES, STAGE_TO_CLASS
+
+
+# ============================================================================
+# Training
+# ============================================================================
+
+def to_chunks(nights_X, nights_y, chunk):
+    """
+    Cut nights into [n, chunk, features] with a mask for the padding.
+    """
+    n_features = nights_X[0].shape[1]
+    X, Y, W = [], [], []
+    for x, y in zip(nights_X, nights_y):
+        for start in range(0, len(y), chunk):
+            xs, ys = x[start:start + chunk], y[start:start + chunk]
+            pad = chunk - len(ys)
+            X.append(np.vstack([xs, np.zeros((pad, n_features))]))
+            Y.append(np.concatenate([ys, np.zeros(pad, dtype=int)]))
+            W.append(np.concatenate([np.ones(len(ys)), np.zeros(pad)]))
+    return np.array(X, dtype=np.float32), np.array(Y), np.array(W, dtype=np.float32)
+
+
+def build_sequence_model(n_features, units, n_classes=len(CLASS_NAMES)):
+    import tensorflow as tf
+    inputs = tf.keras.Input(shape=(None, n_features), name='features')
+    h = tf.keras.layers.GRU(units, return_sequences=True, reset_after=True, name='gru')(inputs)
+    outputs = tf.keras.layers.Dense(n_classes, activation='softmax', name='head')(h)
+    return tf.keras.Model(inputs, outputs)
+
+
+def train_sequence_model(nights_X, nights_y, units=24, chunk=120, epochs=60,
+                         batch_size=16, learning_rate=0.003, patience=10):
+    """
+    Parameters
+    ----------
+    nights_X : list of (epochs, features) arrays, one per night, in order
+    nights_y : list of stage label arrays ('W', 'N1', ...) or class ids
+
+    Returns (model, mean, scale).
+    """
+    import tensorflow as tf
+
+    nights_y = [np.array([STAGE_TO_CLASS[s] if isinstance(s, str) else int(s) for s in y])
+                for y in nights_y]
+    stacked = np.vstack(nights_X)
+    mean = stacked.mean(axis=0)
+    scale = stacked.std(axis=0)
+    scale[scale == 0] = 1.0
+    scaled = [(x - mean) / scale for x in nights_X]
+
+    X, Y, W = to_chunks(scaled, nights_y, chunk)
+    model = build_sequence_model(X.shape[2], units)
+    model.compile(optimizer=tf.keras.optimizers.Adam(learning_rate),
+                  loss='sparse_categorical_crossentropy',
+                  weighted_metrics=['accuracy'])
+    model.fit(X, Y, sample_weight=W, validation_split=0.15, epochs=epochs,
+              batch_size=batch_size, verbose=2,
+              callbacks=[tf.keras.callbacks.EarlyStopping(
+                  patience=patience, restore_best_weights=True)])
+    return model, mean, scale
+
+
+def evaluate_sequence_model(model, mean, scale, nights_X, nights_y):
+    """Accuracy when each night is run from a zero state, as on the device."""
+    correct = total = 0
+    for x, y in zip(nights_X, nights_y):
+        y = np.array([STAGE_TO_CLASS[s] if isinstance(s, str) else int(s) for s in y])
+        p = model.predict(((x - mean) / scale)[None].astype(np.float32), verbose=0)[0]
+        correct += int((p.argmax(axis=1) == y).sum())
+        total += len(y)
+    return correct / max(total, 1)
+
+
+# ============================================================================
+# Export
+# ============================================================================
+
+def folded_weights(model, mean, scale):
+    """GRU and head weights with the scaler folded into the input side."""
+    kernel, recurrent, bias = model.get_layer('gru').get_weights()
+    dense_kernel, dense_bias = model.get_layer('head').get_weights()
+    folded_kernel = kernel / scale[:, None]
+    input_bias = bias[0] - (mean / scale) @ kernel
+    return {
+        'KERNEL': folded_kernel,
+        'RECURRENT_KERNEL': recurrent,
+        'INPUT_BIAS': input_bias,
+        'RECURRENT_BIAS': bias[1],
+        'DENSE_KERNEL': dense_kernel,
+        'DENSE_BIAS': dense_bias,
+    }
+
+
+def generate_header(weights):
+    n_inputs, gates = weights['KERNEL'].shape
+    units = gates // 3
+    n_classes = weights['DENSE_BIAS'].shape[0]
+    order = ['KERNEL', 'RECURRENT_KERNEL', 'INPUT_BIAS', 'RECURRENT_BIAS',
+             'DENSE_KERNEL', 'DENSE_BIAS']
+    blob = b''.join(np.asarray(weights[k], dtype='<f4').tobytes() for k in order)
+    sizes = {
+        'KERNEL': 'SEQUENCE_MODEL_INPUTS * 3 * SEQUENCE_MODEL_UNITS',
+        'RECURRENT_KERNEL': 'SEQUENCE_MODEL_UNITS * 3 * SEQUENCE_MODEL_UNITS',
+        'INPUT_BIAS': '3 * SEQUENCE_MODEL_UNITS',
+        'RECURRENT_BIAS': '3 * SEQUENCE_MODEL_UNITS',
+        'DENSE_KERNEL': 'SEQUENCE_MODEL_UNITS * SEQUENCE_MODEL_CLASSES',
+        'DENSE_BIAS': 'SEQUENCE_MODEL_CLASSES',
+    }
+
+    lines = [
+        '/**',
+        ' * GRU Sequence Model Parameters',
+        ' * =============================',
+        ' * ',
+        ' * Generated by model-training/scripts/export_sequence_model.py.',
+        ' * Used by processing/gru_step.h (INFERENCE_ENGINE_SEQUENCE).',
+        ' * Keras GRU layout (gates z, r, h), feature scaler folded in.',
+        ' * Order: ' + ', '.join(CLASS_NAMES),
+        ' */',
+        '',
+        '#ifndef SEQUENCE_PARAMS_H',
+        '#define SEQUENCE_PARAMS_H',
+        '',
+        '#define SEQUENCE_MODEL_AVAILABLE    1',
+        '#define SEQUENCE_MODEL_CRC32        0x%08XUL' % (zlib.crc32(blob) & 0xFFFFFFFF),
+        '#define SEQUENCE_MODEL_INPUTS       %d' % n_inputs,
+        '#define SEQUENCE_MODEL_UNITS        %d' % units,
+        '#define SEQUENCE_MODEL_CLASSES      %d' % n_classes,
+        '',
+    ]
+    for name in order:
+        values = np.asarray(weights[name], dtype=np.float32).ravel()
+        lines.append('const float SEQUENCE_%s[%s] = {' % (name, sizes[name]))
+        for i in range(0, len(values), 8):
+            lines.append('    ' + ', '.join('%.8ef' % v for v in values[i:i + 8]) + ',')
+        lines += ['};', '']
+    lines += ['#endif // SEQUENCE_PARAMS_H', '']
+    return '\n'.join(lines)
+
+
+def export_step_tflite(model, path):
+    """
+    Single-step model with the state as an explicit input and output, for
+    the TFLM engine. Takes scaled features (the firmware scaler applies).
+    """
+    import tensorflow as tf
+
+    gru = model.get_layer('gru')
+    head = model.get_layer('head')
+    n_features = gru.get_weights()[0].shape[0]
+    units = gru.units
+
+    features = tf.keras.Input(shape=(n_features,), batch_size=1, name='features')
+    state = tf.keras.Input(shape=(units,), batch_size=1, name='state')
+    cell = tf.keras.layers.GRUCell(units, reset_after=True, name='gru_cell')
+    new_state, _ = cell(features, [state])
+    dense = tf.keras.layers.Dense(head.units, activation='softmax', name='head')
+    probabilities = dense(new_state)
+    step = tf.keras.Model([features, state], [probabilities, new_state])
+    cell.set_weights(gru.get_weights())
+    dense.set_weights(head.get_weights())
+
+    tflite = tf.lite.TFLiteConverter.from_keras_model(step).convert()
+
+    # The firmware expects probabilities first, state second
+    interpreter = tf.lite.Interpreter(model_content=tflite)
+    outputs = interpreter.get_output_details()
+    if outputs[0]['shape'][-1] != head.units or outputs[1]['shape'][-1] != units:
+        raise RuntimeError('unexpected output order in the converted step model')
+
+    Path(path).write_bytes(tflite)
+    return tflite
+
+
+def generate_scaler_header(mean, scale):
+    """FEATURE_MEAN / FEATURE_SCALE in the scaler_params.h format (load_scaler)."""
+    def array(name, values):
+        rows = ['    ' + ', '.join('%.8ef' % v for v in values[i:i + 8]) + ','
+                for i in range(0, len(values), 8)]
+        return ['const float %s[%d] = {' % (name, len(values))] + rows + ['};', '']
+
+    lines = [
+        '// Scaler of the GRU step model (sequence_step.tflite), for',
+        '// package_model.py --scaler. Generated by export_sequence_model.py.',
+        '',
+    ]
+    lines += array('FEATURE_MEAN', mean) + array('FEATURE_SCALE', scale)
+    return '\n'.join(lines)
+
+
+def export_sequence_model(model, mean, scale, output_dir):
+    """Write sequence_params.h, sequence_step.tflite and sequence_scaler.h."""
+    output_dir = Path(output_dir)
+    weights = folded_weights(model, mean, scale)
+    header_path = output_dir / 'sequence_params.h'
+    header_path.write_text(generate_header(weights))
+    tflite = export_step_tflite(model, output_dir / 'sequence_step.tflite')
+    (output_dir / 'sequence_scaler.h').write_text(generate_scaler_header(mean, scale))
+
+    units = weights['RECURRENT_BIAS'].shape[0] // 3
+    print("Sequence model (GRU %d units) -> %s, %s (%d bytes)"
+          % (units, header_path, output_dir / 'sequence_step.tflite', len(tflite)))
+    return header_path
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Train and export the GRU sequence model for the firmware'
+    )
+    parser.add_argument(
+        '--features', type=str, required=True,
+        help='CSV of per-epoch features (firmware order) with participant and Sleep_Stage'
+    )
+    parser.add_argument(
+        '--output_dir', type=str, default='.',
+        help='Directory for sequence_params.h and sequence_step.tflite'
+    )
+    parser.add_argument('--units', type=int, default=24, help='GRU units (<= 64)')
+    parser.add_argument('--chunk', type=int, default=120, help='Training chunk in epochs')
+    parser.add_argument('--epochs', type=int, default=60, help='Training epochs')
+
+    args = parser.parse_args()
+    import pandas as pd
+    df = pd.read_csv(args.features)
+    df = df[df['Sleep_Stage'].isin(list(STAGE_TO_CLASS))]
+    feature_cols = [c for c in df.columns if c not in ('Sleep_Stage', 'participant')]
+    groups = [g for _, g in df.groupby('participant', sort=False)]
+    model, mean, scale = train_sequence_model(
+        [g[feature_cols].values for g in groups], [g['Sleep_Stage'].values for g in groups],
+        units=args.units, chunk=args.chunk, epochs=args.epochs)
+    export_sequence_model(model, mean, scale, args.output_dir)
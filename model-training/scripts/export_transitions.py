@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""
+Export the Sleep Stage Transition Model for the Firmware HMM Smoother
+======================================================================
+
+Estimates the 4-class hidden Markov model the firmware's HMMSmoother
+(firmware/src/processing/hmm_smoother.h) runs over the classifier output:
+
+    HMM_TRANSITION[i][j]   P(stage j at epoch t+1 | stage i at epoch t)
+    HMM_INITIAL[i]         P(first epoch of a night is stage i)
+    HMM_CLASS_PRIOR[i]     P(stage i) over all training epochs; the MLP
+                           posterior divided by this is the emission term
+
+from per-night hypnograms (one label per 30 s epoch, in order). Counts
+get add-`smoothing` (Laplace) so no transition is impossible.
+
+Usage (labels file: one night per line, space-separated stages):
+    python export_transitions.py \\
+        --labels ../models/tflite_4class/train_hypnograms.txt \\
+        --output ../models/tflite_4class/transition_params.h
+"""
+
+import argparse
+from pathlib import Path
+
+
+CLASS_NAMES = ['Wake', 'Light', 'Deep', 'REM']
+
+# DREAMT stage labels -> 4-class clinical-lite scheme
+STAGE_TO_CLASS = {'W': 0, 'N1': 1, 'N2': 1, 'N3': 2, 'R': 3}
+
+
+def to_classes(stages):
+    """Map stage labels (strings or class ints) to class indices, dropping unknowns."""
+    classes = []
+    for s in stages:
+        if isinstance(s, str):
+            if s in STAGE_TO_CLASS:
+                classes.append(STAGE_TO_CLASS[s])
+        elif 0 <= int(s) < len(CLASS_NAMES):
+            classes.append(int(s))
+    return classes
+
+
+def estimate_transitions(sequences, smoothing=1.0):
+    """
+    Maximum-likelihood HMM parameters from labelled nights.
+
+    Returns (transition, initial, prior) as nested lists of floats.
+    """
+    k = len(CLASS_NAMES)
+    counts = [[smoothing] * k for _ in range(k)]
+    initial = [smoothing] * k
+    totals = [smoothing] * k
+
+    for seq in sequences:
+        classes = to_classes(seq)
+        if not classes:
+            continue
+        initial[classes[0]] += 1
+        for c in classes:
+            totals[c] += 1
+        for a, b in zip(classes, classes[1:]):
+            counts[a][b] += 1
+
+    transition = [[c / sum(row) for c in row] for row in counts]
+    initial = [c / sum(initial) for c in initial]
+    prior = [c / sum(totals) for c in totals]
+    return transition, initial, prior
+
+
+def generate_header(transition, initial, prior, n_sequences, n_epochs):
+    k = len(CLASS_NAMES)
+
+    def row(values):
+        return ', '.join('%.6ff' % v for v in values)
+
+    lines = [
+        '/**',
+        ' * Sleep Stage Transition Model',
+        ' * ============================',
+        ' * ',
+        ' * Generated by model-training/scripts/export_transitions.py from',
+        ' * %d training nights (%d epochs). Used by processing/hmm_smoother.h.' % (n_sequences, n_epochs),
+        ' * ',
+        ' * Rows: stage at epoch t; columns: stage at epoch t+1.',
+        ' * Order: ' + ', '.join(CLASS_NAMES),
+        ' */',
+        '',
+        '#ifndef TRANSITION_PARAMS_H',
+        '#define TRANSITION_PARAMS_H',
+        '',
+        '#define HMM_N_STATES %d' % k,
+        '',
+        'const float HMM_TRANSITION[HMM_N_STATES][HMM_N_STATES] = {',
+    ]
+    for i in range(k):
+        lines.append('    {%s},   // %s' % (row(transition[i]), CLASS_NAMES[i]))
+    lines += [
+        '};',
+        '',
+        'const float HMM_INITIAL[HMM_N_STATES] = {%s};' % row(initial),
+        '',
+        'const float HMM_CLASS_PRIOR[HMM_N_STATES] = {%s};' % row(prior),
+        '',
+        '#endif // TRANSITION_PARAMS_H',
+        '',
+    ]
+    return '\n'.join(lines)
+
+
+def export_transition_matrix(sequences, output_path, smoothing=1.0):
+    """
+    Write transition_params.h for the firmware from labelled nights.
+
+    Parameters
+    ----------
+    sequences : iterable of sequences
+        One hypnogram per night: stage labels ('W', 'N1', ...) or class ids.
+    output_path : str or Path
+        Header to write.
+    """
+    sequences = [list(s) for s in sequences]
+    transition, initial, prior = estimate_transitions(sequences, smoothing)
+    n_epochs = sum(len(to_classes(s)) for s in sequences)
+    Path(output_path).write_text(
+        generate_header(transition, initial, prior, len(sequences), n_epochs))
+
+    print("Transition matrix (%d nights, %d epochs) -> %s" % (len(sequences), n_epochs, output_path))
+    for i, name in enumerate(CLASS_NAMES):
+        print("  %-5s " % name + ' '.join('%.3f' % p for p in transition[i]))
+    return transition, initial, prior
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Export the sleep stage HMM for the firmware smoother'
+    )
+    parser.add_argument(
+        '--labels', type=str, required=True,
+        help='Hypnograms, one night per line (space-separated stage labels)'
+    )
+    parser.add_argument(
+        '--output', type=str, default='transition_params.h',
+        help='Output header'
+    )
+    parser.add_argument(
+        '--smoothing', type=float, default=1.0,
+        help='Additive (Laplace) smoothing of the transition counts'
+    )
+
+    args = parser.parse_args()
+    nights = [line.split() for line in Path(args.labels).read_text().splitlines() if line.strip()]
+    export_transition_matrix(nights, args.output, args.smoothing)
@@ -0,0 +1,493 @@
+#!/usr/bin/env python3
+"""
+Export a Tree Ensemble for the Firmware
+=======================================
+
+Flattens a random forest or gradient-boosted ensemble into
+tree_params.h for INFERENCE_ENGINE_TREES
+(firmware/src/processing/tree_ensemble.h).
+
+Supported models:
+
+    RandomForestClassifier, ExtraTreesClassifier   (scikit-learn)
+    GradientBoostingClassifier                     (scikit-learn)
+    XGBClassifier                                  (xgboost, multi:softprob)
+
+A SleepStageClassifier saved by train_model.py works too (its .model is
+used), as long as it was trained on the firmware's 72 features in
+firmware order.
+
+Layout, per tree: 8-byte nodes in breadth-first order with the children
+of a node adjacent, so the firmware picks the child as
+next + (x > threshold) without a branch. Thresholds are rounded down to
+the largest float32 at which the trainer's split still goes left:
+
+    scikit-learn   left if x <= t   ->  largest float32 <= t
+    xgboost        left if x < t    ->  largest float32 <  t
+
+Missing values are not handled (the firmware never produces NaN
+features); xgboost's default directions are ignored.
+
+Forest leaves hold class distributions (averaged, as predict_proba).
+Boosted leaves hold one score with the learning rate folded in, summed
+per class on top of TREE_BASE_SCORE and passed through softmax. Stage
+labels are mapped to the firmware's 4 classes; a forest trained on the 5
+stages has N1 and N2 merged into Light in its leaves.
+
+Usage (train on a CSV of per-epoch features in firmware order with a
+Sleep_Stage column):
+    python export_tree_model.py \\
+        --features ../models/tflite_4class/train_features.csv \\
+        --model random_forest --output_dir ../models/tflite_4class
+
+or convert a saved model:
+    python export_tree_model.py --joblib models/sleep_stage_xgboost.joblib \\
+        --features ../models/tflite_4class/train_features.csv \\
+        --output_dir ../models/tflite_4class
+"""
+
+import argparse
+import math
+import struct
+import zlib
+from collections import deque
+from pathlib import Path
+
+from export_transitions import CLASS_NAMES, STAGE_TO_CLASS
+
+
+N_FIRMWARE_FEATURES = 72
+TREE_LEAF = 0xFF
+TREE_KIND_FOREST = 0
+TREE_KIND_BOOSTED = 1
+
+
+# ============================================================================
+# Float32 Thresholds
+# ============================================================================
+
+def _f32_bits(value):
+    return struct.unpack('<I', struct.pack('<f', value))[0]
+
+
+def _f32_from_bits(bits):
+    return struct.unpack('<f', struct.pack('<I', bits))[0]
+
+
+def _f32_below(value):
+    """Next float32 below a float32 value."""
+    if value == 0.0:
+        return -_f32_from_bits(1)
+    bits = _f32_bits(value)
+    return _f32_from_bits(bits - 1 if value > 0 else bits + 1)
+
+
+def float32_at_most(threshold):
+    """Largest float32 f with f <= threshold (float64)."""
+    if math.isinf(threshold):
+        return threshold
+    f = struct.unpack('<f', struct.pack('<f', threshold))[0]
+    return _f32_below(f) if f > threshold else f
+
+
+def float32_below(threshold):
+    """Largest float32 f with f < threshold (a float32 value)."""
+    return _f32_below(struct.unpack('<f', struct.pack('<f', threshold))[0])
+
+
+# ============================================================================
+# Tree Representation
+# ============================================================================
+
+class Node:
+    """Internal node (feature, threshold: right if x > threshold) or leaf (values)."""
+
+    def __init__(self, feature=None, threshold=None, left=None, right=None, values=None):
+        self.feature = feature
+        self.threshold = threshold
+        self.left = left
+        self.right = right
+        self.values = values
+
+    @property
+    def is_leaf(self):
+        return self.values is not None
+
+
+def class_map(classes):
+    """Model class labels -> firmware class ids."""
+    mapped = []
+    for c in classes:
+        if isinstance(c, str):
+            if c not in STAGE_TO_CLASS:
+                raise ValueError('unknown stage label %r' % c)
+            mapped.append(STAGE_TO_CLASS[c])
+        elif 0 <= int(c) < len(CLASS_NAMES):
+            mapped.append(int(c))
+        else:
+            raise ValueError('class %r is not a firmware class' % c)
+    return mapped
+
+
+def from_sklearn_tree(tree, leaf_values, node=0):
+    """
+    scikit-learn tree_ -> Node. leaf_values(node) gives a leaf's values.
+    """
+    left = tree.children_left[node]
+    if left == -1:
+        return Node(values=leaf_values(node))
+    return Node(feature=int(tree.feature[node]),
+                threshold=float32_at_most(float(tree.threshold[node])),
+                left=from_sklearn_tree(tree, leaf_values, left),
+                right=from_sklearn_tree(tree, leaf_values, tree.children_right[node]))
+
+
+def from_xgboost_dump(node, feature_names):
+    """One tree of Booster.get_dump(dump_format='json'), parsed -> Node."""
+    if 'leaf' in node:
+        return Node(values=[float(node['leaf'])])
+    split = node['split']
+    if feature_names and split in feature_names:
+        feature = feature_names.index(split)
+    else:
+        feature = int(split.lstrip('f'))
+    children = {child['nodeid']: child for child in node['children']}
+    return Node(feature=feature,
+                threshold=float32_below(float(node['split_condition'])),
+                left=from_xgboost_dump(children[node['yes']], feature_names),
+                right=from_xgboost_dump(children[node['no']], feature_names))
+
+
+# ============================================================================
+# Model Conversion
+# ============================================================================
+
+def convert_forest(model):
+    """RandomForest/ExtraTrees -> (trees, classes of each tree, base)."""
+    firmware_class = class_map(model.classes_)
+    k = len(CLASS_NAMES)
+
+    trees = []
+    for estimator in model.estimators_:
+        tree = estimator.tree_
+
+        def leaf_values(node, tree=tree):
+            counts = tree.value[node][0]
+            total = float(sum(counts))
+            values = [0.0] * k
+            for i, count in enumerate(counts):
+                values[firmware_class[i]] += float(count) / total
+            return values
+
+        trees.append(from_sklearn_tree(tree, leaf_values))
+    return TREE_KIND_FOREST, trees, [0] * len(trees), [0.0] * k
+
+
+def convert_gradient_boosting(model, n_features):
+    """GradientBoostingClassifier (multinomial) -> (kind, trees, classes, base)."""
+    import numpy as np
+
+    firmware_class = class_map(model.classes_)
+    if sorted(firmware_class) != list(range(len(CLASS_NAMES))):
+        raise ValueError('boosted models need exactly the 4 firmware classes, got %s'
+                         % list(model.classes_))
+
+    lr = model.learning_rate
+    trees, tree_class = [], []
+    for stage in model.estimators_:
+        for i, estimator in enumerate(stage):
+            tree = estimator.tree_
+            trees.append(from_sklearn_tree(
+                tree, lambda node, tree=tree: [lr * float(tree.value[node][0][0])]))
+            tree_class.append(firmware_class[i])
+
+    # The prior (init_) is what decision_function adds on top of the trees
+    zeros = np.zeros((1, n_features))
+    raw = model.decision_function(zeros)[0]
+    contribution = np.zeros(len(firmware_class))
+    for stage in model.estimators_:
+        for i, estimator in enumerate(stage):
+            contribution[i] += lr * estimator.predict(zeros)[0]
+    base = [0.0] * len(CLASS_NAMES)
+    for i, c in enumerate(firmware_class):
+        base[c] = float(raw[i] - contribution[i])
+    return TREE_KIND_BOOSTED, trees, tree_class, base
+
+
+def convert_xgboost(model):
+    """XGBClassifier (multi:softprob) -> (kind, trees, classes, base)."""
+    import json
+
+    firmware_class = class_map(model.classes_)
+    if sorted(firmware_class) != list(range(len(CLASS_NAMES))):
+        raise ValueError('boosted models need exactly the 4 firmware classes, got %s'
+                         % list(model.classes_))
+
+    booster = model.get_booster()
+    names = booster.feature_names
+    dumps = booster.get_dump(dump_format='json')
+    trees = [from_xgboost_dump(json.loads(d), names) for d in dumps]
+    tree_class = [firmware_class[i % len(firmware_class)] for i in range(len(trees))]
+    # base_score is added to every class and cancels in the softmax
+    return TREE_KIND_BOOSTED, trees, tree_class, [0.0] * len(CLASS_NAMES)
+
+
+def convert_model(model, n_features=N_FIRMWARE_FEATURES):
+    """Any supported ensemble -> (kind, trees, tree classes, base scores)."""
+    model = getattr(model, 'model', model)    # SleepStageClassifier wrapper
+    name = type(model).__name__
+    if name in ('RandomForestClassifier', 'ExtraTreesClassifier'):
+        return convert_forest(model)
+    if name == 'GradientBoostingClassifier':
+        return convert_gradient_boosting(model, n_features)
+    if name == 'XGBClassifier':
+        return convert_xgboost(model)
+    raise ValueError('unsupported model type %s' % name)
+
+
+# ============================================================================
+# Flattening
+# ============================================================================
+
+def flatten(tree):
+    """
+    Breadth-first node list and leaf values of one tree.
+
+    Nodes are (threshold, feature, next): internal nodes point at their
+    left child (right = next + 1), leaves at their index in the tree's
+    leaves.
+    """
+    nodes, leaves = [], []
+    queue = deque([tree])
+    queued = 1
+    while queue:
+        node = queue.popleft()
+        if node.is_leaf:
+            nodes.append((0.0, TREE_LEAF, len(leaves)))
+            leaves.append(node.values)
+        else:
+            nodes.append((node.threshold, node.feature, queued))
+            queue.extend([node.left, node.right])
+            queued += 2
+    if len(nodes) > 0xFFFF:
+        raise ValueError('tree of %d nodes (at most 65535)' % len(nodes))
+    return nodes, leaves
+
+
+def flatten_ensemble(kind, trees, tree_class, base):
+    """Everything tree_params.h holds, as a dict."""
+    nodes, roots, leaf_base, leaf_values = [], [], [], []
+    n_leaves = 0
+    for tree in trees:
+        tree_nodes, tree_leaves = flatten(tree)
+        roots.append(len(nodes))
+        leaf_base.append(n_leaves)
+        nodes += tree_nodes
+        for values in tree_leaves:
+            leaf_values += values
+        n_leaves += len(tree_leaves)
+    return {
+        'kind': kind,
+        'nodes': nodes,
+        'roots': roots,
+        'leaf_base': leaf_base,
+        'tree_class': tree_class,
+        'leaf_values': leaf_values,
+        'n_leaves': n_leaves,
+        'base': base,
+    }
+
+
+def predict_flat(flat, x):
+    """TreeEnsemble::predict() on one feature vector (for checking exports)."""
+    k = len(CLASS_NAMES)
+    forest = flat['kind'] == TREE_KIND_FOREST
+    scores = [0.0] * k if forest else list(flat['base'])
+    nodes = flat['nodes']
+    for t, root in enumerate(flat['roots']):
+        i = root
+        while nodes[i][1] != TREE_LEAF:
+            threshold, feature, nxt = nodes[i]
+            i = root + nxt + (1 if x[feature] > threshold else 0)
+        leaf = flat['leaf_base'][t] + nodes[i][2]
+        if forest:
+            for c in range(k):
+                scores[c] += flat['leaf_values'][leaf * k + c]
+        else:
+            scores[flat['tree_class'][t]] += flat['leaf_values'][leaf]
+    if forest:
+        return [s / len(flat['roots']) for s in scores]
+    top = max(scores)
+    exps = [math.exp(s - top) for s in scores]
+    return [e / sum(exps) for e in exps]
+
+
+# ============================================================================
+# Header
+# ============================================================================
+
+def _rows(values, fmt, per_line):
+    return ['    ' + ', '.join(fmt % v for v in values[i:i + per_line]) + ','
+            for i in range(0, len(values), per_line)]
+
+
+def generate_header(flat, n_features=N_FIRMWARE_FEATURES):
+    k = len(CLASS_NAMES)
+    forest = flat['kind'] == TREE_KIND_FOREST
+    blob = b''.join(struct.pack('<fBBH', t, f, 0, n) for t, f, n in flat['nodes'])
+    blob += struct.pack('<%df' % len(flat['leaf_values']), *flat['leaf_values'])
+    blob += struct.pack('<%df' % k, *flat['base'])
+    crc = zlib.crc32(blob) & 0xFFFFFFFF
+
+    lines = [
+        '/**',
+        ' * Tree Ensemble Parameters',
+        ' * ========================',
+        ' * ',
+        ' * Generated by model-training/scripts/export_tree_model.py.',
+        ' * Used by processing/tree_ensemble.h (INFERENCE_ENGINE_TREES).',
+        ' * %s, %d trees, %d nodes, %d leaves. Raw features, no scaler.'
+        % ('Random forest' if forest else 'Gradient-boosted trees',
+           len(flat['roots']), len(flat['nodes']), flat['n_leaves']),
+        ' * Order: ' + ', '.join(CLASS_NAMES),
+        ' */',
+        '',
+        '#ifndef TREE_PARAMS_H',
+        '#define TREE_PARAMS_H',
+        '',
+        '#define TREE_MODEL_AVAILABLE        1',
+        '#define TREE_MODEL_CRC32            0x%08XUL' % crc,
+        '#define TREE_MODEL_KIND             %s' % ('TREE_KIND_FOREST' if forest
+                                                     else 'TREE_KIND_BOOSTED'),
+        '#define TREE_MODEL_FEATURES         %d' % n_features,
+        '#define TREE_MODEL_CLASSES          %d' % k,
+        '#define TREE_MODEL_TREES            %d' % len(flat['roots']),
+        '#define TREE_MODEL_NODES            %d' % len(flat['nodes']),
+        '#define TREE_MODEL_LEAVES           %d' % flat['n_leaves'],
+        '#define TREE_MODEL_LEAF_VALUES      %s' % ('TREE_MODEL_CLASSES' if forest else '1'),
+        '',
+        '// {threshold, feature, reserved, next}',
+        'const TreeNode TREE_NODES[TREE_MODEL_NODES] = {',
+    ]
+    for t, f, n in flat['nodes']:
+        feature = 'TREE_LEAF' if f == TREE_LEAF else str(f)
+        lines.append('    {%.9ef, %s, 0, %d},' % (t, feature, n))
+    lines += ['};', '']
+    lines.append('const uint32_t TREE_ROOTS[TREE_MODEL_TREES] = {')
+    lines += _rows(flat['roots'], '%d', 12) + ['};', '']
+    lines.append('const uint32_t TREE_LEAF_BASE[TREE_MODEL_TREES] = {')
+    lines += _rows(flat['leaf_base'], '%d', 12) + ['};', '']
+    lines.append('const uint8_t TREE_CLASS[TREE_MODEL_TREES] = {')
+    lines += _rows(flat['tree_class'], '%d', 16) + ['};', '']
+    lines.append('const float TREE_LEAF_VALUES[TREE_MODEL_LEAVES * TREE_MODEL_LEAF_VALUES] = {')
+    lines += _rows(flat['leaf_values'], '%.8ef', 8) + ['};', '']
+    lines.append('const float TREE_BASE_SCORE[TREE_MODEL_CLASSES] = {')
+    lines += _rows(flat['base'], '%.8ef', 8) + ['};', '']
+    lines += ['#endif // TREE_PARAMS_H', '']
+    return '\n'.join(lines)
+
+
+def model_bytes(flat):
+    """Flash of the exported arrays (TreeEnsemble::getModelBytes())."""
+    k = len(CLASS_NAMES)
+    return (8 * len(flat['nodes']) + 4 * len(flat['leaf_values']) +
+            9 * len(flat['roots']) + 4 * k)
+
+
+# ============================================================================
+# Training and Export
+# ============================================================================
+
+def train_ensemble(X, y, model_type='random_forest', seed=42):
+    """
+    Ensembles sized for the device: a forest of 30 trees of depth 8, or
+    50 boosting rounds of depth-4 trees per class.
+    """
+    if model_type == 'random_forest':
+        from sklearn.ensemble import RandomForestClassifier
+        model = RandomForestClassifier(n_estimators=30, max_depth=8,
+                                       class_weight='balanced', random_state=seed, n_jobs=-1)
+    elif model_type == 'gradient_boosting':
+        from sklearn.ensemble import GradientBoostingClassifier
+        model = GradientBoostingClassifier(n_estimators=50, max_depth=4,
+                                           learning_rate=0.1, random_state=seed)
+    elif model_type == 'xgboost':
+        from xgboost import XGBClassifier
+        model = XGBClassifier(n_estimators=50, max_depth=4, learning_rate=0.1,
+                              objective='multi:softprob', random_state=seed)
+    else:
+        raise ValueError('unknown model type %s' % model_type)
+    return model.fit(X, y)
+
+
+def export_tree_model(model, output_dir, X=None):
+    """
+    Write tree_params.h. With X, check the flattened ensemble against the
+    model's own predict_proba on those rows.
+    """
+    kind, trees, tree_class, base = convert_model(model)
+    flat = flatten_ensemble(kind, trees, tree_class, base)
+
+    output_dir = Path(output_dir)
+    header_path = output_dir / 'tree_params.h'
+    header_path.write_text(generate_header(flat))
+    print("Tree ensemble (%s, %d trees, %d nodes, %d bytes) -> %s"
+          % ('forest' if kind == TREE_KIND_FOREST else 'boosted', len(trees),
+             len(flat['nodes']), model_bytes(flat), header_path))
+
+    if X is not None:
+        inner = getattr(model, 'model', model)
+        firmware_class = class_map(inner.classes_)
+        reference = inner.predict_proba(X)
+        worst = 0.0
+        for row, probs in zip(X, reference):
+            merged = [0.0] * len(CLASS_NAMES)
+            for i, p in enumerate(probs):
+                merged[firmware_class[i]] += float(p)
+            flat_probs = predict_flat(flat, [float(v) for v in row])
+            worst = max(worst, max(abs(a - b) for a, b in zip(merged, flat_probs)))
+        print("Largest probability difference to predict_proba: %.2e" % worst)
+    return header_path
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Export a random forest or boosted tree ensemble for the firmware'
+    )
+    parser.add_argument(
+        '--features', type=str,
+        help='CSV of per-epoch features (firmware order) with Sleep_Stage'
+    )
+    parser.add_argument('--joblib', type=str, help='Saved model to convert instead of training')
+    parser.add_argument(
+        '--model', type=str, default='random_forest',
+        choices=['random_forest', 'gradient_boosting', 'xgboost'],
+        help='Ensemble to train when no --joblib is given'
+    )
+    parser.add_argument('--output_dir', type=str, default='.', help='Directory for tree_params.h')
+    parser.add_argument('--check_rows', type=int, default=2000,
+                        help='Rows of --features to check the export on')
+
+    args = parser.parse_args()
+    X = y = None
+    if args.features:
+        import pandas as pd
+        df = pd.read_csv(args.features)
+        df = df[df['Sleep_Stage'].isin(list(STAGE_TO_CLASS))]
+        feature_cols = [c for c in df.columns if c not in ('Sleep_Stage', 'participant')]
+        if len(feature_cols) != N_FIRMWARE_FEATURES:
+            parser.error('expected %d firmware features, found %d'
+                         % (N_FIRMWARE_FEATURES, len(feature_cols)))
+        X = df[feature_cols].values.astype('float32')
+        y = [STAGE_TO_CLASS[s] for s in df['Sleep_Stage']]
+
+    if args.joblib:
+        import joblib
+        model = joblib.load(args.joblib)
+    elif X is not None:
+        model = train_ensemble(X, y, args.model)
+    else:
+        parser.error('give --features to train, or --joblib to convert')
+
+    export_tree_model(model, args.output_dir,
+                      X[:args.check_rows] if X is not None else None)
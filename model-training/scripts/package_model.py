@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""
+Package a TFLite Model for the Wearable's A/B Model Store
+==========================================================
+
+Builds the package the firmware's ModelStore (firmware/src/processing/
+model_store.h) keeps in its flash slots:
+
+    ModelPackageHeader   magic "SMPK", model length, scaler count, reserved
+    model bytes          sleep_model.tflite, zero padded to 4 bytes
+    scaler (optional)    float32 FEATURE_MEAN[n], float32 FEATURE_SCALE[n]
+
+Shipping the scaler with the model lets a retrained model be swapped in
+without reflashing the firmware's scaler_params.h.
+
+The device writes the package into its inactive slot and commits it with
+a slot header once the CRC checks out (ModelStore::beginUpdate,
+writeUpdate, finishUpdate).
+
+Usage:
+    python package_model.py \\
+        --tflite ../models/tflite_4class/sleep_model.tflite \\
+        --scaler ../models/tflite_4class/scaler_params.h \\
+        --output ../models/tflite_4class/sleep_model.pkg
+"""
+
+import argparse
+import struct
+import zlib
+from pathlib import Path
+
+from compile_model import load_scaler
+
+
+PACKAGE_MAGIC = 0x4B504D53  # "SMPK"
+
+
+def build_package(tflite_bytes: bytes, mean=None, scale=None) -> bytes:
+    if tflite_bytes[4:8] != b'TFL3':
+        raise ValueError("not a TFLite flatbuffer")
+
+    scaler_count = len(mean) if mean is not None else 0
+    header = struct.pack('<IIII', PACKAGE_MAGIC, len(tflite_bytes), scaler_count, 0)
+    padding = b'\0' * (-len(tflite_bytes) % 4)
+    scaler = b''
+    if scaler_count:
+        if len(scale) != scaler_count:
+            raise ValueError("FEATURE_MEAN and FEATURE_SCALE differ in length")
+        scaler = struct.pack('<%df' % scaler_count, *mean) + struct.pack('<%df' % scaler_count, *scale)
+    return header + tflite_bytes + padding + scaler
+
+
+def package_model(tflite_path, output_path, scaler_path=None):
+    mean = scale = None
+    if scaler_path:
+        mean, scale = load_scaler(scaler_path)
+
+    package = build_package(Path(tflite_path).read_bytes(), mean, scale)
+    Path(output_path).write_bytes(package)
+    crc = zlib.crc32(package) & 0xFFFFFFFF
+    print("Packaged %s: %d bytes, CRC32 0x%08X -> %s"
+          % (Path(tflite_path).name, len(package), crc, output_path))
+    return package
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description='Package sleep_model.tflite for the firmware model store'
+    )
+    parser.add_argument(
+        '--tflite', type=str, required=True,
+        help='TFLite model'
+    )
+    parser.add_argument(
+        '--scaler', type=str, default=None,
+        help='scaler_params.h to ship with the model (optional)'
+    )
+    parser.add_argument(
+        '--output', type=str, default='sleep_model.pkg',
+        help='Output package'
+    )
+
+    args = parser.parse_args()
+    package_model(args.tflite, args.output, args.scaler)
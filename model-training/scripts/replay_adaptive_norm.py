@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+"""
+Replay DREAMT Participants Through the Firmware's Adaptive Normalization
+========================================================================
+
+The firmware can map each epoch onto the training population with the
+wearer's own running feature statistics before classifying it
+(ENABLE_ADAPTIVE_NORM, firmware/src/processing/adaptive_normalizer.h).
+This replays held-out participants epoch by epoch through the same
+update rule and compares a population-trained model with and without it:
+
+    cold    statistics start at the population scaler (first night)
+    warm    statistics carried over from a previous night, as from NVS.
+            DREAMT has one night per participant, so the night is
+            replayed once first; this is an upper bound for night two.
+
+Participants are split into training and held-out groups; an MLP of the
+firmware's shape (64-32-16) is trained on the training group with a
+StandardScaler, which stands in for scaler_params.h. Reports accuracy and
+Cohen's kappa per held-out participant and their mean change.
+
+Usage (CSV of per-epoch features in firmware order, with participant and
+Sleep_Stage columns, rows in recorded order):
+    python replay_adaptive_norm.py \\
+        --features ../models/tflite_4class/train_features.csv \\
+        --weight 0.5 --half_life 480
+"""
+
+import argparse
+
+import numpy as np
+
+from export_transitions import STAGE_TO_CLASS
+
+
+# Mirrors adaptive_normalizer.h
+CLIP_STD = 4.0
+MIN_STD_RATIO = 0.25
+
+
+# ============================================================================
+# Firmware Update Rule
+# ============================================================================
+
+class AdaptiveNormalizer:
+    """Python twin of the firmware's AdaptiveNormalizer (update() / apply())."""
+
+    def __init__(self, pop_mean, pop_scale, half_life, weight):
+        self.pop_mean = np.asarray(pop_mean, dtype=np.float64)
+        self.pop_scale = np.asarray(pop_scale, dtype=np.float64)
+        self.alpha = 1.0 - 2.0 ** (-1.0 / half_life)
+        self.weight = weight
+        self.reset()
+
+    def reset(self):
+        self.mean = self.pop_mean.copy()
+        self.var = self.pop_scale ** 2
+
+    def user_std(self):
+        return np.maximum(np.sqrt(self.var), MIN_STD_RATIO * self.pop_scale)
+
+    def apply(self, x):
+        mean = self.pop_mean + self.weight * (self.mean - self.pop_mean)
+        scale = self.pop_scale + self.weight * (self.user_std() - self.pop_scale)
+        return self.pop_mean + (x - mean) * self.pop_scale / scale
+
+    def update(self, x):
+        limit = CLIP_STD * self.user_std()
+        delta = np.clip(x - self.mean, -limit, limit)
+        seen = ~np.isnan(delta)     # The firmware skips NaN features
+        delta = np.where(seen, delta, 0.0)
+        self.mean = self.mean + self.alpha * delta
+        self.var = np.where(seen, (1.0 - self.alpha) * (self.var + self.alpha * delta * delta),
+                            self.var)
+
+    def replay(self, X):
+        """Normalized epochs of a night, each mapped before it is folded in."""
+        out = np.empty_like(X, dtype=np.float64)
+        for t, x in enumerate(X):
+            out[t] = self.apply(x)
+            self.update(x)
+        return out
+
+
+# ============================================================================
+# Evaluation
+# ============================================================================
+
+def cohen_kappa(y_true, y_pred, n_classes=4):
+    confusion = np.zeros((n_classes, n_classes))
+    np.add.at(confusion, (y_true, y_pred), 1)
+    total = confusion.sum()
+    observed = np.trace(confusion) / total
+    expected = (confusion.sum(axis=0) * confusion.sum(axis=1)).sum() / total ** 2
+    return (observed - expected) / (1.0 - expected) if expected < 1.0 else 0.0
+
+
+def train_population_model(X, y, seed=42):
+    """MLP of the firmware's shape; returns (model, mean, scale)."""
+    from sklearn.neural_network import MLPClassifier
+
+    mean = X.mean(axis=0)
+    scale = X.std(axis=0)
+    scale = np.where(scale > 0, scale, 1.0)
+    model = MLPClassifier(hidden_layer_sizes=(64, 32, 16), max_iter=300,
+                          early_stopping=True, random_state=seed)
+    model.fit((X - mean) / scale, y)
+    return model, mean, scale
+
+
+def replay_participants(model, mean, scale, nights_X, nights_y, half_life, weight):
+    """
+    Per-participant scores for the population scaler alone and with the
+    adaptive stage, cold and warm.
+
+    Returns a list of dicts with n, and accuracy / kappa for 'population',
+    'cold' and 'warm'.
+    """
+    rows = []
+    for X, y in zip(nights_X, nights_y):
+        X = np.nan_to_num(np.asarray(X, dtype=np.float64))
+        norm = AdaptiveNormalizer(mean, scale, half_life, weight)
+        inputs = {
+            'population': X,
+            'cold': norm.replay(X),
+        }
+        # Statistics now hold the whole night, as stored at its end
+        inputs['warm'] = norm.replay(X)
+
+        row = {'n': len(y)}
+        for name, x in inputs.items():
+            pred = model.predict((x - mean) / scale)
+            row[name + '_accuracy'] = float((pred == y).mean())
+            row[name + '_kappa'] = float(cohen_kappa(y, pred))
+        rows.append(row)
+    return rows
+
+
+def summarize(rows, participants):
+    print("%-12s %6s  %-17s %-17s %-17s"
+          % ('participant', 'epochs', 'population', 'cold', 'warm'))
+    for pid, row in zip(participants, rows):
+        print("%-12s %6d  " % (pid, row['n']) + '  '.join(
+            'acc %.3f k %.2f' % (row[m + '_accuracy'], row[m + '_kappa'])
+            for m in ('population', 'cold', 'warm')))
+
+    for mode in ('cold', 'warm'):
+        d_acc = np.mean([r[mode + '_accuracy'] - r['population_accuracy'] for r in rows])
+        d_kappa = np.mean([r[mode + '_kappa'] - r['population_kappa'] for r in rows])
+        better = sum(r[mode + '_kappa'] > r['population_kappa'] for r in rows)
+        print("%s: mean accuracy %+.3f, mean kappa %+.3f, kappa up for %d of %d participants"
+              % (mode, d_acc, d_kappa, better, len(rows)))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description="Replay held-out participants through the firmware's adaptive normalization"
+    )
+    parser.add_argument(
+        '--features', type=str, required=True,
+        help='CSV of per-epoch features (firmware order) with participant and Sleep_Stage'
+    )
+    parser.add_argument('--weight', type=float, default=0.5,
+                        help='ADAPTIVE_NORM_WEIGHT')
+    parser.add_argument('--half_life', type=float, default=480,
+                        help='ADAPTIVE_NORM_HALF_LIFE in epochs')
+    parser.add_argument('--test_fraction', type=float, default=0.3,
+                        help='Fraction of participants held out')
+    parser.add_argument('--seed', type=int, default=42)
+
+    args = parser.parse_args()
+    import pandas as pd
+    df = pd.read_csv(args.features)
+    df = df[df['Sleep_Stage'].isin(list(STAGE_TO_CLASS))]
+    feature_cols = [c for c in df.columns if c not in ('Sleep_Stage', 'participant')]
+
+    participants = np.array(sorted(df['participant'].unique()))
+    rng = np.random.RandomState(args.seed)
+    held_out = set(rng.permutation(participants)[:max(1, int(len(participants) * args.test_fraction))])
+
+    def classes(labels):
+        return np.array([STAGE_TO_CLASS[s] for s in labels])
+
+    train = df[~df['participant'].isin(held_out)]
+    model, mean, scale = train_population_model(
+        np.nan_to_num(train[feature_cols].values), classes(train['Sleep_Stage'].values), args.seed)
+
+    test_ids = [p for p in participants if p in held_out]
+    groups = [df[df['participant'] == p] for p in test_ids]
+    rows = replay_participants(model, mean, scale,
+                               [g[feature_cols].values for g in groups],
+                               [classes(g['Sleep_Stage'].values) for g in groups],
+                               args.half_life, args.weight)
+    print("Adaptive normalization (weight %.2f, half-life %g epochs), %d training / %d held-out participants"
+          % (args.weight, args.half_life, len(participants) - len(test_ids), len(test_ids)))
+    summarize(rows, test_ids)
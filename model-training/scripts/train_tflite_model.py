@@ -34,6 +34,11 @@ import matplotlib.pyplot as plt
 from data.loader import DREAMTLoader
 from features.extractor import FeatureExtractor
 from models.tflite_model import SleepStageMLP
+from compile_model import compile_model
+from export_transitions import export_transition_matrix
+from export_gate import export_gate, evaluate_cascade, to_class_array, N_GATE_FEATURES
+from export_sequence_model import (train_sequence_model, evaluate_sequence_model,
+                                   export_sequence_model)
 
 
 # ============================================================================
@@ -350,6 +355,47 @@ def main(args):
     scaler_path = str(output_dir / 'scaler_params.h')
     model.export_scaler_for_cpp(scaler_path)
     
+    # Stage transition model for the on-device HMM smoother (training
+    # nights only, epochs in recorded order)
+    if 'participant' in df_clean.columns:
+        train_nights = [
+            df_clean.loc[df_clean['participant'] == pid, 'Sleep_Stage'].values
+            for pid in train_pids
+        ]
+    else:
+        train_nights = [y_train]
+    export_transition_matrix(train_nights, output_dir / 'transition_params.h')
+    
+    # IMU-only first stage of the on-device cascade, replayed on the test
+    # nights to see how many epochs skip the PPG features and full model
+    gate_weights, gate_bias, gate_threshold = export_gate(
+        X_train, y_train, output_dir / 'gate_params.h')
+    gate_stats = evaluate_cascade(gate_weights, gate_bias, gate_threshold,
+                                  X_test[:, :N_GATE_FEATURES], to_class_array(y_test))
+    print(f"  Test nights: {gate_stats['gated_fraction']:.1%} of epochs gated, "
+          f"gate accuracy {gate_stats['gate_accuracy']:.1%}")
+    
+    # Optional GRU over whole nights, one step per epoch on the device
+    sequence_trained = False
+    if args.sequence_units > 0 and 'participant' in df_clean.columns:
+        def nights(pids):
+            rows = [df_clean[df_clean['participant'] == pid] for pid in pids]
+            return ([r[feature_cols].values for r in rows],
+                    [r['Sleep_Stage'].values for r in rows])
+        seq_model, seq_mean, seq_scale = train_sequence_model(
+            *nights(train_pids), units=args.sequence_units)
+        seq_accuracy = evaluate_sequence_model(seq_model, seq_mean, seq_scale, *nights(test_pids))
+        print(f"  GRU sequence model test accuracy: {seq_accuracy:.1%} "
+              f"(MLP: {metrics['accuracy']:.1%})")
+        export_sequence_model(seq_model, seq_mean, seq_scale, output_dir)
+        sequence_trained = True
+    
+    # Compile the int8 model into a C++ header (no interpreter on device)
+    if args.quantize:
+        compile_model(tflite_path, scaler_path,
+                      output_dir / 'model_compiled.h',
+                      output_dir / 'golden_vectors.h')
+    
     # ========================================================================
     # Summary
     # ========================================================================
@@ -360,6 +406,15 @@ def main(args):
     print(f"  - keras_model/           : Full Keras model")
     print(f"  - sleep_model.tflite     : TFLite model for ESP32")
     print(f"  - scaler_params.h        : C++ header with scaler params")
+    print(f"  - transition_params.h    : Stage transition model (HMM smoother)")
+    print(f"  - gate_params.h          : IMU-only gate (classification cascade)")
+    if sequence_trained:
+        print(f"  - sequence_params.h      : GRU model (INFERENCE_ENGINE_SEQUENCE)")
+        print(f"  - sequence_step.tflite   : GRU step model for TFLM (state in/out)")
+        print(f"  - sequence_scaler.h      : Scaler of the step model (package_model.py)")
+    if args.quantize:
+        print(f"  - model_compiled.h       : Compiled model (INFERENCE_ENGINE_COMPILED)")
+        print(f"  - golden_vectors.h       : Test vectors for test/test_compiled_model")
     print(f"  - feature_list.txt       : Feature ordering specification")
     print(f"  - metrics.json           : Evaluation metrics")
     print(f"  - training_history.png   : Loss/accuracy plots")
@@ -369,7 +424,7 @@ def main(args):
     print(f"  - Cohen's κ:  {metrics['kappa']:.3f}")
     print("\nNext steps:")
     print("  1. Copy sleep_model.tflite to ESP32 (SPIFFS or embed in firmware)")
-    print("  2. Copy scaler_params.h to firmware/include/")
+    print("  2. Copy scaler_params.h, transition_params.h and gate_params.h to firmware/include/")
     print("  3. Implement feature extraction in C++ matching feature_list.txt")
     
 
@@ -431,6 +486,10 @@ if __name__ == '__main__':
         '--patience', type=int, default=15,
         help='Early stopping patience'
     )
+    parser.add_argument(
+        '--sequence_units', type=int, default=0,
+        help='Also train a GRU sequence model with this many units (0: off)'
+    )
     parser.add_argument(
         '--quantize', action='store_true', default=True,
         help='Apply INT8 quantization for smaller model'
@@ -46,6 +46,16 @@
 #define IMU_GYRO_RANGE          250     // ±250°/s (0=250, 1=500, 2=1000, 3=2000)
 #define IMU_BUFFER_SIZE         64      // Samples to buffer before transmit
 
+// MPU6050 FIFO (imu_sensor.h): samples queue in the sensor and are drained
+// in one burst once IMU_FIFO_BURST are waiting, counted by the data-ready
+// interrupt on MPU6050_INT_PIN. Accelerometer only unless IMU_FIFO_GYRO
+// (the FIFO holds 170 accelerometer or 85 accelerometer+gyro samples).
+// Off until the interrupt wiring and burst timestamps are checked on a
+// board; the IMU is then polled at IMU_SAMPLE_RATE_HZ.
+#define ENABLE_IMU_FIFO         false
+#define IMU_FIFO_BURST          32      // 1 s at 32 Hz
+#define IMU_FIFO_GYRO           false
+
 // PPG (MAX30102) Settings
 #define PPG_SAMPLE_RATE_HZ      100     // Samples per second
 #define PPG_LED_BRIGHTNESS      0x1F    // LED current (0x00-0xFF)
@@ -53,6 +63,27 @@
 #define PPG_LED_MODE            3       // 1=Red only, 2=Red+IR, 3=Red+IR+Green
 #define PPG_ADC_RANGE           16384   // ADC range (2048, 4096, 8192, 16384)
 #define PPG_BUFFER_SIZE         100     // Samples to buffer
+#define PPG_FIFO_DRAIN_MS       100     // FIFO drain interval (the FIFO holds 320 ms at 100 Hz)
+
+// Acquisition task (sensors/sensor_task.h, needs ENABLE_IMU_FIFO): a
+// FreeRTOS task woken by the IMU data-ready interrupt and every
+// PPG_FIFO_DRAIN_MS drains both FIFOs into lock-free rings; the main loop
+// takes the samples in batches. Otherwise the loop drains the FIFOs itself.
+// Off until the task's timing and stack use are checked on the device.
+#define ENABLE_SENSOR_TASK      false
+#define SENSOR_TASK_CORE        0
+#define SENSOR_TASK_PRIORITY    5       // Above the Arduino loop (1)
+#define SENSOR_IMU_RING         128     // Samples, power of two (4 s at 32 Hz)
+#define SENSOR_PPG_RING         256     // Samples, power of two (2.5 s at 100 Hz)
+
+// I2C scheduler (sensors/i2c_scheduler.h, needs ENABLE_SENSOR_TASK): both
+// drivers queue their FIFO reads on one scheduler in the acquisition task,
+// which merges adjacent register reads into bursts, runs them through the
+// ESP-IDF I2C driver and calls the drivers back on completion. Bus
+// utilization and read latency are printed every I2C_STATS_WINDOW_MS.
+// Only run against the mock bus so far, hence off.
+#define ENABLE_I2C_SCHEDULER    false
+#define I2C_STATS_WINDOW_MS     10000
 
 // =============================================================================
 // BLE Configuration
@@ -67,6 +98,7 @@
 #define PPG_CHAR_UUID           "12345678-1234-1234-1234-123456789002"
 #define CONTROL_CHAR_UUID       "12345678-1234-1234-1234-123456789003"
 #define STATUS_CHAR_UUID        "12345678-1234-1234-1234-123456789004"
+#define MODEL_XFER_CHAR_UUID    "12345678-1234-1234-1234-123456789005"
 
 // Standard Heart Rate Service
 #define HR_SERVICE_UUID         0x180D
@@ -78,6 +110,12 @@
 #define BLE_LATENCY             0
 #define BLE_TIMEOUT             400     // 4 seconds
 
+// Model update transfer (see ble/model_transfer.h, needs ENABLE_MODEL_STORE)
+#define BLE_MTU                 247     // Requested ATT MTU
+#define MODEL_XFER_MAX_PACKET   244     // BLE_MTU - 3 (ATT write header)
+#define MODEL_XFER_QUEUE_DEPTH  16      // Packets buffered for the main loop
+#define MODEL_XFER_ACK_BYTES    4096    // Progress notification interval
+
 // =============================================================================
 // WiFi Configuration (for data upload)
 // =============================================================================
@@ -93,6 +131,9 @@
 #define SLEEP_TIMEOUT_MS        60000   // Enter deep sleep after 60s inactivity
 #define LOW_BATTERY_THRESHOLD   3.3     // Voltage threshold for low battery warning
 #define CRITICAL_BATTERY        3.0     // Voltage for shutdown
+#define BATTERY_CHECK_MS        10000   // Critical battery check interval
+#define CRITICAL_BATTERY_CHECKS 3       // Consecutive low readings before shutdown
+#define CRITICAL_SLEEP_SEC      600     // Deep sleep before the battery is checked again
 
 // =============================================================================
 // Data Processing / On-Device Inference
@@ -109,13 +150,136 @@
 //   4. Set ENABLE_EDGE_INFERENCE to true
 #define ENABLE_EDGE_INFERENCE   true
 
-// Model file (if loading from SPIFFS instead of embedding)
-#define MODEL_FILENAME          "/model.tflite"
+// Inference backend for the sleep stage model:
+//   INFERENCE_ENGINE_TFLM:     TFLite Micro interpreter (float or int8 models)
+//   INFERENCE_ENGINE_NATIVE:   dedicated int8 dense-layer engine reading the
+//                              same .tflite (int8 models only, ~4 KB RAM)
+//   INFERENCE_ENGINE_COMPILED: model_compiled.h generated ahead of time by
+//                              compile_model.py (no parsing, no heap)
+//   INFERENCE_ENGINE_SEQUENCE: GRU from sequence_params.h, one step per
+//                              epoch with the hidden state carried over
+//   INFERENCE_ENGINE_TREES:    random forest / boosted trees from
+//                              tree_params.h (export_tree_model.py)
+#define INFERENCE_ENGINE_TFLM     0
+#define INFERENCE_ENGINE_NATIVE   1
+#define INFERENCE_ENGINE_COMPILED 2
+#define INFERENCE_ENGINE_SEQUENCE 3
+#define INFERENCE_ENGINE_TREES    4
+#define INFERENCE_ENGINE          INFERENCE_ENGINE_TFLM
+
+// Recurrent state of sequence models (INFERENCE_ENGINE_SEQUENCE, or a
+// TFLM step model with a state input/output): kept in RTC memory every
+// epoch and in NVS every SEQUENCE_STATE_PERSIST_EPOCHS, so it survives
+// deep sleep and reboots. A new night starts from zero: on the app's START
+// command, or when the stored state is older than SEQUENCE_STATE_MAX_GAP_SEC.
+#define SEQUENCE_STATE_NAMESPACE        "seqstate"
+#define SEQUENCE_STATE_PERSIST_EPOCHS   10      // 5 minutes at 30 s epochs
+#define SEQUENCE_STATE_MAX_GAP_SEC      7200    // 2 hours without an epoch
+
+// Model store: two flash partitions (partitions.csv) holding A/B model
+// packages, memory-mapped in place. The newest valid one replaces the
+// embedded model_data.h; updates are swapped in between epochs.
+// Not used by the compiled, sequence or tree engines.
+#define ENABLE_MODEL_STORE      true
+#define MODEL_PARTITION_A       "model_a"
+#define MODEL_PARTITION_B       "model_b"
+
+// Shadow evaluation of a candidate model (native and TFLM engines, with the
+// model store): a model committed over BLE runs next to the active one on
+// the same features instead of replacing it, and its stages only go to a
+// disagreement log (shadow_monitor.h), sent on the STATUS characteristic
+// after a SHADOW command. "SHADOW_PROMOTE" switches to it, "SHADOW_END"
+// drops it. The shadow pauses below SHADOW_MIN_BATTERY_V and backs off
+// while it costs more than SHADOW_MAX_CPU_MS per epoch. After a reboot the
+// newest stored model runs, as without shadow mode.
+#define ENABLE_SHADOW_MODEL     false
+#define SHADOW_MAX_CPU_MS       5.0f
+#define SHADOW_MIN_BATTERY_V    3.5f
+#define SHADOW_BACKOFF_EPOCHS   20      // 10 minutes at 30 s epochs
+#define SHADOW_REPORT_EPOCHS    120     // 1 hour at 30 s epochs
+
+// HMM smoothing of the per-epoch stages with the trained transition matrix
+// (transition_params.h). Results report the raw, forward-filtered and
+// fixed-lag Viterbi stage.
+#define ENABLE_HMM_SMOOTHING    true
+#define HMM_SMOOTHING_LAG       4       // Viterbi hindsight in epochs (0: off)
+
+// Two-stage cascade: an IMU-only linear classifier (gate_params.h) decides
+// the epochs it is confident about; their PPG features and the full model
+// are skipped.
+#define ENABLE_IMU_GATE         true
+
+// Provisional stages every PROVISIONAL_INTERVAL_SEC within an epoch, so a
+// live display does not wait 30 s for a stage change. The IMU block is
+// estimated from running statistics kept per sample (no buffer rescans)
+// and scored by the gate's linear model; the epoch's final result follows
+// as usual. Results are flagged `provisional`.
+#define ENABLE_PROVISIONAL_STAGES false
+#define PROVISIONAL_INTERVAL_SEC 5
+#define PROVISIONAL_MIN_SEC     2       // Fewest seconds of samples to score
+
+// Per-user adaptive normalization (adaptive_normalizer.h): exponentially
+// weighted statistics of the wearer's raw features, blended with the
+// population scaler (scaler_params.h) by ADAPTIVE_NORM_WEIGHT, map each
+// epoch onto the training population before any engine sees it. Kept in
+// NVS so they carry over between nights: written every
+// ADAPTIVE_NORM_PERSIST_EPOCHS and before a critical-battery shutdown, so
+// a sudden power loss costs at most that many epochs. "NORM_RESET" over
+// BLE starts over for a new wearer.
+#define ENABLE_ADAPTIVE_NORM    false
+#define ADAPTIVE_NORM_NAMESPACE "usernorm"
+#define ADAPTIVE_NORM_HALF_LIFE 480     // Epochs (4 hours at 30 s epochs)
+#define ADAPTIVE_NORM_WEIGHT    0.5f
+#define ADAPTIVE_NORM_PERSIST_EPOCHS 20 // 10 minutes at 30 s epochs
+
+// Actigraphy sleep/wake scoring (actigraphy_scorer.h) when no valid model
+// is present, so a fresh build still reports Wake / Sleep instead of
+// dropping to streaming-only. Per-minute activity counts are the summed
+// IMU magnitude changes above a deadband, scaled to ActiGraph-like counts.
+#define ENABLE_ACTIGRAPHY_FALLBACK true
+#define ACTIGRAPHY_COLE_KRIPKE  0
+#define ACTIGRAPHY_SADEH        1
+#define ACTIGRAPHY_ALGORITHM    ACTIGRAPHY_COLE_KRIPKE
+#define ACTIGRAPHY_DEADBAND_G   0.01f   // Per-sample change ignored as sensor noise
+#define ACTIGRAPHY_COUNTS_PER_G 60.0f   // Calibration: counts per g of summed change
+
+// One arena for the feature buffers, extraction scratch and the TFLM
+// tensor arena (memory_planner.h): buffers that are never live at the
+// same time share bytes. Costs a TFLM interpreter rebuild per epoch; off
+// until that rebuild has been timed on the S3.
+#define ENABLE_SHARED_ARENA     false
+
+// Per-operator profiling of classify() (inference_profiler.h): cycles per
+// TFLM op or native layer, min/mean/p99/max over the night, and the arena
+// high-water mark. Printed every PROFILER_REPORT_EPOCHS and on 'p' over
+// serial; the binary record is sent on the STATUS characteristic after a
+// PROFILE command ("PROFILE_RESET" starts over).
+#define ENABLE_INFERENCE_PROFILER false
+#define PROFILER_REPORT_EPOCHS  120     // 1 hour at 30 s epochs
 
 // Sleep stage classes (4-class clinical-lite)
 // 0: Wake, 1: Light (N1+N2), 2: Deep (N3), 3: REM
 #define N_SLEEP_CLASSES         4
 
+// =============================================================================
+// Optional Feature Blocks
+// =============================================================================
+// Appended after the 72 base features in EpochFeatures. The deployed model
+// only reads the first N_FEATURES inputs, so enabling a block costs CPU but
+// does not change classification until a model is trained with it.
+
+// Respiratory rate from PPG baseline modulation (3 features)
+#define ENABLE_RESP_FEATURES    false
+
+// Permutation / sample entropy of IMU magnitude and IBI series (4 features)
+#define ENABLE_ENTROPY_FEATURES false
+
+// PPG pulse shape: amplitude, rise time, width, dicrotic notch (5 features)
+#define ENABLE_PULSE_FEATURES   false
+
+// CDF 5/3 lifting wavelet energies of PPG and IMU magnitude (10 features)
+#define ENABLE_WAVELET_FEATURES false
+
 // =============================================================================
 // Debug Options
 // =============================================================================
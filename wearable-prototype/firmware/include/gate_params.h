@@ -0,0 +1,29 @@
+/**
+ * IMU Gate Parameters (Placeholder)
+ * =================================
+ *
+ * This file should be generated by the training script:
+ *   python scripts/train_tflite_model.py --data_dir ../data/dreamt
+ *
+ * The training script outputs: models/tflite_4class/gate_params.h
+ * Copy that file here to replace this placeholder.
+ *
+ * Linear softmax over the 50 IMU features used by processing/imu_gate.h,
+ * with the feature scaler folded into the weights.
+ */
+
+#ifndef GATE_PARAMS_H
+#define GATE_PARAMS_H
+
+#define GATE_N_FEATURES 50
+#define GATE_N_CLASSES 4
+
+// Placeholder: a threshold above 1 never decides an epoch, so every epoch
+// runs the full model
+#define GATE_THRESHOLD 2.0f
+
+const float GATE_WEIGHTS[GATE_N_CLASSES * GATE_N_FEATURES] = {0.0f};
+
+const float GATE_BIAS[GATE_N_CLASSES] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+#endif // GATE_PARAMS_H
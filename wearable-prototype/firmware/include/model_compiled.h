@@ -0,0 +1,55 @@
+/**
+ * Compiled Sleep Stage Model (Placeholder)
+ * =========================================
+ *
+ * This file should be generated from your trained model using:
+ *   python scripts/compile_model.py \
+ *       --tflite ../models/tflite_4class/sleep_model.tflite \
+ *       --scaler ../models/tflite_4class/scaler_params.h \
+ *       --output ../../wearable-prototype/firmware/include/model_compiled.h \
+ *       --golden ../../wearable-prototype/firmware/test/test_compiled_model/golden_vectors.h
+ *
+ * train_tflite_model.py runs this step for quantized models and writes
+ * models/tflite_4class/model_compiled.h; copy that file here.
+ *
+ * The generated header holds the weights as constexpr arrays and one
+ * function per layer, and is used when INFERENCE_ENGINE is
+ * INFERENCE_ENGINE_COMPILED.
+ */
+
+#ifndef MODEL_COMPILED_H
+#define MODEL_COMPILED_H
+
+#include <stdint.h>
+
+// Placeholder - SleepClassifier::begin() fails while this is 0
+#define COMPILED_MODEL_AVAILABLE    0
+#define COMPILED_MODEL_CRC32        0x00000000UL
+#define COMPILED_MODEL_INPUTS       72
+#define COMPILED_MODEL_OUTPUTS      4
+#define COMPILED_MODEL_LAYERS       0
+#define COMPILED_MODEL_MAX_WIDTH    72
+
+static inline void compiledModelQuantize(const float* features, int8_t* q) {
+    (void)features;
+    for (int i = 0; i < COMPILED_MODEL_INPUTS; i++) q[i] = 0;
+}
+
+static inline void compiledModelInvoke(const float* features, int8_t* logits) {
+    (void)features;
+    for (int i = 0; i < COMPILED_MODEL_OUTPUTS; i++) logits[i] = 0;
+}
+
+static inline int compiledModelArgmax(const int8_t* logits) {
+    (void)logits;
+    return 0;
+}
+
+static inline void compiledModelSoftmax(const int8_t* logits, float* probabilities) {
+    (void)logits;
+    for (int i = 0; i < COMPILED_MODEL_OUTPUTS; i++) {
+        probabilities[i] = 1.0f / COMPILED_MODEL_OUTPUTS;
+    }
+}
+
+#endif // MODEL_COMPILED_H
@@ -0,0 +1,33 @@
+/**
+ * GRU Sequence Model Parameters (Placeholder)
+ * ===========================================
+ *
+ * This file should be generated by the training script:
+ *   python scripts/train_tflite_model.py --data_dir ../data/dreamt \
+ *       --sequence_units 24
+ *
+ * The training script outputs: models/tflite_4class/sequence_params.h
+ * (or run scripts/export_sequence_model.py). Copy that file here.
+ *
+ * Used by processing/gru_step.h when INFERENCE_ENGINE is
+ * INFERENCE_ENGINE_SEQUENCE. Keras GRU layout, feature scaler folded in.
+ */
+
+#ifndef SEQUENCE_PARAMS_H
+#define SEQUENCE_PARAMS_H
+
+// Placeholder - SleepClassifier::begin() fails while this is 0
+#define SEQUENCE_MODEL_AVAILABLE    0
+#define SEQUENCE_MODEL_CRC32        0x00000000UL
+#define SEQUENCE_MODEL_INPUTS       72
+#define SEQUENCE_MODEL_UNITS        1
+#define SEQUENCE_MODEL_CLASSES      4
+
+const float SEQUENCE_KERNEL[SEQUENCE_MODEL_INPUTS * 3 * SEQUENCE_MODEL_UNITS] = {0.0f};
+const float SEQUENCE_RECURRENT_KERNEL[SEQUENCE_MODEL_UNITS * 3 * SEQUENCE_MODEL_UNITS] = {0.0f};
+const float SEQUENCE_INPUT_BIAS[3 * SEQUENCE_MODEL_UNITS] = {0.0f};
+const float SEQUENCE_RECURRENT_BIAS[3 * SEQUENCE_MODEL_UNITS] = {0.0f};
+const float SEQUENCE_DENSE_KERNEL[SEQUENCE_MODEL_UNITS * SEQUENCE_MODEL_CLASSES] = {0.0f};
+const float SEQUENCE_DENSE_BIAS[SEQUENCE_MODEL_CLASSES] = {0.0f};
+
+#endif // SEQUENCE_PARAMS_H
@@ -0,0 +1,36 @@
+/**
+ * Sleep Stage Transition Model (Placeholder)
+ * ==========================================
+ *
+ * This file should be generated by the training script:
+ *   python scripts/train_tflite_model.py --data_dir ../data/dreamt
+ *
+ * The training script outputs: models/tflite_4class/transition_params.h
+ * (or run scripts/export_transitions.py on labelled hypnograms).
+ * Copy that file here to replace this placeholder.
+ *
+ * Used by processing/hmm_smoother.h.
+ * Rows: stage at epoch t; columns: stage at epoch t+1.
+ * Order: Wake, Light, Deep, REM
+ */
+
+#ifndef TRANSITION_PARAMS_H
+#define TRANSITION_PARAMS_H
+
+#define HMM_N_STATES 4
+
+// Placeholder: stages persist for several epochs, Deep and REM are
+// entered through Light
+const float HMM_TRANSITION[HMM_N_STATES][HMM_N_STATES] = {
+    {0.900f, 0.090f, 0.005f, 0.005f},   // Wake
+    {0.030f, 0.910f, 0.040f, 0.020f},   // Light
+    {0.010f, 0.080f, 0.905f, 0.005f},   // Deep
+    {0.030f, 0.050f, 0.005f, 0.915f},   // REM
+};
+
+const float HMM_INITIAL[HMM_N_STATES] = {0.85f, 0.13f, 0.01f, 0.01f};
+
+// Uniform: the classifier posteriors are used as emissions unchanged
+const float HMM_CLASS_PRIOR[HMM_N_STATES] = {0.25f, 0.25f, 0.25f, 0.25f};
+
+#endif // TRANSITION_PARAMS_H
@@ -0,0 +1,38 @@
+/**
+ * Tree Ensemble Parameters (Placeholder)
+ * ======================================
+ *
+ * This file should be generated by the export script:
+ *   python scripts/export_tree_model.py \
+ *       --features ../models/tflite_4class/train_features.csv \
+ *       --model random_forest --output_dir ../models/tflite_4class
+ *
+ * The script outputs: models/tflite_4class/tree_params.h. Copy that file
+ * here.
+ *
+ * Used by processing/tree_ensemble.h when INFERENCE_ENGINE is
+ * INFERENCE_ENGINE_TREES. Raw features, no scaler.
+ */
+
+#ifndef TREE_PARAMS_H
+#define TREE_PARAMS_H
+
+// Placeholder - SleepClassifier::begin() fails while this is 0
+#define TREE_MODEL_AVAILABLE        0
+#define TREE_MODEL_CRC32            0x00000000UL
+#define TREE_MODEL_KIND             TREE_KIND_FOREST
+#define TREE_MODEL_FEATURES         72
+#define TREE_MODEL_CLASSES          4
+#define TREE_MODEL_TREES            1
+#define TREE_MODEL_NODES            1
+#define TREE_MODEL_LEAVES           1
+#define TREE_MODEL_LEAF_VALUES      TREE_MODEL_CLASSES
+
+const TreeNode TREE_NODES[TREE_MODEL_NODES] = {{0.0f, TREE_LEAF, 0, 0}};
+const uint32_t TREE_ROOTS[TREE_MODEL_TREES] = {0};
+const uint32_t TREE_LEAF_BASE[TREE_MODEL_TREES] = {0};
+const uint8_t TREE_CLASS[TREE_MODEL_TREES] = {0};
+const float TREE_LEAF_VALUES[TREE_MODEL_LEAVES * TREE_MODEL_LEAF_VALUES] = {0.25f, 0.25f, 0.25f, 0.25f};
+const float TREE_BASE_SCORE[TREE_MODEL_CLASSES] = {0.0f};
+
+#endif // TREE_PARAMS_H
@@ -3,6 +3,15 @@
  * =========================
  * 
  * NimBLE-based Bluetooth Low Energy handler for data transmission.
+ * 
+ * With ENABLE_MODEL_STORE it also exposes the model transfer
+ * characteristic (ble/model_transfer.h). Its writes are queued by the
+ * NimBLE task and applied to flash from the main loop through
+ * processModelTransfer(), next to the classifier that maps the slots.
+ * 
+ * The PROFILE / PROFILE_RESET control commands are likewise only flagged
+ * here (takeProfileRequest()); the main loop answers with the inference
+ * profiler's binary record on the STATUS characteristic.
  */
 
 #ifndef BLE_HANDLER_H
@@ -14,12 +23,38 @@
 #include "../sensors/imu_sensor.h"
 #include "../sensors/ppg_sensor.h"
 
+#if ENABLE_MODEL_STORE
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "model_transfer.h"
+#endif
+
+// Pending profiler command (takeProfileRequest())
+#define PROFILE_REQUEST_NONE    0
+#define PROFILE_REQUEST_SEND    1   // "PROFILE": send the record
+#define PROFILE_REQUEST_RESET   2   // "PROFILE_RESET": start over
+
+// Pending shadow model command (takeShadowRequest())
+#define SHADOW_REQUEST_NONE     0
+#define SHADOW_REQUEST_SEND     1   // "SHADOW": send the disagreement log
+#define SHADOW_REQUEST_PROMOTE  2   // "SHADOW_PROMOTE": make it the active model
+#define SHADOW_REQUEST_END      3   // "SHADOW_END": stop the shadow
+
 /**
  * BLE Handler class
  */
 class BLEHandler {
 public:
-    BLEHandler() : _server(nullptr), _connected(false), _deviceName("") {}
+    BLEHandler() : _server(nullptr), _connected(false), _deviceName(""),
+                   _profileRequest(PROFILE_REQUEST_NONE),
+                   _shadowRequest(SHADOW_REQUEST_NONE), _normResetRequest(false),
+                   _startRequest(false) {
+        #if ENABLE_MODEL_STORE
+        _modelChar = nullptr;
+        _modelQueue = nullptr;
+        _modelDropped = 0;
+        #endif
+    }
     
     /**
      * Initialize BLE
@@ -30,6 +65,7 @@ public:
         // Initialize NimBLE
         NimBLEDevice::init(_deviceName);
         NimBLEDevice::setPower(BLE_TX_POWER);
+        NimBLEDevice::setMTU(BLE_MTU);
         
         // Create server
         _server = NimBLEDevice::createServer();
@@ -67,6 +103,19 @@ public:
         );
         _statusChar->setValue("Ready");
         
+        #if ENABLE_MODEL_STORE
+        // Model transfer characteristic (write without response for data)
+        _modelQueue = xQueueCreate(MODEL_XFER_QUEUE_DEPTH, sizeof(ModelTransferPacket));
+        _modelChar = sensorService->createCharacteristic(
+            MODEL_XFER_CHAR_UUID,
+            NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE |
+            NIMBLE_PROPERTY::WRITE_NR | NIMBLE_PROPERTY::NOTIFY
+        );
+        uint8_t status[MODEL_XFER_STATUS_SIZE];
+        _modelChar->setValue(status, _modelTransfer.getStatus(status));
+        _modelChar->setCallbacks(new ModelTransferCallbacks(this));
+        #endif
+        
         // Start service
         sensorService->start();
         
@@ -219,6 +268,56 @@ public:
         }
     }
     
+    /**
+     * Set a binary status value (e.g. the inference profiler record)
+     */
+    void setStatus(const uint8_t* data, size_t length) {
+        if (_statusChar) {
+            _statusChar->setValue(data, length);
+            if (_connected) {
+                _statusChar->notify();
+            }
+        }
+    }
+    
+    /**
+     * Profiler command received since the last call (PROFILE_REQUEST_*).
+     */
+    uint8_t takeProfileRequest() {
+        uint8_t request = _profileRequest;
+        _profileRequest = PROFILE_REQUEST_NONE;
+        return request;
+    }
+    
+    /**
+     * Shadow model command received since the last call (SHADOW_REQUEST_*).
+     */
+    uint8_t takeShadowRequest() {
+        uint8_t request = _shadowRequest;
+        _shadowRequest = SHADOW_REQUEST_NONE;
+        return request;
+    }
+    
+    /**
+     * Whether "NORM_RESET" (new wearer: forget the per-user feature
+     * statistics) was received since the last call.
+     */
+    bool takeNormResetRequest() {
+        bool request = _normResetRequest;
+        _normResetRequest = false;
+        return request;
+    }
+    
+    /**
+     * Whether "START" (a new recording, so a new night) was received
+     * since the last call.
+     */
+    bool takeStartRequest() {
+        bool request = _startRequest;
+        _startRequest = false;
+        return request;
+    }
+    
     /**
      * Handle control commands
      */
@@ -227,6 +326,7 @@ public:
         
         if (command == "START") {
             // Start data collection
+            _startRequest = true;
             setStatus("Streaming");
         } else if (command == "STOP") {
             // Stop data collection
@@ -234,8 +334,70 @@ public:
         } else if (command == "CALIBRATE") {
             // Trigger calibration
             setStatus("Calibrating");
+        } else if (command == "PROFILE") {
+            // Answered from the main loop (profiler statistics live there)
+            _profileRequest = PROFILE_REQUEST_SEND;
+        } else if (command == "PROFILE_RESET") {
+            _profileRequest = PROFILE_REQUEST_RESET;
+        } else if (command == "SHADOW") {
+            _shadowRequest = SHADOW_REQUEST_SEND;
+        } else if (command == "SHADOW_PROMOTE") {
+            _shadowRequest = SHADOW_REQUEST_PROMOTE;
+        } else if (command == "SHADOW_END") {
+            _shadowRequest = SHADOW_REQUEST_END;
+        } else if (command == "NORM_RESET") {
+            _normResetRequest = true;
+        }
+    }
+
+    #if ENABLE_MODEL_STORE
+    /**
+     * Model storage the transfer writes into (the classifier's), and the
+     * classifier hook that starts each update (see ModelUpdateBegin).
+     */
+    void setModelStore(ModelStore* store, ModelUpdateBegin beginUpdate = nullptr,
+                       void* context = nullptr) {
+        _modelTransfer.begin(store, beginUpdate, context);
+    }
+    
+    /**
+     * Apply queued model transfer packets. Call from the loop that runs
+     * the classifier.
+     * 
+     * @param activeSlot Slot the running model is mapped from
+     * @return Slot of a model committed by this call, or -1
+     */
+    int processModelTransfer(int activeSlot) {
+        ModelTransferPacket packet;
+        bool notify = false;
+        
+        while (_modelQueue && xQueueReceive(_modelQueue, &packet, 0) == pdTRUE) {
+            notify |= _modelTransfer.handlePacket(packet.data, packet.length, activeSlot);
+        }
+        
+        if (notify) {
+            uint8_t status[MODEL_XFER_STATUS_SIZE];
+            _modelChar->setValue(status, _modelTransfer.getStatus(status));
+            if (_connected) {
+                _modelChar->notify();
+            }
+        }
+        
+        int slot = _modelTransfer.takeCommittedSlot();
+        if (slot >= 0) {
+            Serial.printf("[BLE] Model update committed to slot %d (%u bytes)\n",
+                         slot, (unsigned)_modelTransfer.getLength());
         }
+        return slot;
+    }
+    
+    /**
+     * Packets lost to a full queue (recovered by the central rewinding).
+     */
+    uint32_t getModelPacketsDropped() const {
+        return _modelDropped;
     }
+    #endif
 
 private:
     NimBLEServer* _server;
@@ -246,6 +408,22 @@ private:
     NimBLECharacteristic* _hrChar;
     bool _connected;
     const char* _deviceName;
+    volatile uint8_t _profileRequest;
+    volatile uint8_t _shadowRequest;
+    volatile bool _normResetRequest;
+    volatile bool _startRequest;
+    
+    #if ENABLE_MODEL_STORE
+    struct ModelTransferPacket {
+        uint16_t length;
+        uint8_t data[MODEL_XFER_MAX_PACKET];
+    };
+    
+    NimBLECharacteristic* _modelChar;
+    QueueHandle_t _modelQueue;
+    ModelTransfer _modelTransfer;
+    volatile uint32_t _modelDropped;
+    #endif
     
     /**
      * Server connection callbacks
@@ -289,6 +467,32 @@ private:
     private:
         BLEHandler* _handler;
     };
+    
+    #if ENABLE_MODEL_STORE
+    /**
+     * Model transfer characteristic callbacks (NimBLE task: queue only,
+     * flash is written from the main loop)
+     */
+    class ModelTransferCallbacks : public NimBLECharacteristicCallbacks {
+    public:
+        ModelTransferCallbacks(BLEHandler* handler) : _handler(handler) {}
+        
+        void onWrite(NimBLECharacteristic* characteristic) override {
+            std::string value = characteristic->getValue();
+            if (value.empty() || value.size() > MODEL_XFER_MAX_PACKET) return;
+            
+            ModelTransferPacket packet;
+            packet.length = (uint16_t)value.size();
+            memcpy(packet.data, value.data(), value.size());
+            if (xQueueSend(_handler->_modelQueue, &packet, 0) != pdTRUE) {
+                _handler->_modelDropped++;
+            }
+        }
+        
+    private:
+        BLEHandler* _handler;
+    };
+    #endif
 };
 
 #endif // BLE_HANDLER_H
@@ -0,0 +1,285 @@
+/**
+ * BLE Model Transfer Protocol
+ * ===========================
+ *
+ * Receives a model package (package_model.py) over the model transfer
+ * characteristic and writes it into the inactive ModelStore slot while the
+ * classifier keeps running on the active one.
+ *
+ * Packets written by the central (little-endian):
+ *
+ *   BEGIN   0x01  u32 length, u32 crc32   start, or resume the same package
+ *   DATA    0x02  u32 offset, bytes        one chunk (up to MTU - 8 bytes)
+ *   COMMIT  0x03                           verify CRC and activate the slot
+ *   ABORT   0x04                           drop the transfer
+ *
+ * Status (read / notify, 12 bytes):
+ *
+ *   u8 state, u8 error, u16 reserved, u32 nextOffset, u32 length
+ *
+ * Chunks are expected in order; nextOffset is the number of bytes received
+ * so far. A chunk past nextOffset (a packet was lost) is dropped and the
+ * status is notified so the central rewinds to nextOffset. The transfer
+ * survives a disconnect: sending BEGIN with the same length and CRC after
+ * reconnecting returns the current nextOffset to resume from. Status is
+ * also notified every MODEL_XFER_ACK_BYTES as flow control.
+ *
+ * A new BEGIN erases the inactive slot. The classifier may still use that
+ * slot (a staged swap, or a shadow model), so the erase goes through the
+ * ModelUpdateBegin hook when one is given, which lets go of it first.
+ *
+ * Arduino-free so it runs in the native tests; BLEHandler feeds it packets
+ * from the main loop.
+ */
+
+#ifndef MODEL_TRANSFER_H
+#define MODEL_TRANSFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../processing/model_store.h"
+
+// ============================================================================
+// Protocol
+// ============================================================================
+
+#define MODEL_XFER_OP_BEGIN     0x01
+#define MODEL_XFER_OP_DATA      0x02
+#define MODEL_XFER_OP_COMMIT    0x03
+#define MODEL_XFER_OP_ABORT     0x04
+
+#define MODEL_XFER_DATA_HEADER  5       // Opcode + offset
+#define MODEL_XFER_STATUS_SIZE  12
+
+enum ModelTransferState {
+    XFER_IDLE = 0,
+    XFER_RECEIVING = 1,
+    XFER_COMMITTED = 2,
+    XFER_FAILED = 3
+};
+
+enum ModelTransferError {
+    XFER_OK = 0,
+    XFER_ERR_PACKET = 1,        // Malformed or unexpected packet
+    XFER_ERR_SIZE = 2,          // Package does not fit a slot
+    XFER_ERR_FLASH = 3,         // Erase / write failed
+    XFER_ERR_GAP = 4,           // Chunk past nextOffset (packet lost)
+    XFER_ERR_INCOMPLETE = 5,    // COMMIT before all bytes arrived
+    XFER_ERR_VERIFY = 6,        // CRC or package check failed at COMMIT
+    XFER_ERR_NO_STORE = 7       // Model store not available
+};
+
+/**
+ * Starts writing a package into the inactive slot in place of
+ * ModelStore::beginUpdate(), e.g. SleepClassifier::beginModelUpdate().
+ *
+ * @return Slot being written, or -1
+ */
+typedef int (*ModelUpdateBegin)(void* context, size_t packageLength);
+
+
+// ============================================================================
+// Model Transfer Class
+// ============================================================================
+
+class ModelTransfer {
+public:
+    ModelTransfer() : _store(nullptr), _beginUpdate(nullptr), _beginContext(nullptr),
+                      _state(XFER_IDLE), _error(XFER_OK),
+                      _length(0), _crc(0), _nextOffset(0), _lastAck(0),
+                      _gapReported(false), _committedSlot(-1) {}
+
+    /**
+     * @param beginUpdate Called on BEGIN before the slot is erased
+     *                    (nullptr: store->beginUpdate())
+     */
+    void begin(ModelStore* store, ModelUpdateBegin beginUpdate = nullptr,
+               void* context = nullptr) {
+        _store = store;
+        _beginUpdate = beginUpdate;
+        _beginContext = context;
+    }
+
+    /**
+     * Handle one packet written by the central.
+     *
+     * @param activeSlot Slot the running model is mapped from (-1: embedded)
+     * @return true if the status should be notified
+     */
+    bool handlePacket(const uint8_t* data, size_t length, int activeSlot) {
+        if (length == 0) return fail(XFER_ERR_PACKET);
+        if (!_store) return fail(XFER_ERR_NO_STORE);
+
+        switch (data[0]) {
+            case MODEL_XFER_OP_BEGIN:
+                if (length != 9) return fail(XFER_ERR_PACKET);
+                return handleBegin(readU32(data + 1), readU32(data + 5), activeSlot);
+
+            case MODEL_XFER_OP_DATA:
+                if (length <= MODEL_XFER_DATA_HEADER) return fail(XFER_ERR_PACKET);
+                return handleData(readU32(data + 1), data + MODEL_XFER_DATA_HEADER,
+                                  length - MODEL_XFER_DATA_HEADER);
+
+            case MODEL_XFER_OP_COMMIT:
+                return handleCommit();
+
+            case MODEL_XFER_OP_ABORT:
+                if (_state == XFER_RECEIVING) _store->abortUpdate();
+                _state = XFER_IDLE;
+                _error = XFER_OK;
+                _nextOffset = 0;
+                return true;
+
+            default:
+                return fail(XFER_ERR_PACKET);
+        }
+    }
+
+    /**
+     * Encode the status for the characteristic value.
+     *
+     * @param out MODEL_XFER_STATUS_SIZE bytes
+     */
+    size_t getStatus(uint8_t* out) const {
+        out[0] = (uint8_t)_state;
+        out[1] = (uint8_t)_error;
+        out[2] = 0;
+        out[3] = 0;
+        writeU32(out + 4, _nextOffset);
+        writeU32(out + 8, _length);
+        return MODEL_XFER_STATUS_SIZE;
+    }
+
+    /**
+     * Slot committed since the last call, or -1.
+     */
+    int takeCommittedSlot() {
+        int slot = _committedSlot;
+        _committedSlot = -1;
+        return slot;
+    }
+
+    ModelTransferState getState() const { return _state; }
+    ModelTransferError getError() const { return _error; }
+    uint32_t getNextOffset() const { return _nextOffset; }
+    uint32_t getLength() const { return _length; }
+
+private:
+    ModelStore* _store;
+    ModelUpdateBegin _beginUpdate;
+    void* _beginContext;
+    ModelTransferState _state;
+    ModelTransferError _error;
+    uint32_t _length;
+    uint32_t _crc;
+    uint32_t _nextOffset;
+    uint32_t _lastAck;          // nextOffset at the last progress notification
+    bool _gapReported;
+    int _committedSlot;
+
+    bool handleBegin(uint32_t length, uint32_t crc, int activeSlot) {
+        // Resume after a reconnect: keep what was received
+        if (_state == XFER_RECEIVING && _store->isUpdating() &&
+            length == _length && crc == _crc) {
+            _error = XFER_OK;
+            _gapReported = false;
+            return true;
+        }
+
+        _length = length;
+        _crc = crc;
+        _nextOffset = 0;
+        _lastAck = 0;
+        _gapReported = false;
+
+        if (length > _store->getCapacity()) {
+            _store->abortUpdate();
+            _state = XFER_FAILED;
+            _error = XFER_ERR_SIZE;
+            return true;
+        }
+        int slot = _beginUpdate ? _beginUpdate(_beginContext, length)
+                                : _store->beginUpdate(length, activeSlot);
+        if (slot < 0) {
+            _state = XFER_FAILED;
+            _error = XFER_ERR_FLASH;
+            return true;
+        }
+
+        _state = XFER_RECEIVING;
+        _error = XFER_OK;
+        return true;
+    }
+
+    bool handleData(uint32_t offset, const uint8_t* data, size_t length) {
+        if (_state != XFER_RECEIVING) return fail(XFER_ERR_PACKET);
+
+        if (offset > _nextOffset) {
+            // Lost a packet: report once, until the central rewinds
+            _error = XFER_ERR_GAP;
+            bool notify = !_gapReported;
+            _gapReported = true;
+            return notify;
+        }
+
+        // Resent chunk: skip what is already written
+        size_t skip = _nextOffset - offset;
+        if (skip >= length) return false;
+        data += skip;
+        length -= skip;
+
+        if (!_store->writeUpdate(_nextOffset, data, length)) {
+            _error = _nextOffset + length > _length ? XFER_ERR_PACKET : XFER_ERR_FLASH;
+            return true;
+        }
+
+        _nextOffset += (uint32_t)length;
+        _error = XFER_OK;
+        _gapReported = false;
+
+        if (_nextOffset - _lastAck >= MODEL_XFER_ACK_BYTES || _nextOffset == _length) {
+            _lastAck = _nextOffset;
+            return true;
+        }
+        return false;
+    }
+
+    bool handleCommit() {
+        if (_state != XFER_RECEIVING) return fail(XFER_ERR_PACKET);
+        if (_nextOffset != _length) {
+            _error = XFER_ERR_INCOMPLETE;
+            return true;
+        }
+
+        int slot = _store->finishUpdate(_crc);
+        if (slot < 0) {
+            _state = XFER_FAILED;
+            _error = XFER_ERR_VERIFY;
+            return true;
+        }
+
+        _state = XFER_COMMITTED;
+        _error = XFER_OK;
+        _committedSlot = slot;
+        return true;
+    }
+
+    bool fail(ModelTransferError error) {
+        _error = error;
+        return true;
+    }
+
+    static uint32_t readU32(const uint8_t* p) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+               ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static void writeU32(uint8_t* p, uint32_t v) {
+        p[0] = v & 0xFF;
+        p[1] = (v >> 8) & 0xFF;
+        p[2] = (v >> 16) & 0xFF;
+        p[3] = (v >> 24) & 0xFF;
+    }
+};
+
+#endif // MODEL_TRANSFER_H
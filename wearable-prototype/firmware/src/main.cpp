@@ -25,6 +25,10 @@
 #include "sensors/ppg_sensor.h"
 #include "ble/ble_handler.h"
 
+#if ENABLE_SENSOR_TASK
+#include "sensors/sensor_task.h"
+#endif
+
 // On-device inference components
 #if ENABLE_EDGE_INFERENCE
 #include "processing/feature_extractor.h"
@@ -39,7 +43,14 @@ IMUSensor imuSensor;
 PPGSensor ppgSensor;
 BLEHandler bleHandler;
 
+#if ENABLE_SENSOR_TASK
+SensorTask sensorTask;
+#endif
+
 #if ENABLE_EDGE_INFERENCE
+#if ENABLE_SHARED_ARENA
+MemoryPlanner memoryPlanner;
+#endif
 FeatureExtractor featureExtractor;
 SleepClassifier sleepClassifier;
 EpochFeatures currentFeatures;
@@ -52,6 +63,32 @@ unsigned long lastPPGRead = 0;
 unsigned long lastDebugPrint = 0;
 unsigned long lastBLETransmit = 0;
 unsigned long lastSleepStageUpdate = 0;
+unsigned long lastBatteryCheck = 0;
+int criticalBatteryChecks = 0;      // Consecutive readings below CRITICAL_BATTERY
+
+#if ENABLE_EDGE_INFERENCE
+// CPU time per epoch (feature extraction + inference), by STAGE_SOURCE_*
+float epochCpuMs[N_STAGE_SOURCES] = {0.0f};
+uint32_t epochCount[N_STAGE_SOURCES] = {0};
+#endif
+
+#if ENABLE_EDGE_INFERENCE && ENABLE_PROVISIONAL_STAGES
+EpochFeatures provisionalFeatures;
+SleepStageResult provisionalStage;
+int provisionalStep = 0;            // Provisional intervals scored this epoch
+#endif
+
+#if ENABLE_EDGE_INFERENCE && SLEEP_MODEL_HOT_SWAP
+bool modelUpdateReady = false;      // New model committed over BLE
+#endif
+
+#if ENABLE_EDGE_INFERENCE && SLEEP_SHADOW_MODEL
+uint32_t shadowReported = 0;        // Compared epochs at the last report
+#endif
+
+// Helper functions (defined at the end)
+float readBatteryVoltage();
+void enterDeepSleep(uint64_t sleepTimeUs);
 
 // Data buffers
 IMUData imuBuffer[IMU_BUFFER_SIZE];
@@ -64,6 +101,131 @@ bool sensorsInitialized = false;
 bool bleConnected = false;
 bool inferenceEnabled = false;
 
+#if ENABLE_EDGE_INFERENCE && ENABLE_INFERENCE_PROFILER
+// =============================================================================
+// Inference Profiling
+// =============================================================================
+
+/**
+ * Print the per-op statistics of the night so far, and optionally the
+ * binary record as hex (the same bytes the PROFILE command sends).
+ */
+void printInferenceProfile(bool withRecord) {
+    const InferenceProfiler& profiler = sleepClassifier.getProfiler();
+    float perUs = (float)InferenceProfiler::cyclesPerMicrosecond();
+    uint32_t invokeMean = profiler.getMean(0);
+    
+    Serial.printf("[PROFILE] %u inferences | arena peak %u bytes | %u events dropped\n",
+                 (unsigned)profiler.getInvocations(), (unsigned)profiler.getArenaPeak(),
+                 (unsigned)profiler.getDropped());
+    Serial.println("[PROFILE] op              min us   mean us    p99 us    max us  share");
+    for (int i = 0; i < profiler.getEventCount(); i++) {
+        const ProfilerEventStats& event = profiler.getEvent(i);
+        Serial.printf("[PROFILE] %-12s %9.1f %9.1f %9.1f %9.1f %5.1f%%\n",
+                     event.tag,
+                     event.minCycles / perUs,
+                     profiler.getMean(i) / perUs,
+                     profiler.getPercentile(i, 0.99f) / perUs,
+                     event.maxCycles / perUs,
+                     invokeMean ? 100.0f * profiler.getMean(i) / invokeMean : 0.0f);
+    }
+    
+    if (withRecord) {
+        uint8_t record[PROFILER_RECORD_MAX];
+        size_t length = profiler.serialize(record);
+        Serial.print("[PROFILE] record ");
+        for (size_t i = 0; i < length; i++) {
+            Serial.printf("%02X", record[i]);
+        }
+        Serial.println();
+    }
+}
+#endif
+
+#if ENABLE_EDGE_INFERENCE && SLEEP_MODEL_HOT_SWAP
+// =============================================================================
+// Model Delivery
+// =============================================================================
+
+/**
+ * BEGIN of a model transfer: the classifier drops a pending swap or shadow
+ * mapped from the slot before it is erased.
+ */
+int beginModelUpdate(void* context, size_t packageLength) {
+    return ((SleepClassifier*)context)->beginModelUpdate(packageLength);
+}
+
+/**
+ * Start the classifier on a model committed over BLE while running without
+ * one (no usable model at boot). Called between epochs: a shared tensor
+ * arena overlaps the feature buffers.
+ */
+void startDeliveredModel() {
+    modelUpdateReady = false;
+    Serial.print("[INFERENCE] Delivered model... ");
+    if (sleepClassifier.begin()) {
+        Serial.printf("OK, arena: %d bytes\n", sleepClassifier.getArenaUsed());
+        inferenceEnabled = true;
+    } else {
+        Serial.println("FAILED!");
+    }
+}
+#endif
+
+// =============================================================================
+// Sensor Samples
+// =============================================================================
+
+/**
+ * Buffer one IMU sample for BLE and feed it to the feature extractor.
+ */
+void handleIMUSample(const IMUData& data) {
+    // Store in buffer for BLE streaming
+    if (imuBufferIndex < IMU_BUFFER_SIZE) {
+        imuBuffer[imuBufferIndex++] = data;
+    }
+    
+    // Add to feature extractor for inference
+    #if ENABLE_EDGE_INFERENCE
+    if (inferenceEnabled) {
+        featureExtractor.addIMUSample(data);
+    }
+    #endif
+    
+    #if LOG_RAW_IMU && DEBUG_SERIAL
+    Serial.printf("[IMU] ax=%+.2f ay=%+.2f az=%+.2f gx=%+.2f gy=%+.2f gz=%+.2f\n",
+                 data.accelX, data.accelY, data.accelZ,
+                 data.gyroX, data.gyroY, data.gyroZ);
+    #endif
+}
+
+/**
+ * Buffer one PPG sample for BLE and feed it (and its beat, if any) to the
+ * feature extractor.
+ */
+void handlePPGSample(const PPGData& data, float heartRate) {
+    // Store in buffer for BLE streaming
+    if (ppgBufferIndex < PPG_BUFFER_SIZE) {
+        ppgBuffer[ppgBufferIndex++] = data;
+    }
+    
+    // Add to feature extractor for inference
+    #if ENABLE_EDGE_INFERENCE
+    if (inferenceEnabled) {
+        featureExtractor.addPPGSample(data, heartRate);
+        if (data.ibiMs > 0) {
+            featureExtractor.addIBI(data.ibiMs);
+        }
+    }
+    #else
+    (void)heartRate;
+    #endif
+    
+    #if LOG_RAW_PPG && DEBUG_SERIAL
+    Serial.printf("[PPG] red=%lu ir=%lu\n", data.red, data.ir);
+    #endif
+}
+
 // =============================================================================
 // Setup
 // =============================================================================
@@ -111,6 +273,15 @@ void setup() {
     } else {
         Serial.println("[SENSORS] WARNING: Some sensors failed to initialize");
     }
+    
+    #if ENABLE_SENSOR_TASK
+    // From here on only the task talks to the sensors
+    if (sensorTask.begin(imuSensor, ppgSensor)) {
+        Serial.printf("[SENSORS] Acquisition task running on core %d\n", SENSOR_TASK_CORE);
+    } else {
+        Serial.println("[SENSORS] ERROR: Acquisition task not started");
+    }
+    #endif
 
     // Initialize BLE
     Serial.print("[BLE] Initializing... ");
@@ -126,6 +297,29 @@ void setup() {
     #if ENABLE_EDGE_INFERENCE
     Serial.println("\n[INFERENCE] Initializing on-device sleep classification...");
     
+    #if ENABLE_SHARED_ARENA
+    // Buffers of different pipeline phases share one arena
+    featureExtractor.requestMemory(memoryPlanner);
+    sleepClassifier.requestMemory(memoryPlanner);
+    if (memoryPlanner.allocate()) {
+        size_t planned = memoryPlanner.getRequiredSize();
+        size_t separate = memoryPlanner.getSeparateSize();
+        Serial.printf("[MEM] Shared arena: %u bytes for %d buffers (separate: %u, saved %u)\n",
+                     (unsigned)planned, memoryPlanner.getBufferCount(),
+                     (unsigned)separate, (unsigned)(separate - planned));
+        for (int i = 0; i < memoryPlanner.getBufferCount(); i++) {
+            Serial.printf("[MEM]   %-12s @%6u %6u bytes  %s-%s\n",
+                         memoryPlanner.getName(i), (unsigned)memoryPlanner.getOffset(i),
+                         (unsigned)memoryPlanner.getSize(i),
+                         MEMORY_PHASE_NAMES[memoryPlanner.getFirstPhase(i)],
+                         MEMORY_PHASE_NAMES[memoryPlanner.getLastPhase(i)]);
+        }
+    } else {
+        Serial.printf("[MEM] Shared arena of %u bytes failed!\n",
+                     (unsigned)memoryPlanner.getRequiredSize());
+    }
+    #endif
+    
     Serial.print("[INFERENCE] Feature extractor... ");
     if (featureExtractor.begin()) {
         Serial.println("OK");
@@ -139,10 +333,21 @@ void setup() {
         inferenceEnabled = true;
         Serial.printf("[INFERENCE] Model arena: %d bytes\n", sleepClassifier.getArenaUsed());
     } else {
+        #if ENABLE_ACTIGRAPHY_FALLBACK
+        Serial.println("FAILED - Actigraphy fallback (Wake/Sleep only)");
+        inferenceEnabled = true;
+        #else
         Serial.println("FAILED - Running in streaming-only mode");
         inferenceEnabled = false;
+        #endif
     }
     
+    #if SLEEP_MODEL_HOT_SWAP
+    // Also without a model: one delivered over BLE is started by startDeliveredModel()
+    bleHandler.setModelStore(&sleepClassifier.getModelStore(), beginModelUpdate,
+                             &sleepClassifier);
+    #endif
+    
     // Initialize last sleep stage
     lastSleepStage.valid = false;
     lastSleepStage.predictedClass = 0;
@@ -163,91 +368,277 @@ void setup() {
 void loop() {
     unsigned long currentTime = millis();
     
+    #if ENABLE_SENSOR_TASK
     // -------------------------------------------------------------------------
-    // Read IMU data at configured rate
+    // Take the samples the acquisition task has queued, in batches
+    // -------------------------------------------------------------------------
+    {
+        IMUData imuBatch[IMU_FIFO_BURST];
+        int count;
+        while ((count = sensorTask.takeIMU(imuBatch, IMU_FIFO_BURST)) > 0) {
+            for (int i = 0; i < count; i++) {
+                handleIMUSample(imuBatch[i]);
+            }
+        }
+        
+        PPGData ppgBatch[PPG_FIFO_DEPTH];
+        float heartRate = sensorTask.getHeartRate();
+        while ((count = sensorTask.takePPG(ppgBatch, PPG_FIFO_DEPTH)) > 0) {
+            for (int i = 0; i < count; i++) {
+                handlePPGSample(ppgBatch[i], heartRate);
+            }
+        }
+    }
+    #else
     // -------------------------------------------------------------------------
+    // Read IMU data: FIFO bursts, or polled at the configured rate
+    // -------------------------------------------------------------------------
+    #if ENABLE_IMU_FIFO
+    if (imuSensor.burstReady()) {
+        IMUData burst[IMU_FIFO_BURST * 2];
+        int count = imuSensor.readBurst(burst, IMU_FIFO_BURST * 2);
+        for (int i = 0; i < count; i++) {
+            handleIMUSample(burst[i]);
+        }
+    }
+    #else
     if (currentTime - lastIMURead >= (1000 / IMU_SAMPLE_RATE_HZ)) {
         lastIMURead = currentTime;
         
         if (imuSensor.isReady()) {
-            IMUData data = imuSensor.read();
-            
-            // Store in buffer for BLE streaming
-            if (imuBufferIndex < IMU_BUFFER_SIZE) {
-                imuBuffer[imuBufferIndex++] = data;
-            }
-            
-            // Add to feature extractor for inference
-            #if ENABLE_EDGE_INFERENCE
-            if (inferenceEnabled) {
-                featureExtractor.addIMUSample(data);
-            }
-            #endif
-            
-            #if LOG_RAW_IMU && DEBUG_SERIAL
-            Serial.printf("[IMU] ax=%+.2f ay=%+.2f az=%+.2f gx=%+.2f gy=%+.2f gz=%+.2f\n",
-                         data.accelX, data.accelY, data.accelZ,
-                         data.gyroX, data.gyroY, data.gyroZ);
-            #endif
+            handleIMUSample(imuSensor.read());
         }
     }
+    #endif
 
     // -------------------------------------------------------------------------
-    // Read PPG data at configured rate
+    // Drain the PPG FIFO (every sample, with its timestamp)
     // -------------------------------------------------------------------------
-    if (currentTime - lastPPGRead >= (1000 / PPG_SAMPLE_RATE_HZ)) {
+    if (currentTime - lastPPGRead >= PPG_FIFO_DRAIN_MS) {
         lastPPGRead = currentTime;
         
         if (ppgSensor.isReady()) {
-            PPGData data = ppgSensor.read();
+            PPGData batch[PPG_FIFO_DEPTH];
+            int count = ppgSensor.readBatch(batch, PPG_FIFO_DEPTH);
             float heartRate = ppgSensor.getLastHeartRate();
-            
-            // Store in buffer for BLE streaming
-            if (ppgBufferIndex < PPG_BUFFER_SIZE) {
-                ppgBuffer[ppgBufferIndex++] = data;
-            }
-            
-            // Add to feature extractor for inference
-            #if ENABLE_EDGE_INFERENCE
-            if (inferenceEnabled) {
-                featureExtractor.addPPGSample(data, heartRate);
+            for (int i = 0; i < count; i++) {
+                handlePPGSample(batch[i], heartRate);
             }
-            #endif
-            
-            #if LOG_RAW_PPG && DEBUG_SERIAL
-            Serial.printf("[PPG] red=%lu ir=%lu\n", data.red, data.ir);
-            #endif
         }
     }
+    #endif
 
     // -------------------------------------------------------------------------
     // Run sleep stage inference when epoch is ready (every 30 seconds)
     // -------------------------------------------------------------------------
     #if ENABLE_EDGE_INFERENCE
+    #if SLEEP_MODEL_HOT_SWAP
+    // Write received model chunks to the inactive slot
+    if (bleHandler.processModelTransfer(sleepClassifier.getActiveSlot()) >= 0) {
+        if (!sleepClassifier.hasModel()) {
+            // Nothing to compare or swap with: started between epochs
+            modelUpdateReady = true;
+        } else {
+            #if SLEEP_SHADOW_MODEL
+            // Evaluated as a shadow first; SHADOW_PROMOTE switches to it
+            sleepClassifier.startShadow();
+            #else
+            modelUpdateReady = true;
+            #endif
+        }
+    }
+    if (modelUpdateReady && !inferenceEnabled) {
+        // Streaming-only: the feature buffers are idle
+        startDeliveredModel();
+    }
+    #endif
+    
+    #if SLEEP_SHADOW_MODEL
+    uint8_t shadowRequest = bleHandler.takeShadowRequest();
+    if (shadowRequest == SHADOW_REQUEST_SEND) {
+        uint8_t record[SHADOW_RECORD_MAX];
+        bleHandler.setStatus(record, sleepClassifier.getShadowMonitor().serialize(record));
+    } else if (shadowRequest == SHADOW_REQUEST_PROMOTE) {
+        // Switches at the next epoch
+        if (!sleepClassifier.promoteShadow()) {
+            bleHandler.setStatus("No shadow model");
+        }
+    } else if (shadowRequest == SHADOW_REQUEST_END) {
+        sleepClassifier.endShadow();
+    }
+    #endif
+    
+    // New recording: the previous night's context does not carry over
+    if (bleHandler.takeStartRequest()) {
+        sleepClassifier.startNight();
+        Serial.println("[SLEEP] New night: smoothing and recurrent state reset");
+    }
+    
+    #if ENABLE_ADAPTIVE_NORM
+    // New wearer: start again from the population scaler
+    if (bleHandler.takeNormResetRequest()) {
+        sleepClassifier.resetNormalizer();
+        Serial.println("[NORM] Per-user statistics reset");
+    }
+    #endif
+    
+    #if ENABLE_INFERENCE_PROFILER
+    // Profiler record on request: BLE control command or 'p' on serial
+    uint8_t profileRequest = bleHandler.takeProfileRequest();
+    if (profileRequest == PROFILE_REQUEST_SEND) {
+        uint8_t record[PROFILER_RECORD_MAX];
+        bleHandler.setStatus(record, sleepClassifier.getProfiler().serialize(record));
+    } else if (profileRequest == PROFILE_REQUEST_RESET) {
+        sleepClassifier.resetProfiler();
+    }
+    if (Serial.available() && Serial.read() == 'p') {
+        printInferenceProfile(true);
+    }
+    #endif
+    
+    #if ENABLE_PROVISIONAL_STAGES
+    // Provisional stage every PROVISIONAL_INTERVAL_SEC of IMU samples
+    int provisionalDue = featureExtractor.getIMUSampleCount() /
+                         (PROVISIONAL_INTERVAL_SEC * IMU_SAMPLE_RATE_HZ);
+    if (inferenceEnabled && provisionalDue > provisionalStep &&
+        !featureExtractor.isEpochReady()) {
+        provisionalStep = provisionalDue;
+        if (featureExtractor.extractProvisionalFeatures(provisionalFeatures) &&
+            sleepClassifier.classifyProvisional(provisionalFeatures, provisionalStage)) {
+            Serial.printf("[PROV] Stage: %s (confidence: %.1f%%, smoothed: %s, %.0f%% of epoch)\n",
+                         provisionalStage.className,
+                         provisionalStage.confidence * 100.0f,
+                         SLEEP_CLASS_NAMES[provisionalStage.smoothedClass],
+                         featureExtractor.getBufferProgress());
+            if (bleConnected) {
+                char status[48];
+                snprintf(status, sizeof(status), "PROVISIONAL:%s:%.2f",
+                         provisionalStage.className, provisionalStage.confidence);
+                bleHandler.setStatus(status);
+            }
+        }
+    }
+    #endif
+    
     if (inferenceEnabled && featureExtractor.isEpochReady()) {
-        // Extract features
-        if (featureExtractor.extractFeatures(currentFeatures)) {
-            // Run inference
-            if (sleepClassifier.classify(currentFeatures, lastSleepStage)) {
-                lastSleepStageUpdate = currentTime;
-                
-                Serial.printf("[SLEEP] Stage: %s (confidence: %.1f%%, inference: %.2fms)\n",
-                             lastSleepStage.className,
-                             lastSleepStage.confidence * 100.0f,
-                             lastSleepStage.inferenceTimeMs);
-                Serial.printf("[SLEEP] Probabilities: W=%.2f L=%.2f D=%.2f R=%.2f\n",
-                             lastSleepStage.probabilities[0],
-                             lastSleepStage.probabilities[1],
-                             lastSleepStage.probabilities[2],
-                             lastSleepStage.probabilities[3]);
-                
-                // Send sleep stage via BLE
-                if (bleConnected) {
-                    bleHandler.sendSleepStage(lastSleepStage.predictedClass, 
-                                             lastSleepStage.confidence);
-                }
+        #if ENABLE_PROVISIONAL_STAGES
+        provisionalStep = 0;
+        #endif
+        
+        #if SLEEP_MODEL_HOT_SWAP
+        // Stage the new model; the classifier switches to it this epoch
+        if (modelUpdateReady && sleepClassifier.hasModel()) {
+            modelUpdateReady = false;
+            sleepClassifier.checkForModelUpdate();
+        }
+        #endif
+        
+        #if SLEEP_SHADOW_MODEL
+        if (sleepClassifier.hasShadow()) {
+            sleepClassifier.setBatteryVoltage(readBatteryVoltage());
+        }
+        #endif
+        
+        unsigned long epochStart = micros();
+        bool classified;
+        
+        #if ENABLE_ACTIGRAPHY_FALLBACK
+        if (!sleepClassifier.hasModel()) {
+            // No model: Wake/Sleep from the IMU activity counts alone
+            classified = featureExtractor.extractIMUFeatures(currentFeatures) &&
+                         sleepClassifier.classifyActigraphy(
+                             featureExtractor.computeActigraphyCounts(), lastSleepStage);
+            featureExtractor.skipPPGFeatures();
+        } else
+        #endif
+        #if ENABLE_IMU_GATE
+        // Cascade: IMU features + gate first, PPG features only if undecided
+        if (!featureExtractor.extractIMUFeatures(currentFeatures)) {
+            classified = false;
+        } else if (sleepClassifier.classifyIMUOnly(currentFeatures, lastSleepStage)) {
+            featureExtractor.skipPPGFeatures();
+            classified = true;
+        } else {
+            classified = featureExtractor.extractPPGFeatures(currentFeatures) &&
+                         sleepClassifier.classify(currentFeatures, lastSleepStage);
+        }
+        #else
+        {
+            classified = featureExtractor.extractFeatures(currentFeatures) &&
+                         sleepClassifier.classify(currentFeatures, lastSleepStage);
+        }
+        #endif
+        
+        if (classified) {
+            lastSleepStageUpdate = currentTime;
+            epochCpuMs[lastSleepStage.source] += (micros() - epochStart) / 1000.0f;
+            epochCount[lastSleepStage.source]++;
+            
+            Serial.printf("[SLEEP] Stage: %s (confidence: %.1f%%, inference: %.2fms, %s)\n",
+                         lastSleepStage.className,
+                         lastSleepStage.confidence * 100.0f,
+                         lastSleepStage.inferenceTimeMs,
+                         STAGE_SOURCE_NAMES[lastSleepStage.source]);
+            Serial.printf("[SLEEP] Probabilities: W=%.2f L=%.2f D=%.2f R=%.2f\n",
+                         lastSleepStage.probabilities[0],
+                         lastSleepStage.probabilities[1],
+                         lastSleepStage.probabilities[2],
+                         lastSleepStage.probabilities[3]);
+            #if ENABLE_HMM_SMOOTHING
+            Serial.printf("[SLEEP] Smoothed: %s (%.1f%%) | %d epochs back: %s\n",
+                         SLEEP_CLASS_NAMES[lastSleepStage.smoothedClass],
+                         lastSleepStage.smoothedProbabilities[lastSleepStage.smoothedClass] * 100.0f,
+                         HMM_SMOOTHING_LAG,
+                         lastSleepStage.laggedClass >= 0 ?
+                             SLEEP_CLASS_NAMES[lastSleepStage.laggedClass] : "---");
+            #endif
+            #if ENABLE_IMU_GATE
+            if (epochCount[STAGE_SOURCE_MODEL] > 0) {
+                // Saving vs. running every epoch through the full path
+                uint32_t epochs = epochCount[STAGE_SOURCE_MODEL] + epochCount[STAGE_SOURCE_IMU_GATE];
+                float fullMs = epochCpuMs[STAGE_SOURCE_MODEL] / epochCount[STAGE_SOURCE_MODEL];
+                float gatedMs = epochCount[STAGE_SOURCE_IMU_GATE] > 0 ?
+                    epochCpuMs[STAGE_SOURCE_IMU_GATE] / epochCount[STAGE_SOURCE_IMU_GATE] : 0.0f;
+                float spentMs = epochCpuMs[STAGE_SOURCE_MODEL] + epochCpuMs[STAGE_SOURCE_IMU_GATE];
+                Serial.printf("[CASCADE] IMU path: %.0f%% of %u epochs | %.2f ms vs %.2f ms full | CPU saved: %.0f%%\n",
+                             sleepClassifier.getGatedFraction() * 100.0f, (unsigned)epochs,
+                             gatedMs, fullMs, 100.0f * (1.0f - spentMs / (fullMs * epochs)));
+            }
+            #endif
+            #if SLEEP_SHADOW_MODEL
+            const ShadowMonitor& shadow = sleepClassifier.getShadowMonitor();
+            if (sleepClassifier.hasShadow() && shadow.getCompared() != shadowReported &&
+                shadow.getCompared() % SHADOW_REPORT_EPOCHS == 0) {
+                shadowReported = shadow.getCompared();
+                Serial.printf("[SHADOW] Sequence %u: %u epochs, %.1f%% agreement, %.2f ms/epoch | skipped: %u battery, %u CPU\n",
+                             (unsigned)sleepClassifier.getShadowSequence(),
+                             (unsigned)shadow.getCompared(), shadow.getAgreement() * 100.0f,
+                             shadow.getCostMs(), (unsigned)shadow.getSkippedBattery(),
+                             (unsigned)shadow.getSkippedCpu());
+            }
+            #endif
+            #if ENABLE_INFERENCE_PROFILER
+            uint32_t profiled = sleepClassifier.getProfiler().getInvocations();
+            if (lastSleepStage.source == STAGE_SOURCE_MODEL && profiled > 0 &&
+                profiled % PROFILER_REPORT_EPOCHS == 0) {
+                printInferenceProfile(false);
+            }
+            #endif
+            
+            // Send sleep stage via BLE
+            if (bleConnected) {
+                bleHandler.sendSleepStage(lastSleepStage.predictedClass, 
+                                         lastSleepStage.confidence);
             }
         }
+        
+        #if SLEEP_MODEL_HOT_SWAP
+        // Actigraphy fallback: switch to the delivered model now that this
+        // epoch's samples are consumed
+        if (modelUpdateReady && !sleepClassifier.hasModel()) {
+            startDeliveredModel();
+        }
+        #endif
     }
     #endif
 
@@ -266,13 +657,36 @@ void loop() {
         // Transmit PPG buffer
         if (ppgBufferIndex >= PPG_BUFFER_SIZE) {
             // Calculate heart rate from buffer
+            #if ENABLE_SENSOR_TASK
+            // The sensor belongs to the task: only the samples taken from it
+            float heartRate = PPGSensor::heartRateFromPeaks(ppgBuffer, ppgBufferIndex);
+            if (heartRate <= 0) heartRate = sensorTask.getHeartRate();
+            #else
             float heartRate = ppgSensor.calculateHeartRate(ppgBuffer, ppgBufferIndex);
+            #endif
             bleHandler.sendHeartRate((uint8_t)heartRate);
             bleHandler.sendPPGData(ppgBuffer, ppgBufferIndex);
             ppgBufferIndex = 0;
         }
     }
 
+    // -------------------------------------------------------------------------
+    // Critical battery: save the night's state and power down
+    // -------------------------------------------------------------------------
+    if (currentTime - lastBatteryCheck >= BATTERY_CHECK_MS) {
+        lastBatteryCheck = currentTime;
+        float batteryVoltage = readBatteryVoltage();
+        // Near 0 V: no ADC pin, or no cell behind the divider (USB power)
+        if (batteryVoltage > 0.5f && batteryVoltage < CRITICAL_BATTERY) {
+            if (++criticalBatteryChecks >= CRITICAL_BATTERY_CHECKS) {
+                Serial.printf("[POWER] Battery critical (%.2fV)\n", batteryVoltage);
+                enterDeepSleep((uint64_t)CRITICAL_SLEEP_SEC * 1000000ULL);
+            }
+        } else {
+            criticalBatteryChecks = 0;
+        }
+    }
+
     // -------------------------------------------------------------------------
     // Status LED blink
     // -------------------------------------------------------------------------
@@ -294,7 +708,11 @@ void loop() {
     if (currentTime - lastDebugPrint >= DEBUG_PRINT_INTERVAL_MS) {
         lastDebugPrint = currentTime;
         
+        #if ENABLE_SENSOR_TASK
+        float heartRate = sensorTask.getHeartRate();
+        #else
         float heartRate = ppgSensor.getLastHeartRate();
+        #endif
         float batteryVoltage = readBatteryVoltage();
         
         #if ENABLE_EDGE_INFERENCE
@@ -315,6 +733,29 @@ void loop() {
                      bleConnected ? "connected" : "advertising",
                      batteryVoltage);
         #endif
+        
+        #if ENABLE_SENSOR_TASK
+        if (sensorTask.getIMUOverruns() > 0 || sensorTask.getPPGOverruns() > 0) {
+            Serial.printf("[SENSORS] Ring overruns: IMU=%lu PPG=%lu samples\n",
+                         (unsigned long)sensorTask.getIMUOverruns(),
+                         (unsigned long)sensorTask.getPPGOverruns());
+        }
+        #endif
+        
+        #if ENABLE_I2C_SCHEDULER
+        I2CStats i2cStats;
+        if (sensorTask.takeI2CStats(i2cStats)) {
+            Serial.printf("[I2C] Bus %.2f%% busy | %lu reads in %lu transactions (%lu merged) | "
+                         "latency mean=%.0f max=%lu us | failed=%lu\n",
+                         i2cStats.utilization * 100.0f,
+                         (unsigned long)i2cStats.requests,
+                         (unsigned long)i2cStats.transactions,
+                         (unsigned long)i2cStats.merged,
+                         i2cStats.meanLatencyUs,
+                         (unsigned long)i2cStats.maxLatencyUs,
+                         (unsigned long)i2cStats.failed);
+        }
+        #endif
     }
     #endif
 
@@ -340,14 +781,32 @@ float readBatteryVoltage() {
 }
 
 /**
- * Enter deep sleep mode
+ * Enter deep sleep mode (on a critical battery, from loop()). The
+ * night's state is written first, so a restart can pick it up.
  */
 void enterDeepSleep(uint64_t sleepTimeUs) {
     Serial.println("[POWER] Entering deep sleep...");
     
-    // Disable sensors
-    imuSensor.sleep();
-    ppgSensor.sleep();
+    bool sensorsIdle = true;
+    #if ENABLE_SENSOR_TASK
+    sensorsIdle = sensorTask.end();
+    #endif
+    
+    // Disable sensors (unless the task is stuck on the bus with them)
+    if (sensorsIdle) {
+        imuSensor.sleep();
+        ppgSensor.sleep();
+    } else {
+        Serial.println("[POWER] Sensor task did not stop, sensors left on");
+    }
+    
+    #if ENABLE_EDGE_INFERENCE && ENABLE_ADAPTIVE_NORM
+    // Keep the epochs since the last periodic write
+    sleepClassifier.persistNormalizer();
+    #endif
+    #if SLEEP_SEQUENCE_STATE
+    sleepClassifier.saveSequenceState();
+    #endif
     
     // Configure wake-up sources
     // esp_sleep_enable_ext0_wakeup(GPIO_NUM_X, 1);  // Wake on button press
@@ -0,0 +1,190 @@
+/**
+ * Actigraphy Sleep/Wake Scorer
+ * ============================
+ *
+ * Model-free sleep/wake scoring over per-minute activity counts with the
+ * standard weighted-window formulas, as implemented in ActiLife:
+ *
+ *   Cole-Kripke (1992)  a = min(counts / 100, 300)
+ *     D = 0.001 (106 a[-4] + 54 a[-3] + 58 a[-2] + 76 a[-1]
+ *                + 230 a[0] + 74 a[+1] + 67 a[+2])
+ *     Sleep if D < 1
+ *
+ *   Sadeh (1994)        a = min(counts, 300)
+ *     PS = 7.601 - 0.065 MW5 - 1.08 NAT - 0.056 SD6 - 0.703 ln(a[0] + 1)
+ *     MW5: mean of a[-5..+5]; NAT: minutes in it with 50 <= a < 100;
+ *     SD6: standard deviation of a[-5..0]
+ *     Sleep if PS > -4
+ *
+ * Both look ahead, so minute t is scored once minute t + 2 (Cole-Kripke)
+ * or t + 5 (Sadeh) has been seen. Minutes before the first are taken as
+ * zero. Fixed-size ring, no allocation; a score is a few dozen
+ * multiply-adds per minute.
+ */
+
+#ifndef ACTIGRAPHY_SCORER_H
+#define ACTIGRAPHY_SCORER_H
+
+#include <stdint.h>
+#include <math.h>
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define ACTIGRAPHY_WINDOW       11      // Minutes, widest window (Sadeh)
+#define ACTIGRAPHY_CK_LAG       2
+#define ACTIGRAPHY_SADEH_LAG    5
+#define ACTIGRAPHY_COUNT_CAP    300.0f
+
+#ifndef ACTIGRAPHY_COLE_KRIPKE
+#define ACTIGRAPHY_COLE_KRIPKE  0
+#define ACTIGRAPHY_SADEH        1
+#endif
+
+
+// ============================================================================
+// Actigraphy Scorer Class
+// ============================================================================
+
+class ActigraphyScorer {
+public:
+    ActigraphyScorer() : _algorithm(ACTIGRAPHY_COLE_KRIPKE), _epochsPerMinute(1) {
+        reset();
+    }
+
+    /**
+     * @param algorithm ACTIGRAPHY_COLE_KRIPKE or ACTIGRAPHY_SADEH
+     * @param epochsPerMinute Epochs summed into one minute of counts
+     */
+    bool begin(int algorithm, int epochsPerMinute) {
+        if ((algorithm != ACTIGRAPHY_COLE_KRIPKE && algorithm != ACTIGRAPHY_SADEH) ||
+            epochsPerMinute <= 0) {
+            return false;
+        }
+        _algorithm = algorithm;
+        _epochsPerMinute = epochsPerMinute;
+        reset();
+        return true;
+    }
+
+    void reset() {
+        for (int i = 0; i < ACTIGRAPHY_WINDOW; i++) _minutes[i] = 0.0f;
+        _head = 0;
+        _minuteCount = 0;
+        _epochInMinute = 0;
+        _pending = 0.0f;
+        _scored = false;
+        _asleep = false;
+        _wakeProbability = 0.5f;
+    }
+
+    /**
+     * Add one epoch of activity counts.
+     *
+     * @return true if this completed a minute and a new score is available
+     */
+    bool addEpoch(float counts) {
+        _pending += counts;
+        if (++_epochInMinute < _epochsPerMinute) {
+            return false;
+        }
+
+        _minutes[_head] = _pending;
+        _head = _head + 1 == ACTIGRAPHY_WINDOW ? 0 : _head + 1;
+        _minuteCount++;
+        _epochInMinute = 0;
+        _pending = 0.0f;
+
+        if (_minuteCount <= (uint32_t)getLag()) {
+            return false;
+        }
+
+        // Chronological window ending at the newest minute
+        float window[ACTIGRAPHY_WINDOW];
+        int row = _head;
+        for (int i = 0; i < ACTIGRAPHY_WINDOW; i++) {
+            window[i] = _minutes[row];
+            row = row + 1 == ACTIGRAPHY_WINDOW ? 0 : row + 1;
+        }
+
+        if (_algorithm == ACTIGRAPHY_SADEH) {
+            float ps = sadeh(window);
+            _asleep = ps > -4.0f;
+            _wakeProbability = 1.0f / (1.0f + expf(ps + 4.0f));
+        } else {
+            float d = coleKripke(window + ACTIGRAPHY_WINDOW - 7);
+            _asleep = d < 1.0f;
+            _wakeProbability = d / (1.0f + d);
+        }
+        _scored = true;
+        return true;
+    }
+
+    /**
+     * Cole-Kripke D over 7 minutes of raw counts, a[-4] .. a[+2].
+     */
+    static float coleKripke(const float* counts) {
+        static const float W[7] = {106.0f, 54.0f, 58.0f, 76.0f, 230.0f, 74.0f, 67.0f};
+        float sum = 0.0f;
+        for (int i = 0; i < 7; i++) {
+            float a = counts[i] * 0.01f;
+            sum += W[i] * (a < ACTIGRAPHY_COUNT_CAP ? a : ACTIGRAPHY_COUNT_CAP);
+        }
+        return 0.001f * sum;
+    }
+
+    /**
+     * Sadeh PS over 11 minutes of raw counts, a[-5] .. a[+5].
+     */
+    static float sadeh(const float* counts) {
+        float a[ACTIGRAPHY_WINDOW];
+        float sum = 0.0f;
+        int nat = 0;
+        for (int i = 0; i < ACTIGRAPHY_WINDOW; i++) {
+            a[i] = counts[i] < ACTIGRAPHY_COUNT_CAP ? counts[i] : ACTIGRAPHY_COUNT_CAP;
+            sum += a[i];
+            if (a[i] >= 50.0f && a[i] < 100.0f) nat++;
+        }
+        float mw5 = sum / ACTIGRAPHY_WINDOW;
+
+        // a[-5] .. a[0]
+        float mean6 = 0.0f;
+        for (int i = 0; i < 6; i++) mean6 += a[i];
+        mean6 /= 6.0f;
+        float var6 = 0.0f;
+        for (int i = 0; i < 6; i++) var6 += (a[i] - mean6) * (a[i] - mean6);
+        float sd6 = sqrtf(var6 / 5.0f);
+
+        return 7.601f - 0.065f * mw5 - 1.08f * nat - 0.056f * sd6 - 0.703f * logf(a[5] + 1.0f);
+    }
+
+    /** Minutes between the newest minute and the scored one. */
+    int getLag() const {
+        return _algorithm == ACTIGRAPHY_SADEH ? ACTIGRAPHY_SADEH_LAG : ACTIGRAPHY_CK_LAG;
+    }
+
+    bool hasScore() const { return _scored; }
+    bool isAsleep() const { return _asleep; }
+
+    /** Monotone map of the score to (0, 1); 0.5 at the sleep/wake threshold. */
+    float getWakeProbability() const { return _wakeProbability; }
+
+    uint32_t getMinuteCount() const { return _minuteCount; }
+
+private:
+    int _algorithm;
+    int _epochsPerMinute;
+
+    float _minutes[ACTIGRAPHY_WINDOW];  // Ring of per-minute counts
+    int _head;                          // Oldest minute / next write
+    uint32_t _minuteCount;
+    int _epochInMinute;
+    float _pending;                     // Counts of the minute in progress
+
+    bool _scored;
+    bool _asleep;
+    float _wakeProbability;
+};
+
+#endif // ACTIGRAPHY_SCORER_H
@@ -0,0 +1,284 @@
+/**
+ * Per-User Adaptive Feature Normalization
+ * =======================================
+ *
+ * FEATURE_MEAN / FEATURE_SCALE describe the training population. A
+ * wearer's own baselines (PPG DC level, resting HR, strap tightness) can
+ * sit far outside it, so the model sees shifted inputs all night. This
+ * stage keeps exponentially weighted per-user statistics of the raw
+ * features and maps each epoch onto the population before the scaler:
+ *
+ *   m_eff = (1 - w) * pop_mean  + w * user_mean
+ *   s_eff = (1 - w) * pop_scale + w * user_std
+ *   x'    = pop_mean + (x - m_eff) * pop_scale / s_eff
+ *
+ * so x' is in raw feature units and every engine (scaler, folded scaler
+ * or trees) takes it unchanged. With w = 0, x' = x. The user statistics
+ * start at the population and follow
+ *
+ *   m   += a * (x - m)
+ *   var  = (1 - a) * (var + a * (x - m_old)^2),   a = 1 - 2^(-1 / half_life)
+ *
+ * with x clipped to m +- ADAPTIVE_NORM_CLIP_STD * std first, so a motion
+ * artifact cannot drag the baseline, and user_std held above
+ * ADAPTIVE_NORM_MIN_STD_RATIO * pop_scale. update() and apply() are
+ * O(features); the per-feature gain and offset are refreshed by update().
+ *
+ * The statistics are written to NVS every `persistEvery` updates and
+ * loaded by begin(), so they carry over from night to night. A record is
+ * only accepted for the same feature count and with a matching CRC. On
+ * the host (no ARDUINO) NVS is a file, as in recurrent_state.h.
+ */
+
+#ifndef ADAPTIVE_NORMALIZER_H
+#define ADAPTIVE_NORMALIZER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "model_store.h"
+
+#ifdef ARDUINO
+#include <Preferences.h>
+#endif
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define ADAPTIVE_NORM_MAGIC             0x4D524E55u     // "UNRM"
+#define ADAPTIVE_NORM_MAX_FEATURES      128
+#define ADAPTIVE_NORM_CLIP_STD          4.0f
+#define ADAPTIVE_NORM_MIN_STD_RATIO     0.25f
+
+
+// ============================================================================
+// Stored Statistics
+// ============================================================================
+
+struct AdaptiveNormRecord {
+    uint32_t magic;             // ADAPTIVE_NORM_MAGIC
+    uint32_t count;             // Features
+    uint32_t updates;           // Epochs seen since the last reset
+    float mean[ADAPTIVE_NORM_MAX_FEATURES];
+    float var[ADAPTIVE_NORM_MAX_FEATURES];
+    uint32_t crc32;             // Over all fields above
+};
+
+
+// ============================================================================
+// Adaptive Normalizer Class
+// ============================================================================
+
+class AdaptiveNormalizer {
+public:
+    AdaptiveNormalizer() : _popMean(nullptr), _popScale(nullptr), _count(0),
+                           _alpha(0.0f), _weight(0.0f), _persistEvery(0) {
+        _name[0] = '\0';
+        memset(&_stats, 0, sizeof(_stats));
+    }
+
+    /**
+     * @param popMean, popScale Population scaler (FEATURE_MEAN, FEATURE_SCALE);
+     *                          kept by pointer
+     * @param count Features normalized (<= ADAPTIVE_NORM_MAX_FEATURES)
+     * @param halfLife Epochs for an old epoch's weight to halve
+     * @param weight Share of the user statistics in the blend, 0..1
+     * @param name NVS namespace (device) or file path (host); nullptr: no
+     *             persistence
+     * @param persistEvery Updates between NVS writes (0: only persist())
+     * @return false on bad parameters; true otherwise, with stored
+     *         statistics loaded if there are any
+     */
+    bool begin(const float* popMean, const float* popScale, int count,
+               float halfLife, float weight, const char* name, uint32_t persistEvery) {
+        _count = 0;
+        if (count <= 0 || count > ADAPTIVE_NORM_MAX_FEATURES || !(halfLife >= 1.0f) ||
+            weight < 0.0f || weight > 1.0f) {
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            if (!(popScale[i] > 0.0f)) return false;
+        }
+        if (name && strlen(name) >= sizeof(_name)) {
+            return false;
+        }
+
+        _popMean = popMean;
+        _popScale = popScale;
+        _count = count;
+        _alpha = 1.0f - powf(2.0f, -1.0f / halfLife);
+        _weight = weight;
+        _persistEvery = persistEvery;
+        strcpy(_name, name ? name : "");
+
+        AdaptiveNormRecord stored;
+        if (readNvs(stored) && isValid(stored) && stored.count == (uint32_t)count) {
+            _stats = stored;
+        } else {
+            resetStats();
+        }
+        refresh();
+        return true;
+    }
+
+    /**
+     * Back to the population (new wearer); also clears the stored copy.
+     */
+    void reset() {
+        if (_count == 0) return;
+        resetStats();
+        refresh();
+        persist();
+    }
+
+    /**
+     * Fold one epoch's raw features into the user statistics.
+     *
+     * @param features Raw features
+     * @param valid Leading features that hold values this epoch (e.g. the
+     *              IMU block when the PPG features were skipped); the rest
+     *              keep their statistics
+     */
+    void update(const float* features, int valid) {
+        if (valid > _count) valid = _count;
+        if (valid <= 0) return;
+
+        for (int i = 0; i < valid; i++) {
+            float mean = _stats.mean[i];
+            float var = _stats.var[i];
+            float limit = ADAPTIVE_NORM_CLIP_STD * userStd(i);
+            float delta = features[i] - mean;
+            if (!(delta == delta)) continue;    // NaN from a failed extraction
+            delta = delta < -limit ? -limit : delta;
+            delta = delta > limit ? limit : delta;
+
+            _stats.mean[i] = mean + _alpha * delta;
+            _stats.var[i] = (1.0f - _alpha) * (var + _alpha * delta * delta);
+        }
+        _stats.updates++;
+        refresh();
+
+        if (_persistEvery > 0 && _stats.updates % _persistEvery == 0) {
+            persist();
+        }
+    }
+
+    /**
+     * Map raw features onto the population: output[i] = x * gain + offset
+     * for the first getCount() features. `output` may be `features`.
+     */
+    void apply(const float* features, float* output, int count) const {
+        if (count > _count) count = _count;
+        for (int i = 0; i < count; i++) {
+            output[i] = features[i] * _gain[i] + _offset[i];
+        }
+    }
+
+    /**
+     * Write the statistics to NVS now (e.g. at the end of a night).
+     */
+    bool persist() {
+        if (_count == 0) return false;
+        _stats.crc32 = recordCrc(_stats);
+        return writeNvs(_stats);
+    }
+
+    int getCount() const { return _count; }
+    uint32_t getUpdates() const { return _stats.updates; }
+    float getUserMean(int index) const { return _stats.mean[index]; }
+    float getUserStd(int index) const { return userStd(index); }
+
+private:
+    const float* _popMean;
+    const float* _popScale;
+    int _count;
+    float _alpha;
+    float _weight;
+    uint32_t _persistEvery;
+    char _name[64];
+
+    AdaptiveNormRecord _stats;
+    float _gain[ADAPTIVE_NORM_MAX_FEATURES];
+    float _offset[ADAPTIVE_NORM_MAX_FEATURES];
+
+    void resetStats() {
+        memset(&_stats, 0, sizeof(_stats));
+        _stats.magic = ADAPTIVE_NORM_MAGIC;
+        _stats.count = (uint32_t)_count;
+        for (int i = 0; i < _count; i++) {
+            _stats.mean[i] = _popMean[i];
+            _stats.var[i] = _popScale[i] * _popScale[i];
+        }
+    }
+
+    /**
+     * User standard deviation, held above the floor.
+     */
+    float userStd(int i) const {
+        float std = sqrtf(_stats.var[i]);
+        float minStd = ADAPTIVE_NORM_MIN_STD_RATIO * _popScale[i];
+        return std > minStd ? std : minStd;
+    }
+
+    /**
+     * Gain and offset of apply() from the current statistics.
+     */
+    void refresh() {
+        for (int i = 0; i < _count; i++) {
+            float mean = _popMean[i] + _weight * (_stats.mean[i] - _popMean[i]);
+            float scale = _popScale[i] + _weight * (userStd(i) - _popScale[i]);
+            _gain[i] = _popScale[i] / scale;
+            _offset[i] = _popMean[i] - mean * _gain[i];
+        }
+    }
+
+    static uint32_t recordCrc(const AdaptiveNormRecord& record) {
+        return crc32Update(0, (const uint8_t*)&record, offsetof(AdaptiveNormRecord, crc32));
+    }
+
+    static bool isValid(const AdaptiveNormRecord& record) {
+        return record.magic == ADAPTIVE_NORM_MAGIC &&
+               record.count > 0 && record.count <= ADAPTIVE_NORM_MAX_FEATURES &&
+               record.crc32 == recordCrc(record);
+    }
+
+    bool writeNvs(const AdaptiveNormRecord& record) {
+        if (_name[0] == '\0') return false;
+        #ifdef ARDUINO
+        Preferences prefs;
+        if (!prefs.begin(_name, false)) return false;
+        size_t written = prefs.putBytes("stats", &record, sizeof(record));
+        prefs.end();
+        return written == sizeof(record);
+        #else
+        FILE* f = fopen(_name, "wb");
+        if (!f) return false;
+        size_t written = fwrite(&record, 1, sizeof(record), f);
+        fclose(f);
+        return written == sizeof(record);
+        #endif
+    }
+
+    bool readNvs(AdaptiveNormRecord& record) {
+        if (_name[0] == '\0') return false;
+        #ifdef ARDUINO
+        Preferences prefs;
+        if (!prefs.begin(_name, true)) return false;
+        size_t read = prefs.getBytes("stats", &record, sizeof(record));
+        prefs.end();
+        return read == sizeof(record);
+        #else
+        FILE* f = fopen(_name, "rb");
+        if (!f) return false;
+        size_t read = fread(&record, 1, sizeof(record), f);
+        fclose(f);
+        return read == sizeof(record);
+        #endif
+    }
+};
+
+#endif // ADAPTIVE_NORMALIZER_H
@@ -0,0 +1,229 @@
+/**
+ * Entropy Features
+ * ================
+ *
+ * Bounded-cost complexity measures for the IMU magnitude and IBI series.
+ *
+ *   - Permutation entropy: ordinal patterns are counted as samples arrive,
+ *     so the per-epoch cost is O(n * m^2) with a tiny constant (m = order).
+ *   - Sample entropy: template matching restricted to neighbouring value
+ *     buckets of width >= r. Only pairs whose first samples fall in adjacent
+ *     buckets can match, which removes most of the O(n^2) comparisons.
+ *     Inputs are decimated to at most ENTROPY_MAX_SAMPEN_LEN points so the
+ *     worst case stays bounded.
+ */
+
+#ifndef ENTROPY_FEATURES_H
+#define ENTROPY_FEATURES_H
+
+#include <stdint.h>
+#include <math.h>
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define ENTROPY_PE_ORDER            4       // Pattern length (4! = 24 patterns)
+#define ENTROPY_PE_PATTERNS         24      // ENTROPY_PE_ORDER!
+#define ENTROPY_SAMPEN_M            2       // Template length
+#define ENTROPY_SAMPEN_R            0.2f    // Tolerance as a fraction of std
+#define ENTROPY_MAX_SAMPEN_LEN      256     // Longest series passed to sample entropy
+#define ENTROPY_MAX_BUCKETS         64      // Value buckets for template search
+
+// Features: PE(magnitude), SampEn(magnitude), PE(IBI), SampEn(IBI)
+#define N_ENTROPY_FEATURES_BLOCK    4
+
+
+// ============================================================================
+// Permutation Entropy
+// ============================================================================
+
+/**
+ * Incremental permutation entropy with ordinal-pattern counting.
+ */
+class PermutationEntropy {
+public:
+    PermutationEntropy() { reset(); }
+
+    /**
+     * Clear the pattern histogram and sample history.
+     */
+    void reset() {
+        for (int i = 0; i < ENTROPY_PE_PATTERNS; i++) _counts[i] = 0;
+        _total = 0;
+        _filled = 0;
+        _head = 0;
+    }
+
+    /**
+     * Add one sample; counts the pattern ending at this sample.
+     */
+    void addSample(float x) {
+        _window[_head] = x;
+        _head = (_head + 1) % ENTROPY_PE_ORDER;
+        if (_filled < ENTROPY_PE_ORDER) {
+            if (++_filled < ENTROPY_PE_ORDER) return;
+        }
+
+        // Lehmer code of the window (oldest sample first); ties rank by age
+        int index = 0;
+        for (int i = 0; i < ENTROPY_PE_ORDER - 1; i++) {
+            float xi = _window[(_head + i) % ENTROPY_PE_ORDER];
+            int smaller = 0;
+            for (int j = i + 1; j < ENTROPY_PE_ORDER; j++) {
+                if (_window[(_head + j) % ENTROPY_PE_ORDER] < xi) smaller++;
+            }
+            index = index * (ENTROPY_PE_ORDER - i) + smaller;
+        }
+
+        _counts[index]++;
+        _total++;
+    }
+
+    /**
+     * Normalized permutation entropy in [0, 1] (0 if no patterns seen).
+     */
+    float compute() const {
+        if (_total == 0) return 0.0f;
+
+        float h = 0.0f;
+        for (int i = 0; i < ENTROPY_PE_PATTERNS; i++) {
+            if (_counts[i] > 0) {
+                float p = (float)_counts[i] / _total;
+                h -= p * logf(p);
+            }
+        }
+        return h / logf((float)ENTROPY_PE_PATTERNS);
+    }
+
+    int getPatternCount() const {
+        return _total;
+    }
+
+private:
+    float _window[ENTROPY_PE_ORDER];
+    uint16_t _counts[ENTROPY_PE_PATTERNS];
+    int _total;
+    int _filled;
+    int _head;
+};
+
+
+// ============================================================================
+// Sample Entropy
+// ============================================================================
+
+/**
+ * Check whether templates starting at i and j match within r for `len` points.
+ */
+static inline bool templatesMatch(const float* x, int i, int j, int len, float r) {
+    for (int k = 0; k < len; k++) {
+        if (fabsf(x[i + k] - x[j + k]) > r) return false;
+    }
+    return true;
+}
+
+/**
+ * Sample entropy SampEn(m, r) using bucket-restricted template search.
+ *
+ * Counts template pairs exactly as the direct O(n^2) definition does.
+ * If no matches are found the result is capped at ln((N-m)(N-m-1)/2).
+ *
+ * @param x Input series
+ * @param length Number of samples (clamped to ENTROPY_MAX_SAMPEN_LEN)
+ * @param m Template length
+ * @param r Absolute tolerance
+ * @return Sample entropy (0 for degenerate input)
+ */
+float sampleEntropy(const float* x, int length, int m, float r) {
+    if (length > ENTROPY_MAX_SAMPEN_LEN) length = ENTROPY_MAX_SAMPEN_LEN;
+    int nTemplates = length - m;
+    if (nTemplates < 2 || r <= 0.0f) return 0.0f;
+
+    float minVal = x[0];
+    float maxVal = x[0];
+    for (int i = 1; i < length; i++) {
+        if (x[i] < minVal) minVal = x[i];
+        if (x[i] > maxVal) maxVal = x[i];
+    }
+
+    // Bucket width must be >= r so matching first samples land in adjacent buckets
+    float width = r;
+    if ((maxVal - minVal) / width >= ENTROPY_MAX_BUCKETS) {
+        width = (maxVal - minVal) / (ENTROPY_MAX_BUCKETS - 1);
+    }
+
+    // Counting sort of template start indices by bucket
+    uint8_t bucketOf[ENTROPY_MAX_SAMPEN_LEN];
+    uint16_t start[ENTROPY_MAX_BUCKETS + 1];
+    uint16_t order[ENTROPY_MAX_SAMPEN_LEN];
+
+    for (int b = 0; b <= ENTROPY_MAX_BUCKETS; b++) start[b] = 0;
+    for (int i = 0; i < nTemplates; i++) {
+        int b = (int)((x[i] - minVal) / width);
+        if (b >= ENTROPY_MAX_BUCKETS) b = ENTROPY_MAX_BUCKETS - 1;
+        bucketOf[i] = (uint8_t)b;
+        start[b + 1]++;
+    }
+    for (int b = 0; b < ENTROPY_MAX_BUCKETS; b++) start[b + 1] += start[b];
+    {
+        uint16_t fill[ENTROPY_MAX_BUCKETS];
+        for (int b = 0; b < ENTROPY_MAX_BUCKETS; b++) fill[b] = start[b];
+        for (int i = 0; i < nTemplates; i++) order[fill[bucketOf[i]]++] = (uint16_t)i;
+    }
+
+    // B: pairs matching for m points, A: pairs also matching at point m
+    uint32_t countB = 0;
+    uint32_t countA = 0;
+    for (int i = 0; i < nTemplates; i++) {
+        int b = bucketOf[i];
+        int bLo = b > 0 ? b - 1 : 0;
+        int bHi = b < ENTROPY_MAX_BUCKETS - 1 ? b + 1 : ENTROPY_MAX_BUCKETS - 1;
+        for (int k = start[bLo]; k < start[bHi + 1]; k++) {
+            int j = order[k];
+            if (j <= i) continue;
+            if (templatesMatch(x, i, j, m, r)) {
+                countB++;
+                if (fabsf(x[i + m] - x[j + m]) <= r) countA++;
+            }
+        }
+    }
+
+    if (countA == 0 || countB == 0) {
+        return logf((float)nTemplates * (nTemplates - 1) / 2.0f);
+    }
+    return -logf((float)countA / countB);
+}
+
+/**
+ * Sample entropy of a series after boxcar decimation to at most
+ * ENTROPY_MAX_SAMPEN_LEN points, with r = ENTROPY_SAMPEN_R * std.
+ */
+float decimatedSampleEntropy(const float* x, int length) {
+    if (length < ENTROPY_SAMPEN_M + 2) return 0.0f;
+
+    int factor = (length + ENTROPY_MAX_SAMPEN_LEN - 1) / ENTROPY_MAX_SAMPEN_LEN;
+    int n = length / factor;
+
+    float dec[ENTROPY_MAX_SAMPEN_LEN];
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float acc = 0.0f;
+        for (int k = 0; k < factor; k++) acc += x[i * factor + k];
+        dec[i] = acc / factor;
+        sum += dec[i];
+    }
+
+    float mean = sum / n;
+    float sumSq = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float diff = dec[i] - mean;
+        sumSq += diff * diff;
+    }
+    float std = sqrtf(sumSq / n);
+    if (std < 1e-6f) return 0.0f;
+
+    return sampleEntropy(dec, n, ENTROPY_SAMPEN_M, ENTROPY_SAMPEN_R * std);
+}
+
+#endif // ENTROPY_FEATURES_H
@@ -7,6 +7,10 @@
  * 
  * Features must match the Python training pipeline exactly.
  * See: model-training/scripts/train_tflite_model.py
+ * 
+ * The epoch buffers and one extraction scratch buffer (sorted copies,
+ * valid HR / IBI values) come from the heap, or from a shared arena
+ * planned by memory_planner.h after requestMemory().
  */
 
 #ifndef FEATURE_EXTRACTOR_H
@@ -16,7 +20,14 @@
 #include <math.h>
 #include "../sensors/imu_sensor.h"
 #include "../sensors/ppg_sensor.h"
-#include "../config.h"
+#include "../include/config.h"
+#include "int_stats.h"
+#include "resp_estimator.h"
+#include "entropy_features.h"
+#include "lifting_wavelet.h"
+#include "pulse_morphology.h"
+#include "memory_planner.h"
+#include "running_stats.h"
 
 // ============================================================================
 // Configuration
@@ -25,6 +36,10 @@
 // Epoch configuration (must match training)
 #define EPOCH_SAMPLES_IMU    (EPOCH_DURATION_SEC * IMU_SAMPLE_RATE_HZ)   // 30 * 32 = 960
 #define EPOCH_SAMPLES_PPG    (EPOCH_DURATION_SEC * PPG_SAMPLE_RATE_HZ)   // 30 * 100 = 3000
+#define EPOCH_MAX_IBI        256  // Max ~256 beats per 30s
+
+// Extraction scratch: the longest signal, as float or int32
+#define EXTRACT_SCRATCH_VALUES (EPOCH_SAMPLES_PPG > EPOCH_SAMPLES_IMU ? EPOCH_SAMPLES_PPG : EPOCH_SAMPLES_IMU)
 
 // Feature counts
 #define N_STAT_FEATURES     12   // mean, std, min, max, range, median, iqr, skew, kurtosis, energy, rms, zero_crossings
@@ -34,11 +49,43 @@
 #define N_HR_FEATURES       5    // mean, std, min, max, range
 #define N_HRV_FEATURES      5    // mean_ibi, sdnn, rmssd, pnn50, pnn20
 
-// Total feature count
+#if N_RUNNING_STAT_FEATURES != N_STAT_FEATURES
+#error "running_stats.h does not match computeStatFeatures()"
+#endif
+
+// Base feature count (model inputs)
 // IMU: 4 axes * 12 stats + 2 extra = 50
 // PPG: 12 stats + 5 HR + 5 HRV = 22
 // Total: 72 features
-#define N_TOTAL_FEATURES    (N_IMU_AXES * N_STAT_FEATURES + N_IMU_EXTRA + N_PPG_STAT + N_HR_FEATURES + N_HRV_FEATURES)
+#define N_BASE_FEATURES     (N_IMU_AXES * N_STAT_FEATURES + N_IMU_EXTRA + N_PPG_STAT + N_HR_FEATURES + N_HRV_FEATURES)
+
+// Optional feature blocks (see config.h), appended after the base features
+#if ENABLE_RESP_FEATURES
+#define N_RESP_FEATURES     N_RESP_FEATURES_BLOCK
+#else
+#define N_RESP_FEATURES     0
+#endif
+
+#if ENABLE_ENTROPY_FEATURES
+#define N_ENTROPY_FEATURES  N_ENTROPY_FEATURES_BLOCK
+#else
+#define N_ENTROPY_FEATURES  0
+#endif
+
+#if ENABLE_PULSE_FEATURES
+#define N_PULSE_FEATURES    N_PULSE_FEATURES_BLOCK
+#else
+#define N_PULSE_FEATURES    0
+#endif
+
+#if ENABLE_WAVELET_FEATURES
+#define N_WAVELET_FEATURES  N_WAVELET_FEATURES_BLOCK
+#else
+#define N_WAVELET_FEATURES  0
+#endif
+
+#define N_TOTAL_FEATURES    (N_BASE_FEATURES + N_RESP_FEATURES + N_ENTROPY_FEATURES + \
+                             N_PULSE_FEATURES + N_WAVELET_FEATURES)
 
 
 // ============================================================================
@@ -62,6 +109,10 @@ struct EpochFeatures {
     static const int IDX_PPG_START = N_STAT_FEATURES * 4 + N_IMU_EXTRA;
     static const int IDX_HR_START = IDX_PPG_START + N_PPG_STAT;
     static const int IDX_HRV_START = IDX_HR_START + N_HR_FEATURES;
+    static const int IDX_RESP_START = N_BASE_FEATURES;
+    static const int IDX_ENTROPY_START = IDX_RESP_START + N_RESP_FEATURES;
+    static const int IDX_PULSE_START = IDX_ENTROPY_START + N_ENTROPY_FEATURES;
+    static const int IDX_WAVELET_START = IDX_PULSE_START + N_PULSE_FEATURES;
 };
 
 
@@ -75,8 +126,10 @@ struct EpochFeatures {
  * @param data Input signal array
  * @param length Number of samples
  * @param output Output array for 12 features
+ * @param scratch `length` values for the sorted copy (nullptr: heap)
  */
-void computeStatFeatures(const float* data, int length, float* output) {
+void computeStatFeatures(const float* data, int length, float* output,
+                         float* scratch = nullptr) {
     if (length == 0) {
         for (int i = 0; i < N_STAT_FEATURES; i++) output[i] = 0.0f;
         return;
@@ -118,7 +171,7 @@ void computeStatFeatures(const float* data, int length, float* output) {
     // For efficiency, we'll use a simplified approach
     
     // Create sorted copy (partial sort for quartiles)
-    float* sorted = (float*)malloc(length * sizeof(float));
+    float* sorted = scratch ? scratch : (float*)malloc(length * sizeof(float));
     memcpy(sorted, data, length * sizeof(float));
     
     // Simple insertion sort (acceptable for 960-3000 samples per epoch)
@@ -139,7 +192,7 @@ void computeStatFeatures(const float* data, int length, float* output) {
     output[5] = sorted[q2Idx];  // Median
     output[6] = sorted[q3Idx] - sorted[q1Idx];  // IQR
     
-    free(sorted);
+    if (!scratch) free(sorted);
     
     // ---- Higher moments ----
     
@@ -185,24 +238,31 @@ void computeStatFeatures(const float* data, int length, float* output) {
 }
 
 
-/**
- * Compute magnitude from 3-axis accelerometer data.
- */
-void computeMagnitude(const float* x, const float* y, const float* z, 
-                      float* mag, int length) {
-    for (int i = 0; i < length; i++) {
-        mag[i] = sqrtf(x[i]*x[i] + y[i]*y[i] + z[i]*z[i]);
-    }
-}
-
-
 // ============================================================================
 // Feature Extractor Class
 // ============================================================================
 
 class FeatureExtractor {
 public:
-    FeatureExtractor() : _epochReady(false) {}
+    FeatureExtractor() : _planner(nullptr), _epochReady(false), _imuExtracted(false) {}
+    
+    /**
+     * Take the buffers from a shared arena instead of the heap. Call before
+     * planner.plan() and begin(). The epoch buffers live from sampling
+     * through extraction, the scratch during extraction only.
+     */
+    void requestMemory(MemoryPlanner& planner) {
+        _planner = &planner;
+        const uint8_t S = MEMORY_PHASE_SAMPLE, E = MEMORY_PHASE_EXTRACT;
+        _memoryIds[BUFFER_ACC_X] = planner.request("accX", EPOCH_SAMPLES_IMU * sizeof(float), S, E);
+        _memoryIds[BUFFER_ACC_Y] = planner.request("accY", EPOCH_SAMPLES_IMU * sizeof(float), S, E);
+        _memoryIds[BUFFER_ACC_Z] = planner.request("accZ", EPOCH_SAMPLES_IMU * sizeof(float), S, E);
+        _memoryIds[BUFFER_ACC_MAG] = planner.request("accMag", EPOCH_SAMPLES_IMU * sizeof(float), S, E);
+        _memoryIds[BUFFER_PPG] = planner.request("ppg", EPOCH_SAMPLES_PPG * sizeof(int32_t), S, E);
+        _memoryIds[BUFFER_HR] = planner.request("hr", EPOCH_SAMPLES_PPG * sizeof(float), S, E);
+        _memoryIds[BUFFER_IBI] = planner.request("ibi", EPOCH_MAX_IBI * sizeof(float), S, E);
+        _memoryIds[BUFFER_SCRATCH] = planner.request("scratch", EXTRACT_SCRATCH_VALUES * sizeof(float), E, E);
+    }
     
     /**
      * Initialize the feature extractor.
@@ -210,18 +270,40 @@ public:
     bool begin() {
         _imuIndex = 0;
         _ppgIndex = 0;
+        _ibiCount = 0;
         _epochReady = false;
+        _imuExtracted = false;
+        
+        #if ENABLE_PROVISIONAL_STAGES
+        for (int axis = 0; axis < N_IMU_AXES; axis++) _running[axis].reset();
+        _runningActivity = 0.0f;
+        #endif
         
         // Allocate buffers
-        _accX = (float*)malloc(EPOCH_SAMPLES_IMU * sizeof(float));
-        _accY = (float*)malloc(EPOCH_SAMPLES_IMU * sizeof(float));
-        _accZ = (float*)malloc(EPOCH_SAMPLES_IMU * sizeof(float));
-        _accMag = (float*)malloc(EPOCH_SAMPLES_IMU * sizeof(float));
-        _ppgBuffer = (float*)malloc(EPOCH_SAMPLES_PPG * sizeof(float));
-        _hrBuffer = (float*)malloc(EPOCH_SAMPLES_PPG * sizeof(float));
-        _ibiBuffer = (float*)malloc(256 * sizeof(float));  // Max ~256 beats per 30s
-        
-        if (!_accX || !_accY || !_accZ || !_accMag || !_ppgBuffer || !_hrBuffer || !_ibiBuffer) {
+        _accX = (float*)allocate(BUFFER_ACC_X, EPOCH_SAMPLES_IMU * sizeof(float));
+        _accY = (float*)allocate(BUFFER_ACC_Y, EPOCH_SAMPLES_IMU * sizeof(float));
+        _accZ = (float*)allocate(BUFFER_ACC_Z, EPOCH_SAMPLES_IMU * sizeof(float));
+        _accMag = (float*)allocate(BUFFER_ACC_MAG, EPOCH_SAMPLES_IMU * sizeof(float));
+        _ppgBuffer = (int32_t*)allocate(BUFFER_PPG, EPOCH_SAMPLES_PPG * sizeof(int32_t));
+        _hrBuffer = (float*)allocate(BUFFER_HR, EPOCH_SAMPLES_PPG * sizeof(float));
+        _ibiBuffer = (float*)allocate(BUFFER_IBI, EPOCH_MAX_IBI * sizeof(float));
+        _scratch = allocate(BUFFER_SCRATCH, EXTRACT_SCRATCH_VALUES * sizeof(float));
+        
+        #if ENABLE_RESP_FEATURES
+        _resp.reset();
+        #endif
+        
+        #if ENABLE_ENTROPY_FEATURES
+        _peMag.reset();
+        _peIBI.reset();
+        #endif
+        
+        #if ENABLE_PULSE_FEATURES
+        _pulse.reset();
+        #endif
+        
+        if (!_accX || !_accY || !_accZ || !_accMag || !_ppgBuffer || !_hrBuffer ||
+            !_ibiBuffer || !_scratch) {
             Serial.println("[FEAT] Memory allocation failed!");
             return false;
         }
@@ -238,10 +320,29 @@ public:
      */
     void addIMUSample(const IMUData& data) {
         if (_imuIndex < EPOCH_SAMPLES_IMU) {
+            float mag = sqrtf(data.accelX * data.accelX +
+                              data.accelY * data.accelY +
+                              data.accelZ * data.accelZ);
             _accX[_imuIndex] = data.accelX;
             _accY[_imuIndex] = data.accelY;
             _accZ[_imuIndex] = data.accelZ;
+            _accMag[_imuIndex] = mag;
+
+            #if ENABLE_PROVISIONAL_STAGES
+            _running[0].add(data.accelX);
+            _running[1].add(data.accelY);
+            _running[2].add(data.accelZ);
+            _running[3].add(mag);
+            if (_imuIndex > 0) {
+                _runningActivity += fabsf(mag - _accMag[_imuIndex - 1]);
+            }
+            #endif
+
             _imuIndex++;
+
+            #if ENABLE_ENTROPY_FEATURES
+            _peMag.addSample(mag);
+            #endif
         }
     }
     
@@ -250,10 +351,18 @@ public:
      */
     void addPPGSample(const PPGData& data, float heartRate) {
         if (_ppgIndex < EPOCH_SAMPLES_PPG) {
-            // Use IR signal as BVP proxy
-            _ppgBuffer[_ppgIndex] = (float)data.ir;
+            // Use IR signal as BVP proxy (raw counts, for exact integer stats)
+            _ppgBuffer[_ppgIndex] = (int32_t)data.ir;
             _hrBuffer[_ppgIndex] = heartRate;
             _ppgIndex++;
+            
+            #if ENABLE_RESP_FEATURES
+            _resp.addSample(data.ir);
+            #endif
+            
+            #if ENABLE_PULSE_FEATURES
+            _pulse.addSample(data.ir);
+            #endif
         }
     }
     
@@ -261,8 +370,14 @@ public:
      * Add detected IBI (inter-beat interval) for HRV computation.
      */
     void addIBI(float ibiMs) {
-        if (_ibiCount < 256) {
+        if (_ibiCount < EPOCH_MAX_IBI) {
             _ibiBuffer[_ibiCount++] = ibiMs;
+            
+            #if ENABLE_ENTROPY_FEATURES
+            if (ibiMs > 300.0f && ibiMs < 2000.0f) {
+                _peIBI.addSample(ibiMs);
+            }
+            #endif
         }
     }
     
@@ -273,6 +388,39 @@ public:
         return (_imuIndex >= EPOCH_SAMPLES_IMU && _ppgIndex >= EPOCH_SAMPLES_PPG);
     }
     
+    #if ENABLE_PROVISIONAL_STAGES
+    /**
+     * IMU block of the open epoch from the running statistics, for a
+     * provisional stage before the epoch is complete (running_stats.h lists
+     * which features are estimates). Costs the same whatever the fill;
+     * nothing is rescanned and the epoch stays open.
+     * 
+     * @param features Output: the features before IDX_PPG_START; `valid`
+     *                 stays false, as these are not classify() input
+     * @return false with less than PROVISIONAL_MIN_SEC of IMU samples
+     */
+    bool extractProvisionalFeatures(EpochFeatures& features) const {
+        features.valid = false;
+        if (_imuIndex < PROVISIONAL_MIN_SEC * IMU_SAMPLE_RATE_HZ) {
+            return false;
+        }
+        
+        int idx = 0;
+        for (int axis = 0; axis < N_IMU_AXES; axis++) {
+            _running[axis].snapshot(&features.features[idx], EPOCH_SAMPLES_IMU);
+            idx += N_STAT_FEATURES;
+        }
+        
+        // Activity count scaled to a full epoch; movement intensity is the
+        // magnitude std
+        features.features[idx++] = _runningActivity * (EPOCH_SAMPLES_IMU - 1) / (_imuIndex - 1);
+        features.features[idx++] = features.features[EpochFeatures::IDX_IMU_MAG_START + 1];
+        
+        features.timestamp = millis();
+        return true;
+    }
+    #endif
+    
     /**
      * Extract all features from current epoch buffers.
      * 
@@ -280,8 +428,19 @@ public:
      * @return true if extraction successful
      */
     bool extractFeatures(EpochFeatures& features) {
+        return extractIMUFeatures(features) && extractPPGFeatures(features);
+    }
+    
+    /**
+     * First half of extractFeatures(): the IMU block only (features before
+     * IDX_PPG_START). The epoch stays open until extractPPGFeatures() or
+     * skipPPGFeatures(); `features.valid` is set by extractPPGFeatures().
+     * 
+     * @return true if the epoch is ready
+     */
+    bool extractIMUFeatures(EpochFeatures& features) {
+        features.valid = false;
         if (!isEpochReady()) {
-            features.valid = false;
             return false;
         }
         
@@ -289,33 +448,52 @@ public:
         
         // ====== IMU Features ======
         
-        // Compute magnitude
-        computeMagnitude(_accX, _accY, _accZ, _accMag, EPOCH_SAMPLES_IMU);
+        // (magnitude is filled per sample by addIMUSample())
         
         // X-axis statistics
-        computeStatFeatures(_accX, EPOCH_SAMPLES_IMU, &features.features[idx]);
+        computeStatFeatures(_accX, EPOCH_SAMPLES_IMU, &features.features[idx], (float*)_scratch);
         idx += N_STAT_FEATURES;
         
         // Y-axis statistics
-        computeStatFeatures(_accY, EPOCH_SAMPLES_IMU, &features.features[idx]);
+        computeStatFeatures(_accY, EPOCH_SAMPLES_IMU, &features.features[idx], (float*)_scratch);
         idx += N_STAT_FEATURES;
         
         // Z-axis statistics
-        computeStatFeatures(_accZ, EPOCH_SAMPLES_IMU, &features.features[idx]);
+        computeStatFeatures(_accZ, EPOCH_SAMPLES_IMU, &features.features[idx], (float*)_scratch);
         idx += N_STAT_FEATURES;
         
         // Magnitude statistics
-        computeStatFeatures(_accMag, EPOCH_SAMPLES_IMU, &features.features[idx]);
+        computeStatFeatures(_accMag, EPOCH_SAMPLES_IMU, &features.features[idx], (float*)_scratch);
         idx += N_STAT_FEATURES;
         
         // IMU extra features
         features.features[idx++] = computeActivityCount();
         features.features[idx++] = computeMovementIntensity();
         
+        features.timestamp = millis();
+        _imuExtracted = true;
+        return true;
+    }
+    
+    /**
+     * Second half of extractFeatures(): PPG and optional blocks, then
+     * starts the next epoch.
+     * 
+     * @return false unless extractIMUFeatures() ran for this epoch
+     */
+    bool extractPPGFeatures(EpochFeatures& features) {
+        if (!_imuExtracted) {
+            features.valid = false;
+            return false;
+        }
+        
+        int idx = EpochFeatures::IDX_PPG_START;
+        
         // ====== PPG Features ======
         
-        // PPG signal statistics
-        computeStatFeatures(_ppgBuffer, EPOCH_SAMPLES_PPG, &features.features[idx]);
+        // PPG signal statistics (int64 accumulation, see int_stats.h)
+        computeStatFeatures(_ppgBuffer, EPOCH_SAMPLES_PPG, &features.features[idx],
+                            (int32_t*)_scratch);
         idx += N_STAT_FEATURES;
         
         // HR features
@@ -326,9 +504,34 @@ public:
         computeHRVFeatures(&features.features[idx]);
         idx += N_HRV_FEATURES;
         
-        // Mark as valid and add timestamp
+        // ====== Optional Feature Blocks ======
+        
+        #if ENABLE_RESP_FEATURES
+        _resp.finishEpoch(&features.features[idx]);
+        idx += N_RESP_FEATURES;
+        #endif
+        
+        #if ENABLE_ENTROPY_FEATURES
+        computeEntropyFeatures(&features.features[idx]);
+        idx += N_ENTROPY_FEATURES;
+        #endif
+        
+        #if ENABLE_PULSE_FEATURES
+        _pulse.finishEpoch(&features.features[idx]);
+        idx += N_PULSE_FEATURES;
+        #endif
+        
+        // The wavelet transform runs in place, so it must be the last
+        // consumer of the PPG and magnitude buffers in this epoch
+        #if ENABLE_WAVELET_FEATURES
+        computeWaveletFeatures(_ppgBuffer, EPOCH_SAMPLES_PPG, &features.features[idx]);
+        idx += N_WAVELET_CHANNEL_FEATURES;
+        computeWaveletFeatures(_accMag, EPOCH_SAMPLES_IMU, &features.features[idx]);
+        idx += N_WAVELET_CHANNEL_FEATURES;
+        #endif
+        
+        // Mark as valid
         features.valid = true;
-        features.timestamp = millis();
         
         // Reset buffers for next epoch
         resetBuffers();
@@ -336,15 +539,64 @@ public:
         return true;
     }
     
+    /**
+     * Close an epoch decided from the IMU block alone: no PPG, HR, HRV or
+     * optional-block features are computed. The streaming blocks only
+     * restart their per-epoch accumulators, so their filters stay settled.
+     */
+    void skipPPGFeatures() {
+        #if ENABLE_RESP_FEATURES
+        _resp.discardEpoch();
+        #endif
+        
+        #if ENABLE_ENTROPY_FEATURES
+        _peMag.reset();
+        _peIBI.reset();
+        #endif
+        
+        #if ENABLE_PULSE_FEATURES
+        _pulse.discardEpoch();
+        #endif
+        
+        resetBuffers();
+    }
+
+    #if ENABLE_ACTIGRAPHY_FALLBACK
+    /**
+     * Activity counts of the open epoch for actigraphy scoring: IMU
+     * magnitude changes above ACTIGRAPHY_DEADBAND_G, summed and scaled by
+     * ACTIGRAPHY_COUNTS_PER_G. Call after extractIMUFeatures().
+     */
+    float computeActigraphyCounts() const {
+        float sum = 0.0f;
+        for (int i = 1; i < _imuIndex; i++) {
+            float change = fabsf(_accMag[i] - _accMag[i-1]) - ACTIGRAPHY_DEADBAND_G;
+            if (change > 0.0f) sum += change;
+        }
+        return sum * ACTIGRAPHY_COUNTS_PER_G;
+    }
+    #endif
+
     /**
      * Reset buffers for next epoch.
      */
     void resetBuffers() {
+        _imuExtracted = false;
         _imuIndex = 0;
         _ppgIndex = 0;
         _ibiCount = 0;
+        
+        #if ENABLE_PROVISIONAL_STAGES
+        for (int axis = 0; axis < N_IMU_AXES; axis++) _running[axis].reset();
+        _runningActivity = 0.0f;
+        #endif
     }
     
+    /**
+     * IMU samples in the open epoch.
+     */
+    int getIMUSampleCount() const { return _imuIndex; }
+    
     /**
      * Get current buffer fill percentage.
      */
@@ -360,9 +612,16 @@ private:
     float* _accY;
     float* _accZ;
     float* _accMag;
-    float* _ppgBuffer;
+    int32_t* _ppgBuffer;
     float* _hrBuffer;
     float* _ibiBuffer;
+    void* _scratch;                 // Extraction only, reused step by step
+    
+    enum { BUFFER_ACC_X, BUFFER_ACC_Y, BUFFER_ACC_Z, BUFFER_ACC_MAG,
+           BUFFER_PPG, BUFFER_HR, BUFFER_IBI, BUFFER_SCRATCH, N_BUFFERS };
+    
+    MemoryPlanner* _planner;        // Shared arena, or nullptr for the heap
+    int _memoryIds[N_BUFFERS];
     
     // Buffer indices
     int _imuIndex;
@@ -370,6 +629,58 @@ private:
     int _ibiCount;
     
     bool _epochReady;
+    bool _imuExtracted;
+    
+    #if ENABLE_RESP_FEATURES
+    RespiratoryEstimator _resp;
+    #endif
+    
+    #if ENABLE_PROVISIONAL_STAGES
+    RunningStats _running[N_IMU_AXES];  // X, Y, Z, magnitude
+    float _runningActivity;             // Sum of |magnitude change|
+    #endif
+    
+    void* allocate(int index, size_t bytes) {
+        return _planner ? _planner->get(_memoryIds[index]) : malloc(bytes);
+    }
+    
+    /**
+     * Copy the epoch's valid IBIs (300-2000 ms) to `validIBI`.
+     */
+    int collectValidIBI(float* validIBI) const {
+        int validCount = 0;
+        for (int i = 0; i < _ibiCount; i++) {
+            if (_ibiBuffer[i] > 300.0f && _ibiBuffer[i] < 2000.0f) {
+                validIBI[validCount++] = _ibiBuffer[i];
+            }
+        }
+        return validCount;
+    }
+    
+    #if ENABLE_PULSE_FEATURES
+    PulseMorphology _pulse;
+    #endif
+    
+    #if ENABLE_ENTROPY_FEATURES
+    PermutationEntropy _peMag;
+    PermutationEntropy _peIBI;
+    
+    /**
+     * Compute entropy features (PE is already accumulated per sample).
+     */
+    void computeEntropyFeatures(float* output) {
+        output[0] = _peMag.compute();
+        output[1] = decimatedSampleEntropy(_accMag, _imuIndex);
+        
+        float* validIBI = (float*)_scratch;
+        int validCount = collectValidIBI(validIBI);
+        output[2] = _peIBI.compute();
+        output[3] = decimatedSampleEntropy(validIBI, validCount);
+        
+        _peMag.reset();
+        _peIBI.reset();
+    }
+    #endif
     
     /**
      * Compute activity count (sum of absolute differences in magnitude).
@@ -405,7 +716,7 @@ private:
      */
     void computeHRFeatures(float* output) {
         // Filter out invalid HR values
-        float validHR[EPOCH_SAMPLES_PPG];
+        float* validHR = (float*)_scratch;
         int validCount = 0;
         
         for (int i = 0; i < _ppgIndex; i++) {
@@ -449,14 +760,8 @@ private:
      */
     void computeHRVFeatures(float* output) {
         // Filter outliers (physiologically impossible values)
-        float validIBI[256];
-        int validCount = 0;
-        
-        for (int i = 0; i < _ibiCount; i++) {
-            if (_ibiBuffer[i] > 300.0f && _ibiBuffer[i] < 2000.0f) {
-                validIBI[validCount++] = _ibiBuffer[i];
-            }
-        }
+        float* validIBI = (float*)_scratch;
+        int validCount = collectValidIBI(validIBI);
         
         if (validCount < 2) {
             for (int i = 0; i < N_HRV_FEATURES; i++) output[i] = 0.0f;
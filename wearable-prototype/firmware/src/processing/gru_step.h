@@ -0,0 +1,192 @@
+/**
+ * Incremental GRU Sequence Model
+ * ==============================
+ *
+ * One step of a single-layer GRU followed by a dense softmax head, run
+ * once per epoch. The hidden state carries the night so far, so each
+ * epoch costs one step rather than a re-run over a history window:
+ *
+ *   z  = sigmoid(x Wz + bz + h Uz + cz)
+ *   r  = sigmoid(x Wr + br + h Ur + cr)
+ *   h~ = tanh(x Wh + bh + r * (h Uh + ch))
+ *   h' = z * h + (1 - z) * h~
+ *   p  = softmax(h' Wo + bo)
+ *
+ * This is Keras GRU(reset_after=True), the TF2 default, with the Keras
+ * weight layout: kernel [inputs][3 * units] and recurrent kernel
+ * [units][3 * units], gates in z, r, h order, separate input and
+ * recurrent biases. The feature scaler is folded into the kernel and
+ * input bias by model-training/scripts/export_sequence_model.py, so raw
+ * features go straight in.
+ *
+ * The state lives in a fixed buffer; getState()/setState() let the
+ * caller persist it (recurrent_state.h). Float arithmetic: about
+ * 3 * units * (inputs + units) multiply-adds per step.
+ */
+
+#ifndef GRU_STEP_H
+#define GRU_STEP_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "inference_profiler.h"
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define GRU_MAX_UNITS       64
+#define GRU_MAX_CLASSES     8
+
+
+// ============================================================================
+// GRU Step Class
+// ============================================================================
+
+class GRUStep {
+public:
+    GRUStep() : _kernel(nullptr), _recurrentKernel(nullptr), _inputBias(nullptr),
+                _recurrentBias(nullptr), _denseKernel(nullptr), _denseBias(nullptr),
+                _inputs(0), _units(0), _classes(0) {
+        reset();
+    }
+
+    /**
+     * @param kernel [inputs][3 * units]
+     * @param recurrentKernel [units][3 * units]
+     * @param inputBias, recurrentBias [3 * units]
+     * @param denseKernel [units][classes]
+     * @param denseBias [classes]
+     * @return false if a size is out of range
+     */
+    bool begin(const float* kernel, const float* recurrentKernel,
+               const float* inputBias, const float* recurrentBias,
+               const float* denseKernel, const float* denseBias,
+               int inputs, int units, int classes) {
+        _units = 0;
+        if (inputs <= 0 || units <= 0 || units > GRU_MAX_UNITS ||
+            classes <= 1 || classes > GRU_MAX_CLASSES) {
+            return false;
+        }
+        _kernel = kernel;
+        _recurrentKernel = recurrentKernel;
+        _inputBias = inputBias;
+        _recurrentBias = recurrentBias;
+        _denseKernel = denseKernel;
+        _denseBias = denseBias;
+        _inputs = inputs;
+        _units = units;
+        _classes = classes;
+        reset();
+        return true;
+    }
+
+    /**
+     * Zero the hidden state (start of a night).
+     */
+    void reset() {
+        memset(_state, 0, sizeof(_state));
+    }
+
+    /**
+     * Advance one epoch.
+     *
+     * @param features Raw features, `inputs` values; a non-finite one
+     *                 counts as 0, so one bad epoch cannot poison the state
+     * @param probabilities Softmax output, `classes` values
+     * @param profiler Records GRU and DENSE events (optional)
+     * @return Most likely class
+     */
+    int step(const float* features, float* probabilities,
+             InferenceProfiler* profiler = nullptr) {
+        const int u = _units;
+        const int gates = 3 * u;
+        uint32_t event = profiler ? profiler->beginEvent("GRU") : 0;
+
+        // x W + b and h U + c for all three gates, row by row so both
+        // kernels are read sequentially
+        float xw[3 * GRU_MAX_UNITS];
+        float hu[3 * GRU_MAX_UNITS];
+        memcpy(xw, _inputBias, gates * sizeof(float));
+        memcpy(hu, _recurrentBias, gates * sizeof(float));
+        for (int i = 0; i < _inputs; i++) {
+            const float x = isfinite(features[i]) ? features[i] : 0.0f;
+            const float* row = _kernel + i * gates;
+            for (int j = 0; j < gates; j++) xw[j] += x * row[j];
+        }
+        for (int i = 0; i < u; i++) {
+            const float h = _state[i];
+            const float* row = _recurrentKernel + i * gates;
+            for (int j = 0; j < gates; j++) hu[j] += h * row[j];
+        }
+
+        for (int j = 0; j < u; j++) {
+            float z = sigmoid(xw[j] + hu[j]);
+            float r = sigmoid(xw[u + j] + hu[u + j]);
+            float candidate = tanhf(xw[2 * u + j] + r * hu[2 * u + j]);
+            _state[j] = z * _state[j] + (1.0f - z) * candidate;
+        }
+
+        if (profiler) {
+            profiler->endEvent(event);
+            event = profiler->beginEvent("DENSE");
+        }
+
+        // Dense head + softmax
+        float logits[GRU_MAX_CLASSES];
+        int best = 0;
+        for (int c = 0; c < _classes; c++) logits[c] = _denseBias[c];
+        for (int i = 0; i < u; i++) {
+            const float h = _state[i];
+            const float* row = _denseKernel + i * _classes;
+            for (int c = 0; c < _classes; c++) logits[c] += h * row[c];
+        }
+        for (int c = 1; c < _classes; c++) {
+            if (logits[c] > logits[best]) best = c;
+        }
+        float sum = 0.0f;
+        for (int c = 0; c < _classes; c++) {
+            probabilities[c] = expf(logits[c] - logits[best]);
+            sum += probabilities[c];
+        }
+        for (int c = 0; c < _classes; c++) probabilities[c] /= sum;
+
+        if (profiler) profiler->endEvent(event);
+        return best;
+    }
+
+    const float* getState() const { return _state; }
+
+    void setState(const float* state) {
+        memcpy(_state, state, _units * sizeof(float));
+    }
+
+    int getUnits() const { return _units; }
+    int getInputs() const { return _inputs; }
+
+    /** Weight bytes read per step. */
+    size_t getWeightBytes() const {
+        return (size_t)(3 * _units * (_inputs + _units + 2) + _classes * (_units + 1)) *
+               sizeof(float);
+    }
+
+private:
+    const float* _kernel;
+    const float* _recurrentKernel;
+    const float* _inputBias;
+    const float* _recurrentBias;
+    const float* _denseKernel;
+    const float* _denseBias;
+    int _inputs;
+    int _units;
+    int _classes;
+
+    float _state[GRU_MAX_UNITS];
+
+    static float sigmoid(float x) {
+        return 1.0f / (1.0f + expf(-x));
+    }
+};
+
+#endif // GRU_STEP_H
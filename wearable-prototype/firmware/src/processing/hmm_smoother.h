@@ -0,0 +1,230 @@
+/**
+ * Online HMM Smoothing of Sleep Stages
+ * ====================================
+ *
+ * Treats the sleep stage as a hidden Markov chain with the trained
+ * transition matrix (transition_params.h) and the classifier output as
+ * its per-epoch evidence, so isolated implausible epochs (Deep -> Wake ->
+ * Deep) are outweighed by the stages around them.
+ *
+ * Emission: the MLP gives P(stage | x); dividing by the training class
+ * prior gives a term proportional to P(x | stage) (hybrid HMM).
+ *
+ * Two outputs per epoch, both O(K^2) per update and constant memory:
+ *
+ *   Forward filter    P(stage_t | x_1..x_t), available immediately
+ *   Fixed-lag Viterbi stage of epoch t - lag on the most likely path
+ *                     through epoch t, i.e. decided with `lag` epochs of
+ *                     hindsight; keeps a ring of lag x K back-pointers
+ */
+
+#ifndef HMM_SMOOTHER_H
+#define HMM_SMOOTHER_H
+
+#include <stdint.h>
+#include <math.h>
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define HMM_MAX_STATES      8
+#define HMM_MAX_LAG         32
+#define HMM_MIN_EMISSION    1e-6f   // Floor so one confident epoch cannot veto a stage
+
+
+// ============================================================================
+// HMM Smoother Class
+// ============================================================================
+
+class HMMSmoother {
+public:
+    HMMSmoother() : _states(0), _lag(0) {
+        reset();
+    }
+
+    /**
+     * @param transition Row-major states x states, rows sum to 1
+     * @param initial Stage distribution of the first epoch
+     * @param prior Training class frequencies (emission = posterior / prior)
+     * @param states Number of stages (<= HMM_MAX_STATES)
+     * @param lag Fixed-lag Viterbi delay in epochs (0 disables it)
+     * @return false if a size is out of range
+     */
+    bool begin(const float* transition, const float* initial, const float* prior,
+               int states, int lag) {
+        _states = 0;
+        if (states <= 0 || states > HMM_MAX_STATES || lag < 0 || lag > HMM_MAX_LAG) {
+            return false;
+        }
+
+        for (int i = 0; i < states; i++) {
+            for (int j = 0; j < states; j++) {
+                float p = transition[i * states + j];
+                _transition[i][j] = p;
+                _logTransition[i][j] = logf(p > 0.0f ? p : 1e-30f);
+            }
+            _initial[i] = initial[i];
+            _invPrior[i] = prior[i] > 0.0f ? 1.0f / prior[i] : 1.0f;
+        }
+        _states = states;
+        _lag = lag;
+        reset();
+        return true;
+    }
+
+    /**
+     * Forget the history (e.g. at the start of a night).
+     */
+    void reset() {
+        _epochs = 0;
+        _head = 0;
+        _lagged = -1;
+    }
+
+    /**
+     * Add one epoch of classifier posteriors.
+     *
+     * @param probabilities Classifier output, `states` values
+     * @param filtered Forward posterior for this epoch (may be nullptr)
+     * @return Most likely stage now (argmax of the forward posterior)
+     */
+    int update(const float* probabilities, float* filtered) {
+        float emission[HMM_MAX_STATES];
+        int best = forward(probabilities, emission, _alpha);
+        if (filtered) {
+            for (int s = 0; s < _states; s++) filtered[s] = _alpha[s];
+        }
+
+        // ---- Fixed-lag Viterbi ----
+        if (_lag > 0) {
+            updateViterbi(emission);
+        }
+
+        _epochs++;
+        return best;
+    }
+
+    /**
+     * Forward posterior update() would give for these posteriors, without
+     * adding the epoch (e.g. for a provisional, partial-epoch estimate).
+     *
+     * @param filtered Output, `states` values
+     * @return Argmax of `filtered`
+     */
+    int preview(const float* probabilities, float* filtered) const {
+        float emission[HMM_MAX_STATES];
+        return forward(probabilities, emission, filtered);
+    }
+
+    /**
+     * Viterbi stage of the epoch `lag` updates back, or -1 until that many
+     * epochs have been seen (or with lag 0).
+     */
+    int getLaggedStage() const { return _lagged; }
+
+    int getLag() const { return _lag; }
+    uint32_t getEpochCount() const { return _epochs; }
+
+private:
+    int _states;
+    int _lag;
+    float _transition[HMM_MAX_STATES][HMM_MAX_STATES];
+    float _logTransition[HMM_MAX_STATES][HMM_MAX_STATES];
+    float _initial[HMM_MAX_STATES];
+    float _invPrior[HMM_MAX_STATES];
+
+    float _alpha[HMM_MAX_STATES];           // Forward posterior
+    float _delta[HMM_MAX_STATES];           // Viterbi log score, max at 0
+    uint8_t _backpointer[HMM_MAX_LAG][HMM_MAX_STATES];  // Ring, one row per epoch
+    int _head;                              // Next ring row
+    uint32_t _epochs;
+    int _lagged;
+
+    /**
+     * One forward filter step from the current posterior.
+     *
+     * @param emission Output, the epoch's emission terms
+     * @param alpha Output, the new forward posterior (may be _alpha)
+     * @return Argmax of `alpha`
+     */
+    int forward(const float* probabilities, float* emission, float* alpha) const {
+        const int k = _states;
+        for (int s = 0; s < k; s++) {
+            float p = probabilities[s] > HMM_MIN_EMISSION ? probabilities[s] : HMM_MIN_EMISSION;
+            emission[s] = p * _invPrior[s];
+        }
+
+        float next[HMM_MAX_STATES];
+        float sum = 0.0f;
+        for (int s = 0; s < k; s++) {
+            float predicted = 0.0f;
+            if (_epochs == 0) {
+                predicted = _initial[s];
+            } else {
+                for (int i = 0; i < k; i++) predicted += _alpha[i] * _transition[i][s];
+            }
+            next[s] = predicted * emission[s];
+            sum += next[s];
+        }
+        int best = 0;
+        for (int s = 0; s < k; s++) {
+            alpha[s] = sum > 0.0f ? next[s] / sum : 1.0f / k;
+            if (alpha[s] > alpha[best]) best = s;
+        }
+        return best;
+    }
+
+    void updateViterbi(const float* emission) {
+        const int k = _states;
+        float delta[HMM_MAX_STATES];
+        float top = -INFINITY;
+
+        for (int s = 0; s < k; s++) {
+            float score;
+            if (_epochs == 0) {
+                score = logf(_initial[s] > 0.0f ? _initial[s] : 1e-30f);
+            } else {
+                int from = 0;
+                score = _delta[0] + _logTransition[0][s];
+                for (int i = 1; i < k; i++) {
+                    float candidate = _delta[i] + _logTransition[i][s];
+                    if (candidate > score) {
+                        score = candidate;
+                        from = i;
+                    }
+                }
+                _backpointer[_head][s] = (uint8_t)from;
+            }
+            delta[s] = score + logf(emission[s]);
+            if (delta[s] > top) top = delta[s];
+        }
+
+        // Keep the scores bounded: only differences matter
+        int state = 0;
+        for (int s = 0; s < k; s++) {
+            _delta[s] = delta[s] - top;
+            if (_delta[s] > _delta[state]) state = s;
+        }
+
+        if (_epochs == 0) {
+            _lagged = -1;
+            return;
+        }
+        _head = _head + 1 == _lag ? 0 : _head + 1;
+
+        // Trace the best path back `lag` epochs through the ring
+        if (_epochs < (uint32_t)_lag) {
+            _lagged = -1;
+            return;
+        }
+        int row = _head;
+        for (int step = 0; step < _lag; step++) {
+            row = row == 0 ? _lag - 1 : row - 1;
+            state = _backpointer[row][state];
+        }
+        _lagged = state;
+    }
+};
+
+#endif // HMM_SMOOTHER_H
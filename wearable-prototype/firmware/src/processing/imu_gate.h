@@ -0,0 +1,103 @@
+/**
+ * IMU-Only Gate Classifier
+ * ========================
+ *
+ * First stage of the classification cascade: a linear softmax over the
+ * IMU block of EpochFeatures (the 50 features before IDX_PPG_START).
+ * When its top probability reaches the threshold the epoch is decided
+ * here, and the PPG features and the full model are skipped. Most of a
+ * night is either still sleep or clearly active wake, so most epochs
+ * take this path.
+ *
+ * Weights come from gate_params.h (model-training/scripts/export_gate.py),
+ * with the feature scaler folded in so raw features go straight in.
+ * About 200 multiply-adds and 4 expf per epoch.
+ */
+
+#ifndef IMU_GATE_H
+#define IMU_GATE_H
+
+#include <stdint.h>
+#include <math.h>
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define IMU_GATE_MAX_CLASSES    8
+
+
+// ============================================================================
+// IMU Gate Class
+// ============================================================================
+
+class IMUGate {
+public:
+    IMUGate() : _weights(nullptr), _bias(nullptr), _features(0), _classes(0),
+                _threshold(2.0f) {}
+
+    /**
+     * @param weights Row-major classes x features (scaler folded in)
+     * @param bias One per class
+     * @param threshold Minimum top probability to decide an epoch (> 1
+     *                  disables the gate)
+     */
+    bool begin(const float* weights, const float* bias, int features, int classes,
+               float threshold) {
+        _classes = 0;
+        if (features <= 0 || classes <= 1 || classes > IMU_GATE_MAX_CLASSES) {
+            return false;
+        }
+        _weights = weights;
+        _bias = bias;
+        _features = features;
+        _classes = classes;
+        _threshold = threshold;
+        return true;
+    }
+
+    /**
+     * Classify one epoch from its IMU features.
+     *
+     * @param features Raw IMU features (EpochFeatures::features)
+     * @param probabilities Softmax output, one per class
+     * @return Decided class, or -1 if not confident enough
+     */
+    int classify(const float* features, float* probabilities) const {
+        if (_classes == 0) return -1;
+
+        float logits[IMU_GATE_MAX_CLASSES];
+        float top = -INFINITY;
+        int best = 0;
+        for (int c = 0; c < _classes; c++) {
+            const float* w = _weights + c * _features;
+            float acc = _bias[c];
+            for (int i = 0; i < _features; i++) acc += w[i] * features[i];
+            logits[c] = acc;
+            if (acc > top) {
+                top = acc;
+                best = c;
+            }
+        }
+
+        float sum = 0.0f;
+        for (int c = 0; c < _classes; c++) {
+            probabilities[c] = expf(logits[c] - top);
+            sum += probabilities[c];
+        }
+        for (int c = 0; c < _classes; c++) probabilities[c] /= sum;
+
+        return probabilities[best] >= _threshold ? best : -1;
+    }
+
+    float getThreshold() const { return _threshold; }
+
+private:
+    const float* _weights;
+    const float* _bias;
+    int _features;
+    int _classes;
+    float _threshold;
+};
+
+#endif // IMU_GATE_H
@@ -0,0 +1,307 @@
+/**
+ * Inference Profiler
+ * ==================
+ *
+ * Cycle counts per operator / layer of each classify(), aggregated over
+ * a night: min, mean, p99 and max per event, plus the arena high-water
+ * mark. The same interface as TFLM's MicroProfilerInterface
+ * (beginEvent(tag) -> handle, endEvent(handle)), so the TFLM interpreter
+ * and the native engines report the same way.
+ *
+ * Events are matched by their position within an invocation, so the three
+ * FULLY_CONNECTED layers of the MLP get three slots. Slot 0 is the whole
+ * invocation. A slot whose tag changes (a new model) starts over; events
+ * past PROFILER_MAX_EVENTS are counted as dropped.
+ *
+ * p99 comes from a log histogram (4 buckets per octave), so it is the
+ * upper edge of its bucket, within 19% and clamped to the observed max.
+ *
+ * Binary record (serialize(), little-endian, at most PROFILER_RECORD_MAX
+ * bytes so it fits one BLE attribute):
+ *
+ *   [0]      version (PROFILER_RECORD_VERSION)
+ *   [1]      event count n, including slot 0
+ *   [2..3]   cycles per microsecond (CPU MHz; 1000 on the host: ns)
+ *   [4..7]   invocations
+ *   [8..11]  arena high-water mark (bytes)
+ *   [12..15] dropped events
+ *   n x 28:  tag (12 bytes, NUL padded), min, mean, p99, max (u32 cycles)
+ *
+ * Cycles come from the CPU cycle counter on the device and from a
+ * nanosecond clock on the host.
+ */
+
+#ifndef INFERENCE_PROFILER_H
+#define INFERENCE_PROFILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define PROFILER_MAX_EVENTS     16      // Including slot 0 (whole invocation)
+#define PROFILER_TAG_LEN        12
+#define PROFILER_BUCKETS        96      // 4 per octave from 16 cycles
+#define PROFILER_RECORD_VERSION 1
+#define PROFILER_HEADER_SIZE    16
+#define PROFILER_EVENT_SIZE     (PROFILER_TAG_LEN + 16)
+#define PROFILER_RECORD_MAX     (PROFILER_HEADER_SIZE + PROFILER_MAX_EVENTS * PROFILER_EVENT_SIZE)
+
+
+// ============================================================================
+// Event Statistics
+// ============================================================================
+
+struct ProfilerEventStats {
+    char tag[PROFILER_TAG_LEN];
+    uint32_t count;
+    uint32_t minCycles;
+    uint32_t maxCycles;
+    uint32_t lastCycles;
+    uint64_t totalCycles;
+    uint16_t histogram[PROFILER_BUCKETS];
+};
+
+
+// ============================================================================
+// Inference Profiler Class
+// ============================================================================
+
+class InferenceProfiler {
+public:
+    InferenceProfiler() { reset(); }
+
+    /**
+     * Forget all statistics (e.g. at the start of a night).
+     */
+    void reset() {
+        memset(_events, 0, sizeof(_events));
+        setTag(_events[0], "invoke");
+        _eventCount = 1;
+        _nextEvent = 1;
+        _invokeStart = 0;
+        _arenaPeak = 0;
+        _dropped = 0;
+        memset(_eventStart, 0, sizeof(_eventStart));
+    }
+
+    /**
+     * Start of one classification.
+     */
+    void beginInvoke() {
+        _nextEvent = 1;
+        _invokeStart = cycles();
+    }
+
+    /**
+     * End of the classification started by beginInvoke().
+     *
+     * @param arenaBytes Working memory of the engine (for the high-water mark)
+     */
+    void endInvoke(size_t arenaBytes) {
+        record(_events[0], cycles() - _invokeStart);
+        if (arenaBytes > _arenaPeak) _arenaPeak = (uint32_t)arenaBytes;
+    }
+
+    /**
+     * Start of one operator / layer; events must not nest.
+     *
+     * @return Handle for endEvent()
+     */
+    uint32_t beginEvent(const char* tag) {
+        if (_nextEvent >= PROFILER_MAX_EVENTS) {
+            _dropped++;
+            return 0;
+        }
+        int slot = _nextEvent++;
+        ProfilerEventStats& event = _events[slot];
+        if (strncmp(event.tag, tag, PROFILER_TAG_LEN - 1) != 0) {
+            // Another model: the slot measures something else now
+            memset(&event, 0, sizeof(event));
+            setTag(event, tag);
+        }
+        if (slot >= _eventCount) _eventCount = slot + 1;
+        _eventStart[slot] = cycles();
+        return (uint32_t)slot;
+    }
+
+    void endEvent(uint32_t handle) {
+        if (handle == 0 || handle >= PROFILER_MAX_EVENTS) return;
+        record(_events[handle], cycles() - _eventStart[handle]);
+    }
+
+    // ---- Results ----
+
+    uint32_t getInvocations() const { return _events[0].count; }
+    int getEventCount() const { return _eventCount; }
+    uint32_t getArenaPeak() const { return _arenaPeak; }
+    uint32_t getDropped() const { return _dropped; }
+
+    const ProfilerEventStats& getEvent(int i) const { return _events[i]; }
+
+    uint32_t getMean(int i) const {
+        const ProfilerEventStats& event = _events[i];
+        return event.count ? (uint32_t)(event.totalCycles / event.count) : 0;
+    }
+
+    /**
+     * Percentile of an event's cycles (bucket upper edge, clamped to the
+     * observed range).
+     *
+     * @param fraction e.g. 0.99f
+     */
+    uint32_t getPercentile(int i, float fraction) const {
+        const ProfilerEventStats& event = _events[i];
+        if (event.count == 0) return 0;
+
+        uint32_t target = (uint32_t)(fraction * event.count + 0.999f);
+        if (target < 1) target = 1;
+        uint32_t seen = 0;
+        for (int b = 0; b < PROFILER_BUCKETS; b++) {
+            seen += event.histogram[b];
+            if (seen >= target) {
+                uint32_t edge = bucketUpperEdge(b);
+                if (edge > event.maxCycles) edge = event.maxCycles;
+                if (edge < event.minCycles) edge = event.minCycles;
+                return edge;
+            }
+        }
+        return event.maxCycles;
+    }
+
+    /**
+     * Cycle counter ticks per microsecond.
+     */
+    static uint32_t cyclesPerMicrosecond() {
+        #ifdef ARDUINO
+        return getCpuFrequencyMhz();
+        #else
+        return 1000;
+        #endif
+    }
+
+    /**
+     * Write the binary record.
+     *
+     * @param out At least PROFILER_RECORD_MAX bytes
+     * @return Bytes written
+     */
+    size_t serialize(uint8_t* out) const {
+        out[0] = PROFILER_RECORD_VERSION;
+        out[1] = (uint8_t)_eventCount;
+        writeU16(out + 2, (uint16_t)cyclesPerMicrosecond());
+        writeU32(out + 4, getInvocations());
+        writeU32(out + 8, _arenaPeak);
+        writeU32(out + 12, _dropped);
+
+        uint8_t* p = out + PROFILER_HEADER_SIZE;
+        for (int i = 0; i < _eventCount; i++) {
+            const ProfilerEventStats& event = _events[i];
+            memcpy(p, event.tag, PROFILER_TAG_LEN);
+            writeU32(p + PROFILER_TAG_LEN, event.count ? event.minCycles : 0);
+            writeU32(p + PROFILER_TAG_LEN + 4, getMean(i));
+            writeU32(p + PROFILER_TAG_LEN + 8, getPercentile(i, 0.99f));
+            writeU32(p + PROFILER_TAG_LEN + 12, event.maxCycles);
+            p += PROFILER_EVENT_SIZE;
+        }
+        return (size_t)(p - out);
+    }
+
+private:
+    ProfilerEventStats _events[PROFILER_MAX_EVENTS];
+    uint32_t _eventStart[PROFILER_MAX_EVENTS];
+    int _eventCount;
+    int _nextEvent;
+    uint32_t _invokeStart;
+    uint32_t _arenaPeak;
+    uint32_t _dropped;
+
+    static uint32_t cycles() {
+        #ifdef ARDUINO
+        return ESP.getCycleCount();
+        #else
+        using namespace std::chrono;
+        return (uint32_t)duration_cast<nanoseconds>(
+            steady_clock::now().time_since_epoch()).count();
+        #endif
+    }
+
+    static void setTag(ProfilerEventStats& event, const char* tag) {
+        // Truncated, NUL padded (the slot was cleared)
+        size_t length = strlen(tag);
+        if (length > PROFILER_TAG_LEN - 1) length = PROFILER_TAG_LEN - 1;
+        memcpy(event.tag, tag, length);
+        event.tag[length] = '\0';
+    }
+
+    static void record(ProfilerEventStats& event, uint32_t elapsed) {
+        if (event.count == 0 || elapsed < event.minCycles) event.minCycles = elapsed;
+        if (elapsed > event.maxCycles) event.maxCycles = elapsed;
+        event.lastCycles = elapsed;
+        event.totalCycles += elapsed;
+        event.count++;
+        uint16_t& bucket = event.histogram[bucketOf(elapsed)];
+        if (bucket < 0xFFFF) bucket++;
+    }
+
+    /**
+     * Log bucket: 4 per octave, octave 4 (16 cycles) first.
+     */
+    static int bucketOf(uint32_t value) {
+        if (value < 16) return 0;
+        int msb = 31 - __builtin_clz(value);
+        int bucket = (msb - 4) * 4 + (int)((value >> (msb - 2)) & 3);
+        return bucket < PROFILER_BUCKETS ? bucket : PROFILER_BUCKETS - 1;
+    }
+
+    static uint32_t bucketUpperEdge(int bucket) {
+        int msb = bucket / 4 + 4;
+        if (msb >= 31) return 0xFFFFFFFFu;
+        return ((uint32_t)(5 + bucket % 4) << (msb - 2)) - 1;
+    }
+
+    static void writeU16(uint8_t* p, uint16_t v) {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+    }
+
+    static void writeU32(uint8_t* p, uint32_t v) {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+        p[2] = (uint8_t)(v >> 16);
+        p[3] = (uint8_t)(v >> 24);
+    }
+};
+
+
+// ============================================================================
+// Scoped Event
+// ============================================================================
+
+/**
+ * Times the enclosing block as one event; no-op without a profiler.
+ */
+class ProfileScope {
+public:
+    ProfileScope(InferenceProfiler* profiler, const char* tag)
+        : _profiler(profiler), _handle(profiler ? profiler->beginEvent(tag) : 0) {}
+
+    ~ProfileScope() {
+        if (_profiler) _profiler->endEvent(_handle);
+    }
+
+private:
+    InferenceProfiler* _profiler;
+    uint32_t _handle;
+};
+
+#endif // INFERENCE_PROFILER_H
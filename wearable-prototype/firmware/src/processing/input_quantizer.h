@@ -0,0 +1,128 @@
+/**
+ * Fused Feature Scaler + Input Quantizer
+ * ======================================
+ *
+ * The classifier input is (x - FEATURE_MEAN) / FEATURE_SCALE, quantized
+ * with the model's input scale s and zero point zp:
+ *
+ *   q = round(((x - mean) / scale) / s) + zp = round(x * mul + offset)
+ *
+ *   mul    = 1 / (scale * s)
+ *   offset = zp - mean * mul
+ *
+ * The pairs are computed once when the model is loaded, so each epoch is a
+ * single multiply-add-clamp per feature written straight into the model's
+ * int8 input, with no float scaled copy and no divides. With s = 1 and
+ * zp = 0 the same pairs give the scaled float input for float models.
+ *
+ * A non-finite feature (NaN from a degenerate epoch, or an infinity) is
+ * taken as the population mean: zp in the int8 input, 0 in the float one.
+ */
+
+#ifndef INPUT_QUANTIZER_H
+#define INPUT_QUANTIZER_H
+
+#include <stdint.h>
+#include <math.h>
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define INPUT_QUANTIZER_MAX_FEATURES    128
+
+
+// ============================================================================
+// Input Quantizer Class
+// ============================================================================
+
+class InputQuantizer {
+public:
+    InputQuantizer() : _zeroPoint(0), _count(0) {}
+
+    /**
+     * Precompute the per-feature multiplier/offset pairs.
+     *
+     * @param mean Scaler means (FEATURE_MEAN)
+     * @param scale Scaler standard deviations (FEATURE_SCALE)
+     * @param count Number of features (<= INPUT_QUANTIZER_MAX_FEATURES)
+     * @param inputScale Model input scale (1 for float models)
+     * @param inputZeroPoint Model input zero point (0 for float models)
+     * @return false if count is out of range or a scale is not positive
+     */
+    bool begin(const float* mean, const float* scale, int count,
+               float inputScale, int32_t inputZeroPoint) {
+        _count = 0;
+        if (count <= 0 || count > INPUT_QUANTIZER_MAX_FEATURES || !(inputScale > 0.0f)) {
+            return false;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (!(scale[i] > 0.0f)) return false;
+            double mul = 1.0 / ((double)scale[i] * (double)inputScale);
+            _mul[i] = (float)mul;
+            _offset[i] = (float)((double)inputZeroPoint - (double)mean[i] * mul);
+        }
+        _zeroPoint = (int8_t)(inputZeroPoint < -128 ? -128 : (inputZeroPoint > 127 ? 127 : inputZeroPoint));
+        _count = count;
+        return true;
+    }
+
+    /**
+     * Scale and quantize one feature vector into an int8 input tensor.
+     * Rounds to nearest (ties up; TFLite's QUANTIZE rounds ties away from
+     * zero, which only differs on exact negative ties) and saturates.
+     */
+    void quantize(const float* features, int8_t* output) const {
+        for (int i = 0; i < _count; i++) {
+            // NaN would pass both clamps and reach the int cast
+            if (!isfinite(features[i])) {
+                output[i] = _zeroPoint;
+                continue;
+            }
+            float v = features[i] * _mul[i] + _offset[i];
+            // Clamp in float first: the int cast of an out-of-range float is
+            // undefined. Shifted to be positive, truncation rounds half up
+            // without a branch.
+            v = v < -128.0f ? -128.0f : v;
+            v = v > 127.0f ? 127.0f : v;
+            output[i] = (int8_t)((int32_t)(v + 128.5f) - 128);
+        }
+    }
+
+    /**
+     * Scaled features for float models (begin() with scale 1, zero point 0).
+     */
+    void scale(const float* features, float* output) const {
+        for (int i = 0; i < _count; i++) {
+            output[i] = isfinite(features[i]) ? features[i] * _mul[i] + _offset[i] : 0.0f;
+        }
+    }
+
+    int getCount() const { return _count; }
+
+private:
+    float _mul[INPUT_QUANTIZER_MAX_FEATURES];
+    float _offset[INPUT_QUANTIZER_MAX_FEATURES];
+    int8_t _zeroPoint;
+    int _count;
+};
+
+
+// ============================================================================
+// Output Helpers
+// ============================================================================
+
+/**
+ * Index of the largest int8 logit. Dequantization is monotonic, so this is
+ * the predicted class without converting anything to float.
+ */
+static inline int argmaxInt8(const int8_t* values, int count) {
+    int best = 0;
+    for (int i = 1; i < count; i++) {
+        if (values[i] > values[best]) best = i;
+    }
+    return best;
+}
+
+#endif // INPUT_QUANTIZER_H
@@ -0,0 +1,755 @@
+/**
+ * Native Int8 MLP Engine
+ * ======================
+ *
+ * Runs the quantized sleep-stage MLP (72 -> 64 -> 32 -> 16 -> 4) without the
+ * TFLite Micro interpreter. Parameters are read directly from the same
+ * .tflite flatbuffer (weights stay in place, nothing is copied), and the
+ * arithmetic follows TFLM's int8 FULLY_CONNECTED reference kernel exactly:
+ *
+ *   acc = bias + sum(w * (x - inputZeroPoint))     int8 x int8 -> int32
+ *   y   = clamp(requantize(acc) + outputZeroPoint)  per-channel multiplier
+ *
+ * The input zero point is folded into the bias at load time (bias - zp *
+ * sum(w)), so the inner loop is a plain int8 dot product. ReLU is fused into
+ * the clamp, and the final softmax uses a 256-entry exp table indexed by the
+ * int8 logit difference from the maximum.
+ *
+ * Inner products use AVX2 on x86 hosts and a 4-way unrolled scalar loop
+ * elsewhere (ESP-DSP has no int8 x int8 -> int32 dot product to reuse).
+ *
+ * invokeBatch() runs many inputs as matrix-matrix products, for
+ * reprocessing whole nights on a host or gateway. Inputs go through all
+ * layers in blocks of MLP_BATCH_BLOCK so activations stay in L1, and each
+ * weight row pair is loaded once per tile of MLP_BATCH_TILE inputs (2 x 4
+ * accumulators in registers). Results are bit-identical to invoke().
+ * Without AVX2 a tile only repeats the scalar dot products, so batches
+ * run one input at a time through invoke()'s loop instead.
+ *
+ * Supported graph: a chain of FULLY_CONNECTED (NONE/RELU/RELU6), with
+ * optional RESHAPE, standalone RELU, a leading QUANTIZE, a trailing SOFTMAX
+ * and DEQUANTIZE. Anything else fails load() with a message.
+ */
+
+#ifndef INT8_MLP_H
+#define INT8_MLP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "tflite_reader.h"
+#include "inference_profiler.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define MLP_MAX_LAYERS      8
+#define MLP_MAX_WIDTH       128     // Widest layer input or output
+#define MLP_MAX_NEURONS     256     // Sum of all layer outputs
+#define MLP_BATCH_BLOCK     8       // Inputs carried through all layers together
+#define MLP_BATCH_TILE      4       // Inputs sharing each weight load (fixed)
+
+
+// ============================================================================
+// Fixed-Point Helpers (gemmlowp / TFLite semantics)
+// ============================================================================
+
+static inline int32_t saturatingRoundingDoublingHighMul(int32_t a, int32_t b) {
+    if (a == b && a == INT32_MIN) return INT32_MAX;
+    int64_t ab = (int64_t)a * b;
+    int32_t nudge = ab >= 0 ? (1 << 30) : (1 - (1 << 30));
+    return (int32_t)((ab + nudge) / (1ll << 31));
+}
+
+static inline int32_t roundingDivideByPOT(int32_t x, int exponent) {
+    int32_t mask = (int32_t)((1ll << exponent) - 1);
+    int32_t remainder = x & mask;
+    int32_t threshold = (mask >> 1) + (x < 0 ? 1 : 0);
+    return (x >> exponent) + (remainder > threshold ? 1 : 0);
+}
+
+static inline int32_t multiplyByQuantizedMultiplier(int32_t x, int32_t multiplier, int shift) {
+    int leftShift = shift > 0 ? shift : 0;
+    int rightShift = shift > 0 ? 0 : -shift;
+    return roundingDivideByPOT(
+        saturatingRoundingDoublingHighMul(x * (1 << leftShift), multiplier), rightShift);
+}
+
+#if defined(__AVX2__)
+/**
+ * multiplyByQuantizedMultiplier() on four values sharing one multiplier
+ * (the inputs of a batch tile), bit-identical. The multiplier is a
+ * positive Q31 value, so the INT32_MIN saturation case cannot occur.
+ */
+static inline __m128i multiplyByQuantizedMultiplier4(__m128i x, int32_t multiplier, int shift) {
+    const __m128i zero = _mm_setzero_si128();
+    x = _mm_sll_epi32(x, _mm_cvtsi32_si128(shift > 0 ? shift : 0));
+
+    // Doubling high multiply: trunc((x * m + nudge) / 2^31), even and odd lanes
+    __m128i m = _mm_set1_epi32(multiplier);
+    __m128i products[2] = {_mm_mul_epi32(x, m), _mm_mul_epi32(_mm_srli_epi64(x, 32), m)};
+    for (int i = 0; i < 2; i++) {
+        __m128i negative = _mm_cmpgt_epi64(zero, products[i]);
+        __m128i nudge = _mm_add_epi64(_mm_set1_epi64x(1ll << 30),
+                                      _mm_and_si128(negative, _mm_set1_epi64x(1 - (1ll << 31))));
+        __m128i v = _mm_add_epi64(products[i], nudge);
+        negative = _mm_cmpgt_epi64(zero, v);
+        __m128i magnitude = _mm_sub_epi64(_mm_xor_si128(v, negative), negative);
+        magnitude = _mm_srli_epi64(magnitude, 31);
+        products[i] = _mm_sub_epi64(_mm_xor_si128(magnitude, negative), negative);
+    }
+    __m128i high = _mm_blend_epi32(products[0], _mm_slli_epi64(products[1], 32), 0xA);
+
+    // Rounding right shift
+    int exponent = shift > 0 ? 0 : -shift;
+    __m128i mask = _mm_set1_epi32((int32_t)((1ll << exponent) - 1));
+    __m128i remainder = _mm_and_si128(high, mask);
+    __m128i threshold = _mm_sub_epi32(_mm_srai_epi32(mask, 1), _mm_cmpgt_epi32(zero, high));
+    __m128i result = _mm_sra_epi32(high, _mm_cvtsi32_si128(exponent));
+    return _mm_sub_epi32(result, _mm_cmpgt_epi32(remainder, threshold));
+}
+#endif
+
+/**
+ * Split a real multiplier into a Q31 mantissa and a power-of-two shift.
+ */
+static inline void quantizeMultiplier(double real, int32_t* quantized, int* shift) {
+    if (real == 0.0) {
+        *quantized = 0;
+        *shift = 0;
+        return;
+    }
+    double q = frexp(real, shift);
+    int64_t fixed = (int64_t)round(q * (double)(1ll << 31));
+    if (fixed == (1ll << 31)) {
+        fixed /= 2;
+        (*shift)++;
+    }
+    if (*shift < -31) {
+        *shift = 0;
+        fixed = 0;
+    }
+    *quantized = (int32_t)fixed;
+}
+
+/**
+ * int8 dot product with int32 accumulation.
+ */
+static inline int32_t dotInt8(const int8_t* a, const int8_t* b, int n) {
+    int i = 0;
+    int32_t sum = 0;
+
+#if defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 16 <= n; i += 16) {
+        __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+        __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_hadd_epi32(s, s);
+    s = _mm_hadd_epi32(s, s);
+    sum = _mm_cvtsi128_si32(s);
+#endif
+
+    int32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) {
+        s0 += a[i] * b[i];
+    }
+    return sum + s0 + s1 + s2 + s3;
+}
+
+#if defined(__AVX2__)
+/**
+ * Sums of four int32x8 accumulators, as {a, b, c, d}.
+ */
+static inline __m128i horizontalSum4(__m256i a, __m256i b, __m256i c, __m256i d) {
+    __m256i ab = _mm256_hadd_epi32(a, b);
+    __m256i cd = _mm256_hadd_epi32(c, d);
+    __m256i abcd = _mm256_hadd_epi32(ab, cd);
+    return _mm_add_epi32(_mm256_castsi256_si128(abcd), _mm256_extracti128_si256(abcd, 1));
+}
+
+/**
+ * Dot products of two weight rows with MLP_BATCH_TILE inputs:
+ * acc[r][t] = sum(w_r * x_t).
+ *
+ * @param x MLP_BATCH_TILE input rows of n values
+ * @param wide The same rows widened to int16, 8 values of padding
+ */
+static inline void dotInt8Tile(const int8_t* w0, const int8_t* w1, const int8_t* const* x,
+                               const int16_t (*wide)[MLP_MAX_WIDTH + 8], int n,
+                               int32_t acc[2][MLP_BATCH_TILE]) {
+    int k = 0;
+    __m256i s0[MLP_BATCH_TILE], s1[MLP_BATCH_TILE];
+    for (int t = 0; t < MLP_BATCH_TILE; t++) {
+        s0[t] = _mm256_setzero_si256();
+        s1[t] = _mm256_setzero_si256();
+    }
+    for (; k + 16 <= n; k += 16) {
+        __m256i a = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(w0 + k)));
+        __m256i b = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(w1 + k)));
+        for (int t = 0; t < MLP_BATCH_TILE; t++) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(wide[t] + k));
+            s0[t] = _mm256_add_epi32(s0[t], _mm256_madd_epi16(a, v));
+            s1[t] = _mm256_add_epi32(s1[t], _mm256_madd_epi16(b, v));
+        }
+    }
+    if (k + 8 <= n) {
+        // Half step: the upper eight weights load as zero (`wide` is padded)
+        __m256i a = _mm256_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*)(w0 + k)));
+        __m256i b = _mm256_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*)(w1 + k)));
+        for (int t = 0; t < MLP_BATCH_TILE; t++) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(wide[t] + k));
+            s0[t] = _mm256_add_epi32(s0[t], _mm256_madd_epi16(a, v));
+            s1[t] = _mm256_add_epi32(s1[t], _mm256_madd_epi16(b, v));
+        }
+        k += 8;
+    }
+    _mm_storeu_si128((__m128i*)acc[0], horizontalSum4(s0[0], s0[1], s0[2], s0[3]));
+    _mm_storeu_si128((__m128i*)acc[1], horizontalSum4(s1[0], s1[1], s1[2], s1[3]));
+    for (; k < n; k++) {
+        int32_t a = w0[k], b = w1[k];
+        for (int t = 0; t < MLP_BATCH_TILE; t++) {
+            int32_t v = x[t][k];
+            acc[0][t] += a * v;
+            acc[1][t] += b * v;
+        }
+    }
+}
+#endif
+
+
+// ============================================================================
+// Dense Layer
+// ============================================================================
+
+struct Int8DenseLayer {
+    const int8_t* weights;      // [outputs][inputs], row-major, zero point 0
+    int16_t inputs;
+    int16_t outputs;
+    int16_t channelStart;       // Index into the engine's per-channel arrays
+    int8_t outputZeroPoint;
+    int8_t actMin;
+    int8_t actMax;
+};
+
+
+// ============================================================================
+// Int8 MLP Class
+// ============================================================================
+
+class Int8MLP {
+public:
+    Int8MLP() { reset(); }
+
+    void reset() {
+        _layerCount = 0;
+        _neurons = 0;
+        _inputScale = 1.0f;
+        _inputZeroPoint = 0;
+        _logitScale = 1.0f;
+        _softmaxBeta = 1.0f;
+        _hasSoftmax = false;
+        _floatInput = false;
+        _floatOutput = false;
+        _output = nullptr;
+        _error = "not loaded";
+    }
+
+    /**
+     * Build the engine from a .tflite flatbuffer. Weights are referenced in
+     * place, so `model` must outlive the engine.
+     *
+     * @return true on success; see getError() otherwise
+     */
+    bool load(const uint8_t* model, size_t length) {
+        reset();
+
+        TFLiteReader r;
+        if (!r.begin(model, length)) return fail("not a TFLite v3 flatbuffer");
+
+        uint32_t root = r.root();
+        uint32_t subgraphs = r.child(root, TFL_MODEL_SUBGRAPHS);
+        if (r.vectorLength(subgraphs) != 1) return fail("expected exactly one subgraph");
+
+        uint32_t graph = r.vectorTable(subgraphs, 0);
+        uint32_t tensors = r.child(graph, TFL_SUBGRAPH_TENSORS);
+        uint32_t operators = r.child(graph, TFL_SUBGRAPH_OPERATORS);
+        uint32_t codes = r.child(root, TFL_MODEL_OPERATOR_CODES);
+        uint32_t buffers = r.child(root, TFL_MODEL_BUFFERS);
+
+        int32_t current = r.vectorScalar<int32_t>(r.child(graph, TFL_SUBGRAPH_INPUTS), 0, -1);
+        uint32_t opCount = r.vectorLength(operators);
+
+        for (uint32_t i = 0; i < opCount; i++) {
+            uint32_t op = r.vectorTable(operators, i);
+            uint32_t code = r.vectorTable(codes, r.readScalar<uint32_t>(op, TFL_OP_OPCODE_INDEX, 0));
+            // Old converters only set the deprecated int8 code
+            int32_t opcode = r.readScalar<int32_t>(code, TFL_OPCODE_BUILTIN_CODE, 0);
+            int32_t deprecated = r.readScalar<int8_t>(code, TFL_OPCODE_DEPRECATED_CODE, 0);
+            if (deprecated > opcode) opcode = deprecated;
+
+            uint32_t inputs = r.child(op, TFL_OP_INPUTS);
+            int32_t in0 = r.vectorScalar<int32_t>(inputs, 0, -1);
+            int32_t out0 = r.vectorScalar<int32_t>(r.child(op, TFL_OP_OUTPUTS), 0, -1);
+            if (in0 != current) return fail("graph is not a single chain");
+            if (_hasSoftmax && opcode != TFL_OP_DEQUANTIZE) {
+                return fail("operator after SOFTMAX");
+            }
+
+            uint32_t inTensor = r.vectorTable(tensors, (uint32_t)in0);
+            uint32_t outTensor = r.vectorTable(tensors, (uint32_t)out0);
+
+            switch (opcode) {
+                case TFL_OP_QUANTIZE:
+                    if (_layerCount > 0) return fail("QUANTIZE inside the graph");
+                    _floatInput = true;
+                    break;
+
+                case TFL_OP_RESHAPE:
+                    break;
+
+                case TFL_OP_FULLY_CONNECTED: {
+                    uint32_t weightTensor = r.vectorTable(tensors,
+                        (uint32_t)r.vectorScalar<int32_t>(inputs, 1, -1));
+                    int32_t biasIndex = r.vectorScalar<int32_t>(inputs, 2, -1);
+                    uint32_t biasTensor = biasIndex >= 0 ? r.vectorTable(tensors, (uint32_t)biasIndex) : 0;
+                    uint8_t activation = r.readScalar<uint8_t>(
+                        r.child(op, TFL_OP_BUILTIN_OPTIONS), TFL_FC_FUSED_ACTIVATION, TFL_ACT_NONE);
+                    if (!loadFullyConnected(r, buffers, inTensor, weightTensor, biasTensor,
+                                            outTensor, activation)) {
+                        return false;
+                    }
+                    break;
+                }
+
+                case TFL_OP_RELU: {
+                    if (_layerCount == 0) return fail("RELU before any layer");
+                    Int8DenseLayer& last = _layers[_layerCount - 1];
+                    if (last.actMin < last.outputZeroPoint) last.actMin = last.outputZeroPoint;
+                    break;
+                }
+
+                case TFL_OP_SOFTMAX:
+                    if (_layerCount == 0) return fail("SOFTMAX before any layer");
+                    _hasSoftmax = true;
+                    _softmaxBeta = r.readScalar<float>(
+                        r.child(op, TFL_OP_BUILTIN_OPTIONS), TFL_SOFTMAX_BETA, 1.0f);
+                    break;
+
+                case TFL_OP_DEQUANTIZE:
+                    _floatOutput = true;
+                    break;
+
+                default:
+                    return fail("unsupported operator");
+            }
+            current = out0;
+        }
+
+        if (_layerCount == 0) return fail("no FULLY_CONNECTED layers");
+
+        buildExpTable();   // Beta is only known once SOFTMAX has been parsed
+        _error = nullptr;
+        return true;
+    }
+
+    /**
+     * Append one int8 fully connected layer. Used by load(); also lets tests
+     * and hand-built models drive the engine without a flatbuffer.
+     *
+     * @param weights [outputs][inputs] int8, symmetric (zero point 0)
+     * @param bias int32 per output (little-endian, any alignment), or nullptr
+     * @param filterScales One scale (per-tensor) or `outputs` scales (per-channel)
+     * @param activation TFL_ACT_NONE, TFL_ACT_RELU or TFL_ACT_RELU6
+     */
+    bool addFullyConnected(const int8_t* weights, const void* bias, int inputs, int outputs,
+                           float inputScale, int32_t inputZeroPoint,
+                           const float* filterScales, int nFilterScales,
+                           float outputScale, int32_t outputZeroPoint, uint8_t activation) {
+        if (_layerCount >= MLP_MAX_LAYERS) return fail("too many layers");
+        if (inputs > MLP_MAX_WIDTH || outputs > MLP_MAX_WIDTH) return fail("layer too wide");
+        if (_neurons + outputs > MLP_MAX_NEURONS) return fail("too many neurons");
+        if (_layerCount > 0 && _layers[_layerCount - 1].outputs != inputs) {
+            return fail("layer sizes do not chain");
+        }
+        if (nFilterScales != 1 && nFilterScales != outputs) return fail("bad filter scales");
+
+        Int8DenseLayer& layer = _layers[_layerCount];
+        layer.weights = weights;
+        layer.inputs = (int16_t)inputs;
+        layer.outputs = (int16_t)outputs;
+        layer.channelStart = (int16_t)_neurons;
+        layer.outputZeroPoint = (int8_t)outputZeroPoint;
+        layer.actMin = -128;
+        layer.actMax = 127;
+        if (activation == TFL_ACT_RELU || activation == TFL_ACT_RELU6) {
+            layer.actMin = (int8_t)(outputZeroPoint > -128 ? outputZeroPoint : -128);
+        }
+        if (activation == TFL_ACT_RELU6) {
+            int32_t six = outputZeroPoint + (int32_t)roundf(6.0f / outputScale);
+            layer.actMax = (int8_t)(six < 127 ? six : 127);
+        } else if (activation != TFL_ACT_NONE && activation != TFL_ACT_RELU) {
+            return fail("unsupported fused activation");
+        }
+
+        for (int o = 0; o < outputs; o++) {
+            int32_t b = 0;
+            if (bias) memcpy(&b, (const uint8_t*)bias + 4 * o, 4);
+
+            // Fold the input zero point: sum(w * (x - zp)) = sum(w * x) - zp * sum(w)
+            int32_t rowSum = 0;
+            const int8_t* row = weights + o * inputs;
+            for (int i = 0; i < inputs; i++) rowSum += row[i];
+            _bias[_neurons + o] = b - inputZeroPoint * rowSum;
+
+            float filterScale = filterScales[nFilterScales == 1 ? 0 : o];
+            double real = (double)inputScale * (double)filterScale / (double)outputScale;
+            int shift;
+            quantizeMultiplier(real, &_multiplier[_neurons + o], &shift);
+            _shift[_neurons + o] = (int8_t)shift;
+        }
+
+        if (_layerCount == 0) {
+            _inputScale = inputScale;
+            _inputZeroPoint = inputZeroPoint;
+        }
+        _logitScale = outputScale;
+        _logitZeroPoint = outputZeroPoint;
+        _neurons += outputs;
+        _layerCount++;
+        buildExpTable();
+        _error = nullptr;
+        return true;
+    }
+
+    /**
+     * Run all layers on a quantized input vector.
+     *
+     * @param input getInputSize() int8 values in the input quantization
+     * @param profiler Records one FULLY_CONNECTED event per layer (optional)
+     * @return Output logits (getOutputSize() int8 values)
+     */
+    const int8_t* invoke(const int8_t* input, InferenceProfiler* profiler = nullptr) {
+        _output = forward(input, _bufferA, _bufferB, profiler);
+        return _output;
+    }
+
+    /**
+     * Run all layers on many quantized inputs (same results as invoke() on
+     * each). Does not change the last invoke() output.
+     *
+     * @param inputs count x getInputSize() int8 values, row after row
+     * @param count Number of inputs
+     * @param logits Output, count x getOutputSize() int8 values
+     */
+    void invokeBatch(const int8_t* inputs, int count, int8_t* logits) const {
+        int inputSize = getInputSize();
+        int outputSize = getOutputSize();
+
+        #if defined(__AVX2__)
+        int8_t bufferA[MLP_BATCH_BLOCK * MLP_MAX_WIDTH];
+        int8_t bufferB[MLP_BATCH_BLOCK * MLP_MAX_WIDTH];
+        for (int start = 0; start < count; start += MLP_BATCH_BLOCK) {
+            int rows = count - start < MLP_BATCH_BLOCK ? count - start : MLP_BATCH_BLOCK;
+            const int8_t* x = inputs + start * inputSize;
+            int8_t* y = bufferA;
+
+            for (int l = 0; l < _layerCount; l++) {
+                // The last layer writes straight into the caller's logits
+                if (l == _layerCount - 1) y = logits + start * outputSize;
+                denseBatch(_layers[l], x, rows, y);
+                x = y;
+                y = (y == bufferA) ? bufferB : bufferA;
+            }
+        }
+        #else
+        // No SIMD tile: invoke()'s loop is the fastest here
+        int8_t bufferA[MLP_MAX_WIDTH];
+        int8_t bufferB[MLP_MAX_WIDTH];
+        for (int i = 0; i < count; i++) {
+            memcpy(logits + i * outputSize,
+                   forward(inputs + i * inputSize, bufferA, bufferB, nullptr), outputSize);
+        }
+        #endif
+    }
+
+    /**
+     * Index of the largest logit from the last invoke() (no dequantization).
+     * Only valid after invoke().
+     */
+    int argmax() const {
+        int best = 0;
+        for (int i = 1; i < getOutputSize(); i++) {
+            if (_output[i] > _output[best]) best = i;
+        }
+        return best;
+    }
+
+    /**
+     * Softmax of the last logits via the exp table.
+     *
+     * @param probabilities Output, getOutputSize() values summing to 1
+     */
+    void softmax(float* probabilities) const {
+        softmax(_output, probabilities);
+    }
+
+    /**
+     * Softmax of one row of invokeBatch() logits.
+     */
+    void softmax(const int8_t* logits, float* probabilities) const {
+        int n = getOutputSize();
+        int8_t maxLogit = logits[0];
+        for (int i = 1; i < n; i++) {
+            if (logits[i] > maxLogit) maxLogit = logits[i];
+        }
+        float sum = 0.0f;
+        for (int i = 0; i < n; i++) {
+            probabilities[i] = _expTable[maxLogit - logits[i]];
+            sum += probabilities[i];
+        }
+        for (int i = 0; i < n; i++) {
+            probabilities[i] /= sum;
+        }
+    }
+
+    // ---- Model info ----
+
+    bool isLoaded() const { return _layerCount > 0 && _error == nullptr; }
+    const char* getError() const { return _error ? _error : "ok"; }
+    int getLayerCount() const { return _layerCount; }
+    int getInputSize() const { return _layerCount ? _layers[0].inputs : 0; }
+    int getOutputSize() const { return _layerCount ? _layers[_layerCount - 1].outputs : 0; }
+    float getInputScale() const { return _inputScale; }
+    int32_t getInputZeroPoint() const { return _inputZeroPoint; }
+    float getLogitScale() const { return _logitScale; }
+    int32_t getLogitZeroPoint() const { return _logitZeroPoint; }
+    bool hasSoftmax() const { return _hasSoftmax; }
+    bool hasFloatInput() const { return _floatInput; }
+    bool hasFloatOutput() const { return _floatOutput; }
+
+    /**
+     * RAM used by the engine (weights excluded; they stay in the model).
+     */
+    size_t getMemoryUsed() const { return sizeof(*this); }
+
+private:
+    Int8DenseLayer _layers[MLP_MAX_LAYERS];
+    int _layerCount;
+
+    // Per-output-channel parameters, all layers back to back
+    int32_t _bias[MLP_MAX_NEURONS];         // Includes the folded input zero point
+    int32_t _multiplier[MLP_MAX_NEURONS];
+    int8_t _shift[MLP_MAX_NEURONS];
+    int _neurons;
+
+    // Ping-pong activations
+    int8_t _bufferA[MLP_MAX_WIDTH];
+    int8_t _bufferB[MLP_MAX_WIDTH];
+    const int8_t* _output;
+
+    float _inputScale;
+    int32_t _inputZeroPoint;
+    float _logitScale;
+    int32_t _logitZeroPoint;
+    float _softmaxBeta;
+    float _expTable[256];
+    bool _hasSoftmax;
+    bool _floatInput;
+    bool _floatOutput;
+
+    const char* _error;
+
+    /**
+     * exp(-d * beta * logitScale) for logit differences d = 0..255.
+     */
+    void buildExpTable() {
+        for (int d = 0; d < 256; d++) {
+            _expTable[d] = expf(-(float)d * _softmaxBeta * _logitScale);
+        }
+    }
+
+    bool fail(const char* message) {
+        _error = message;
+        return false;
+    }
+
+    static int8_t requantize(const Int8DenseLayer& layer, int32_t acc,
+                             int32_t multiplier, int shift) {
+        acc = multiplyByQuantizedMultiplier(acc, multiplier, shift);
+        acc += layer.outputZeroPoint;
+        if (acc < layer.actMin) acc = layer.actMin;
+        if (acc > layer.actMax) acc = layer.actMax;
+        return (int8_t)acc;
+    }
+
+    /**
+     * All layers for one input, alternating between two buffers of
+     * MLP_MAX_WIDTH.
+     *
+     * @return The buffer holding the logits
+     */
+    const int8_t* forward(const int8_t* input, int8_t* bufferA, int8_t* bufferB,
+                          InferenceProfiler* profiler) const {
+        const int8_t* x = input;
+        int8_t* y = bufferA;
+
+        for (int l = 0; l < _layerCount; l++) {
+            ProfileScope event(profiler, "FULLY_CONNECTED");
+            const Int8DenseLayer& layer = _layers[l];
+            const int32_t* bias = &_bias[layer.channelStart];
+            const int32_t* multiplier = &_multiplier[layer.channelStart];
+            const int8_t* shift = &_shift[layer.channelStart];
+
+            for (int o = 0; o < layer.outputs; o++) {
+                int32_t acc = bias[o] + dotInt8(layer.weights + o * layer.inputs, x, layer.inputs);
+                y[o] = requantize(layer, acc, multiplier[o], shift[o]);
+            }
+
+            x = y;
+            y = (y == bufferA) ? bufferB : bufferA;
+        }
+        return x;
+    }
+
+    #if defined(__AVX2__)
+    /**
+     * requantize() of one output channel for a whole tile, in place.
+     */
+    static void requantizeTile(const Int8DenseLayer& layer, int32_t* acc,
+                               int32_t bias, int32_t multiplier, int shift) {
+        __m128i x = _mm_add_epi32(_mm_loadu_si128((const __m128i*)acc), _mm_set1_epi32(bias));
+        x = multiplyByQuantizedMultiplier4(x, multiplier, shift);
+        x = _mm_add_epi32(x, _mm_set1_epi32(layer.outputZeroPoint));
+        x = _mm_max_epi32(x, _mm_set1_epi32(layer.actMin));
+        x = _mm_min_epi32(x, _mm_set1_epi32(layer.actMax));
+        _mm_storeu_si128((__m128i*)acc, x);
+    }
+
+    /**
+     * One layer for `rows` inputs (<= MLP_BATCH_BLOCK), tile by tile.
+     */
+    void denseBatch(const Int8DenseLayer& layer, const int8_t* x, int rows, int8_t* y) const {
+        const int n = layer.inputs;
+        const int32_t* bias = &_bias[layer.channelStart];
+        const int32_t* multiplier = &_multiplier[layer.channelStart];
+        const int8_t* shift = &_shift[layer.channelStart];
+        int16_t wide[MLP_BATCH_TILE][MLP_MAX_WIDTH + 8];
+
+        for (int b = 0; b < rows; b += MLP_BATCH_TILE) {
+            int tile = rows - b < MLP_BATCH_TILE ? rows - b : MLP_BATCH_TILE;
+
+            // A partial tile repeats its first input; the extra sums are dropped
+            const int8_t* tileInputs[MLP_BATCH_TILE];
+            for (int t = 0; t < MLP_BATCH_TILE; t++) {
+                tileInputs[t] = x + (b + (t < tile ? t : 0)) * n;
+            }
+            for (int t = 0; t < MLP_BATCH_TILE; t++) {
+                for (int k = 0; k < n; k++) wide[t][k] = tileInputs[t][k];
+            }
+
+            for (int o = 0; o < layer.outputs; o += 2) {
+                // An odd last row is paired with itself
+                int o1 = o + 1 < layer.outputs ? o + 1 : o;
+                int32_t acc[2][MLP_BATCH_TILE];
+                dotInt8Tile(layer.weights + o * n, layer.weights + o1 * n, tileInputs,
+                            wide, n, acc);
+
+                requantizeTile(layer, acc[0], bias[o], multiplier[o], shift[o]);
+                requantizeTile(layer, acc[1], bias[o1], multiplier[o1], shift[o1]);
+                for (int t = 0; t < tile; t++) {
+                    int8_t* out = y + (b + t) * layer.outputs;
+                    out[o] = (int8_t)acc[0][t];
+                    out[o1] = (int8_t)acc[1][t];
+                }
+            }
+        }
+    }
+    #endif
+
+    /**
+     * First scale and zero point of a tensor's quantization parameters.
+     */
+    static bool tensorQuantization(const TFLiteReader& r, uint32_t tensor,
+                                   float* scale, int32_t* zeroPoint) {
+        uint32_t quant = r.child(tensor, TFL_TENSOR_QUANTIZATION);
+        uint32_t scales = r.child(quant, TFL_QUANT_SCALE);
+        if (r.vectorLength(scales) == 0) return false;
+        *scale = r.vectorScalar<float>(scales, 0, 0.0f);
+        *zeroPoint = (int32_t)r.vectorScalar<int64_t>(r.child(quant, TFL_QUANT_ZERO_POINT), 0, 0);
+        return *scale > 0.0f;
+    }
+
+    static const uint8_t* tensorData(const TFLiteReader& r, uint32_t buffers, uint32_t tensor,
+                                     size_t expectedBytes) {
+        uint32_t buffer = r.vectorTable(buffers, r.readScalar<uint32_t>(tensor, TFL_TENSOR_BUFFER, 0));
+        uint32_t data = r.child(buffer, TFL_BUFFER_DATA);
+        if (r.vectorLength(data) != expectedBytes) return nullptr;
+        return r.vectorData(data, 1);
+    }
+
+    bool loadFullyConnected(const TFLiteReader& r, uint32_t buffers, uint32_t inTensor,
+                            uint32_t weightTensor, uint32_t biasTensor, uint32_t outTensor,
+                            uint8_t activation) {
+        if (r.readScalar<int8_t>(inTensor, TFL_TENSOR_TYPE, -1) != TFL_TYPE_INT8 ||
+            r.readScalar<int8_t>(weightTensor, TFL_TENSOR_TYPE, -1) != TFL_TYPE_INT8 ||
+            r.readScalar<int8_t>(outTensor, TFL_TENSOR_TYPE, -1) != TFL_TYPE_INT8) {
+            return fail("FULLY_CONNECTED is not int8 (float model?)");
+        }
+
+        uint32_t shape = r.child(weightTensor, TFL_TENSOR_SHAPE);
+        if (r.vectorLength(shape) != 2) return fail("weights are not 2-D");
+        int outputs = r.vectorScalar<int32_t>(shape, 0, 0);
+        int inputs = r.vectorScalar<int32_t>(shape, 1, 0);
+        if (inputs <= 0 || outputs <= 0 || outputs > MLP_MAX_WIDTH) return fail("bad weight shape");
+
+        float inScale, outScale, unused;
+        int32_t inZero, outZero, weightZero;
+        if (!tensorQuantization(r, inTensor, &inScale, &inZero) ||
+            !tensorQuantization(r, outTensor, &outScale, &outZero) ||
+            !tensorQuantization(r, weightTensor, &unused, &weightZero)) {
+            return fail("missing quantization parameters");
+        }
+        if (weightZero != 0) return fail("asymmetric weights");
+
+        uint32_t scaleVec = r.child(r.child(weightTensor, TFL_TENSOR_QUANTIZATION), TFL_QUANT_SCALE);
+        int nScales = (int)r.vectorLength(scaleVec);
+        if (nScales != 1 && nScales != outputs) return fail("bad filter scales");
+        float filterScales[MLP_MAX_WIDTH];
+        for (int i = 0; i < nScales; i++) {
+            filterScales[i] = r.vectorScalar<float>(scaleVec, (uint32_t)i, 0.0f);
+        }
+
+        const uint8_t* weights = tensorData(r, buffers, weightTensor, (size_t)inputs * outputs);
+        if (!weights) return fail("weight buffer size mismatch");
+
+        const uint8_t* bias = nullptr;
+        if (biasTensor) {
+            if (r.readScalar<int8_t>(biasTensor, TFL_TENSOR_TYPE, -1) != TFL_TYPE_INT32) {
+                return fail("bias is not int32");
+            }
+            bias = tensorData(r, buffers, biasTensor, (size_t)outputs * 4);
+            if (!bias) return fail("bias buffer size mismatch");
+        }
+
+        return addFullyConnected((const int8_t*)weights, bias, inputs, outputs,
+                                 inScale, inZero, filterScales, nScales,
+                                 outScale, outZero, activation);
+    }
+};
+
+#endif // INT8_MLP_H
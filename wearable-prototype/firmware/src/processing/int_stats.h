@@ -0,0 +1,191 @@
+/**
+ * Exact Integer Statistics
+ * ========================
+ *
+ * computeStatFeatures() for raw integer samples (PPG counts). Sums, energy
+ * and central moments are accumulated in int64, which is exact for the
+ * MAX30102's 18-bit samples, so the result does not depend on summation
+ * order and host and device builds produce bit-identical features.
+ *
+ * Float accumulation of ~3000 samples of ~1e5 counts loses most of the
+ * low-order bits of the energy (~3e13) and of the variance computed from it.
+ *
+ * Each output is finalized from the exact integer sums with a handful of
+ * double operations and rounded to float once. Build with -ffp-contract=off
+ * so the compiler does not fuse those into target-specific FMAs.
+ */
+
+#ifndef INT_STATS_H
+#define INT_STATS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define INT_STATS_MAX_SAMPLE_BITS   18      // MAX30102 ADC resolution
+#define INT_STATS_MAX_LENGTH        4096    // n * x^2 must fit in int64
+
+// Same layout as computeStatFeatures(const float*, ...)
+#define N_INT_STAT_FEATURES         12
+
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static inline int bitLength(uint64_t v) {
+    int bits = 0;
+    while (v) {
+        bits++;
+        v >>= 1;
+    }
+    return bits;
+}
+
+/**
+ * Right shift applied to deviations before the 3rd/4th power sums, so that
+ * n * |d|^4 stays below 2^62. Zero for typical PPG epochs (|d| < ~6000).
+ */
+static inline int momentShift(int32_t maxAbsDev, int length) {
+    int shift = 0;
+    while (4 * bitLength((uint32_t)(maxAbsDev >> shift)) + bitLength((uint32_t)length) > 62) {
+        shift++;
+    }
+    return shift;
+}
+
+
+// ============================================================================
+// Statistical Features
+// ============================================================================
+
+/**
+ * Compute statistical features from raw integer samples.
+ *
+ * @param data Input samples (0 <= x < 2^INT_STATS_MAX_SAMPLE_BITS)
+ * @param length Number of samples (<= INT_STATS_MAX_LENGTH)
+ * @param output Output array for 12 features
+ * @param scratch `length` values for the sorted copy (nullptr: heap)
+ */
+void computeStatFeatures(const int32_t* data, int length, float* output,
+                         int32_t* scratch = nullptr) {
+    if (length == 0) {
+        for (int i = 0; i < N_INT_STAT_FEATURES; i++) output[i] = 0.0f;
+        return;
+    }
+
+    // ---- Exact power sums ----
+
+    int64_t sum = 0;
+    int64_t sumSq = 0;
+    int32_t minVal = data[0];
+    int32_t maxVal = data[0];
+    for (int i = 0; i < length; i++) {
+        int64_t x = data[i];
+        sum += x;
+        sumSq += x * x;
+        if (data[i] < minVal) minVal = data[i];
+        if (data[i] > maxVal) maxVal = data[i];
+    }
+
+    double n = (double)length;
+    double mean = (double)sum / n;
+    output[0] = (float)mean;
+
+    // n^2 * variance, exact
+    int64_t varNum = (int64_t)length * sumSq - sum * sum;
+    double variance = (double)varNum / (n * n);
+    double std = sqrt(variance);
+    output[1] = (float)std;
+
+    output[2] = (float)minVal;
+    output[3] = (float)maxVal;
+    output[4] = (float)(maxVal - minVal);  // Range
+
+    // ---- Median and IQR ----
+
+    int32_t* sorted = scratch ? scratch : (int32_t*)malloc(length * sizeof(int32_t));
+    if (sorted) {
+        memcpy(sorted, data, length * sizeof(int32_t));
+
+        // Simple insertion sort (acceptable for 3000 samples per epoch)
+        for (int i = 1; i < length; i++) {
+            int32_t key = sorted[i];
+            int j = i - 1;
+            while (j >= 0 && sorted[j] > key) {
+                sorted[j + 1] = sorted[j];
+                j--;
+            }
+            sorted[j + 1] = key;
+        }
+
+        output[5] = (float)sorted[length / 2];  // Median
+        output[6] = (float)(sorted[(3 * length) / 4] - sorted[length / 4]);  // IQR
+        if (!scratch) free(sorted);
+    } else {
+        output[5] = (float)mean;
+        output[6] = 0.0f;
+    }
+
+    // ---- Higher moments ----
+    // Deviations from the integer-rounded mean m0; the offset to the true
+    // mean (s1 / n) is corrected analytically below.
+
+    if (varNum > 0) {
+        int32_t m0 = (int32_t)((sum + length / 2) / length);
+        int32_t maxAbsDev = maxVal - m0 > m0 - minVal ? maxVal - m0 : m0 - minVal;
+        int shift = momentShift(maxAbsDev, length);
+
+        int64_t s1 = 0, s2 = 0, s3 = 0, s4 = 0;
+        for (int i = 0; i < length; i++) {
+            int64_t d = (data[i] - m0) >> shift;
+            int64_t d2 = d * d;
+            s1 += d;
+            s2 += d2;
+            s3 += d2 * d;
+            s4 += d2 * d2;
+        }
+
+        double a = (double)s1 / n;
+        double m2 = (double)s2 / n - a * a;
+        double m3 = (double)s3 / n - 3.0 * a * (double)s2 / n + 2.0 * a * a * a;
+        double m4 = (double)s4 / n - 4.0 * a * (double)s3 / n +
+                    6.0 * a * a * (double)s2 / n - 3.0 * a * a * a * a;
+
+        if (m2 > 0.0) {
+            output[7] = (float)(m3 / (m2 * sqrt(m2)));     // Skewness
+            output[8] = (float)(m4 / (m2 * m2) - 3.0);     // Excess Kurtosis
+        } else {
+            output[7] = 0.0f;
+            output[8] = 0.0f;
+        }
+    } else {
+        output[7] = 0.0f;
+        output[8] = 0.0f;
+    }
+
+    // ---- Energy features ----
+
+    output[9] = (float)sumSq;                          // Energy
+    output[10] = (float)sqrt((double)sumSq / n);       // RMS
+
+    // ---- Zero crossings (relative to the mean, compared exactly) ----
+
+    int zeroCrossings = 0;
+    bool prevAbove = (int64_t)data[0] * length > sum;
+    for (int i = 1; i < length; i++) {
+        bool currAbove = (int64_t)data[i] * length > sum;
+        if (prevAbove != currAbove) {
+            zeroCrossings++;
+        }
+        prevAbove = currAbove;
+    }
+    output[11] = (float)zeroCrossings;
+}
+
+#endif // INT_STATS_H
@@ -0,0 +1,248 @@
+/**
+ * Lifting Wavelet Transform (CDF 5/3)
+ * ===================================
+ *
+ * In-place, interleaved discrete wavelet transform using the lifting scheme:
+ *
+ *   predict:  d[k] = x[2k+1] - (x[2k] + x[2k+2]) / 2
+ *   update:   s[k] = x[2k]   + (d[k-1] + d[k]) / 4
+ *
+ * Integer inputs use the reversible JPEG 2000 variant (floor rounding via
+ * arithmetic shifts), so raw PPG counts are transformed exactly. Float inputs
+ * use the linear transform. Boundaries use whole-sample symmetric extension.
+ *
+ * After L levels of liftingForward() the buffer holds, without any extra
+ * storage:
+ *   detail level j: indices 2^(j-1) + k * 2^j
+ *   approximation:  indices k * 2^L
+ *
+ * The features follow pywt.wavedec(x, 'bior2.2', mode='reflect') on the
+ * training side exactly, not just in the interior: pywt keeps
+ * (n + 5) / 2 coefficients per level, the lifting output plus mirrored
+ * copies at both ends, and the leading copy shifts the decimation phase of
+ * every following level. waveletDecompose() therefore lifts one level at a
+ * time and compacts the approximation into pywt's layout, in place, before
+ * the next level. Energies are rescaled to the bior2.2 filter gains
+ * (approx sqrt(2) per level, detail 1/sqrt(2)).
+ */
+
+#ifndef LIFTING_WAVELET_H
+#define LIFTING_WAVELET_H
+
+#include <stdint.h>
+#include <math.h>
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define WAVELET_LEVELS              4
+#define WAVELET_FRAC_BITS           8       // Integer decomposition: fraction bits (18-bit PPG fits)
+
+// Features per channel: relative detail energy per level + entropy over levels
+#define N_WAVELET_CHANNEL_FEATURES  (WAVELET_LEVELS + 1)
+#define N_WAVELET_FEATURES_BLOCK    (2 * N_WAVELET_CHANNEL_FEATURES)   // PPG + IMU magnitude
+
+
+// ============================================================================
+// Lifting Steps
+// ============================================================================
+
+static inline int32_t liftPredict(int32_t left, int32_t right) { return (left + right) >> 1; }
+static inline float liftPredict(float left, float right) { return 0.5f * (left + right); }
+
+static inline int32_t liftUpdate(int32_t left, int32_t right) { return (left + right + 2) >> 2; }
+static inline float liftUpdate(float left, float right) { return 0.25f * (left + right); }
+
+/**
+ * Forward CDF 5/3 transform, in place.
+ *
+ * @param x Signal buffer (overwritten with interleaved coefficients)
+ * @param length Number of samples
+ * @param levels Decomposition levels
+ */
+template <typename T>
+void liftingForward(T* x, int length, int levels) {
+    for (int level = 0; level < levels; level++) {
+        int step = 1 << level;
+        int count = (length + step - 1) / step;   // Samples at this level
+        if (count < 2) return;
+
+        // Predict: odd samples become detail coefficients
+        for (int k = 1; k < count; k += 2) {
+            T left = x[(k - 1) * step];
+            T right = (k + 1 < count) ? x[(k + 1) * step] : left;
+            x[k * step] -= liftPredict(left, right);
+        }
+
+        // Update: even samples become approximation coefficients
+        for (int k = 0; k < count; k += 2) {
+            T left = (k > 0) ? x[(k - 1) * step] : x[step];
+            T right = (k + 1 < count) ? x[(k + 1) * step] : left;
+            x[k * step] += liftUpdate(left, right);
+        }
+    }
+}
+
+/**
+ * Inverse CDF 5/3 transform, in place (exact for integer inputs).
+ */
+template <typename T>
+void liftingInverse(T* x, int length, int levels) {
+    for (int level = levels - 1; level >= 0; level--) {
+        int step = 1 << level;
+        int count = (length + step - 1) / step;
+        if (count < 2) continue;
+
+        for (int k = 0; k < count; k += 2) {
+            T left = (k > 0) ? x[(k - 1) * step] : x[step];
+            T right = (k + 1 < count) ? x[(k + 1) * step] : left;
+            x[k * step] -= liftUpdate(left, right);
+        }
+
+        for (int k = 1; k < count; k += 2) {
+            T left = x[(k - 1) * step];
+            T right = (k + 1 < count) ? x[(k + 1) * step] : left;
+            x[k * step] += liftPredict(left, right);
+        }
+    }
+}
+
+
+// ============================================================================
+// Energy and Entropy Features
+// ============================================================================
+
+static inline float strideEnergy(const int32_t* x, int length, int start, int step) {
+    int64_t sum = 0;
+    for (int i = start; i < length; i += step) {
+        sum += (int64_t)x[i] * x[i];
+    }
+    return (float)sum;
+}
+
+static inline float strideEnergy(const float* x, int length, int start, int step) {
+    float sum = 0.0f;
+    for (int i = start; i < length; i += step) {
+        sum += x[i] * x[i];
+    }
+    return sum;
+}
+
+/**
+ * Give integer samples WAVELET_FRAC_BITS of fraction before decomposing, so
+ * the floor rounding of the lifting steps stays far below the pywt parity
+ * tolerance.
+ *
+ * @return Energy scale that undoes the prescaling
+ */
+static inline float waveletPrescale(int32_t* x, int length) {
+    for (int i = 0; i < length; i++) {
+        x[i] *= (1 << WAVELET_FRAC_BITS);
+    }
+    return 1.0f / (float)(1 << (2 * WAVELET_FRAC_BITS));
+}
+
+static inline float waveletPrescale(float* x, int length) {
+    (void)x;
+    (void)length;
+    return 1.0f;
+}
+
+/**
+ * Index into a length-n sequence under whole-sample symmetric extension.
+ */
+static inline int waveletMirror(int i, int n) {
+    int period = 2 * (n - 1);
+    i %= period;
+    if (i < 0) i += period;
+    return i < n ? i : period - i;
+}
+
+/**
+ * pywt.wavedec() energies, in place.
+ *
+ * Each level lifts the current approximation (liftingForward() with one
+ * level), sums the detail energy over pywt's (n + 5) / 2 coefficients,
+ * mirrored ends included, then compacts pywt's approximation
+ * (A[-2], A[0], A[2], ..., mirrored tail) into the front of the buffer.
+ * Levels stop early below 5 samples, where pywt's output would outgrow the
+ * buffer (their energies are 0); epochs never get there. Integer samples
+ * must stay below 2^(29 - WAVELET_FRAC_BITS) in magnitude.
+ *
+ * @param x Signal buffer (destroyed; ends with the final approximation)
+ * @param detailEnergy Output, one value per level (level 1 first)
+ * @param approxEnergy Output, energy of the final approximation
+ */
+template <typename T>
+void waveletDecompose(T* x, int length, int levels,
+                      float* detailEnergy, float* approxEnergy) {
+    float scale = waveletPrescale(x, length);
+    int n = length;
+    int level = 0;
+    for (; level < levels && n >= 5; level++) {
+        liftingForward(x, n, 1);
+        int count = (n + 5) / 2;
+
+        // Detail k sits at odd index 2k - 1 of the lifted level; k = 0 and
+        // k > n / 2 fall outside it and are mirrored
+        float detail = strideEnergy(x, n, 1, 2);
+        T d = x[waveletMirror(-1, n)];
+        detail += (float)d * (float)d;
+        for (int k = n / 2 + 1; k < count; k++) {
+            d = x[waveletMirror(2 * k - 1, n)];
+            detail += (float)d * (float)d;
+        }
+
+        // Approximation k sits at even index 2k - 2
+        T head = x[waveletMirror(-2, n)];
+        T tail = x[waveletMirror(2 * count - 4, n)];
+        for (int k = 1; k < count - 1; k++) {
+            x[k] = x[2 * k - 2];        // Reads stay ahead of the writes
+        }
+        x[0] = head;
+        x[count - 1] = tail;
+
+        // Relative to lifting: detail 2^(j-2), approximation 2^j in energy
+        detailEnergy[level] = scale * (float)(1 << (level + 1)) / 4.0f * detail;
+        n = count;
+    }
+    for (int j = level; j < levels; j++) {
+        detailEnergy[j] = 0.0f;
+    }
+    *approxEnergy = scale * (float)(1 << level) * strideEnergy(x, n, 0, 1);
+}
+
+/**
+ * Transform a buffer in place and compute its wavelet features.
+ *
+ * Output: relative energy of each detail level (fraction of total detail
+ * energy), then the normalized Shannon entropy of that distribution.
+ *
+ * @param x Signal buffer (destroyed)
+ * @param output Output array for N_WAVELET_CHANNEL_FEATURES features
+ */
+template <typename T>
+void computeWaveletFeatures(T* x, int length, float* output) {
+    float detail[WAVELET_LEVELS];
+    float approx;
+    waveletDecompose(x, length, WAVELET_LEVELS, detail, &approx);
+
+    float total = 0.0f;
+    for (int j = 0; j < WAVELET_LEVELS; j++) total += detail[j];
+
+    if (total <= 0.0f) {
+        for (int j = 0; j < N_WAVELET_CHANNEL_FEATURES; j++) output[j] = 0.0f;
+        return;
+    }
+
+    float entropy = 0.0f;
+    for (int j = 0; j < WAVELET_LEVELS; j++) {
+        float p = detail[j] / total;
+        output[j] = p;
+        if (p > 0.0f) entropy -= p * logf(p);
+    }
+    output[WAVELET_LEVELS] = entropy / logf((float)WAVELET_LEVELS);
+}
+
+#endif // LIFTING_WAVELET_H
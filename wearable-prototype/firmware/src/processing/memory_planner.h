@@ -0,0 +1,216 @@
+/**
+ * Memory Planner
+ * ==============
+ *
+ * Places buffers with known lifetimes in one arena, overlapping those that
+ * are never live at the same time. Buffers are placed largest first at the
+ * lowest offset that does not collide with a placed buffer of overlapping
+ * lifetime, as TFLM's GreedyMemoryPlanner does for tensors.
+ *
+ * Lifetimes are inclusive ranges of the epoch pipeline phases:
+ *
+ *   MEMORY_PHASE_SAMPLE    sensor samples are being buffered
+ *   MEMORY_PHASE_EXTRACT   feature extraction
+ *   MEMORY_PHASE_INFER     classify()
+ *
+ * Usage: request() every buffer, plan() once with an arena of at least
+ * getRequiredSize() bytes, then get() the pointers. Requests made after
+ * plan() fail.
+ */
+
+#ifndef MEMORY_PLANNER_H
+#define MEMORY_PLANNER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define PLANNER_MAX_BUFFERS     16
+#define PLANNER_ALIGNMENT       16
+
+#define MEMORY_PHASE_SAMPLE     0
+#define MEMORY_PHASE_EXTRACT    1
+#define MEMORY_PHASE_INFER      2
+#define N_MEMORY_PHASES         3
+
+const char* MEMORY_PHASE_NAMES[N_MEMORY_PHASES] = {
+    "sample", "extract", "infer"
+};
+
+
+// ============================================================================
+// Memory Planner Class
+// ============================================================================
+
+class MemoryPlanner {
+public:
+    MemoryPlanner() : _count(0), _arena(nullptr), _requiredSize(0), _planned(false) {}
+
+    /**
+     * Register a buffer.
+     *
+     * @param name Label for the report (not copied)
+     * @param firstPhase First MEMORY_PHASE_* the buffer is live in
+     * @param lastPhase Last MEMORY_PHASE_* the buffer is live in
+     * @return Buffer id for get(), or -1
+     */
+    int request(const char* name, size_t bytes, uint8_t firstPhase, uint8_t lastPhase) {
+        if (_planned || _count >= PLANNER_MAX_BUFFERS || bytes == 0 ||
+            firstPhase > lastPhase || lastPhase >= N_MEMORY_PHASES) {
+            return -1;
+        }
+        Buffer& buffer = _buffers[_count];
+        buffer.name = name;
+        buffer.size = align(bytes);
+        buffer.firstPhase = firstPhase;
+        buffer.lastPhase = lastPhase;
+        buffer.offset = 0;
+        _requiredSize = 0;
+        return _count++;
+    }
+
+    /**
+     * Arena bytes the plan needs.
+     */
+    size_t getRequiredSize() {
+        if (_requiredSize == 0) {
+            layout();
+        }
+        return _requiredSize;
+    }
+
+    /**
+     * Bytes the buffers would take as separate allocations.
+     */
+    size_t getSeparateSize() const {
+        size_t total = 0;
+        for (int i = 0; i < _count; i++) total += _buffers[i].size;
+        return total;
+    }
+
+    /**
+     * Assign the buffers to `arena` (PLANNER_ALIGNMENT aligned).
+     *
+     * @return false if the arena is too small or misaligned
+     */
+    bool plan(uint8_t* arena, size_t size) {
+        if (_planned || !arena || ((uintptr_t)arena % PLANNER_ALIGNMENT) != 0 ||
+            size < getRequiredSize()) {
+            return false;
+        }
+        _arena = arena;
+        _planned = true;
+        return true;
+    }
+
+    /**
+     * Plan into a heap arena of getRequiredSize() bytes (allocated once,
+     * never freed).
+     */
+    bool allocate() {
+        size_t size = getRequiredSize();
+        uint8_t* raw = (uint8_t*)malloc(size + PLANNER_ALIGNMENT - 1);
+        if (!raw) return false;
+        uintptr_t aligned = ((uintptr_t)raw + PLANNER_ALIGNMENT - 1) &
+                            ~(uintptr_t)(PLANNER_ALIGNMENT - 1);
+        return plan((uint8_t*)aligned, size);
+    }
+
+    bool isPlanned() const { return _planned; }
+
+    /**
+     * Pointer to a planned buffer (nullptr before plan()).
+     */
+    void* get(int id) const {
+        if (!_planned || id < 0 || id >= _count) return nullptr;
+        return _arena + _buffers[id].offset;
+    }
+
+    // ---- Report ----
+
+    int getBufferCount() const { return _count; }
+    const char* getName(int id) const { return _buffers[id].name; }
+    size_t getOffset(int id) const { return _buffers[id].offset; }
+    size_t getSize(int id) const { return _buffers[id].size; }
+    uint8_t getFirstPhase(int id) const { return _buffers[id].firstPhase; }
+    uint8_t getLastPhase(int id) const { return _buffers[id].lastPhase; }
+
+private:
+    struct Buffer {
+        const char* name;
+        size_t size;
+        size_t offset;
+        uint8_t firstPhase;
+        uint8_t lastPhase;
+    };
+
+    Buffer _buffers[PLANNER_MAX_BUFFERS];
+    int _count;
+    uint8_t* _arena;
+    size_t _requiredSize;
+    bool _planned;
+
+    static size_t align(size_t bytes) {
+        return (bytes + PLANNER_ALIGNMENT - 1) / PLANNER_ALIGNMENT * PLANNER_ALIGNMENT;
+    }
+
+    static bool liveTogether(const Buffer& a, const Buffer& b) {
+        return a.firstPhase <= b.lastPhase && b.firstPhase <= a.lastPhase;
+    }
+
+    /**
+     * Greedy placement, largest buffer first (ties in request order).
+     */
+    void layout() {
+        int order[PLANNER_MAX_BUFFERS];
+        for (int i = 0; i < _count; i++) {
+            int j = i;
+            while (j > 0 && _buffers[order[j - 1]].size < _buffers[i].size) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = i;
+        }
+
+        _requiredSize = 0;
+        for (int n = 0; n < _count; n++) {
+            Buffer& buffer = _buffers[order[n]];
+
+            // Candidates: the start, or the end of a placed buffer in use
+            // at the same time; take the lowest one that fits
+            size_t best = SIZE_MAX;
+            for (int c = -1; c < n; c++) {
+                size_t offset = 0;
+                if (c >= 0) {
+                    const Buffer& other = _buffers[order[c]];
+                    if (!liveTogether(buffer, other)) continue;
+                    offset = other.offset + other.size;
+                }
+                if (offset >= best || collides(buffer, offset, order, n)) continue;
+                best = offset;
+            }
+
+            buffer.offset = best;
+            if (best + buffer.size > _requiredSize) {
+                _requiredSize = best + buffer.size;
+            }
+        }
+    }
+
+    bool collides(const Buffer& buffer, size_t offset, const int* order, int placed) const {
+        for (int c = 0; c < placed; c++) {
+            const Buffer& other = _buffers[order[c]];
+            if (liveTogether(buffer, other) &&
+                offset < other.offset + other.size && other.offset < offset + buffer.size) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif // MEMORY_PLANNER_H
@@ -0,0 +1,466 @@
+/**
+ * A/B Model Store
+ * ===============
+ *
+ * Keeps the sleep model in two raw flash data partitions (MODEL_PARTITION_A
+ * and MODEL_PARTITION_B, see partitions.csv) and memory-maps the newest
+ * valid one through the flash MMU, so the model is used in place with no
+ * RAM copy. Updates are written to the other slot and only become visible
+ * once complete and verified, so a failed or interrupted update leaves the
+ * running model untouched.
+ *
+ * Slot layout:
+ *
+ *   0   ModelSlotHeader   written last, after the package is verified
+ *   32  package           ModelPackageHeader, .tflite bytes (padded to 4),
+ *                         optional scaler (float mean[n], float scale[n])
+ *
+ * The package is built on the host by model-training/scripts/package_model.py.
+ * A package without a scaler uses the compiled-in scaler_params.h.
+ *
+ * On the host (no ARDUINO) each partition is a file of MODEL_PARTITION_SIZE
+ * bytes mapped with mmap(), so the same loader runs in native tests.
+ *
+ * LittleFS files are not contiguous in flash and cannot be mapped, which is
+ * why models live in raw partitions rather than under a filename.
+ */
+
+#ifndef MODEL_STORE_H
+#define MODEL_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include "esp_partition.h"
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define MODEL_SLOT_MAGIC            0x4C444D53u     // "SMDL"
+#define MODEL_PACKAGE_MAGIC         0x4B504D53u     // "SMPK"
+#define MODEL_SLOT_HEADER_SIZE      32
+#define MODEL_SLOT_COUNT            2
+#define MODEL_FLASH_SECTOR          4096
+#define MODEL_SCALER_MAX_FEATURES   128             // As INPUT_QUANTIZER_MAX_FEATURES
+
+// Host stand-in file size; matches the partitions in partitions.csv
+#ifndef MODEL_PARTITION_SIZE
+#define MODEL_PARTITION_SIZE        0x20000
+#endif
+
+
+// ============================================================================
+// Data Structures
+// ============================================================================
+
+struct ModelSlotHeader {
+    uint32_t magic;             // MODEL_SLOT_MAGIC
+    uint32_t sequence;          // Newest valid slot wins
+    uint32_t length;            // Package bytes
+    uint32_t crc32;             // CRC-32 of the package
+    uint32_t reserved[4];
+};
+
+struct ModelPackageHeader {
+    uint32_t magic;             // MODEL_PACKAGE_MAGIC
+    uint32_t modelLength;       // .tflite bytes
+    uint32_t scalerCount;       // 0: use the compiled-in scaler
+    uint32_t reserved;
+};
+
+/**
+ * A validated model, pointing into the mapped slot.
+ */
+struct ModelImage {
+    const uint8_t* model;
+    size_t modelLength;
+    const float* mean;          // nullptr without a scaler
+    const float* scale;
+    int scalerCount;
+    uint32_t sequence;
+    int slot;
+};
+
+
+// ============================================================================
+// CRC-32 (IEEE 802.3, as zlib.crc32)
+// ============================================================================
+
+static inline uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length) {
+    static const uint32_t NIBBLE_TABLE[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+        0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ NIBBLE_TABLE[crc & 0x0F];
+        crc = (crc >> 4) ^ NIBBLE_TABLE[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+
+// ============================================================================
+// Partition Access (ESP-IDF, or a file-backed stand-in on the host)
+// ============================================================================
+
+class ModelPartition {
+public:
+    ModelPartition() : _size(0), _mapped(nullptr) {
+        #ifdef ARDUINO
+        _partition = nullptr;
+        _handle = 0;
+        #else
+        _fd = -1;
+        _mappedLength = 0;
+        #endif
+    }
+
+    ~ModelPartition() { close(); }
+
+    /**
+     * @param name Partition label (device) or file path (host)
+     */
+    bool open(const char* name) {
+        close();
+        #ifdef ARDUINO
+        _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                              ESP_PARTITION_SUBTYPE_ANY, name);
+        if (!_partition) return false;
+        _size = _partition->size;
+        #else
+        _fd = ::open(name, O_RDWR | O_CREAT, 0644);
+        if (_fd < 0) return false;
+        struct stat st;
+        if (fstat(_fd, &st) != 0) return false;
+        if ((size_t)st.st_size < MODEL_PARTITION_SIZE) {
+            // New "partition": erased flash reads as 0xFF
+            uint8_t erased[MODEL_FLASH_SECTOR];
+            memset(erased, 0xFF, sizeof(erased));
+            for (size_t off = 0; off < MODEL_PARTITION_SIZE; off += sizeof(erased)) {
+                if (pwrite(_fd, erased, sizeof(erased), (off_t)off) != (ssize_t)sizeof(erased)) {
+                    return false;
+                }
+            }
+        }
+        _size = MODEL_PARTITION_SIZE;
+        #endif
+        return true;
+    }
+
+    void close() {
+        unmap();
+        #ifdef ARDUINO
+        _partition = nullptr;
+        #else
+        if (_fd >= 0) ::close(_fd);
+        _fd = -1;
+        #endif
+        _size = 0;
+    }
+
+    size_t size() const { return _size; }
+
+    /**
+     * Map the first `length` bytes read-only. One mapping per partition;
+     * remapping replaces the previous one.
+     */
+    const uint8_t* map(size_t length) {
+        unmap();
+        if (length == 0 || length > _size) return nullptr;
+        #ifdef ARDUINO
+        const void* ptr = nullptr;
+        if (esp_partition_mmap(_partition, 0, length, ESP_PARTITION_MMAP_DATA,
+                               &ptr, &_handle) != ESP_OK) {
+            return nullptr;
+        }
+        _mapped = (const uint8_t*)ptr;
+        #else
+        void* ptr = mmap(nullptr, length, PROT_READ, MAP_SHARED, _fd, 0);
+        if (ptr == MAP_FAILED) return nullptr;
+        _mapped = (const uint8_t*)ptr;
+        _mappedLength = length;
+        #endif
+        return _mapped;
+    }
+
+    void unmap() {
+        if (!_mapped) return;
+        #ifdef ARDUINO
+        esp_partition_munmap(_handle);
+        #else
+        munmap((void*)_mapped, _mappedLength);
+        #endif
+        _mapped = nullptr;
+    }
+
+    bool isMapped() const { return _mapped != nullptr; }
+
+    bool read(size_t offset, void* dst, size_t length) const {
+        if (offset + length > _size) return false;
+        #ifdef ARDUINO
+        return esp_partition_read(_partition, offset, dst, length) == ESP_OK;
+        #else
+        return pread(_fd, dst, length, (off_t)offset) == (ssize_t)length;
+        #endif
+    }
+
+    /**
+     * Erase whole sectors covering [offset, offset + length).
+     */
+    bool erase(size_t offset, size_t length) {
+        size_t start = offset & ~(size_t)(MODEL_FLASH_SECTOR - 1);
+        size_t end = (offset + length + MODEL_FLASH_SECTOR - 1) & ~(size_t)(MODEL_FLASH_SECTOR - 1);
+        if (end > _size) return false;
+        #ifdef ARDUINO
+        return esp_partition_erase_range(_partition, start, end - start) == ESP_OK;
+        #else
+        uint8_t erased[MODEL_FLASH_SECTOR];
+        memset(erased, 0xFF, sizeof(erased));
+        for (size_t off = start; off < end; off += sizeof(erased)) {
+            if (pwrite(_fd, erased, sizeof(erased), (off_t)off) != (ssize_t)sizeof(erased)) {
+                return false;
+            }
+        }
+        return true;
+        #endif
+    }
+
+    /**
+     * Program bytes. Like NOR flash, programming can only clear bits, so
+     * the range must have been erased (rewriting identical data is fine).
+     */
+    bool write(size_t offset, const void* src, size_t length) {
+        if (offset + length > _size) return false;
+        #ifdef ARDUINO
+        return esp_partition_write(_partition, offset, src, length) == ESP_OK;
+        #else
+        uint8_t current[256];
+        const uint8_t* bytes = (const uint8_t*)src;
+        for (size_t done = 0; done < length; done += sizeof(current)) {
+            size_t n = length - done < sizeof(current) ? length - done : sizeof(current);
+            if (pread(_fd, current, n, (off_t)(offset + done)) != (ssize_t)n) return false;
+            for (size_t i = 0; i < n; i++) current[i] &= bytes[done + i];
+            if (pwrite(_fd, current, n, (off_t)(offset + done)) != (ssize_t)n) return false;
+        }
+        return true;
+        #endif
+    }
+
+private:
+    size_t _size;
+    const uint8_t* _mapped;
+    #ifdef ARDUINO
+    const esp_partition_t* _partition;
+    spi_flash_mmap_handle_t _handle;
+    #else
+    int _fd;
+    size_t _mappedLength;
+    #endif
+};
+
+
+// ============================================================================
+// Model Store Class
+// ============================================================================
+
+class ModelStore {
+public:
+    ModelStore() : _updateSlot(-1), _updateLength(0) {}
+
+    /**
+     * Open both slots.
+     *
+     * @param nameA, nameB Partition labels (device) or file paths (host)
+     */
+    bool begin(const char* nameA, const char* nameB) {
+        _updateSlot = -1;
+        return _slots[0].open(nameA) && _slots[1].open(nameB);
+    }
+
+    // ---- Reading ----
+
+    /**
+     * Slot holding the newest valid model, or -1 if neither is valid.
+     */
+    int newestSlot() {
+        int best = -1;
+        uint32_t bestSequence = 0;
+        for (int s = 0; s < MODEL_SLOT_COUNT; s++) {
+            ModelSlotHeader header;
+            if (!readHeader(s, &header)) continue;
+            if (best < 0 || (int32_t)(header.sequence - bestSequence) > 0) {
+                best = s;
+                bestSequence = header.sequence;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * Map a slot and validate its contents (CRC, package, TFLite identifier).
+     * The image stays valid until release(slot) or the next update of it.
+     */
+    bool map(int slot, ModelImage* image) {
+        if (slot < 0 || slot >= MODEL_SLOT_COUNT || slot == _updateSlot) return false;
+
+        ModelSlotHeader header;
+        if (!readHeader(slot, &header)) return false;
+
+        const uint8_t* base = _slots[slot].map(MODEL_SLOT_HEADER_SIZE + header.length);
+        if (!base) return false;
+        if (!parsePackage(base + MODEL_SLOT_HEADER_SIZE, header, image)) {
+            _slots[slot].unmap();
+            return false;
+        }
+        image->sequence = header.sequence;
+        image->slot = slot;
+        return true;
+    }
+
+    void release(int slot) {
+        if (slot >= 0 && slot < MODEL_SLOT_COUNT) _slots[slot].unmap();
+    }
+
+    // ---- Updating ----
+
+    /**
+     * Start writing a package into the slot not in use by `activeSlot`
+     * (pass -1 if nothing is mapped). Erases the slot, header included, so
+     * it stays invalid until finishUpdate().
+     *
+     * @return Slot being written, or -1
+     */
+    int beginUpdate(size_t packageLength, int activeSlot) {
+        _updateSlot = -1;
+        int slot = activeSlot == 0 ? 1 : 0;
+        if (packageLength < sizeof(ModelPackageHeader) ||
+            MODEL_SLOT_HEADER_SIZE + packageLength > _slots[slot].size()) {
+            return -1;
+        }
+        _slots[slot].unmap();
+        if (!_slots[slot].erase(0, MODEL_SLOT_HEADER_SIZE + packageLength)) return -1;
+
+        _updateSlot = slot;
+        _updateLength = packageLength;
+        return slot;
+    }
+
+    /**
+     * Write package bytes at `offset`. Chunks may arrive in any order and
+     * may be repeated (e.g. after a reconnect).
+     */
+    bool writeUpdate(size_t offset, const uint8_t* data, size_t length) {
+        if (_updateSlot < 0 || offset > _updateLength || length > _updateLength - offset) {
+            return false;
+        }
+        return _slots[_updateSlot].write(MODEL_SLOT_HEADER_SIZE + offset, data, length);
+    }
+
+    /**
+     * Verify the written package and commit it by writing the slot header.
+     *
+     * @param expectedCrc CRC-32 of the package as sent by the host
+     * @return Committed slot, or -1 (the slot stays invalid)
+     */
+    int finishUpdate(uint32_t expectedCrc) {
+        int slot = _updateSlot;
+        _updateSlot = -1;
+        if (slot < 0) return -1;
+
+        ModelSlotHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = MODEL_SLOT_MAGIC;
+        header.length = (uint32_t)_updateLength;
+        header.crc32 = expectedCrc;
+
+        const uint8_t* base = _slots[slot].map(MODEL_SLOT_HEADER_SIZE + _updateLength);
+        ModelImage image;
+        bool valid = base && parsePackage(base + MODEL_SLOT_HEADER_SIZE, header, &image);
+        _slots[slot].unmap();
+        if (!valid) return -1;
+
+        int other = 1 - slot;
+        ModelSlotHeader otherHeader;
+        header.sequence = readHeader(other, &otherHeader) ? otherHeader.sequence + 1 : 1;
+        return _slots[slot].write(0, &header, sizeof(header)) ? slot : -1;
+    }
+
+    /**
+     * Abandon an update; the slot stays invalid.
+     */
+    void abortUpdate() {
+        _updateSlot = -1;
+    }
+
+    bool isUpdating() const { return _updateSlot >= 0; }
+    size_t getUpdateLength() const { return _updateLength; }
+
+    /**
+     * Largest package a slot can hold.
+     */
+    size_t getCapacity() const {
+        size_t a = _slots[0].size();
+        size_t b = _slots[1].size();
+        size_t smallest = a < b ? a : b;
+        return smallest > MODEL_SLOT_HEADER_SIZE ? smallest - MODEL_SLOT_HEADER_SIZE : 0;
+    }
+
+private:
+    ModelPartition _slots[MODEL_SLOT_COUNT];
+    int _updateSlot;
+    size_t _updateLength;
+
+    bool readHeader(int slot, ModelSlotHeader* header) const {
+        if (slot == _updateSlot) return false;
+        if (!_slots[slot].read(0, header, sizeof(*header))) return false;
+        return header->magic == MODEL_SLOT_MAGIC &&
+               header->length >= sizeof(ModelPackageHeader) &&
+               MODEL_SLOT_HEADER_SIZE + header->length <= _slots[slot].size();
+    }
+
+    static bool parsePackage(const uint8_t* package, const ModelSlotHeader& header,
+                             ModelImage* image) {
+        if (crc32Update(0, package, header.length) != header.crc32) return false;
+
+        ModelPackageHeader pkg;
+        if (header.length < sizeof(pkg)) return false;
+        memcpy(&pkg, package, sizeof(pkg));
+
+        // Bound the header fields before any arithmetic on them: the CRC
+        // only proves the bytes arrived intact, and on the 32-bit target a
+        // hostile length or count would wrap the sums below
+        size_t modelStart = sizeof(pkg);
+        if (pkg.magic != MODEL_PACKAGE_MAGIC || pkg.modelLength < 8 ||
+            pkg.modelLength > header.length - modelStart ||
+            pkg.scalerCount > MODEL_SCALER_MAX_FEATURES) {
+            return false;
+        }
+        size_t modelPadded = ((size_t)pkg.modelLength + 3) & ~(size_t)3;
+        size_t scalerBytes = (size_t)pkg.scalerCount * 2 * sizeof(float);
+        if (modelStart + modelPadded + scalerBytes != header.length) return false;
+
+        const uint8_t* model = package + modelStart;
+        if (memcmp(model + 4, "TFL3", 4) != 0) return false;
+
+        image->model = model;
+        image->modelLength = pkg.modelLength;
+        image->scalerCount = (int)pkg.scalerCount;
+        image->mean = pkg.scalerCount ? (const float*)(model + modelPadded) : nullptr;
+        image->scale = pkg.scalerCount ? image->mean + pkg.scalerCount : nullptr;
+        return true;
+    }
+};
+
+#endif // MODEL_STORE_H
@@ -0,0 +1,386 @@
+/**
+ * PPG Pulse Morphology
+ * ====================
+ *
+ * Streaming beat segmenter over the IR channel. Each sample updates a small
+ * state machine (foot -> upstroke -> peak -> downslope -> next foot); when a
+ * beat closes, one compact PulseRecord is stored. Only a short look-back of
+ * the filtered signal is kept (to place the foot once an upstroke is
+ * confirmed), so memory is bounded by PULSE_MAX_BEATS records per epoch.
+ *
+ * Per-beat measurements:
+ *   - amplitude:   (peak - foot) / baseline, i.e. a perfusion index
+ *   - rise time:   foot to systolic peak
+ *   - width:       time above half amplitude (the rising half level uses the
+ *                  previous beat's amplitude, since the current one is only
+ *                  known at the peak)
+ *   - notch ratio: height of the dicrotic notch (or, if none, the flattest
+ *                  point of the downslope) relative to the pulse amplitude
+ */
+
+#ifndef PULSE_MORPHOLOGY_H
+#define PULSE_MORPHOLOGY_H
+
+#include <stdint.h>
+#include <math.h>
+#include "config.h"
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define PULSE_MAX_BPM           200
+#define PULSE_MIN_BPM           30
+#define PULSE_MAX_BEATS         ((EPOCH_DURATION_SEC * PULSE_MAX_BPM) / 60)   // 100
+#define PULSE_INVERT_IR         true    // Reflective PPG: more blood, less IR
+#define PULSE_HIGHPASS_HZ       0.1f
+#define PULSE_LOWPASS_HZ        8.0f
+#define PULSE_TRIGGER           0.5f    // Foot/peak confirmation, fraction of pulse amplitude
+#define PULSE_FOOT_LOOKBACK     32      // Samples searched back for the foot (320 ms)
+#define PULSE_ONSET_SLOPE       0.2f    // Upstroke onset, fraction of the steepest slope
+
+// Features: median amplitude, amplitude CV, mean rise time (ms),
+//           mean width (ms), mean notch ratio
+#define N_PULSE_FEATURES_BLOCK  5
+
+/**
+ * Compact per-beat record (12 bytes).
+ */
+struct PulseRecord {
+    float amplitude;        // (peak - foot) / baseline
+    uint16_t ibiMs;         // Foot-to-foot interval
+    uint16_t riseMs;        // Foot to systolic peak
+    uint16_t widthMs;       // Time above half amplitude
+    uint8_t notchRatio;     // Notch height / amplitude, scaled to 0-255
+    uint8_t flags;          // PULSE_FLAG_*
+};
+
+#define PULSE_FLAG_NOTCH        0x01    // True dicrotic notch (local minimum) found
+
+
+// ============================================================================
+// Pulse Morphology Class
+// ============================================================================
+
+class PulseMorphology {
+public:
+    PulseMorphology() { reset(); }
+
+    /**
+     * Reset filter and segmenter state and clear the epoch records.
+     */
+    void reset() {
+        float fs = (float)PPG_SAMPLE_RATE_HZ;
+        _hpAlpha = expf(-2.0f * (float)M_PI * PULSE_HIGHPASS_HZ / fs);
+        _lpAlpha = expf(-2.0f * (float)M_PI * PULSE_LOWPASS_HZ / fs);
+
+        _primed = false;
+        _baseline = 0.0f;
+        _hpPrevIn = 0.0f;
+        _hpPrevOut = 0.0f;
+        _lp = 0.0f;
+        _prevY = 0.0f;
+        _prevY2 = 0.0f;
+        _prevSlope = 0.0f;
+        _envelope = 0.0f;
+
+        _state = SEEK_FOOT;
+        _sample = 0;
+        _minVal = 0.0f;
+        for (int i = 0; i < PULSE_FOOT_LOOKBACK; i++) _history[i] = 0.0f;
+        _haveFoot = false;
+        _lastAmplitude = 0.0f;
+        _ampEstimate = 0.0f;
+
+        _count = 0;
+    }
+
+    /**
+     * Add one raw IR sample (at PPG_SAMPLE_RATE_HZ).
+     */
+    void addSample(uint32_t ir) {
+        float x = (float)ir;
+        if (!_primed) {
+            _baseline = x;
+            _hpPrevIn = x;
+            _primed = true;
+        }
+
+        _baseline += 0.005f * (x - _baseline);
+
+        float hp = _hpAlpha * (_hpPrevOut + x - _hpPrevIn);
+        _hpPrevIn = x;
+        _hpPrevOut = hp;
+        _lp += (1.0f - _lpAlpha) * (hp - _lp);
+
+        float y = PULSE_INVERT_IR ? -_lp : _lp;
+        float dy = y - _prevY;
+        _prevY = y;
+        _history[_sample % PULSE_FOOT_LOOKBACK] = y;
+
+        // Until the first beat closes, estimate the amplitude from |y|
+        _envelope += 0.01f * (fabsf(y) - _envelope);
+        float trigger = PULSE_TRIGGER * (_ampEstimate > 0.0f ? _ampEstimate : 2.0f * _envelope);
+
+        switch (_state) {
+            case SEEK_FOOT:
+                trackFoot(y, trigger);
+                break;
+
+            case UPSTROKE:
+                if (y > _peakVal) {
+                    _peakVal = y;
+                    _peakAt = _sample;
+                }
+                if (!_halfUpSeen && _lastAmplitude > 0.0f &&
+                    y >= _footVal + 0.5f * _lastAmplitude) {
+                    _halfUpSeen = true;
+                    _halfUpAt = _sample;
+                }
+                if (y < _peakVal - trigger) {
+                    // Peak confirmed; start on the downslope
+                    _state = DOWNSLOPE;
+                    _halfDownAt = -1;
+                    _notchFound = false;
+                    _notchVal = y;
+                    _flattestSlope = -1e30f;
+                    _flattestVal = y;
+                    _minVal = y;
+                }
+                break;
+
+            case DOWNSLOPE: {
+                float amp = _peakVal - _footVal;
+                if (_halfDownAt < 0 && y < _footVal + 0.5f * amp) {
+                    _halfDownAt = _sample;
+                }
+                if (!_notchFound && y > _footVal + 0.2f * amp) {
+                    if (dy >= 0.0f && _prevSlope < 0.0f) {
+                        _notchFound = true;
+                        _notchVal = _prevY2;
+                    } else if (dy > _flattestSlope) {
+                        _flattestSlope = dy;
+                        _flattestVal = y;
+                    }
+                }
+                trackFoot(y, trigger);
+                break;
+            }
+        }
+
+        _prevSlope = dy;
+        _prevY2 = y;
+        _sample++;
+    }
+
+    /**
+     * Write the epoch summary and clear the records.
+     *
+     * @param output Output array for N_PULSE_FEATURES_BLOCK features
+     */
+    void finishEpoch(float* output) {
+        if (_count == 0) {
+            for (int i = 0; i < N_PULSE_FEATURES_BLOCK; i++) output[i] = 0.0f;
+            return;
+        }
+
+        // Median amplitude (insertion sort; at most PULSE_MAX_BEATS values)
+        float amps[PULSE_MAX_BEATS];
+        float sum = 0.0f;
+        float riseSum = 0.0f;
+        float widthSum = 0.0f;
+        float notchSum = 0.0f;
+        for (int i = 0; i < _count; i++) {
+            float a = _records[i].amplitude;
+            int j = i - 1;
+            while (j >= 0 && amps[j] > a) {
+                amps[j + 1] = amps[j];
+                j--;
+            }
+            amps[j + 1] = a;
+
+            sum += a;
+            riseSum += _records[i].riseMs;
+            widthSum += _records[i].widthMs;
+            notchSum += _records[i].notchRatio / 255.0f;
+        }
+
+        float mean = sum / _count;
+        float sumSq = 0.0f;
+        for (int i = 0; i < _count; i++) {
+            float diff = _records[i].amplitude - mean;
+            sumSq += diff * diff;
+        }
+
+        output[0] = amps[_count / 2];
+        output[1] = mean > 0.0f ? sqrtf(sumSq / _count) / mean : 0.0f;
+        output[2] = riseSum / _count;
+        output[3] = widthSum / _count;
+        output[4] = notchSum / _count;
+
+        _count = 0;
+    }
+
+    /**
+     * Clear the records without computing the summary.
+     */
+    void discardEpoch() {
+        _count = 0;
+    }
+
+    int getBeatCount() const {
+        return _count;
+    }
+
+    const PulseRecord* getRecords() const {
+        return _records;
+    }
+
+private:
+    enum State : uint8_t {
+        SEEK_FOOT,
+        UPSTROKE,
+        DOWNSLOPE
+    };
+
+    // Filters
+    float _hpAlpha;
+    float _lpAlpha;
+    bool _primed;
+    float _baseline;
+    float _hpPrevIn;
+    float _hpPrevOut;
+    float _lp;
+    float _prevY;
+    float _prevY2;
+    float _prevSlope;
+    float _envelope;
+
+    // Segmenter
+    State _state;
+    int32_t _sample;
+    float _minVal;
+    float _history[PULSE_FOOT_LOOKBACK];
+    bool _haveFoot;
+    float _footVal;
+    int32_t _footAt;
+    float _footBaseline;
+    float _peakVal;
+    int32_t _peakAt;
+    bool _halfUpSeen;
+    int32_t _halfUpAt;
+    int32_t _halfDownAt;
+    bool _notchFound;
+    float _notchVal;
+    float _flattestSlope;
+    float _flattestVal;
+    float _lastAmplitude;
+    float _ampEstimate;
+
+    // Epoch records
+    PulseRecord _records[PULSE_MAX_BEATS];
+    int _count;
+
+    static uint16_t samplesToMs(int32_t samples) {
+        int32_t ms = samples * 1000 / PPG_SAMPLE_RATE_HZ;
+        return (uint16_t)(ms > 65535 ? 65535 : ms);
+    }
+
+    /**
+     * Walk back down the upstroke to its onset (the foot): the first sample
+     * where the slope falls below a fraction of the steepest upstroke slope,
+     * so a slowly drifting diastolic tail is not counted as part of the rise.
+     */
+    void upstrokeOnset(float* value, int32_t* at) const {
+        int32_t oldest = _sample - PULSE_FOOT_LOOKBACK + 1;
+        if (oldest < 0) oldest = 0;
+
+        float maxSlope = 0.0f;
+        for (int32_t t = _sample; t > oldest; t--) {
+            float slope = _history[t % PULSE_FOOT_LOOKBACK] - _history[(t - 1) % PULSE_FOOT_LOOKBACK];
+            if (slope > maxSlope) maxSlope = slope;
+        }
+
+        int32_t t = _sample;
+        while (t > oldest &&
+               _history[t % PULSE_FOOT_LOOKBACK] - _history[(t - 1) % PULSE_FOOT_LOOKBACK] >
+               PULSE_ONSET_SLOPE * maxSlope) {
+            t--;
+        }
+        *at = t;
+        *value = _history[t % PULSE_FOOT_LOOKBACK];
+    }
+
+    /**
+     * Follow the running minimum; a rise of `trigger` above it confirms an
+     * upstroke, and the foot is then placed at the start of that upstroke
+     * (the high-pass can leave the post-systolic trough below the true foot).
+     */
+    void trackFoot(float y, float trigger) {
+        if (y < _minVal) _minVal = y;
+
+        int32_t minInterval = PPG_SAMPLE_RATE_HZ * 60 / PULSE_MAX_BPM;
+        int32_t maxInterval = PPG_SAMPLE_RATE_HZ * 60 / PULSE_MIN_BPM;
+
+        if (_haveFoot && _sample - _footAt > maxInterval) {
+            // Lost the pulse: relax the amplitude estimate so smaller beats register
+            _ampEstimate *= 0.5f;
+            _haveFoot = false;
+        }
+
+        if (trigger <= 0.0f || y <= _minVal + trigger) return;
+
+        float footVal;
+        int32_t footAt;
+        upstrokeOnset(&footVal, &footAt);
+
+        int32_t interval = _haveFoot ? footAt - _footAt : 0;
+        if (_haveFoot && interval < minInterval) {
+            // Too soon for a new beat: restart the minimum search from here
+            _minVal = y;
+            return;
+        }
+
+        if (_haveFoot && _state == DOWNSLOPE && interval <= maxInterval) {
+            closeBeat(interval, footAt);
+        }
+
+        // New beat starts at this foot
+        _haveFoot = true;
+        _footVal = footVal;
+        _footAt = footAt;
+        _footBaseline = _baseline;
+        _peakVal = y;
+        _peakAt = _sample;
+        _halfUpSeen = false;
+        _state = UPSTROKE;
+    }
+
+    /**
+     * Store the beat that started at _footAt and ends at nextFootAt.
+     */
+    void closeBeat(int32_t interval, int32_t nextFootAt) {
+        float amp = _peakVal - _footVal;
+        if (amp <= 0.0f) return;
+        _lastAmplitude = amp;
+        _ampEstimate = _ampEstimate > 0.0f ? _ampEstimate + 0.3f * (amp - _ampEstimate) : amp;
+        if (_count >= PULSE_MAX_BEATS) return;
+
+        PulseRecord& r = _records[_count++];
+        r.amplitude = _footBaseline > 0.0f ? amp / _footBaseline : 0.0f;
+        r.ibiMs = samplesToMs(interval);
+        r.riseMs = samplesToMs(_peakAt - _footAt);
+        int32_t widthStart = _halfUpSeen ? _halfUpAt : _footAt;
+        int32_t widthEnd = _halfDownAt >= 0 ? _halfDownAt : nextFootAt;
+        r.widthMs = samplesToMs(widthEnd > widthStart ? widthEnd - widthStart : 0);
+
+        float notch = _notchFound ? _notchVal : _flattestVal;
+        float ratio = (notch - _footVal) / amp;
+        if (ratio < 0.0f) ratio = 0.0f;
+        if (ratio > 1.0f) ratio = 1.0f;
+        r.notchRatio = (uint8_t)(ratio * 255.0f + 0.5f);
+        r.flags = _notchFound ? PULSE_FLAG_NOTCH : 0;
+    }
+};
+
+#endif // PULSE_MORPHOLOGY_H
@@ -0,0 +1,243 @@
+/**
+ * Persistent Recurrent State
+ * ==========================
+ *
+ * Keeps a sequence model's hidden state across deep sleep and reboots so
+ * the night does not restart from a zero state:
+ *
+ *   RTC slow memory   written every epoch (plain RAM, no wear); survives
+ *                     deep sleep and software resets
+ *   NVS (Preferences) written every `persistEvery` epochs; survives
+ *                     power loss
+ *
+ * restore() takes the RTC copy when it is valid, else the NVS copy. A
+ * record is only accepted for the model it was written by (model id)
+ * and with a matching CRC, since RTC memory holds garbage after power-on.
+ *
+ * Each record also carries the clock at the save (seconds, time() on the
+ * device, which keeps counting through deep sleep and resets). A record
+ * older than `maxGapSec` belongs to an earlier night and is dropped. So
+ * is one from "the future": after a power-on the clock restarts at zero,
+ * which leaves the record's age unknown.
+ *
+ * On the host (no ARDUINO) the RTC copy is a static record and NVS is a
+ * file, so the same logic runs in native tests.
+ */
+
+#ifndef RECURRENT_STATE_H
+#define RECURRENT_STATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "gru_step.h"
+#include "model_store.h"
+
+#ifdef ARDUINO
+#include <Preferences.h>
+#include "esp_attr.h"
+#endif
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define RECURRENT_STATE_MAGIC   0x54534552u     // "REST"
+#define RECURRENT_STATE_MAX     GRU_MAX_UNITS
+
+
+// ============================================================================
+// State Record
+// ============================================================================
+
+struct RecurrentStateRecord {
+    uint32_t magic;             // RECURRENT_STATE_MAGIC
+    uint32_t modelId;           // CRC-32 of the model the state belongs to
+    uint32_t epochs;            // Steps since the state was last reset
+    uint32_t savedAtSec;        // Clock at the save
+    uint32_t units;
+    float state[RECURRENT_STATE_MAX];
+    uint32_t crc32;             // Over all fields above
+};
+
+
+// ============================================================================
+// State Store Class
+// ============================================================================
+
+class RecurrentStateStore {
+public:
+    RecurrentStateStore() : _persistEvery(0), _maxGapSec(0) {
+        _name[0] = '\0';
+    }
+
+    /**
+     * @param name NVS namespace (device) or file path (host)
+     * @param persistEvery Epochs between NVS writes (0: RTC only)
+     * @param maxGapSec Oldest record restore() resumes from (0: any age)
+     */
+    bool begin(const char* name, uint32_t persistEvery, uint32_t maxGapSec) {
+        if (!name || strlen(name) >= sizeof(_name)) {
+            return false;
+        }
+        strcpy(_name, name);
+        _persistEvery = persistEvery;
+        _maxGapSec = maxGapSec;
+        return true;
+    }
+
+    /**
+     * Record the state after a step (call every epoch). A non-finite state
+     * is not recorded; the last good one stays.
+     *
+     * @param nowSec Clock, seconds
+     */
+    void save(const float* state, int units, uint32_t modelId, uint32_t epochs,
+              uint32_t nowSec) {
+        if (units <= 0 || units > RECURRENT_STATE_MAX) return;
+        for (int i = 0; i < units; i++) {
+            if (!isfinite(state[i])) return;
+        }
+
+        RecurrentStateRecord& record = retained();
+        record.magic = RECURRENT_STATE_MAGIC;
+        record.modelId = modelId;
+        record.epochs = epochs;
+        record.savedAtSec = nowSec;
+        record.units = (uint32_t)units;
+        memcpy(record.state, state, units * sizeof(float));
+        memset(record.state + units, 0, (RECURRENT_STATE_MAX - units) * sizeof(float));
+        record.crc32 = recordCrc(record);
+
+        if (_persistEvery > 0 && epochs % _persistEvery == 0) {
+            persist();
+        }
+    }
+
+    /**
+     * Write the retained record to NVS now (e.g. before powering down).
+     */
+    bool persist() {
+        const RecurrentStateRecord& record = retained();
+        if (!isValid(record)) return false;
+        return writeNvs(record);
+    }
+
+    /**
+     * Load the newest valid state for this model, unless it is more than
+     * maxGapSec old (then both copies are cleared: a new night).
+     *
+     * @param nowSec Clock, seconds
+     * @param epochs Steps the state has seen (may be nullptr)
+     * @return false if there is none; `state` is left untouched
+     */
+    bool restore(float* state, int units, uint32_t modelId, uint32_t nowSec,
+                 uint32_t* epochs) {
+        RecurrentStateRecord stored;
+        const RecurrentStateRecord* record = nullptr;
+        if (matches(retained(), units, modelId)) {
+            record = &retained();
+        } else if (readNvs(stored) && matches(stored, units, modelId)) {
+            record = &stored;
+            retained() = stored;
+        }
+        if (!record) return false;
+        if (isStale(*record, nowSec)) {
+            clear();
+            return false;
+        }
+
+        memcpy(state, record->state, units * sizeof(float));
+        if (epochs) *epochs = record->epochs;
+        return true;
+    }
+
+    /**
+     * Forget the stored state (new night).
+     */
+    void clear() {
+        memset(&retained(), 0, sizeof(RecurrentStateRecord));
+        RecurrentStateRecord empty;
+        memset(&empty, 0, sizeof(empty));
+        writeNvs(empty);
+    }
+
+    /**
+     * Host only: lose the RTC copy, as a power-on does.
+     */
+    static void clearRetained() {
+        memset(&retained(), 0, sizeof(RecurrentStateRecord));
+    }
+
+private:
+    char _name[64];
+    uint32_t _persistEvery;
+    uint32_t _maxGapSec;
+
+    static RecurrentStateRecord& retained() {
+        #ifdef ARDUINO
+        RTC_NOINIT_ATTR static RecurrentStateRecord record;
+        #else
+        static RecurrentStateRecord record;
+        #endif
+        return record;
+    }
+
+    static uint32_t recordCrc(const RecurrentStateRecord& record) {
+        return crc32Update(0, (const uint8_t*)&record, offsetof(RecurrentStateRecord, crc32));
+    }
+
+    static bool isValid(const RecurrentStateRecord& record) {
+        return record.magic == RECURRENT_STATE_MAGIC &&
+               record.units > 0 && record.units <= RECURRENT_STATE_MAX &&
+               record.crc32 == recordCrc(record);
+    }
+
+    static bool matches(const RecurrentStateRecord& record, int units, uint32_t modelId) {
+        return isValid(record) && record.units == (uint32_t)units && record.modelId == modelId;
+    }
+
+    bool isStale(const RecurrentStateRecord& record, uint32_t nowSec) const {
+        if (_maxGapSec == 0) return false;
+        return nowSec < record.savedAtSec || nowSec - record.savedAtSec > _maxGapSec;
+    }
+
+    bool writeNvs(const RecurrentStateRecord& record) {
+        if (_name[0] == '\0') return false;
+        #ifdef ARDUINO
+        Preferences prefs;
+        if (!prefs.begin(_name, false)) return false;
+        size_t written = prefs.putBytes("state", &record, sizeof(record));
+        prefs.end();
+        return written == sizeof(record);
+        #else
+        FILE* f = fopen(_name, "wb");
+        if (!f) return false;
+        size_t written = fwrite(&record, 1, sizeof(record), f);
+        fclose(f);
+        return written == sizeof(record);
+        #endif
+    }
+
+    bool readNvs(RecurrentStateRecord& record) {
+        if (_name[0] == '\0') return false;
+        #ifdef ARDUINO
+        Preferences prefs;
+        if (!prefs.begin(_name, true)) return false;
+        size_t read = prefs.getBytes("state", &record, sizeof(record));
+        prefs.end();
+        return read == sizeof(record);
+        #else
+        FILE* f = fopen(_name, "rb");
+        if (!f) return false;
+        size_t read = fread(&record, 1, sizeof(record), f);
+        fclose(f);
+        return read == sizeof(record);
+        #endif
+    }
+};
+
+#endif // RECURRENT_STATE_H
@@ -0,0 +1,250 @@
+/**
+ * Respiratory Rate Estimator
+ * ==========================
+ *
+ * Streaming estimate of breathing rate from the respiratory-induced
+ * intensity variation (RIIV) riding on the IR PPG baseline.
+ *
+ * Pipeline (per IR sample, O(1)):
+ *   1. Boxcar decimation to RESP_DECIMATED_HZ (100 Hz -> 10 Hz)
+ *   2. 2nd-order Butterworth high-pass at RESP_HIGHPASS_HZ (DC / drift)
+ *   3. 4th-order Butterworth low-pass at RESP_LOWPASS_HZ, two biquads
+ *      (the cardiac pulse is 2-5x the breathing swing on the IR baseline,
+ *      so it needs ~24 dB/octave to stay under the trigger hysteresis)
+ *   4. Schmitt-trigger breath detection with a threshold that tracks the
+ *      running RMS of the respiratory band
+ *
+ * Filter state persists across epochs; only the per-epoch breath statistics
+ * are reset by finishEpoch().
+ */
+
+#ifndef RESP_ESTIMATOR_H
+#define RESP_ESTIMATOR_H
+
+#include <stdint.h>
+#include <math.h>
+#include "config.h"
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define RESP_DECIMATION         10      // 100 Hz PPG -> 10 Hz respiratory band
+#define RESP_DECIMATED_HZ       ((float)PPG_SAMPLE_RATE_HZ / RESP_DECIMATION)
+#define RESP_HIGHPASS_HZ        0.1f    // ~6 breaths/min
+#define RESP_LOWPASS_HZ         0.4f    // ~24 breaths/min (30 still passes at -7 dB)
+#define RESP_HYSTERESIS         0.3f    // Trigger level as a fraction of band RMS
+#define RESP_MIN_INTERVAL_SEC   2.0f    // 30 breaths/min
+#define RESP_MAX_INTERVAL_SEC   15.0f   // 4 breaths/min
+
+// Features: rate mean (bpm), rate std (bpm), modulation depth (band RMS / DC)
+#define N_RESP_FEATURES_BLOCK   3
+
+
+// ============================================================================
+// Respiratory Estimator Class
+// ============================================================================
+
+class RespiratoryEstimator {
+public:
+    RespiratoryEstimator() { reset(); }
+
+    /**
+     * Reset filter state and epoch statistics.
+     */
+    void reset() {
+        float fs = RESP_DECIMATED_HZ;
+        _highpass.design(RESP_HIGHPASS_HZ / fs, 0.70711f, true);
+        _lowpass[0].design(RESP_LOWPASS_HZ / fs, 0.54120f, false);
+        _lowpass[1].design(RESP_LOWPASS_HZ / fs, 1.30656f, false);
+
+        _decimSum = 0.0f;
+        _decimCount = 0;
+        _primed = false;
+        _dc = 0.0f;
+        _envelope = 0.0f;
+        _above = false;
+        _sampleCount = 0;
+        _lastOnset = -1;
+
+        resetEpoch();
+    }
+
+    /**
+     * Add one raw IR sample (at PPG_SAMPLE_RATE_HZ).
+     */
+    void addSample(uint32_t ir) {
+        _decimSum += (float)ir;
+        if (++_decimCount < RESP_DECIMATION) return;
+
+        float x = _decimSum / RESP_DECIMATION;
+        _decimSum = 0.0f;
+        _decimCount = 0;
+        processDecimated(x);
+    }
+
+    /**
+     * Write the epoch features and start a new epoch.
+     *
+     * @param output Output array for N_RESP_FEATURES_BLOCK features
+     */
+    void finishEpoch(float* output) {
+        if (_breaths > 0) {
+            float mean = _rateSum / _breaths;
+            float var = _rateSumSq / _breaths - mean * mean;
+            output[0] = mean;
+            output[1] = var > 0.0f ? sqrtf(var) : 0.0f;
+        } else {
+            output[0] = 0.0f;
+            output[1] = 0.0f;
+        }
+
+        if (_bandCount > 0 && _dcSum > 0.0f) {
+            float rms = sqrtf(_bandSumSq / _bandCount);
+            output[2] = rms / (_dcSum / _bandCount);
+        } else {
+            output[2] = 0.0f;
+        }
+
+        resetEpoch();
+    }
+
+    /**
+     * Start a new epoch without computing its features.
+     */
+    void discardEpoch() {
+        resetEpoch();
+    }
+
+    /**
+     * Number of breaths detected so far in the current epoch.
+     */
+    int getBreathCount() const {
+        return _breaths;
+    }
+
+private:
+    /**
+     * Butterworth biquad section (bilinear transform, transposed direct
+     * form II).
+     */
+    struct Biquad {
+        float b0, b1, b2, a1, a2;
+        float s1, s2;
+
+        /**
+         * @param fc Cutoff as a fraction of the sample rate
+         * @param q Section Q (0.7071 for 2nd order; 0.5412, 1.3066 for 4th)
+         */
+        void design(float fc, float q, bool highpass) {
+            float k = tanf((float)M_PI * fc);
+            float norm = 1.0f / (1.0f + k / q + k * k);
+            b0 = highpass ? norm : k * k * norm;
+            b1 = highpass ? -2.0f * b0 : 2.0f * b0;
+            b2 = b0;
+            a1 = 2.0f * (k * k - 1.0f) * norm;
+            a2 = (1.0f - k / q + k * k) * norm;
+            s1 = 0.0f;
+            s2 = 0.0f;
+        }
+
+        /**
+         * Start in the steady state of a high-pass fed a constant `x`.
+         */
+        void settleHighpass(float x) {
+            s1 = (b1 + b2) * x;
+            s2 = b2 * x;
+        }
+
+        float process(float x) {
+            float y = b0 * x + s1;
+            s1 = b1 * x - a1 * y + s2;
+            s2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    Biquad _highpass;
+    Biquad _lowpass[2];
+
+    // Decimator
+    float _decimSum;
+    int _decimCount;
+
+    // Filter state
+    bool _primed;
+    float _dc;
+
+    // Breath detector state
+    float _envelope;
+    bool _above;
+    int32_t _sampleCount;
+    int32_t _lastOnset;
+
+    // Per-epoch statistics
+    int _breaths;
+    float _rateSum;
+    float _rateSumSq;
+    int _bandCount;
+    float _bandSumSq;
+    float _dcSum;
+
+    void resetEpoch() {
+        _breaths = 0;
+        _rateSum = 0.0f;
+        _rateSumSq = 0.0f;
+        _bandCount = 0;
+        _bandSumSq = 0.0f;
+        _dcSum = 0.0f;
+    }
+
+    /**
+     * Band-pass and breath detection on one decimated sample.
+     */
+    void processDecimated(float x) {
+        if (!_primed) {
+            // Start the filters at the current level to avoid a long transient
+            _dc = x;
+            _highpass.settleHighpass(x);
+            _primed = true;
+        }
+
+        // Slow DC tracker for modulation depth
+        _dc += 0.01f * (x - _dc);
+
+        // Band-pass: high-pass, then the two low-pass sections
+        float band = _highpass.process(x);
+        band = _lowpass[0].process(band);
+        band = _lowpass[1].process(band);
+
+        // Running RMS envelope (~10 s time constant)
+        _envelope += 0.01f * (band * band - _envelope);
+        float threshold = RESP_HYSTERESIS * sqrtf(_envelope);
+
+        _bandSumSq += band * band;
+        _dcSum += _dc;
+        _bandCount++;
+
+        // Schmitt trigger: a breath onset is a rising crossing of +threshold
+        // after the band has been below -threshold
+        if (!_above && band > threshold) {
+            _above = true;
+            if (_lastOnset >= 0) {
+                float interval = (_sampleCount - _lastOnset) / RESP_DECIMATED_HZ;
+                if (interval >= RESP_MIN_INTERVAL_SEC && interval <= RESP_MAX_INTERVAL_SEC) {
+                    float rate = 60.0f / interval;
+                    _rateSum += rate;
+                    _rateSumSq += rate * rate;
+                    _breaths++;
+                }
+            }
+            _lastOnset = _sampleCount;
+        } else if (_above && band < -threshold) {
+            _above = false;
+        }
+
+        _sampleCount++;
+    }
+};
+
+#endif // RESP_ESTIMATOR_H
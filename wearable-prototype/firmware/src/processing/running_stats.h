@@ -0,0 +1,134 @@
+/**
+ * Running Epoch Statistics
+ * ========================
+ *
+ * computeStatFeatures() for a partly filled epoch, updated per sample in
+ * O(1) and read at any time without touching the sample buffer. Used for
+ * provisional stages before the epoch is complete.
+ *
+ * Exact for the samples so far: mean, std, min, max, range, skewness,
+ * kurtosis and rms (power sums of x - first sample, to limit float
+ * cancellation). Estimated:
+ *
+ *   median, IQR      from the moments, as for a normal distribution
+ *                    (median = mean, IQR = 1.349 std)
+ *   zero crossings   counted against the running mean, from the second
+ *                    sample on (the first is the mean itself)
+ *
+ * The length-dependent sums (energy, zero crossings) are scaled to a full
+ * epoch, so the output is in the units of the final features.
+ */
+
+#ifndef RUNNING_STATS_H
+#define RUNNING_STATS_H
+
+#include <math.h>
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+// Same layout as computeStatFeatures(const float*, ...)
+#define N_RUNNING_STAT_FEATURES     12
+
+#define RUNNING_IQR_PER_STD         1.349f  // Normal distribution
+
+
+// ============================================================================
+// Running Stats Class
+// ============================================================================
+
+class RunningStats {
+public:
+    RunningStats() {
+        reset();
+    }
+
+    void reset() {
+        _count = 0;
+        _crossings = 0;
+        _above = false;
+        _primed = false;
+        _shift = _sum = _sumSq = _sumCube = _sumQuad = _energy = 0.0f;
+        _minVal = _maxVal = 0.0f;
+    }
+
+    void add(float x) {
+        if (_count == 0) {
+            _shift = x;
+            _minVal = _maxVal = x;
+        } else {
+            bool above = x > _shift + _sum / _count;
+            if (_primed && above != _above) _crossings++;
+            _above = above;
+            _primed = true;
+            if (x < _minVal) _minVal = x;
+            if (x > _maxVal) _maxVal = x;
+        }
+        float d = x - _shift;
+        float d2 = d * d;
+        _sum += d;
+        _sumSq += d2;
+        _sumCube += d2 * d;
+        _sumQuad += d2 * d2;
+        _energy += x * x;
+        _count++;
+    }
+
+    /**
+     * The 12 statistics, as computeStatFeatures() would give for an epoch
+     * of `epochLength` samples like the ones so far.
+     */
+    void snapshot(float* output, int epochLength) const {
+        if (_count == 0) {
+            for (int i = 0; i < N_RUNNING_STAT_FEATURES; i++) output[i] = 0.0f;
+            return;
+        }
+
+        // Central moments from the raw power sums of d = x - shift
+        float m1 = _sum / _count;
+        float s2 = _sumSq / _count;
+        float s3 = _sumCube / _count;
+        float s4 = _sumQuad / _count;
+        float m2 = s2 - m1 * m1;
+        float m3 = s3 - 3.0f * m1 * s2 + 2.0f * m1 * m1 * m1;
+        float m4 = s4 - 4.0f * m1 * s3 + 6.0f * m1 * m1 * s2 - 3.0f * m1 * m1 * m1 * m1;
+        float std = m2 > 0.0f ? sqrtf(m2) : 0.0f;
+
+        output[0] = _shift + m1;
+        output[1] = std;
+        output[2] = _minVal;
+        output[3] = _maxVal;
+        output[4] = _maxVal - _minVal;
+        output[5] = output[0];
+        output[6] = RUNNING_IQR_PER_STD * std;
+        if (std > 0.0001f) {
+            output[7] = m3 / (m2 * std);
+            output[8] = m4 / (m2 * m2) - 3.0f;
+        } else {
+            output[7] = 0.0f;
+            output[8] = 0.0f;
+        }
+        output[9] = _energy * epochLength / _count;
+        output[10] = sqrtf(_energy / _count);
+        output[11] = _count > 2 ? (float)_crossings * (epochLength - 1) / (_count - 2) : 0.0f;
+    }
+
+    int getCount() const { return _count; }
+
+private:
+    float _shift;           // First sample
+    float _sum;             // Power sums of x - _shift
+    float _sumSq;
+    float _sumCube;
+    float _sumQuad;
+    float _energy;          // Sum of x^2
+    float _minVal;
+    float _maxVal;
+    int _crossings;
+    int _count;
+    bool _above;            // Last sample above the running mean
+    bool _primed;           // _above holds a compared sample
+};
+
+#endif // RUNNING_STATS_H
@@ -0,0 +1,280 @@
+/**
+ * Shadow Model Monitor
+ * ====================
+ *
+ * Bookkeeping for a candidate ("shadow") model run next to the active one
+ * on the same epochs. Shadow results never reach the wearer: each compared
+ * epoch becomes a 2-byte record (both stages, confidence delta) in a ring
+ * of SHADOW_LOG_EPOCHS, plus an active x shadow stage count matrix.
+ *
+ * The shadow also has a cost budget. shouldRun() says no while
+ *
+ *   the battery is below the minimum (with SHADOW_BATTERY_HYSTERESIS_V to
+ *   come back on), or
+ *   the shadow's mean cost per epoch (moving average) is over budget: it
+ *   then sits out SHADOW_BACKOFF_EPOCHS and is tried again, so an over-
+ *   budget model runs at most one epoch in SHADOW_BACKOFF_EPOCHS + 1
+ *
+ * and counts the skipped epochs per reason.
+ *
+ * Binary record (serialize(), little-endian, at most SHADOW_RECORD_MAX
+ * bytes so it fits one BLE attribute):
+ *
+ *   [0]      version (SHADOW_RECORD_VERSION)
+ *   [1]      classes k
+ *   [2]      flags: bit 0 battery low, bit 1 over budget (backing off)
+ *   [3]      records in the tail, n
+ *   [4..7]   epochs compared
+ *   [8..11]  epochs skipped for the battery
+ *   [12..15] epochs skipped for the CPU budget
+ *   [16..19] mean shadow cost (us)
+ *   k x k:   u16 counts, row = active stage, column = shadow stage
+ *   n x 2:   the latest records, oldest first
+ */
+
+#ifndef SHADOW_MONITOR_H
+#define SHADOW_MONITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#ifndef SHADOW_LOG_EPOCHS
+#define SHADOW_LOG_EPOCHS           960     // 8 hours at 30 s epochs
+#endif
+#define SHADOW_MAX_CLASSES          8
+#define SHADOW_BATTERY_HYSTERESIS_V 0.1f
+#define SHADOW_COST_SMOOTHING       0.2f    // Weight of the newest epoch
+#define SHADOW_RECORD_VERSION       1
+#define SHADOW_HEADER_SIZE          20
+#define SHADOW_RECORD_TAIL          120     // Records sent by serialize()
+#define SHADOW_RECORD_MAX           (SHADOW_HEADER_SIZE + \
+                                     SHADOW_MAX_CLASSES * SHADOW_MAX_CLASSES * 2 + \
+                                     SHADOW_RECORD_TAIL * 2)
+
+
+// ============================================================================
+// Log Record
+// ============================================================================
+
+struct ShadowRecord {
+    uint8_t stages;             // Active stage << 4 | shadow stage
+    int8_t confidenceDelta;     // Shadow - active top probability, in % points
+
+    uint8_t activeStage() const { return stages >> 4; }
+    uint8_t shadowStage() const { return stages & 0x0F; }
+    bool agrees() const { return activeStage() == shadowStage(); }
+};
+
+
+// ============================================================================
+// Shadow Monitor Class
+// ============================================================================
+
+class ShadowMonitor {
+public:
+    ShadowMonitor() : _classes(0), _maxCostMs(0.0f), _minBatteryV(0.0f), _backoffEpochs(0) {
+        reset();
+    }
+
+    /**
+     * @param classes Stages per model (<= SHADOW_MAX_CLASSES)
+     * @param maxCostMs Budget for the shadow's mean cost per epoch
+     * @param minBatteryV Battery voltage below which the shadow stops
+     * @param backoffEpochs Epochs sat out once over budget
+     */
+    bool begin(int classes, float maxCostMs, float minBatteryV, int backoffEpochs) {
+        _classes = 0;
+        if (classes <= 1 || classes > SHADOW_MAX_CLASSES || maxCostMs <= 0.0f ||
+            backoffEpochs < 0) {
+            return false;
+        }
+        _classes = classes;
+        _maxCostMs = maxCostMs;
+        _minBatteryV = minBatteryV;
+        _backoffEpochs = backoffEpochs;
+        reset();
+        return true;
+    }
+
+    /**
+     * Forget the log and the budget state (e.g. for a new shadow model).
+     */
+    void reset() {
+        memset(_counts, 0, sizeof(_counts));
+        _head = 0;
+        _logged = 0;
+        _compared = 0;
+        _skippedBattery = 0;
+        _skippedCpu = 0;
+        _costMs = 0.0f;
+        _backoff = 0;
+        _batteryLow = false;
+    }
+
+    /**
+     * Latest battery reading (<= 0: no reading, ignored).
+     */
+    void setBatteryVoltage(float volts) {
+        if (volts <= 0.0f) return;
+        if (volts < _minBatteryV) {
+            _batteryLow = true;
+        } else if (volts >= _minBatteryV + SHADOW_BATTERY_HYSTERESIS_V) {
+            _batteryLow = false;
+        }
+    }
+
+    /**
+     * Whether to run the shadow this epoch; call once per epoch. A no is
+     * counted as a skipped epoch.
+     */
+    bool shouldRun() {
+        if (_classes == 0) return false;
+        if (_batteryLow) {
+            _skippedBattery++;
+            return false;
+        }
+        if (_backoff > 0) {
+            _backoff--;
+            _skippedCpu++;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Log one epoch run by both models.
+     *
+     * @param activeConfidence, shadowConfidence Top probabilities, 0..1
+     * @param shadowMs Time the shadow took
+     */
+    void record(int activeStage, float activeConfidence,
+                int shadowStage, float shadowConfidence, float shadowMs) {
+        if (activeStage < 0 || activeStage >= _classes ||
+            shadowStage < 0 || shadowStage >= _classes) {
+            return;
+        }
+
+        float delta = (shadowConfidence - activeConfidence) * 100.0f;
+        ShadowRecord& entry = _log[_head];
+        entry.stages = (uint8_t)(activeStage << 4 | shadowStage);
+        entry.confidenceDelta = (int8_t)(delta >= 0.0f ? delta + 0.5f : delta - 0.5f);
+        _head = (_head + 1) % SHADOW_LOG_EPOCHS;
+        if (_logged < SHADOW_LOG_EPOCHS) _logged++;
+
+        if (_counts[activeStage][shadowStage] < UINT16_MAX) {
+            _counts[activeStage][shadowStage]++;
+        }
+        _costMs = _compared == 0 ? shadowMs
+                                 : _costMs + SHADOW_COST_SMOOTHING * (shadowMs - _costMs);
+        _compared++;
+
+        if (_costMs > _maxCostMs) {
+            _backoff = _backoffEpochs;
+        }
+    }
+
+    // ---- Results ----
+
+    uint32_t getCompared() const { return _compared; }
+    uint32_t getSkippedBattery() const { return _skippedBattery; }
+    uint32_t getSkippedCpu() const { return _skippedCpu; }
+    float getCostMs() const { return _costMs; }
+    bool isBatteryLow() const { return _batteryLow; }
+    bool isBackingOff() const { return _backoff > 0; }
+    uint16_t getCount(int activeStage, int shadowStage) const {
+        return _counts[activeStage][shadowStage];
+    }
+
+    /**
+     * Fraction of compared epochs where both models chose the same stage.
+     */
+    float getAgreement() const {
+        uint32_t total = 0, same = 0;
+        for (int a = 0; a < _classes; a++) {
+            for (int s = 0; s < _classes; s++) {
+                total += _counts[a][s];
+                if (a == s) same += _counts[a][s];
+            }
+        }
+        return total > 0 ? (float)same / total : 1.0f;
+    }
+
+    /**
+     * Records in the log (at most SHADOW_LOG_EPOCHS).
+     */
+    int getLogSize() const { return _logged; }
+
+    /**
+     * Logged record, 0 = oldest still held.
+     */
+    const ShadowRecord& getRecord(int index) const {
+        int first = _logged < SHADOW_LOG_EPOCHS ? 0 : _head;
+        return _log[(first + index) % SHADOW_LOG_EPOCHS];
+    }
+
+    /**
+     * Write the binary record.
+     *
+     * @param out At least SHADOW_RECORD_MAX bytes
+     * @return Bytes written
+     */
+    size_t serialize(uint8_t* out) const {
+        int tail = _logged < SHADOW_RECORD_TAIL ? _logged : SHADOW_RECORD_TAIL;
+        out[0] = SHADOW_RECORD_VERSION;
+        out[1] = (uint8_t)_classes;
+        out[2] = (uint8_t)((_batteryLow ? 1 : 0) | (_backoff > 0 ? 2 : 0));
+        out[3] = (uint8_t)tail;
+        writeU32(out + 4, _compared);
+        writeU32(out + 8, _skippedBattery);
+        writeU32(out + 12, _skippedCpu);
+        writeU32(out + 16, (uint32_t)(_costMs * 1000.0f));
+
+        uint8_t* p = out + SHADOW_HEADER_SIZE;
+        for (int a = 0; a < _classes; a++) {
+            for (int s = 0; s < _classes; s++) {
+                writeU16(p, _counts[a][s]);
+                p += 2;
+            }
+        }
+        for (int i = _logged - tail; i < _logged; i++) {
+            const ShadowRecord& entry = getRecord(i);
+            p[0] = entry.stages;
+            p[1] = (uint8_t)entry.confidenceDelta;
+            p += 2;
+        }
+        return (size_t)(p - out);
+    }
+
+private:
+    int _classes;
+    float _maxCostMs;
+    float _minBatteryV;
+    int _backoffEpochs;
+
+    ShadowRecord _log[SHADOW_LOG_EPOCHS];   // Ring
+    int _head;                              // Next ring entry
+    int _logged;
+    uint16_t _counts[SHADOW_MAX_CLASSES][SHADOW_MAX_CLASSES];
+    uint32_t _compared;
+    uint32_t _skippedBattery;
+    uint32_t _skippedCpu;
+    float _costMs;                          // Moving average per epoch
+    int _backoff;                           // Epochs left to sit out
+    bool _batteryLow;
+
+    static void writeU16(uint8_t* p, uint16_t v) {
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+    }
+
+    static void writeU32(uint8_t* p, uint32_t v) {
+        for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+    }
+};
+
+#endif // SHADOW_MONITOR_H
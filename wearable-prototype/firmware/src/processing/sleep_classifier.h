@@ -5,6 +5,64 @@
  * Runs the trained MLP model on ESP32 to classify sleep stages
  * from extracted IMU + PPG features.
  * 
+ * Backend is selected by INFERENCE_ENGINE (config.h): the TFLite Micro
+ * interpreter, the native int8 engine (int8_mlp.h), which reads the
+ * same model bytes without an interpreter or tensor arena, or the
+ * ahead-of-time compiled model (model_compiled.h) with the feature scaler
+ * folded into its input quantization, or a GRU sequence model
+ * (gru_step.h) that advances one step per epoch, or a random forest /
+ * gradient-boosted ensemble (tree_ensemble.h) on the raw features.
+ * 
+ * Sequence models keep a hidden state across epochs: the GRU engine, or a
+ * TFLM step model with a second input/output pair carrying the state
+ * (exported by export_sequence_model.py). The state is saved to RTC
+ * memory and NVS (recurrent_state.h) and restored by begin(), so a night
+ * survives deep sleep and reboots. Epochs of a sequence model always run
+ * the model; the IMU gate is bypassed so the state sees every epoch.
+ * 
+ * With ENABLE_MODEL_STORE the runtime engines load the newest model from
+ * the A/B flash slots (model_store.h), mapped in place, and fall back to
+ * the embedded model_data.h. checkForModelUpdate() stages a newly written
+ * model; it replaces the running one at the start of the next classify().
+ * 
+ * With ENABLE_SHADOW_MODEL, startShadow() runs the model in the other
+ * store slot as a shadow of the active one: after each classify() it sees
+ * the same features (native: in the idle engine of the A/B pair; TFLM: in
+ * the same tensor arena, with the same op resolver) and its stage only
+ * goes to a disagreement log with a CPU and battery budget
+ * (shadow_monitor.h). promoteShadow() stages it like an update.
+ * 
+ * With ENABLE_ADAPTIVE_NORM every epoch is first mapped onto the training
+ * population by the wearer's own running feature statistics
+ * (adaptive_normalizer.h), kept in NVS across nights; the model, gate and
+ * shadow all see the mapped features. The reference is always
+ * scaler_params.h, also for a store model with its own scaler.
+ * 
+ * With ENABLE_HMM_SMOOTHING each result also carries the stage after HMM
+ * smoothing (hmm_smoother.h), since epochs classified on their own flicker
+ * between implausible stages.
+ * 
+ * With ENABLE_IMU_GATE, classifyIMUOnly() is tried first on the IMU block
+ * of an epoch (imu_gate.h); only undecided epochs need the PPG features
+ * and classify().
+ * 
+ * With requestMemory(), the TFLM tensor arena is planned into a shared
+ * arena (memory_planner.h) and only live during classify(): the feature
+ * buffers use the same bytes in between, and the interpreter is rebuilt in
+ * place at each classify(). Step model state is kept outside the arena.
+ * 
+ * With ENABLE_INFERENCE_PROFILER, classify() records cycles per TFLM op
+ * or native layer into getProfiler() (inference_profiler.h); the gate and
+ * actigraphy paths are not profiled.
+ * 
+ * With ENABLE_PROVISIONAL_STAGES, classifyProvisional() gives a stage for
+ * the open epoch from its running IMU statistics, with the gate's linear
+ * model; it leaves no trace in the HMM, the counters or a sequence state.
+ * 
+ * With ENABLE_ACTIGRAPHY_FALLBACK, classifyActigraphy() scores Wake/Sleep
+ * from activity counts alone (actigraphy_scorer.h) for when begin() finds
+ * no valid model; sleep is reported as Light.
+ * 
  * Classes:
  *   0: Wake
  *   1: Light Sleep (N1 + N2)
@@ -16,18 +74,86 @@
 #define SLEEP_CLASSIFIER_H
 
 #include <Arduino.h>
+#include "feature_extractor.h"
+#include "input_quantizer.h"
+#include "inference_profiler.h"
+#include "memory_planner.h"
+
+#if INFERENCE_ENGINE == INFERENCE_ENGINE_NATIVE
+#include "int8_mlp.h"
+#elif INFERENCE_ENGINE == INFERENCE_ENGINE_COMPILED
+#include "model_compiled.h"
+#elif INFERENCE_ENGINE == INFERENCE_ENGINE_SEQUENCE
+#include "gru_step.h"
+#include "sequence_params.h"
+#elif INFERENCE_ENGINE == INFERENCE_ENGINE_TREES
+#include "tree_ensemble.h"
+#include "tree_params.h"
+#else
+#include <new>
 #include "tensorflow/lite/micro/micro_interpreter.h"
 #include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/micro_profiler_interface.h"
 #include "tensorflow/lite/schema/schema_generated.h"
-#include "feature_extractor.h"
+#endif
+
+// Engines that run a .tflite model (model_data.h or the model store)
+#define SLEEP_MODEL_FROM_TFLITE \
+    (INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM || INFERENCE_ENGINE == INFERENCE_ENGINE_NATIVE)
+
+// Engines that can carry a recurrent state between epochs
+#define SLEEP_SEQUENCE_STATE \
+    (INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM || INFERENCE_ENGINE == INFERENCE_ENGINE_SEQUENCE)
 
 // Include the model data (generated from TFLite model)
 // This will be created by: xxd -i sleep_model.tflite > model_data.h
+#if SLEEP_MODEL_FROM_TFLITE
 #include "model_data.h"
+#endif
+
+#if SLEEP_SEQUENCE_STATE
+#include <time.h>
+#include "recurrent_state.h"
+#endif
 
 // Include scaler parameters (generated by training script)
 #include "scaler_params.h"
 
+// Models can be swapped at runtime (not the compiled or GRU model)
+#define SLEEP_MODEL_HOT_SWAP    (ENABLE_MODEL_STORE && SLEEP_MODEL_FROM_TFLITE)
+
+#if SLEEP_MODEL_HOT_SWAP
+#include "model_store.h"
+#endif
+
+// A candidate model from the other store slot, evaluated next to the active one
+#define SLEEP_SHADOW_MODEL      (ENABLE_SHADOW_MODEL && SLEEP_MODEL_HOT_SWAP)
+
+#if SLEEP_SHADOW_MODEL
+#include "shadow_monitor.h"
+#endif
+
+#if ENABLE_HMM_SMOOTHING
+#include "hmm_smoother.h"
+#include "transition_params.h"
+#endif
+
+// The gate's linear model also gives the provisional stages
+#define SLEEP_IMU_GATE_MODEL    (ENABLE_IMU_GATE || ENABLE_PROVISIONAL_STAGES)
+
+#if SLEEP_IMU_GATE_MODEL
+#include "imu_gate.h"
+#include "gate_params.h"
+#endif
+
+#if ENABLE_ACTIGRAPHY_FALLBACK
+#include "actigraphy_scorer.h"
+#endif
+
+#if ENABLE_ADAPTIVE_NORM
+#include "adaptive_normalizer.h"
+#endif
+
 // ============================================================================
 // Configuration
 // ============================================================================
@@ -43,6 +169,25 @@ const char* SLEEP_CLASS_NAMES[N_SLEEP_CLASSES] = {
     "Wake", "Light", "Deep", "REM"
 };
 
+#if ENABLE_HMM_SMOOTHING && HMM_N_STATES != N_SLEEP_CLASSES
+#error "transition_params.h does not match N_SLEEP_CLASSES"
+#endif
+
+#if SLEEP_IMU_GATE_MODEL && (GATE_N_CLASSES != N_SLEEP_CLASSES || \
+                        GATE_N_FEATURES != N_IMU_AXES * N_STAT_FEATURES + N_IMU_EXTRA)
+#error "gate_params.h does not match the IMU feature block"
+#endif
+
+// Which stage produced a result
+#define STAGE_SOURCE_MODEL      0   // Full model on all features
+#define STAGE_SOURCE_IMU_GATE   1   // IMU-only gate (PPG features skipped)
+#define STAGE_SOURCE_ACTIGRAPHY 2   // Model-free actigraphy fallback
+#define N_STAGE_SOURCES         3
+
+const char* STAGE_SOURCE_NAMES[N_STAGE_SOURCES] = {
+    "model", "IMU gate", "actigraphy"
+};
+
 
 // ============================================================================
 // Sleep Stage Result
@@ -56,129 +201,394 @@ struct SleepStageResult {
     uint32_t timestamp;
     bool valid;
     float inferenceTimeMs;
+    uint8_t source;                  // STAGE_SOURCE_*
+    
+    // HMM smoothing (the raw values above without ENABLE_HMM_SMOOTHING)
+    uint8_t smoothedClass;           // Forward-filtered stage of this epoch
+    float smoothedProbabilities[N_SLEEP_CLASSES];
+    int8_t laggedClass;              // Viterbi stage of the epoch HMM_SMOOTHING_LAG
+                                     // back (-1 until available / lag 0)
+    bool provisional;                // Open epoch, from partial data; the final
+                                     // result of the epoch follows
 };
 
 
+#if INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM && ENABLE_INFERENCE_PROFILER
+// ============================================================================
+// TFLM Profiler Adapter
+// ============================================================================
+
+/**
+ * Forwards the interpreter's per-op events to an InferenceProfiler.
+ */
+class TFLMProfilerAdapter : public tflite::MicroProfilerInterface {
+public:
+    TFLMProfilerAdapter() : _profiler(nullptr) {}
+    
+    void begin(InferenceProfiler* profiler) {
+        _profiler = profiler;
+    }
+    
+    uint32_t BeginEvent(const char* tag) override {
+        return _profiler->beginEvent(tag);
+    }
+    
+    void EndEvent(uint32_t eventHandle) override {
+        _profiler->endEvent(eventHandle);
+    }
+    
+private:
+    InferenceProfiler* _profiler;
+};
+#endif
+
+
 // ============================================================================
 // Sleep Classifier Class
 // ============================================================================
 
 class SleepClassifier {
 public:
-    SleepClassifier() : _initialized(false), _interpreter(nullptr) {}
+    SleepClassifier() : _initialized(false), _epochs(0) {
+        #if SLEEP_IMU_GATE_MODEL
+        _gate.begin(GATE_WEIGHTS, GATE_BIAS, GATE_N_FEATURES, GATE_N_CLASSES, GATE_THRESHOLD);
+        #endif
+        #if ENABLE_IMU_GATE
+        _gatedEpochs = 0;
+        #endif
+        #if ENABLE_ACTIGRAPHY_FALLBACK
+        _actigraphy.begin(ACTIGRAPHY_ALGORITHM,
+                          EPOCH_DURATION_SEC < 60 ? 60 / EPOCH_DURATION_SEC : 1);
+        #endif
+        #if ENABLE_HMM_SMOOTHING
+        _smoother.begin(&HMM_TRANSITION[0][0], HMM_INITIAL, HMM_CLASS_PRIOR,
+                        HMM_N_STATES, HMM_SMOOTHING_LAG);
+        #endif
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_NATIVE
+        _active = 0;
+        _staged = 0;
+        #elif INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM
+        _model = nullptr;
+        _stagedModel = nullptr;
+        _interpreter = nullptr;
+        _stateInput = nullptr;
+        _stateOutput = nullptr;
+        _modelId = 0;
+        _stagedId = 0;
+        _tensorArena = nullptr;
+        _arenaUsed = 0;
+        _planner = nullptr;
+        _arenaId = -1;
+        _arenaCurrent = false;
+        memset(_sequenceState, 0, sizeof(_sequenceState));
+        #if ENABLE_INFERENCE_PROFILER
+        _tflmProfiler.begin(&_profiler);
+        #endif
+        #endif
+        #if SLEEP_SEQUENCE_STATE
+        _sequenceEpochs = 0;
+        #endif
+        #if SLEEP_MODEL_FROM_TFLITE
+        _stagedMean = FEATURE_MEAN;
+        _stagedScale = FEATURE_SCALE;
+        #endif
+        #if SLEEP_MODEL_HOT_SWAP
+        _activeSlot = -1;
+        _pendingSlot = -1;
+        _modelSequence = 0;
+        _pendingSequence = 0;
+        _swapPending = false;
+        #endif
+        #if SLEEP_SHADOW_MODEL
+        _shadowMonitor.begin(N_SLEEP_CLASSES, SHADOW_MAX_CPU_MS, SHADOW_MIN_BATTERY_V,
+                             SHADOW_BACKOFF_EPOCHS);
+        _shadowSlot = -1;
+        _shadowSequence = 0;
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM
+        _shadowModel = nullptr;
+        _shadowUnchecked = false;
+        #endif
+        #endif
+    }
     
+    #if INFERENCE_ENGINE == INFERENCE_ENGINE_COMPILED
     /**
-     * Initialize the TFLite interpreter.
+     * Check that a compiled model is linked in.
      * 
      * @return true if initialization successful
      */
     bool begin() {
-        Serial.println("[TFLITE] Initializing sleep classifier...");
+        Serial.println("[COMPILED] Initializing compiled model...");
         
-        // Allocate tensor arena
-        _tensorArena = (uint8_t*)malloc(TENSOR_ARENA_SIZE);
-        if (!_tensorArena) {
-            Serial.println("[TFLITE] Failed to allocate tensor arena!");
+        if (!COMPILED_MODEL_AVAILABLE) {
+            Serial.println("[COMPILED] model_compiled.h is a placeholder - run compile_model.py");
             return false;
         }
         
-        // Load the model
-        _model = tflite::GetModel(sleep_model_tflite);
-        if (_model->version() != TFLITE_SCHEMA_VERSION) {
-            Serial.printf("[TFLITE] Model schema version mismatch: %d vs %d\n",
-                         _model->version(), TFLITE_SCHEMA_VERSION);
+        if (COMPILED_MODEL_INPUTS != N_FEATURES || COMPILED_MODEL_OUTPUTS != N_SLEEP_CLASSES) {
+            Serial.printf("[COMPILED] Model shape %d -> %d, expected %d -> %d\n",
+                         COMPILED_MODEL_INPUTS, COMPILED_MODEL_OUTPUTS,
+                         N_FEATURES, N_SLEEP_CLASSES);
             return false;
         }
         
-        // Set up the op resolver (add only the ops your model needs)
-        // MLP typically needs: FullyConnected, Relu, Softmax, BatchNorm (if used)
-        static tflite::MicroMutableOpResolver<10> resolver;
-        resolver.AddFullyConnected();
-        resolver.AddRelu();
-        resolver.AddSoftmax();
-        resolver.AddReshape();
-        resolver.AddQuantize();
-        resolver.AddDequantize();
-        // Add BatchNorm ops if your model uses them
-        // resolver.AddMul();
-        // resolver.AddAdd();
-        
-        // Build the interpreter
-        static tflite::MicroInterpreter static_interpreter(
-            _model, resolver, _tensorArena, TENSOR_ARENA_SIZE);
-        _interpreter = &static_interpreter;
+        Serial.printf("[COMPILED] %d layers, model CRC32 %08lX\n",
+                     COMPILED_MODEL_LAYERS, (unsigned long)COMPILED_MODEL_CRC32);
         
-        // Allocate tensors
-        TfLiteStatus allocate_status = _interpreter->AllocateTensors();
-        if (allocate_status != kTfLiteOk) {
-            Serial.println("[TFLITE] AllocateTensors() failed!");
+        beginNormalizer();
+        _initialized = true;
+        Serial.println("[COMPILED] Classifier ready!");
+        
+        return true;
+    }
+    #elif INFERENCE_ENGINE == INFERENCE_ENGINE_SEQUENCE
+    /**
+     * Set up the GRU and resume its state from before a sleep or reboot.
+     * 
+     * @return true if initialization successful
+     */
+    bool begin() {
+        Serial.println("[GRU] Initializing sequence model...");
+        
+        if (!SEQUENCE_MODEL_AVAILABLE) {
+            Serial.println("[GRU] sequence_params.h is a placeholder - run export_sequence_model.py");
             return false;
         }
         
-        // Get input/output tensor info
-        _input = _interpreter->input(0);
-        _output = _interpreter->output(0);
+        if (SEQUENCE_MODEL_INPUTS != N_FEATURES || SEQUENCE_MODEL_CLASSES != N_SLEEP_CLASSES ||
+            !_gru.begin(SEQUENCE_KERNEL, SEQUENCE_RECURRENT_KERNEL,
+                        SEQUENCE_INPUT_BIAS, SEQUENCE_RECURRENT_BIAS,
+                        SEQUENCE_DENSE_KERNEL, SEQUENCE_DENSE_BIAS,
+                        SEQUENCE_MODEL_INPUTS, SEQUENCE_MODEL_UNITS, SEQUENCE_MODEL_CLASSES)) {
+            Serial.printf("[GRU] Model shape %d -> %d units -> %d not supported\n",
+                         SEQUENCE_MODEL_INPUTS, SEQUENCE_MODEL_UNITS, SEQUENCE_MODEL_CLASSES);
+            return false;
+        }
+        
+        _stateStore.begin(SEQUENCE_STATE_NAMESPACE, SEQUENCE_STATE_PERSIST_EPOCHS,
+                          SEQUENCE_STATE_MAX_GAP_SEC);
+        float state[GRU_MAX_UNITS];
+        if (restoreSequenceState(state, SEQUENCE_MODEL_UNITS, SEQUENCE_MODEL_CRC32)) {
+            _gru.setState(state);
+        }
+        
+        Serial.printf("[GRU] %d units, %d bytes of weights\n",
+                     SEQUENCE_MODEL_UNITS, (int)_gru.getWeightBytes());
+        
+        beginNormalizer();
+        _initialized = true;
+        Serial.println("[GRU] Classifier ready!");
+        
+        return true;
+    }
+    #elif INFERENCE_ENGINE == INFERENCE_ENGINE_TREES
+    /**
+     * Attach the exported tree ensemble.
+     * 
+     * @return true if initialization successful
+     */
+    bool begin() {
+        Serial.println("[TREES] Initializing tree ensemble...");
+        
+        if (!TREE_MODEL_AVAILABLE) {
+            Serial.println("[TREES] tree_params.h is a placeholder - run export_tree_model.py");
+            return false;
+        }
+        
+        if (TREE_MODEL_FEATURES != N_FEATURES || TREE_MODEL_CLASSES != N_SLEEP_CLASSES ||
+            !_trees.begin(TREE_MODEL_KIND, TREE_NODES, TREE_MODEL_NODES,
+                          TREE_ROOTS, TREE_LEAF_BASE, TREE_CLASS, TREE_MODEL_TREES,
+                          TREE_LEAF_VALUES, TREE_MODEL_LEAVES, TREE_BASE_SCORE,
+                          TREE_MODEL_CLASSES, TREE_MODEL_FEATURES)) {
+            Serial.printf("[TREES] Ensemble of %d trees (%d -> %d) is invalid\n",
+                         TREE_MODEL_TREES, TREE_MODEL_FEATURES, TREE_MODEL_CLASSES);
+            return false;
+        }
+        
+        Serial.printf("[TREES] %d %s trees, %lu nodes, %u bytes, model CRC32 %08lX\n",
+                     TREE_MODEL_TREES,
+                     TREE_MODEL_KIND == TREE_KIND_FOREST ? "forest" : "boosted",
+                     (unsigned long)TREE_MODEL_NODES, (unsigned)_trees.getModelBytes(),
+                     (unsigned long)TREE_MODEL_CRC32);
+        
+        beginNormalizer();
+        _initialized = true;
+        Serial.println("[TREES] Classifier ready!");
+        
+        return true;
+    }
+    #elif INFERENCE_ENGINE == INFERENCE_ENGINE_NATIVE
+    /**
+     * Load the int8 model into the native engine.
+     * 
+     * @return true if initialization successful
+     */
+    bool begin() {
+        Serial.println("[MLP] Initializing native int8 engine...");
+        
+        if (!loadInitialModel()) {
+            return false;
+        }
+        
+        const Int8MLP& mlp = _engines[_active];
+        Serial.printf("[MLP] %d layers, input scale=%.6f zp=%d\n",
+                     mlp.getLayerCount(), mlp.getInputScale(), mlp.getInputZeroPoint());
+        Serial.printf("[MLP] Engine RAM: %d bytes\n", (int)mlp.getMemoryUsed());
+        
+        beginNormalizer();
+        _initialized = true;
+        Serial.println("[MLP] Classifier ready!");
+        
+        return true;
+    }
+    #else
+    /**
+     * Initialize the TFLite interpreter.
+     * 
+     * @return true if initialization successful
+     */
+    bool begin() {
+        Serial.println("[TFLITE] Initializing sleep classifier...");
+        
+        // Allocate tensor arena (or take it from the shared arena); kept
+        // from an earlier begin() that found no usable model
+        if (!_tensorArena) {
+            _tensorArena = _planner ? (uint8_t*)_planner->get(_arenaId)
+                                    : (uint8_t*)malloc(TENSOR_ARENA_SIZE);
+        }
+        if (!_tensorArena) {
+            Serial.println("[TFLITE] Failed to allocate tensor arena!");
+            return false;
+        }
+        
+        _stateStore.begin(SEQUENCE_STATE_NAMESPACE, SEQUENCE_STATE_PERSIST_EPOCHS,
+                          SEQUENCE_STATE_MAX_GAP_SEC);
+        
+        if (!loadInitialModel()) {
+            return false;
+        }
         
         Serial.printf("[TFLITE] Input: dims=%d, type=%d\n", 
                      _input->dims->size, _input->type);
         Serial.printf("[TFLITE] Output: dims=%d, type=%d\n",
                      _output->dims->size, _output->type);
-        Serial.printf("[TFLITE] Arena used: %d bytes\n",
-                     _interpreter->arena_used_bytes());
+        Serial.printf("[TFLITE] Arena used: %d bytes%s\n",
+                     (int)_arenaUsed, _planner ? " (shared)" : "");
+        
+        beginNormalizer();
         
+        // Feature extraction writes the shared arena from now on
+        _arenaCurrent = !_planner;
         _initialized = true;
         Serial.println("[TFLITE] Classifier ready!");
         
         return true;
     }
+    #endif
+    
+    /**
+     * Take the tensor arena from a shared arena, live during classify()
+     * only. Call before planner.plan() and begin(). The other engines keep
+     * their few KB of working memory in the object and request nothing.
+     */
+    void requestMemory(MemoryPlanner& planner) {
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM
+        _planner = &planner;
+        _arenaId = planner.request("tensor arena", TENSOR_ARENA_SIZE,
+                                   MEMORY_PHASE_INFER, MEMORY_PHASE_INFER);
+        #else
+        (void)planner;
+        #endif
+    }
     
     /**
      * Classify sleep stage from extracted features.
      * 
-     * @param features Extracted epoch features
+     * @param epoch Extracted epoch features
      * @param result Output classification result
      * @return true if classification successful
      */
-    bool classify(const EpochFeatures& features, SleepStageResult& result) {
+    bool classify(const EpochFeatures& epoch, SleepStageResult& result) {
         if (!_initialized) {
             result.valid = false;
             return false;
         }
         
-        if (!features.valid) {
+        startEpoch(true);
+        
+        if (!epoch.valid) {
+            result.valid = false;
+            return false;
+        }
+        
+        const EpochFeatures& features = normalize(epoch, N_FEATURES);
+        
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM
+        // The shared arena held feature buffers since the last epoch. Rebuilt
+        // before the timing starts: it is arena bookkeeping, not model latency
+        if (!_arenaCurrent && !buildInterpreter(_model)) {
             result.valid = false;
             return false;
         }
+        _arenaCurrent = !_planner;
+        #endif
         
         unsigned long startTime = micros();
+        #if ENABLE_INFERENCE_PROFILER
+        _profiler.beginInvoke();
+        #endif
+        
+        // Predicted class comes from the int8 logits where there are any;
+        // dequantizing is monotonic, so it matches the float argmax
+        uint8_t maxClass = 0;
         
-        // Scale features using the scaler parameters from training
-        float scaledFeatures[N_FEATURES];
-        for (int i = 0; i < N_FEATURES; i++) {
-            scaledFeatures[i] = (features.features[i] - FEATURE_MEAN[i]) / FEATURE_SCALE[i];
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_COMPILED
+        // Scaling and input quantization are folded into the compiled model
+        int8_t logits[COMPILED_MODEL_OUTPUTS];
+        {
+            ProfileScope event(profiler(), "COMPILED");
+            compiledModelInvoke(features.features, logits);
+        }
+        maxClass = compiledModelArgmax(logits);
+        compiledModelSoftmax(logits, result.probabilities);
+        #elif INFERENCE_ENGINE == INFERENCE_ENGINE_NATIVE
+        // Scale + quantize in one pass, then run the dense layers
+        int8_t inputData[N_FEATURES];
+        {
+            ProfileScope event(profiler(), "QUANTIZE");
+            _quantizer.quantize(features.features, inputData);
         }
         
-        // Copy scaled features to input tensor
-        if (_input->type == kTfLiteFloat32) {
-            // Float model
-            float* inputData = _input->data.f;
-            for (int i = 0; i < N_FEATURES; i++) {
-                inputData[i] = scaledFeatures[i];
-            }
-        } else if (_input->type == kTfLiteInt8) {
-            // Quantized model
-            int8_t* inputData = _input->data.int8;
-            float scale = _input->params.scale;
-            int zero_point = _input->params.zero_point;
-            
-            for (int i = 0; i < N_FEATURES; i++) {
-                int32_t quantized = (int32_t)(scaledFeatures[i] / scale) + zero_point;
-                quantized = max(-128, min(127, quantized));
-                inputData[i] = (int8_t)quantized;
+        Int8MLP& mlp = _engines[_active];
+        mlp.invoke(inputData, profiler());
+        {
+            ProfileScope event(profiler(), "SOFTMAX");
+            maxClass = mlp.argmax();
+            mlp.softmax(result.probabilities);
+        }
+        #elif INFERENCE_ENGINE == INFERENCE_ENGINE_SEQUENCE
+        // One GRU step; the scaler is folded into the kernel
+        maxClass = (uint8_t)_gru.step(features.features, result.probabilities, profiler());
+        recordSequenceStep(_gru.getState(), _gru.getUnits(), SEQUENCE_MODEL_CRC32);
+        #elif INFERENCE_ENGINE == INFERENCE_ENGINE_TREES
+        // Raw features; trees need no scaler
+        maxClass = (uint8_t)_trees.predict(features.features, result.probabilities, profiler());
+        #else
+        // Scale (and quantize) straight into the input tensor
+        {
+            ProfileScope event(profiler(), "QUANTIZE");
+            if (_input->type == kTfLiteFloat32) {
+                _quantizer.scale(features.features, _input->data.f);
+            } else if (_input->type == kTfLiteInt8) {
+                _quantizer.quantize(features.features, _input->data.int8);
             }
         }
         
-        // Run inference
+        if (_stateInput) {
+            memcpy(_stateInput->data.f, _sequenceState, _stateInput->bytes);
+        }
+        
+        // Run inference (per-op events come from the interpreter)
         TfLiteStatus invoke_status = _interpreter->Invoke();
         if (invoke_status != kTfLiteOk) {
             Serial.println("[TFLITE] Invoke failed!");
@@ -186,65 +596,1146 @@ public:
             return false;
         }
         
+        // Step model: the new state is the next epoch's state input
+        if (_stateInput) {
+            memcpy(_sequenceState, _stateOutput->data.f, _stateOutput->bytes);
+            recordSequenceStep(_sequenceState, _stateOutput->bytes / sizeof(float), _modelId);
+        }
+        
         // Extract output probabilities
-        if (_output->type == kTfLiteFloat32) {
-            float* outputData = _output->data.f;
-            for (int i = 0; i < N_SLEEP_CLASSES; i++) {
-                result.probabilities[i] = outputData[i];
+        maxClass = readOutput(_output, result.probabilities);
+        #endif
+        
+        #if ENABLE_INFERENCE_PROFILER
+        _profiler.endInvoke(getArenaUsed());
+        #endif
+        
+        // Fill result
+        result.source = STAGE_SOURCE_MODEL;
+        finishResult(result, maxClass, startTime);
+        adaptNormalizer(epoch, N_FEATURES);
+        
+        #if SLEEP_SHADOW_MODEL
+        runShadow(features, result);
+        #endif
+        
+        return true;
+    }
+    
+    /**
+     * Classify many epochs in order, e.g. a whole night on a host or a
+     * gateway. Results match classify() on each epoch (including HMM
+     * smoothing, in order); inferenceTimeMs is the per-epoch share.
+     * 
+     * The native engine runs the MLP as matrix-matrix products
+     * (Int8MLP::invokeBatch()); the other engines loop over classify().
+     * A pending model swap applies once, before the first epoch. Batches
+     * are not profiled per op; native batches skip the shadow model.
+     * 
+     * @param features `count` epochs
+     * @param results Output, one per epoch (invalid epochs give valid = false)
+     * @return Number of epochs classified
+     */
+    int classifyBatch(const EpochFeatures* features, SleepStageResult* results, int count) {
+        int classified = 0;
+        
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_NATIVE
+        if (!_initialized) {
+            for (int i = 0; i < count; i++) results[i].valid = false;
+            return 0;
+        }
+        startEpoch(true);
+        
+        int8_t inputs[MLP_BATCH_BLOCK * N_FEATURES];
+        int8_t logits[MLP_BATCH_BLOCK * N_SLEEP_CLASSES];
+        int epochs[MLP_BATCH_BLOCK];
+        Int8MLP& mlp = _engines[_active];
+        
+        int next = 0;
+        while (next < count) {
+            unsigned long startTime = micros();
+            
+            // Quantize the next block of valid epochs
+            int rows = 0;
+            for (; next < count && rows < MLP_BATCH_BLOCK; next++) {
+                if (!features[next].valid) {
+                    results[next].valid = false;
+                    continue;
+                }
+                // The statistics only depend on the inputs, so they can
+                // advance here, ahead of the block's results
+                _quantizer.quantize(normalize(features[next], N_FEATURES).features,
+                                    inputs + rows * N_FEATURES);
+                adaptNormalizer(features[next], N_FEATURES);
+                epochs[rows++] = next;
             }
-        } else if (_output->type == kTfLiteInt8) {
-            int8_t* outputData = _output->data.int8;
-            float scale = _output->params.scale;
-            int zero_point = _output->params.zero_point;
             
-            for (int i = 0; i < N_SLEEP_CLASSES; i++) {
-                result.probabilities[i] = (outputData[i] - zero_point) * scale;
+            mlp.invokeBatch(inputs, rows, logits);
+            for (int r = 0; r < rows; r++) {
+                SleepStageResult& result = results[epochs[r]];
+                const int8_t* epochLogits = logits + r * N_SLEEP_CLASSES;
+                mlp.softmax(epochLogits, result.probabilities);
+                result.source = STAGE_SOURCE_MODEL;
+                finishResult(result, (uint8_t)argmaxInt8(epochLogits, N_SLEEP_CLASSES), startTime);
             }
+            
+            float blockMs = (micros() - startTime) / 1000.0f;
+            for (int r = 0; r < rows; r++) {
+                results[epochs[r]].inferenceTimeMs = blockMs / rows;
+            }
+            classified += rows;
         }
+        #else
+        for (int i = 0; i < count; i++) {
+            if (classify(features[i], results[i])) classified++;
+        }
+        #endif
         
-        // Find predicted class (argmax)
-        uint8_t maxClass = 0;
-        float maxProb = result.probabilities[0];
-        for (int i = 1; i < N_SLEEP_CLASSES; i++) {
-            if (result.probabilities[i] > maxProb) {
-                maxProb = result.probabilities[i];
-                maxClass = i;
-            }
+        return classified;
+    }
+    
+    #if ENABLE_IMU_GATE
+    /**
+     * First stage of the cascade: decide the epoch from its IMU features
+     * (FeatureExtractor::extractIMUFeatures()) if the gate is confident.
+     * On false, compute the PPG features and call classify().
+     * 
+     * @return true if `result` holds the decided epoch
+     */
+    bool classifyIMUOnly(const EpochFeatures& epoch, SleepStageResult& result) {
+        // A sequence model has to see every epoch
+        if (!_initialized || isStateful()) {
+            return false;
         }
         
-        // Fill result
-        result.predictedClass = maxClass;
-        result.className = SLEEP_CLASS_NAMES[maxClass];
-        result.confidence = maxProb;
+        startEpoch(false);
+        
+        unsigned long startTime = micros();
+        float probabilities[N_SLEEP_CLASSES];
+        int decided = _gate.classify(normalize(epoch, GATE_N_FEATURES).features, probabilities);
+        if (decided < 0) {
+            return false;
+        }
+        
+        // Undecided epochs update all features in classify()
+        adaptNormalizer(epoch, GATE_N_FEATURES);
+        _gatedEpochs++;
+        memcpy(result.probabilities, probabilities, sizeof(result.probabilities));
+        result.source = STAGE_SOURCE_IMU_GATE;
+        finishResult(result, (uint8_t)decided, startTime);
+        
+        return true;
+    }
+    
+    /**
+     * Fraction of classified epochs decided by the IMU gate.
+     */
+    float getGatedFraction() const {
+        return _epochs > 0 ? (float)_gatedEpochs / _epochs : 0.0f;
+    }
+    #endif
+    
+    #if ENABLE_PROVISIONAL_STAGES
+    /**
+     * Provisional stage of the open epoch, from the IMU block of
+     * FeatureExtractor::extractProvisionalFeatures(): the gate's linear
+     * softmax without its threshold. The smoothed stage is the HMM forward
+     * posterior this would have as the next epoch (HMMSmoother::preview());
+     * the HMM, the epoch counters, a pending model swap and any sequence
+     * state are left alone, so the epoch's final result is unaffected.
+     * 
+     * @return true if `result` holds a provisional stage
+     */
+    bool classifyProvisional(const EpochFeatures& features, SleepStageResult& result) {
+        unsigned long startTime = micros();
+        _gate.classify(normalize(features, GATE_N_FEATURES).features, result.probabilities);
+        
+        uint8_t best = 0;
+        for (int i = 1; i < N_SLEEP_CLASSES; i++) {
+            if (result.probabilities[i] > result.probabilities[best]) best = i;
+        }
+        result.predictedClass = best;
+        result.className = SLEEP_CLASS_NAMES[best];
+        result.confidence = result.probabilities[best];
         result.timestamp = millis();
         result.valid = true;
+        result.source = STAGE_SOURCE_IMU_GATE;
+        result.provisional = true;
+        
+        #if ENABLE_HMM_SMOOTHING
+        result.smoothedClass = (uint8_t)_smoother.preview(result.probabilities,
+                                                         result.smoothedProbabilities);
+        #else
+        result.smoothedClass = best;
+        memcpy(result.smoothedProbabilities, result.probabilities, sizeof(result.probabilities));
+        #endif
+        result.laggedClass = -1;
         result.inferenceTimeMs = (micros() - startTime) / 1000.0f;
         
         return true;
     }
+    #endif
     
+    #if ENABLE_ACTIGRAPHY_FALLBACK
     /**
-     * Get classifier status.
+     * Model-free Wake/Sleep scoring for when no model is loaded. Needs only
+     * the epoch's activity counts (FeatureExtractor::computeActigraphyCounts()).
+     * The result is the latest scored minute, ActigraphyScorer::getLag()
+     * minutes behind; sleep is reported as Light.
+     * 
+     * @return true once the first minute has been scored
      */
-    bool isReady() const {
-        return _initialized;
+    bool classifyActigraphy(float activityCounts, SleepStageResult& result) {
+        unsigned long startTime = micros();
+        _actigraphy.addEpoch(activityCounts);
+        if (!_actigraphy.hasScore()) {
+            return false;
+        }
+        
+        float wake = _actigraphy.getWakeProbability();
+        result.probabilities[0] = wake;
+        result.probabilities[1] = 1.0f - wake;
+        for (int i = 2; i < N_SLEEP_CLASSES; i++) {
+            result.probabilities[i] = 0.0f;
+        }
+        
+        result.source = STAGE_SOURCE_ACTIGRAPHY;
+        finishResult(result, _actigraphy.isAsleep() ? 1 : 0, startTime);
+        
+        return true;
     }
+    #endif
     
+    #if ENABLE_ADAPTIVE_NORM
     /**
-     * Get memory usage.
+     * New wearer: back to the population scaler, stored statistics cleared.
      */
-    size_t getArenaUsed() const {
-        return _initialized ? _interpreter->arena_used_bytes() : 0;
+    void resetNormalizer() {
+        _normalizer.reset();
     }
     
-private:
-    bool _initialized;
-    const tflite::Model* _model;
-    tflite::MicroInterpreter* _interpreter;
-    TfLiteTensor* _input;
-    TfLiteTensor* _output;
-    uint8_t* _tensorArena;
-};
-
-#endif // SLEEP_CLASSIFIER_H
-
+    /**
+     * Write the per-user statistics to NVS now (they are also written every
+     * ADAPTIVE_NORM_PERSIST_EPOCHS), e.g. before deep sleep.
+     */
+    bool persistNormalizer() {
+        return _normalizer.persist();
+    }
+    
+    const AdaptiveNormalizer& getNormalizer() const { return _normalizer; }
+    #endif
+    
+    /**
+     * Whether begin() loaded a model (classify() is usable).
+     */
+    bool hasModel() const { return _initialized; }
+    
+    /**
+     * Whether the model carries a recurrent state between epochs.
+     */
+    bool isStateful() const {
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_SEQUENCE
+        return true;
+        #elif INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM
+        return _stateInput != nullptr;
+        #else
+        return false;
+        #endif
+    }
+    
+    #if SLEEP_SEQUENCE_STATE
+    /**
+     * Start a new night: zero the recurrent state and forget the stored one.
+     */
+    void resetSequenceState() {
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_SEQUENCE
+        _gru.reset();
+        #else
+        memset(_sequenceState, 0, sizeof(_sequenceState));
+        #endif
+        _sequenceEpochs = 0;
+        _stateStore.clear();
+    }
+    
+    /**
+     * Write the recurrent state to NVS now (it is also written every
+     * SEQUENCE_STATE_PERSIST_EPOCHS), e.g. before deep sleep.
+     */
+    bool saveSequenceState() {
+        return isStateful() && _stateStore.persist();
+    }
+    
+    /**
+     * Epochs the recurrent state has seen since it was last reset.
+     */
+    uint32_t getSequenceEpochs() const { return _sequenceEpochs; }
+    #endif
+    
+    #if ENABLE_INFERENCE_PROFILER
+    /**
+     * Per-op cycle statistics of classify() since the last reset.
+     */
+    const InferenceProfiler& getProfiler() const {
+        return _profiler;
+    }
+    
+    void resetProfiler() {
+        _profiler.reset();
+    }
+    #endif
+    
+    /**
+     * Restart the stage smoothing (e.g. for a new recording).
+     */
+    void resetSmoothing() {
+        #if ENABLE_HMM_SMOOTHING
+        _smoother.reset();
+        #endif
+    }
+    
+    /**
+     * New recording (the app's START): nothing of the previous night
+     * carries over into the stages, smoothing or recurrent state.
+     */
+    void startNight() {
+        resetSmoothing();
+        #if SLEEP_SEQUENCE_STATE
+        resetSequenceState();
+        #endif
+    }
+    
+    #if SLEEP_MODEL_HOT_SWAP
+    /**
+     * Stage the newest model in the store if it is not the running one.
+     * It replaces the running model at the start of the next classify().
+     * Call from the same task as classify().
+     * 
+     * @return true if a new model was staged
+     */
+    bool checkForModelUpdate() {
+        if (!_initialized || _swapPending || _store.isUpdating()) {
+            return false;
+        }
+        
+        int slot = _store.newestSlot();
+        if (slot < 0 || slot == _activeSlot) {
+            return false;
+        }
+        
+        return stageSlot(slot);
+    }
+    
+    /**
+     * Start writing a model package into the slot the running model is not
+     * using. Drops a staged model that has not been switched to yet, since
+     * that slot may be the one being overwritten.
+     * 
+     * @return Slot being written, or -1
+     */
+    int beginModelUpdate(size_t packageLength) {
+        if (_swapPending) {
+            _swapPending = false;
+            _store.release(_pendingSlot);
+        }
+        #if SLEEP_SHADOW_MODEL
+        endShadow();
+        #endif
+        return _store.beginUpdate(packageLength, _activeSlot);
+    }
+    
+    /**
+     * Model storage (writeUpdate / finishUpdate after beginModelUpdate()).
+     */
+    ModelStore& getModelStore() {
+        return _store;
+    }
+    
+    int getActiveSlot() const {
+        return _activeSlot;
+    }
+    
+    /**
+     * Sequence number of the running model (0: embedded model_data.h).
+     */
+    uint32_t getModelSequence() const {
+        return _modelSequence;
+    }
+    #endif
+    
+    #if SLEEP_SHADOW_MODEL
+    /**
+     * Run the model in the store slot the active model is not using as the
+     * shadow of the active one, with a fresh log. Single-input models only
+     * (no step models). Staging an update or writing that slot ends it.
+     * Call from the same task as classify().
+     * 
+     * @return true if the shadow is running
+     */
+    bool startShadow() {
+        endShadow();
+        if (!_initialized || _swapPending || _store.isUpdating()) {
+            return false;
+        }
+        
+        int slot = _activeSlot >= 0 ? 1 - _activeSlot : _store.newestSlot();
+        ModelImage image;
+        if (slot < 0 || !_store.map(slot, &image)) {
+            return false;
+        }
+        if (!stageImage(image) || !attachShadow()) {
+            _store.release(slot);
+            Serial.printf("[SHADOW] Slot %d rejected\n", slot);
+            return false;
+        }
+        
+        _shadowSlot = slot;
+        _shadowSequence = image.sequence;
+        _shadowMonitor.reset();
+        Serial.printf("[SHADOW] Running slot %d (sequence %u) as shadow\n",
+                     slot, (unsigned)image.sequence);
+        return true;
+    }
+    
+    /**
+     * Stop the shadow (its log is kept until the next startShadow()).
+     */
+    void endShadow() {
+        if (_shadowSlot < 0) {
+            return;
+        }
+        _store.release(_shadowSlot);
+        _shadowSlot = -1;
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM
+        _shadowModel = nullptr;
+        _shadowUnchecked = false;
+        #endif
+        Serial.println("[SHADOW] Stopped");
+    }
+    
+    /**
+     * Stage the shadow model to replace the active one at the next
+     * classify(), as checkForModelUpdate() would.
+     * 
+     * @return true if it was staged
+     */
+    bool promoteShadow() {
+        if (_shadowSlot < 0 || _swapPending || _store.isUpdating()) {
+            return false;
+        }
+        int slot = _shadowSlot;
+        endShadow();
+        return stageSlot(slot);
+    }
+    
+    bool hasShadow() const { return _shadowSlot >= 0; }
+    uint32_t getShadowSequence() const { return _shadowSequence; }
+    
+    /**
+     * Disagreement log and budget state of the current (or last) shadow.
+     */
+    const ShadowMonitor& getShadowMonitor() const {
+        return _shadowMonitor;
+    }
+    
+    /**
+     * Latest battery reading, for the shadow's battery budget.
+     */
+    void setBatteryVoltage(float volts) {
+        _shadowMonitor.setBatteryVoltage(volts);
+    }
+    #endif
+    
+    /**
+     * Get classifier status.
+     */
+    bool isReady() const {
+        return _initialized;
+    }
+    
+    /**
+     * Get memory usage (tensor arena, or native engine state; the compiled
+     * model only uses the stack).
+     */
+    size_t getArenaUsed() const {
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_COMPILED
+        return 0;
+        #elif INFERENCE_ENGINE == INFERENCE_ENGINE_NATIVE
+        return _initialized ? sizeof(_engines) : 0;
+        #elif INFERENCE_ENGINE == INFERENCE_ENGINE_SEQUENCE
+        return _initialized ? sizeof(_gru) : 0;
+        #elif INFERENCE_ENGINE == INFERENCE_ENGINE_TREES
+        return _initialized ? sizeof(_trees) : 0;
+        #else
+        return _initialized ? _arenaUsed : 0;
+        #endif
+    }
+    
+private:
+    bool _initialized;
+    uint32_t _epochs;               // Classified epochs (both stages)
+    
+    #if SLEEP_IMU_GATE_MODEL
+    IMUGate _gate;
+    #endif
+    
+    #if ENABLE_IMU_GATE
+    uint32_t _gatedEpochs;
+    #endif
+    
+    #if ENABLE_ACTIGRAPHY_FALLBACK
+    ActigraphyScorer _actigraphy;
+    #endif
+    
+    #if ENABLE_HMM_SMOOTHING
+    HMMSmoother _smoother;
+    #endif
+    
+    #if ENABLE_ADAPTIVE_NORM
+    AdaptiveNormalizer _normalizer;
+    EpochFeatures _normalized;      // normalize() output
+    #endif
+    
+    #if ENABLE_INFERENCE_PROFILER
+    InferenceProfiler _profiler;
+    #endif
+    
+    #if SLEEP_MODEL_FROM_TFLITE
+    InputQuantizer _quantizer;      // Scaler + input quantization, fused
+    const float* _stagedMean;
+    const float* _stagedScale;
+    #endif
+    
+    #if INFERENCE_ENGINE == INFERENCE_ENGINE_NATIVE
+    Int8MLP _engines[2];            // Running and staged model
+    int _active;
+    int _staged;
+    #elif INFERENCE_ENGINE == INFERENCE_ENGINE_SEQUENCE
+    GRUStep _gru;
+    #elif INFERENCE_ENGINE == INFERENCE_ENGINE_TREES
+    TreeEnsemble _trees;
+    #elif INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM
+    const tflite::Model* _model;
+    const tflite::Model* _stagedModel;
+    tflite::MicroInterpreter* _interpreter;
+    alignas(tflite::MicroInterpreter) uint8_t _interpreterStorage[sizeof(tflite::MicroInterpreter)];
+    TfLiteTensor* _input;
+    TfLiteTensor* _output;
+    TfLiteTensor* _stateInput;      // Step models only, else nullptr
+    TfLiteTensor* _stateOutput;
+    float _sequenceState[RECURRENT_STATE_MAX];  // Outside the (shared) arena
+    uint32_t _modelId;              // CRC-32 of the running model
+    uint32_t _stagedId;
+    uint8_t* _tensorArena;
+    size_t _arenaUsed;
+    MemoryPlanner* _planner;        // Shared arena, or nullptr for the heap
+    int _arenaId;
+    bool _arenaCurrent;             // Arena still holds the interpreter
+    #if ENABLE_INFERENCE_PROFILER
+    TFLMProfilerAdapter _tflmProfiler;
+    #endif
+    #endif
+    
+    #if SLEEP_SEQUENCE_STATE
+    RecurrentStateStore _stateStore;
+    uint32_t _sequenceEpochs;
+    #endif
+    
+    #if SLEEP_MODEL_HOT_SWAP
+    ModelStore _store;
+    int _activeSlot;                // -1: embedded model
+    int _pendingSlot;
+    uint32_t _modelSequence;
+    uint32_t _pendingSequence;
+    bool _swapPending;
+    #endif
+    
+    #if SLEEP_SHADOW_MODEL
+    ShadowMonitor _shadowMonitor;
+    InputQuantizer _shadowQuantizer;    // Scaler + input quantization of the shadow
+    int _shadowSlot;                    // -1: no shadow
+    uint32_t _shadowSequence;
+    #if INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM
+    const tflite::Model* _shadowModel;
+    bool _shadowUnchecked;              // Tensors not checked yet (shared arena)
+    #endif
+    #endif
+    
+    /**
+     * Load the wearer's feature statistics (no-op without ENABLE_ADAPTIVE_NORM).
+     */
+    void beginNormalizer() {
+        #if ENABLE_ADAPTIVE_NORM
+        if (!_normalizer.begin(FEATURE_MEAN, FEATURE_SCALE, N_FEATURES,
+                               ADAPTIVE_NORM_HALF_LIFE, ADAPTIVE_NORM_WEIGHT,
+                               ADAPTIVE_NORM_NAMESPACE, ADAPTIVE_NORM_PERSIST_EPOCHS)) {
+            Serial.println("[NORM] Invalid scaler parameters, normalization off");
+        } else {
+            Serial.printf("[NORM] Per-user statistics from %lu epochs\n",
+                         (unsigned long)_normalizer.getUpdates());
+        }
+        #endif
+    }
+    
+    /**
+     * The first `count` features mapped onto the population, or `epoch`
+     * itself without ENABLE_ADAPTIVE_NORM. Valid until the next call.
+     */
+    const EpochFeatures& normalize(const EpochFeatures& epoch, int count) {
+        #if ENABLE_ADAPTIVE_NORM
+        if (_normalizer.getCount() > 0) {
+            _normalized = epoch;
+            _normalizer.apply(epoch.features, _normalized.features, count);
+            return _normalized;
+        }
+        #else
+        (void)count;
+        #endif
+        return epoch;
+    }
+    
+    /**
+     * Fold a decided epoch's first `count` raw features into the per-user
+     * statistics.
+     */
+    void adaptNormalizer(const EpochFeatures& epoch, int count) {
+        #if ENABLE_ADAPTIVE_NORM
+        _normalizer.update(epoch.features, count);
+        #else
+        (void)epoch;
+        (void)count;
+        #endif
+    }
+    
+    /**
+     * Epoch boundary: switch to a staged model before deciding the epoch.
+     * 
+     * @param inference Called from classify(); a TFLM swap builds the
+     *                  interpreter, so with a shared arena it waits for that
+     */
+    void startEpoch(bool inference) {
+        #if SLEEP_MODEL_HOT_SWAP
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM
+        bool canSwap = inference || !_planner;
+        #else
+        bool canSwap = true;
+        (void)inference;
+        #endif
+        if (_swapPending && canSwap) {
+            applyModelSwap();
+        }
+        #else
+        (void)inference;
+        #endif
+    }
+    
+    /**
+     * Profiler for the engines' events, or nullptr when profiling is off.
+     */
+    InferenceProfiler* profiler() {
+        #if ENABLE_INFERENCE_PROFILER
+        return &_profiler;
+        #else
+        return nullptr;
+        #endif
+    }
+    
+    /**
+     * Fill the common result fields once `probabilities` are set.
+     */
+    void finishResult(SleepStageResult& result, uint8_t predictedClass,
+                      unsigned long startTime) {
+        result.predictedClass = predictedClass;
+        result.className = SLEEP_CLASS_NAMES[predictedClass];
+        result.confidence = result.probabilities[predictedClass];
+        result.timestamp = millis();
+        result.valid = true;
+        result.inferenceTimeMs = (micros() - startTime) / 1000.0f;
+        result.provisional = false;
+        _epochs++;
+        
+        #if ENABLE_HMM_SMOOTHING
+        result.smoothedClass = (uint8_t)_smoother.update(result.probabilities,
+                                                        result.smoothedProbabilities);
+        result.laggedClass = (int8_t)_smoother.getLaggedStage();
+        #else
+        result.smoothedClass = predictedClass;
+        memcpy(result.smoothedProbabilities, result.probabilities, sizeof(result.probabilities));
+        result.laggedClass = -1;
+        #endif
+    }
+    
+    #if SLEEP_SEQUENCE_STATE
+    /**
+     * Load the stored state for this model into `state`, or zero it (none,
+     * or older than SEQUENCE_STATE_MAX_GAP_SEC: a new night).
+     */
+    bool restoreSequenceState(float* state, int units, uint32_t modelId) {
+        uint32_t epochs = 0;
+        if (_stateStore.restore(state, units, modelId, clockSeconds(), &epochs)) {
+            _sequenceEpochs = epochs;
+            Serial.printf("[SEQ] Resumed recurrent state after %u epochs\n", (unsigned)epochs);
+            return true;
+        }
+        memset(state, 0, units * sizeof(float));
+        _sequenceEpochs = 0;
+        return false;
+    }
+    
+    void recordSequenceStep(const float* state, int units, uint32_t modelId) {
+        _sequenceEpochs++;
+        _stateStore.save(state, units, modelId, _sequenceEpochs, clockSeconds());
+    }
+    
+    /**
+     * Seconds on the system clock, which runs on through deep sleep.
+     */
+    static uint32_t clockSeconds() {
+        return (uint32_t)time(nullptr);
+    }
+    #endif
+    
+    #if SLEEP_MODEL_FROM_TFLITE
+    /**
+     * Activate the newest stored model, then the older one, then the
+     * embedded one.
+     */
+    bool loadInitialModel() {
+        #if SLEEP_MODEL_HOT_SWAP
+        if (_store.begin(MODEL_PARTITION_A, MODEL_PARTITION_B)) {
+            int newest = _store.newestSlot();
+            for (int i = 0; newest >= 0 && i < MODEL_SLOT_COUNT; i++) {
+                int slot = (newest + i) % MODEL_SLOT_COUNT;
+                ModelImage image;
+                if (!_store.map(slot, &image)) continue;
+                if (stageImage(image) && activateStaged()) {
+                    _activeSlot = slot;
+                    _modelSequence = image.sequence;
+                    Serial.printf("[MODEL] Using slot %d (sequence %u, %d bytes)\n",
+                                 slot, (unsigned)image.sequence, (int)image.modelLength);
+                    return true;
+                }
+                _store.release(slot);
+                Serial.printf("[MODEL] Slot %d rejected\n", slot);
+            }
+        } else {
+            Serial.println("[MODEL] Model partitions not found, using embedded model");
+        }
+        #endif
+        
+        return stageModel(sleep_model_tflite, sleep_model_tflite_len,
+                          FEATURE_MEAN, FEATURE_SCALE) &&
+               activateStaged();
+    }
+    
+    /**
+     * Configure the fused quantizer for the active model's input.
+     */
+    bool configureQuantizer(float inputScale, int32_t inputZeroPoint) {
+        // Built aside so a rejected scaler leaves the running one intact
+        InputQuantizer next;
+        if (!next.begin(_stagedMean, _stagedScale, N_FEATURES,
+                        inputScale, inputZeroPoint)) {
+            Serial.println("[MODEL] Invalid scaler parameters");
+            return false;
+        }
+        _quantizer = next;
+        return true;
+    }
+    #endif
+    
+    #if SLEEP_MODEL_HOT_SWAP
+    bool stageImage(const ModelImage& image) {
+        if (image.scalerCount != 0 && image.scalerCount != N_FEATURES) {
+            Serial.printf("[MODEL] Scaler has %d features, expected %d\n",
+                         image.scalerCount, N_FEATURES);
+            return false;
+        }
+        return stageModel(image.model, image.modelLength,
+                          image.scalerCount ? image.mean : FEATURE_MEAN,
+                          image.scalerCount ? image.scale : FEATURE_SCALE);
+    }
+    
+    /**
+     * Map and stage the model in `slot`; applyModelSwap() switches to it.
+     */
+    bool stageSlot(int slot) {
+        #if SLEEP_SHADOW_MODEL
+        endShadow();    // Staging reuses the shadow's engine and slot mapping
+        #endif
+        
+        ModelImage image;
+        if (!_store.map(slot, &image)) {
+            return false;
+        }
+        if (!stageImage(image)) {
+            _store.release(slot);
+            Serial.printf("[MODEL] Slot %d rejected\n", slot);
+            return false;
+        }
+        
+        _pendingSlot = slot;
+        _pendingSequence = image.sequence;
+        _swapPending = true;
+        Serial.printf("[MODEL] Staged slot %d (sequence %u)\n", slot, (unsigned)image.sequence);
+        return true;
+    }
+    
+    /**
+     * Switch to the staged model. On failure the previous model keeps
+     * running and the staged slot is released.
+     */
+    void applyModelSwap() {
+        _swapPending = false;
+        int previousSlot = _activeSlot;
+        
+        if (!activateStaged()) {
+            _store.release(_pendingSlot);
+            Serial.printf("[MODEL] Swap to slot %d failed, keeping current model\n", _pendingSlot);
+            return;
+        }
+        
+        _activeSlot = _pendingSlot;
+        _modelSequence = _pendingSequence;
+        if (previousSlot >= 0) {
+            _store.release(previousSlot);
+        }
+        #if ENABLE_INFERENCE_PROFILER
+        _profiler.reset();      // Per-op statistics are per model
+        #endif
+        Serial.printf("[MODEL] Switched to slot %d (sequence %u)\n",
+                     _activeSlot, (unsigned)_modelSequence);
+    }
+    #endif
+    
+    #if SLEEP_SHADOW_MODEL
+    /**
+     * Run the shadow on the epoch `result` was classified from, if the
+     * budget allows, and log the pair.
+     */
+    void runShadow(const EpochFeatures& features, const SleepStageResult& result) {
+        if (_shadowSlot < 0) {
+            return;
+        }
+        if (_store.isUpdating()) {
+            endShadow();    // Its slot is being rewritten
+            return;
+        }
+        #if INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM
+        if (_shadowUnchecked && !checkShadow()) {
+            Serial.printf("[SHADOW] Slot %d rejected\n", _shadowSlot);
+            endShadow();
+            return;
+        }
+        #endif
+        if (!_shadowMonitor.shouldRun()) {
+            return;
+        }
+        
+        unsigned long startTime = micros();
+        float probabilities[N_SLEEP_CLASSES];
+        int stage = invokeShadow(features, probabilities);
+        if (stage < 0) {
+            Serial.println("[SHADOW] Shadow model failed");
+            endShadow();
+            return;
+        }
+        _shadowMonitor.record(result.predictedClass, result.confidence,
+                              stage, probabilities[stage], (micros() - startTime) / 1000.0f);
+    }
+    #endif
+    
+    #if INFERENCE_ENGINE == INFERENCE_ENGINE_NATIVE
+    /**
+     * Load a model into the idle engine; the running one is untouched.
+     */
+    bool stageModel(const uint8_t* model, size_t length,
+                    const float* mean, const float* scale) {
+        int next = _initialized ? 1 - _active : _active;
+        Int8MLP& mlp = _engines[next];
+        
+        if (!mlp.load(model, length)) {
+            Serial.printf("[MLP] Model load failed: %s\n", mlp.getError());
+            return false;
+        }
+        
+        if (mlp.getInputSize() != N_FEATURES || mlp.getOutputSize() != N_SLEEP_CLASSES) {
+            Serial.printf("[MLP] Model shape %d -> %d, expected %d -> %d\n",
+                         mlp.getInputSize(), mlp.getOutputSize(),
+                         N_FEATURES, N_SLEEP_CLASSES);
+            return false;
+        }
+        
+        _staged = next;
+        _stagedMean = mean;
+        _stagedScale = scale;
+        return true;
+    }
+    
+    bool activateStaged() {
+        const Int8MLP& mlp = _engines[_staged];
+        if (!configureQuantizer(mlp.getInputScale(), mlp.getInputZeroPoint())) {
+            return false;
+        }
+        _active = _staged;
+        return true;
+    }
+    
+    #if SLEEP_SHADOW_MODEL
+    /**
+     * Keep the staged model as the shadow: it stays in the idle engine.
+     */
+    bool attachShadow() {
+        const Int8MLP& mlp = _engines[_staged];
+        return _shadowQuantizer.begin(_stagedMean, _stagedScale, N_FEATURES,
+                                      mlp.getInputScale(), mlp.getInputZeroPoint());
+    }
+    
+    /**
+     * @return Shadow stage, or -1 on failure
+     */
+    int invokeShadow(const EpochFeatures& features, float* probabilities) {
+        Int8MLP& mlp = _engines[1 - _active];
+        int8_t inputData[N_FEATURES];
+        _shadowQuantizer.quantize(features.features, inputData);
+        mlp.invoke(inputData);
+        mlp.softmax(probabilities);
+        return mlp.argmax();
+    }
+    #endif
+    #elif INFERENCE_ENGINE == INFERENCE_ENGINE_TFLM
+    static tflite::MicroMutableOpResolver<16>& opResolver() {
+        // Set up the op resolver (add only the ops your model needs)
+        // MLP typically needs: FullyConnected, Relu, Softmax, BatchNorm (if used)
+        static tflite::MicroMutableOpResolver<16> resolver;
+        static bool registered = false;
+        if (!registered) {
+            resolver.AddFullyConnected();
+            resolver.AddRelu();
+            resolver.AddSoftmax();
+            resolver.AddReshape();
+            resolver.AddQuantize();
+            resolver.AddDequantize();
+            // GRU step models (export_sequence_model.py); also covers BatchNorm
+            resolver.AddLogistic();
+            resolver.AddTanh();
+            resolver.AddMul();
+            resolver.AddAdd();
+            resolver.AddSub();
+            resolver.AddSplit();
+            resolver.AddSplitV();
+            resolver.AddStridedSlice();
+            resolver.AddConcatenation();
+            registered = true;
+        }
+        return resolver;
+    }
+    
+    bool stageModel(const uint8_t* model, size_t length,
+                    const float* mean, const float* scale) {
+        const tflite::Model* next = tflite::GetModel(model);
+        if (next->version() != TFLITE_SCHEMA_VERSION) {
+            Serial.printf("[TFLITE] Model schema version mismatch: %d vs %d\n",
+                         next->version(), TFLITE_SCHEMA_VERSION);
+            return false;
+        }
+        
+        _stagedModel = next;
+        _stagedId = crc32Update(0, model, length);
+        _stagedMean = mean;
+        _stagedScale = scale;
+        return true;
+    }
+    
+    /**
+     * Copy the output tensor to probabilities (dequantized if int8).
+     * 
+     * @return Predicted class
+     */
+    static uint8_t readOutput(const TfLiteTensor* output, float* probabilities) {
+        uint8_t maxClass = 0;
+        if (output->type == kTfLiteFloat32) {
+            const float* outputData = output->data.f;
+            for (int i = 0; i < N_SLEEP_CLASSES; i++) {
+                probabilities[i] = outputData[i];
+                if (outputData[i] > outputData[maxClass]) maxClass = i;
+            }
+        } else if (output->type == kTfLiteInt8) {
+            const int8_t* outputData = output->data.int8;
+            float scale = output->params.scale;
+            int zero_point = output->params.zero_point;
+            
+            maxClass = argmaxInt8(outputData, N_SLEEP_CLASSES);
+            for (int i = 0; i < N_SLEEP_CLASSES; i++) {
+                probabilities[i] = (outputData[i] - zero_point) * scale;
+            }
+        }
+        return maxClass;
+    }
+    
+    /**
+     * (Re)build the interpreter in the same arena for `model`.
+     */
+    bool buildInterpreter(const tflite::Model* model) {
+        // With a shared arena the old interpreter's data was overwritten
+        // with the arena; it owns nothing else, so it is not destroyed
+        if (_interpreter && !_planner) {
+            _interpreter->~MicroInterpreter();
+        }
+        #if ENABLE_INFERENCE_PROFILER
+        _interpreter = new (_interpreterStorage) tflite::MicroInterpreter(
+            model, opResolver(), _tensorArena, TENSOR_ARENA_SIZE, nullptr, &_tflmProfiler);
+        #else
+        _interpreter = new (_interpreterStorage) tflite::MicroInterpreter(
+            model, opResolver(), _tensorArena, TENSOR_ARENA_SIZE);
+        #endif
+        
+        // Allocate tensors
+        if (_interpreter->AllocateTensors() != kTfLiteOk) {
+            Serial.println("[TFLITE] AllocateTensors() failed!");
+            return false;
+        }
+        _arenaUsed = _interpreter->arena_used_bytes();
+        _arenaCurrent = true;
+        
+        // Get input/output tensor info
+        _input = _interpreter->input(0);
+        _output = _interpreter->output(0);
+        
+        // Step model: second input is the previous state, second output
+        // the new one (float, same size)
+        _stateInput = nullptr;
+        _stateOutput = nullptr;
+        if (_interpreter->inputs_size() == 2 && _interpreter->outputs_size() == 2) {
+            TfLiteTensor* in = _interpreter->input(1);
+            TfLiteTensor* out = _interpreter->output(1);
+            if (in->type != kTfLiteFloat32 || out->type != kTfLiteFloat32 ||
+                in->bytes != out->bytes || in->bytes > RECURRENT_STATE_MAX * sizeof(float)) {
+                Serial.println("[TFLITE] Unsupported state tensors!");
+                return false;
+            }
+            _stateInput = in;
+            _stateOutput = out;
+        }
+        return true;
+    }
+    
+    /**
+     * Rebuild the interpreter for the staged model; on failure rebuild it
+     * for the previous one.
+     */
+    bool activateStaged() {
+        const tflite::Model* previous = _model;
+        if (!buildInterpreter(_stagedModel)) {
+            if (previous) buildInterpreter(previous);
+            return false;
+        }
+        
+        // Fold the scaler into the input quantization
+        bool quantizedInput = _input->type == kTfLiteInt8;
+        if (!configureQuantizer(quantizedInput ? _input->params.scale : 1.0f,
+                                quantizedInput ? _input->params.zero_point : 0)) {
+            if (previous) buildInterpreter(previous);
+            return false;
+        }
+        
+        _model = _stagedModel;
+        _modelId = _stagedId;
+        
+        // Resume this model's state; a different model starts from zero
+        if (_stateInput) {
+            restoreSequenceState(_sequenceState, _stateInput->bytes / sizeof(float), _modelId);
+        }
+        return true;
+    }
+    
+    #if SLEEP_SHADOW_MODEL
+    /**
+     * Build the shadow's interpreter in the active one's storage and arena
+     * (the active interpreter is rebuilt afterwards).
+     */
+    tflite::MicroInterpreter* buildShadowInterpreter() {
+        if (_interpreter && !_planner) {
+            _interpreter->~MicroInterpreter();
+        }
+        _interpreter = new (_interpreterStorage) tflite::MicroInterpreter(
+            _shadowModel, opResolver(), _tensorArena, TENSOR_ARENA_SIZE);
+        _arenaCurrent = false;
+        return _interpreter->AllocateTensors() == kTfLiteOk ? _interpreter : nullptr;
+    }
+    
+    /**
+     * Give the arena back to the active model. A shared arena goes back to
+     * the feature buffers; classify() rebuilds the interpreter anyway.
+     */
+    void restoreInterpreter() {
+        if (!_planner) {
+            buildInterpreter(_model);
+        }
+    }
+    
+    /**
+     * Keep the staged model as the shadow, if it is a plain classifier of
+     * the same features. A shared arena holds the feature buffers between
+     * classify() calls, so there the check waits for the next runShadow().
+     */
+    bool attachShadow() {
+        _shadowModel = _stagedModel;
+        if (_planner) {
+            _shadowUnchecked = true;
+            return true;
+        }
+        return checkShadow();
+    }
+    
+    /**
+     * Allocate the shadow's tensors and check their shapes and types.
+     */
+    bool checkShadow() {
+        _shadowUnchecked = false;
+        tflite::MicroInterpreter* shadow = buildShadowInterpreter();
+        bool usable = false;
+        if (shadow && shadow->inputs_size() == 1 && shadow->outputs_size() == 1) {
+            const TfLiteTensor* input = shadow->input(0);
+            const TfLiteTensor* output = shadow->output(0);
+            bool quantizedInput = input->type == kTfLiteInt8;
+            usable = (quantizedInput || input->type == kTfLiteFloat32) &&
+                     (output->type == kTfLiteInt8 || output->type == kTfLiteFloat32) &&
+                     input->bytes == N_FEATURES * (quantizedInput ? 1 : sizeof(float)) &&
+                     output->bytes == N_SLEEP_CLASSES *
+                         (output->type == kTfLiteInt8 ? 1 : sizeof(float)) &&
+                     _shadowQuantizer.begin(_stagedMean, _stagedScale, N_FEATURES,
+                                            quantizedInput ? input->params.scale : 1.0f,
+                                            quantizedInput ? input->params.zero_point : 0);
+        }
+        restoreInterpreter();
+        if (!usable) {
+            _shadowModel = nullptr;
+        }
+        return usable;
+    }
+    
+    /**
+     * @return Shadow stage, or -1 on failure
+     */
+    int invokeShadow(const EpochFeatures& features, float* probabilities) {
+        int stage = -1;
+        tflite::MicroInterpreter* shadow = buildShadowInterpreter();
+        if (shadow) {
+            TfLiteTensor* input = shadow->input(0);
+            if (input->type == kTfLiteFloat32) {
+                _shadowQuantizer.scale(features.features, input->data.f);
+            } else {
+                _shadowQuantizer.quantize(features.features, input->data.int8);
+            }
+            if (shadow->Invoke() == kTfLiteOk) {
+                stage = readOutput(shadow->output(0), probabilities);
+            }
+        }
+        restoreInterpreter();
+        return stage;
+    }
+    #endif
+    #endif
+};
+
+#endif // SLEEP_CLASSIFIER_H
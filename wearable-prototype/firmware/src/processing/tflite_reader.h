@@ -0,0 +1,193 @@
+/**
+ * Minimal TFLite Flatbuffer Reader
+ * ================================
+ *
+ * Read-only, bounds-checked accessors for the subset of the .tflite schema
+ * (schema.fbs, version 3) that the native inference engine needs: tensors,
+ * quantization parameters, buffers, operators and their options.
+ *
+ * No flatbuffers or TFLM headers are required, so the reader builds on the
+ * host. Tables and vectors are referred to by their byte offset in the model
+ * buffer; 0 means "absent".
+ */
+
+#ifndef TFLITE_READER_H
+#define TFLITE_READER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ============================================================================
+// Schema Constants (tensorflow/lite/schema/schema.fbs)
+// ============================================================================
+
+// Table field indices
+#define TFL_MODEL_VERSION           0
+#define TFL_MODEL_OPERATOR_CODES    1
+#define TFL_MODEL_SUBGRAPHS         2
+#define TFL_MODEL_BUFFERS           4
+
+#define TFL_OPCODE_DEPRECATED_CODE  0
+#define TFL_OPCODE_BUILTIN_CODE     3
+
+#define TFL_SUBGRAPH_TENSORS        0
+#define TFL_SUBGRAPH_INPUTS         1
+#define TFL_SUBGRAPH_OUTPUTS        2
+#define TFL_SUBGRAPH_OPERATORS      3
+
+#define TFL_TENSOR_SHAPE            0
+#define TFL_TENSOR_TYPE             1
+#define TFL_TENSOR_BUFFER           2
+#define TFL_TENSOR_QUANTIZATION     4
+
+#define TFL_QUANT_SCALE             2
+#define TFL_QUANT_ZERO_POINT        3
+
+#define TFL_OP_OPCODE_INDEX         0
+#define TFL_OP_INPUTS               1
+#define TFL_OP_OUTPUTS              2
+#define TFL_OP_BUILTIN_OPTIONS      4
+
+#define TFL_BUFFER_DATA             0
+
+#define TFL_FC_FUSED_ACTIVATION     0
+#define TFL_SOFTMAX_BETA            0
+
+// Builtin operators
+#define TFL_OP_DEQUANTIZE           6
+#define TFL_OP_FULLY_CONNECTED      9
+#define TFL_OP_RELU                 19
+#define TFL_OP_RESHAPE              22
+#define TFL_OP_SOFTMAX              25
+#define TFL_OP_QUANTIZE             114
+
+// Tensor types
+#define TFL_TYPE_FLOAT32            0
+#define TFL_TYPE_INT32              2
+#define TFL_TYPE_INT8               9
+
+// Fused activations
+#define TFL_ACT_NONE                0
+#define TFL_ACT_RELU                1
+#define TFL_ACT_RELU6               3
+
+#define TFL_SCHEMA_VERSION          3
+
+
+// ============================================================================
+// Flatbuffer Reader
+// ============================================================================
+
+class TFLiteReader {
+public:
+    TFLiteReader() : _data(nullptr), _length(0) {}
+
+    /**
+     * Attach to a model buffer and check the file identifier and version.
+     *
+     * @return true if this looks like a version 3 .tflite flatbuffer
+     */
+    bool begin(const uint8_t* data, size_t length) {
+        _data = data;
+        _length = length;
+        if (!data || length < 16 || memcmp(data + 4, "TFL3", 4) != 0) {
+            _length = 0;
+            return false;
+        }
+        return readScalar<uint32_t>(root(), TFL_MODEL_VERSION, 0) == TFL_SCHEMA_VERSION;
+    }
+
+    uint32_t root() const {
+        return deref(0);
+    }
+
+    // ---- Tables ----
+
+    /**
+     * Byte offset of field `index` inside `table`, or 0 if absent.
+     */
+    uint32_t field(uint32_t table, int index) const {
+        if (table == 0 || !inBounds(table, 4)) return 0;
+        int32_t soffset = readRaw<int32_t>(table);
+        int64_t vtable = (int64_t)table - soffset;
+        if (vtable < 0 || !inBounds((uint32_t)vtable, 4)) return 0;
+
+        uint16_t vtableSize = readRaw<uint16_t>((uint32_t)vtable);
+        uint32_t entry = 4 + 2 * (uint32_t)index;
+        if (entry + 2 > vtableSize || !inBounds((uint32_t)vtable + entry, 2)) return 0;
+
+        uint16_t offset = readRaw<uint16_t>((uint32_t)vtable + entry);
+        return offset ? table + offset : 0;
+    }
+
+    template <typename T>
+    T readScalar(uint32_t table, int index, T defaultValue) const {
+        uint32_t pos = field(table, index);
+        if (pos == 0 || !inBounds(pos, sizeof(T))) return defaultValue;
+        return readRaw<T>(pos);
+    }
+
+    /**
+     * Follow an offset field (sub-table, vector or string).
+     */
+    uint32_t child(uint32_t table, int index) const {
+        uint32_t pos = field(table, index);
+        return pos ? deref(pos) : 0;
+    }
+
+    // ---- Vectors ----
+
+    uint32_t vectorLength(uint32_t vec) const {
+        if (vec == 0 || !inBounds(vec, 4)) return 0;
+        return readRaw<uint32_t>(vec);
+    }
+
+    /**
+     * Pointer to the elements of a vector, or nullptr if they do not fit.
+     */
+    const uint8_t* vectorData(uint32_t vec, size_t elementSize) const {
+        uint32_t n = vectorLength(vec);
+        if (vec == 0 || !inBounds(vec + 4, (size_t)n * elementSize)) return nullptr;
+        return _data + vec + 4;
+    }
+
+    template <typename T>
+    T vectorScalar(uint32_t vec, uint32_t i, T defaultValue) const {
+        if (i >= vectorLength(vec) || !inBounds(vec + 4 + i * sizeof(T), sizeof(T))) {
+            return defaultValue;
+        }
+        return readRaw<T>(vec + 4 + i * (uint32_t)sizeof(T));
+    }
+
+    /**
+     * Element i of a vector of tables.
+     */
+    uint32_t vectorTable(uint32_t vec, uint32_t i) const {
+        if (i >= vectorLength(vec)) return 0;
+        return deref(vec + 4 + 4 * i);
+    }
+
+private:
+    const uint8_t* _data;
+    size_t _length;
+
+    bool inBounds(uint32_t pos, size_t size) const {
+        return (size_t)pos <= _length && size <= _length - pos;
+    }
+
+    template <typename T>
+    T readRaw(uint32_t pos) const {
+        T value;
+        memcpy(&value, _data + pos, sizeof(T));   // Flatbuffers are little endian
+        return value;
+    }
+
+    uint32_t deref(uint32_t pos) const {
+        if (!inBounds(pos, 4)) return 0;
+        uint64_t target = (uint64_t)pos + readRaw<uint32_t>(pos);
+        return target < _length ? (uint32_t)target : 0;
+    }
+};
+
+#endif // TFLITE_READER_H
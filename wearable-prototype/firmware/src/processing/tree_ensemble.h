@@ -0,0 +1,244 @@
+/**
+ * Tree Ensemble Engine
+ * ====================
+ *
+ * Evaluates random forests and gradient-boosted trees exported by
+ * model-training/scripts/export_tree_model.py (scikit-learn or XGBoost).
+ *
+ * Each tree is a flat array of 8-byte nodes in breadth-first order, root
+ * first, with the two children of a node next to each other. One level of
+ * the walk is
+ *
+ *   node = tree[node.next + (x[node.feature] > node.threshold)]
+ *
+ * so the split direction is an index, not a branch; the only branch is
+ * the (well predicted) test for a leaf. A tree of depth d touches d nodes,
+ * and the top levels sit in the first cache lines of the tree. Trees are
+ * walked TREE_INTERLEAVE at a time, so their node loads overlap.
+ *
+ *   TREE_KIND_FOREST   Leaves hold class distributions; the probabilities
+ *                      are their mean over the trees (predict_proba)
+ *   TREE_KIND_BOOSTED  Leaves hold one score for their tree's class; the
+ *                      scores are summed per class on top of a base score,
+ *                      then softmax (learning rate folded into the leaves)
+ *
+ * Features go in raw; trees do not need the scaler. Thresholds are stored
+ * as the largest float at which the trainer's split still goes left, so
+ * float features split exactly as in training.
+ */
+
+#ifndef TREE_ENSEMBLE_H
+#define TREE_ENSEMBLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include "inference_profiler.h"
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define TREE_KIND_FOREST    0
+#define TREE_KIND_BOOSTED   1
+
+#define TREE_LEAF           0xFF    // Node feature of a leaf
+#define TREE_MAX_CLASSES    8
+#define TREE_INTERLEAVE     4       // Trees walked together
+
+
+// ============================================================================
+// Node
+// ============================================================================
+
+struct TreeNode {
+    float threshold;        // Right child if x[feature] > threshold
+    uint8_t feature;        // TREE_LEAF for leaves
+    uint8_t reserved;
+    uint16_t next;          // Left child (right is next + 1), from the tree's
+                            // root; for a leaf, its index in the tree's leaves
+};
+
+
+// ============================================================================
+// Tree Ensemble Class
+// ============================================================================
+
+class TreeEnsemble {
+public:
+    TreeEnsemble() : _nodes(nullptr), _roots(nullptr), _leafBase(nullptr),
+                     _treeClass(nullptr), _leafValues(nullptr), _baseScore(nullptr),
+                     _kind(TREE_KIND_FOREST), _trees(0), _nodeCount(0), _leafCount(0),
+                     _classes(0) {}
+
+    /**
+     * Check and attach an exported ensemble (arrays stay in flash).
+     *
+     * @param nodes All trees back to back, nodeCount nodes
+     * @param roots [trees] first node of each tree
+     * @param leafBase [trees] first leaf of each tree in leafValues
+     * @param treeClass [trees] class a boosted tree scores (unused for forests)
+     * @param leafValues Per leaf: `classes` values (forest) or one (boosted)
+     * @param baseScore [classes] boosted starting scores (unused for forests)
+     * @param features Feature vector length
+     * @return false if the arrays are inconsistent (a walk could leave them)
+     */
+    bool begin(int kind, const TreeNode* nodes, uint32_t nodeCount,
+               const uint32_t* roots, const uint32_t* leafBase, const uint8_t* treeClass,
+               int trees, const float* leafValues, uint32_t leafCount,
+               const float* baseScore, int classes, int features) {
+        _trees = 0;
+        if ((kind != TREE_KIND_FOREST && kind != TREE_KIND_BOOSTED) || trees <= 0 ||
+            classes <= 1 || classes > TREE_MAX_CLASSES || features <= 0 ||
+            features >= TREE_LEAF) {
+            return false;
+        }
+
+        for (int t = 0; t < trees; t++) {
+            uint32_t end = t + 1 < trees ? roots[t + 1] : nodeCount;
+            uint32_t leafEnd = t + 1 < trees ? leafBase[t + 1] : leafCount;
+            if (roots[t] >= end || end > nodeCount || leafBase[t] > leafEnd ||
+                leafEnd > leafCount || end - roots[t] > 0xFFFF) {
+                return false;
+            }
+            if (kind == TREE_KIND_BOOSTED && treeClass[t] >= classes) return false;
+
+            // Children come after their parent, so every walk ends at a leaf
+            for (uint32_t i = 0; i < end - roots[t]; i++) {
+                const TreeNode& node = nodes[roots[t] + i];
+                if (node.feature == TREE_LEAF) {
+                    if (leafBase[t] + node.next >= leafEnd) return false;
+                } else if (node.feature >= features || node.next <= i ||
+                           (uint32_t)node.next + 1 >= end - roots[t]) {
+                    return false;
+                }
+            }
+        }
+
+        _kind = kind;
+        _nodes = nodes;
+        _roots = roots;
+        _leafBase = leafBase;
+        _treeClass = treeClass;
+        _leafValues = leafValues;
+        _baseScore = baseScore;
+        _nodeCount = nodeCount;
+        _leafCount = leafCount;
+        _classes = classes;
+        _trees = trees;
+        return true;
+    }
+
+    /**
+     * Classify one feature vector.
+     *
+     * @param features Raw features
+     * @param probabilities Output, `classes` values summing to 1
+     * @param profiler Records a TREES event (optional)
+     * @return Most likely class
+     */
+    int predict(const float* features, float* probabilities,
+                InferenceProfiler* profiler = nullptr) const {
+        ProfileScope event(profiler, "TREES");
+        const int valuesPerLeaf = _kind == TREE_KIND_FOREST ? _classes : 1;
+
+        float scores[TREE_MAX_CLASSES];
+        for (int c = 0; c < _classes; c++) {
+            scores[c] = _kind == TREE_KIND_BOOSTED ? _baseScore[c] : 0.0f;
+        }
+
+        for (int t = 0; t < _trees; t += TREE_INTERLEAVE) {
+            int group = _trees - t < TREE_INTERLEAVE ? _trees - t : TREE_INTERLEAVE;
+            uint32_t leaves[TREE_INTERLEAVE];
+            walk(features, t, group, leaves);
+
+            for (int g = 0; g < group; g++) {
+                const float* value = _leafValues + (size_t)leaves[g] * valuesPerLeaf;
+                if (_kind == TREE_KIND_FOREST) {
+                    for (int c = 0; c < _classes; c++) scores[c] += value[c];
+                } else {
+                    scores[_treeClass[t + g]] += value[0];
+                }
+            }
+        }
+
+        int best = 0;
+        for (int c = 1; c < _classes; c++) {
+            if (scores[c] > scores[best]) best = c;
+        }
+
+        if (_kind == TREE_KIND_FOREST) {
+            for (int c = 0; c < _classes; c++) probabilities[c] = scores[c] / _trees;
+        } else {
+            float sum = 0.0f;
+            for (int c = 0; c < _classes; c++) {
+                probabilities[c] = expf(scores[c] - scores[best]);
+                sum += probabilities[c];
+            }
+            for (int c = 0; c < _classes; c++) probabilities[c] /= sum;
+        }
+        return best;
+    }
+
+    // ---- Model info ----
+
+    bool isLoaded() const { return _trees > 0; }
+    int getKind() const { return _kind; }
+    int getTreeCount() const { return _trees; }
+    uint32_t getNodeCount() const { return _nodeCount; }
+    uint32_t getLeafCount() const { return _leafCount; }
+
+    /**
+     * Flash taken by the exported arrays.
+     */
+    size_t getModelBytes() const {
+        size_t valuesPerLeaf = _kind == TREE_KIND_FOREST ? _classes : 1;
+        return _nodeCount * sizeof(TreeNode) + _leafCount * valuesPerLeaf * sizeof(float) +
+               _trees * (2 * sizeof(uint32_t) + 1) + _classes * sizeof(float);
+    }
+
+private:
+    const TreeNode* _nodes;
+    const uint32_t* _roots;
+    const uint32_t* _leafBase;
+    const uint8_t* _treeClass;
+    const float* _leafValues;
+    const float* _baseScore;
+    int _kind;
+    int _trees;
+    uint32_t _nodeCount;
+    uint32_t _leafCount;
+    int _classes;
+
+    /**
+     * Walk trees first..first + count - 1 to their leaves, a level of each
+     * per round.
+     *
+     * @param leaves Output, global leaf indices
+     */
+    void walk(const float* x, int first, int count, uint32_t* leaves) const {
+        const TreeNode* trees[TREE_INTERLEAVE];
+        const TreeNode* node[TREE_INTERLEAVE];
+        for (int g = 0; g < count; g++) {
+            trees[g] = _nodes + _roots[first + g];
+            node[g] = trees[g];
+        }
+
+        bool walking = true;
+        while (walking) {
+            walking = false;
+            for (int g = 0; g < count; g++) {
+                const TreeNode* n = node[g];
+                if (n->feature == TREE_LEAF) continue;
+                node[g] = trees[g] + n->next + (x[n->feature] > n->threshold);
+                walking = true;
+            }
+        }
+
+        for (int g = 0; g < count; g++) {
+            leaves[g] = _leafBase[first + g] + node[g]->next;
+        }
+    }
+};
+
+#endif // TREE_ENSEMBLE_H
@@ -0,0 +1,242 @@
+/**
+ * I2C Bus Backend
+ * ===============
+ *
+ * Register reads for the I2C scheduler (i2c_scheduler.h): write the
+ * register address, repeated start, read `length` bytes.
+ *
+ * On the device this is the ESP-IDF I2C master driver on I2C_BUS_PORT,
+ * the port Wire.begin() installed it on, so scheduled reads and the
+ * libraries' Wire transactions are serialized by the driver. The calling
+ * task sleeps on the driver's semaphore while the peripheral moves the
+ * bytes; the CPU is free for other tasks.
+ *
+ * On the host (no ARDUINO) the bus is a mock: up to I2C_MOCK_DEVICES
+ * register files with auto-increment, an optional FIFO port register per
+ * device (reads pop a byte queue and do not advance the address), absent
+ * addresses NACK, and a simulated microsecond clock that advances by each
+ * transaction's time on the wire at the configured bus speed. Transactions
+ * are logged for tests.
+ */
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include "driver/i2c.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#endif
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define I2C_BUS_PORT            0       // I2C_NUM_0, as used by Wire
+#define I2C_BUS_TIMEOUT_MS      20
+
+#define I2C_MOCK_DEVICES        4
+#define I2C_MOCK_FIFO_SIZE      1024
+#define I2C_MOCK_LOG_SIZE       64
+
+
+#ifdef ARDUINO
+// ============================================================================
+// ESP-IDF Backend
+// ============================================================================
+
+class I2CBus {
+public:
+    I2CBus() : _frequencyHz(0) {}
+
+    /**
+     * @param frequencyHz Bus speed, already set by Wire (bookkeeping only)
+     */
+    bool begin(uint32_t frequencyHz) {
+        _frequencyHz = frequencyHz;
+        return true;
+    }
+
+    bool readRegisters(uint8_t address, uint8_t reg, uint8_t* out, uint16_t length) {
+        return i2c_master_write_read_device((i2c_port_t)I2C_BUS_PORT, address, &reg, 1,
+                                            out, length,
+                                            pdMS_TO_TICKS(I2C_BUS_TIMEOUT_MS)) == ESP_OK;
+    }
+
+    uint32_t nowMicros() const {
+        return (uint32_t)esp_timer_get_time();
+    }
+
+    uint32_t getFrequency() const { return _frequencyHz; }
+
+private:
+    uint32_t _frequencyHz;
+};
+
+#else
+// ============================================================================
+// Mock Backend (host)
+// ============================================================================
+
+struct I2CMockTransaction {
+    uint8_t address;
+    uint8_t reg;
+    uint16_t length;
+    bool ok;
+};
+
+class I2CBus {
+public:
+    I2CBus() : _frequencyHz(400000), _devices(0), _clockUs(0), _logged(0) {}
+
+    bool begin(uint32_t frequencyHz) {
+        if (frequencyHz == 0) return false;
+        _frequencyHz = frequencyHz;
+        return true;
+    }
+
+    bool readRegisters(uint8_t address, uint8_t reg, uint8_t* out, uint16_t length) {
+        MockDevice* device = find(address);
+        bool ok = device != nullptr;
+        if (ok) {
+            uint8_t cursor = reg;
+            for (uint16_t i = 0; i < length; i++) {
+                if (device->hasFifo && cursor == device->fifoReg) {
+                    out[i] = popFifo(*device);
+                } else {
+                    out[i] = device->regs[cursor++];
+                }
+            }
+        }
+        // A NACKed address byte ends the transaction early
+        _clockUs += ok ? transactionMicros(length) : bitsMicros(9 + 2);
+        log(address, reg, length, ok);
+        return ok;
+    }
+
+    uint32_t nowMicros() const { return _clockUs; }
+
+    uint32_t getFrequency() const { return _frequencyHz; }
+
+    // ---- Mock setup ----
+
+    /**
+     * Attach a device with zeroed registers (false when full or present).
+     */
+    bool addDevice(uint8_t address) {
+        if (_devices >= I2C_MOCK_DEVICES || find(address)) return false;
+        MockDevice& device = _device[_devices++];
+        memset(&device, 0, sizeof(device));
+        device.address = address;
+        return true;
+    }
+
+    void setRegister(uint8_t address, uint8_t reg, uint8_t value) {
+        MockDevice* device = find(address);
+        if (device) device->regs[reg] = value;
+    }
+
+    /**
+     * Make `reg` a FIFO port: reads pop pushFifo() bytes (0 when empty).
+     */
+    void setFifoPort(uint8_t address, uint8_t reg) {
+        MockDevice* device = find(address);
+        if (!device) return;
+        device->hasFifo = true;
+        device->fifoReg = reg;
+    }
+
+    /**
+     * Queue bytes behind the FIFO port (the oldest are dropped when full).
+     */
+    void pushFifo(uint8_t address, const uint8_t* bytes, int count) {
+        MockDevice* device = find(address);
+        if (!device) return;
+        for (int i = 0; i < count; i++) {
+            device->fifo[(device->fifoHead + device->fifoCount) % I2C_MOCK_FIFO_SIZE] = bytes[i];
+            if (device->fifoCount < I2C_MOCK_FIFO_SIZE) {
+                device->fifoCount++;
+            } else {
+                device->fifoHead = (device->fifoHead + 1) % I2C_MOCK_FIFO_SIZE;
+            }
+        }
+    }
+
+    /**
+     * Let idle time pass on the simulated clock.
+     */
+    void advance(uint32_t micros) { _clockUs += micros; }
+
+    /**
+     * Wire time of a register read of `length` bytes: address + register,
+     * repeated start, address + data, each byte with its ACK bit, plus
+     * start, repeated start and stop.
+     */
+    uint32_t transactionMicros(uint16_t length) const {
+        return bitsMicros(9 * (3 + (uint32_t)length) + 3);
+    }
+
+    int getTransactions() const { return _logged; }
+
+    /**
+     * Logged transaction, 0 = oldest of the last I2C_MOCK_LOG_SIZE.
+     */
+    const I2CMockTransaction& getTransaction(int index) const {
+        int first = _logged < I2C_MOCK_LOG_SIZE ? 0 : _logged - I2C_MOCK_LOG_SIZE;
+        return _log[(first + index) % I2C_MOCK_LOG_SIZE];
+    }
+
+    void clearLog() { _logged = 0; }
+
+private:
+    struct MockDevice {
+        uint8_t address;
+        uint8_t regs[256];
+        bool hasFifo;
+        uint8_t fifoReg;
+        uint8_t fifo[I2C_MOCK_FIFO_SIZE];
+        int fifoHead;
+        int fifoCount;
+    };
+
+    uint32_t _frequencyHz;
+    MockDevice _device[I2C_MOCK_DEVICES];
+    int _devices;
+    uint32_t _clockUs;
+    I2CMockTransaction _log[I2C_MOCK_LOG_SIZE];
+    int _logged;
+
+    MockDevice* find(uint8_t address) {
+        for (int i = 0; i < _devices; i++) {
+            if (_device[i].address == address) return &_device[i];
+        }
+        return nullptr;
+    }
+
+    static uint8_t popFifo(MockDevice& device) {
+        if (device.fifoCount == 0) return 0;
+        uint8_t value = device.fifo[device.fifoHead];
+        device.fifoHead = (device.fifoHead + 1) % I2C_MOCK_FIFO_SIZE;
+        device.fifoCount--;
+        return value;
+    }
+
+    uint32_t bitsMicros(uint32_t bits) const {
+        return (uint32_t)(((uint64_t)bits * 1000000 + _frequencyHz / 2) / _frequencyHz);
+    }
+
+    void log(uint8_t address, uint8_t reg, uint16_t length, bool ok) {
+        I2CMockTransaction& entry = _log[_logged % I2C_MOCK_LOG_SIZE];
+        entry.address = address;
+        entry.reg = reg;
+        entry.length = length;
+        entry.ok = ok;
+        _logged++;
+    }
+};
+#endif
+
+#endif // I2C_BUS_H
@@ -0,0 +1,286 @@
+/**
+ * I2C Transaction Scheduler
+ * =========================
+ *
+ * One queue of register reads for every device on the sensor bus. Drivers
+ * submit() a read with a completion callback and return; process() runs
+ * the queue on the bus backend (i2c_bus.h) and calls each request back
+ * with its bytes, where the driver may queue its next read (e.g. the FIFO
+ * data once the FIFO count is known). process() keeps going until the
+ * queue is empty, so a whole drain of both sensors is one call.
+ *
+ * Adjacent reads are merged: requests to the same device whose registers
+ * follow each other (reg == previous reg + length) become one burst of up
+ * to I2C_SCHED_MAX_BURST bytes, also when requests to other devices sit
+ * between them. A request flagged I2C_READ_STREAM (a FIFO data port,
+ * where the address does not advance) is never merged, and a request that
+ * cannot merge ends the search for its device, so reads of one device
+ * always run in submission order.
+ *
+ * submit() and process() must run in the same task; callbacks run inside
+ * process(), which is not reentrant. getStats() reports request latency
+ * (submit to completion, so queue wait included) min / mean / max, bus
+ * time per transaction and bus utilization since resetStats(); reset at
+ * least every 71 minutes (32-bit microsecond clock).
+ */
+
+#ifndef I2C_SCHEDULER_H
+#define I2C_SCHEDULER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "i2c_bus.h"
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define I2C_SCHED_QUEUE         16      // Pending requests
+#define I2C_SCHED_MAX_BURST     32      // Bytes of one merged transaction
+
+// Request flags
+#define I2C_READ_STREAM         0x01    // FIFO port: never merged
+
+
+// ============================================================================
+// Requests
+// ============================================================================
+
+struct I2CRequest;
+
+/**
+ * @param ok false if the device did not answer (the buffer is undefined)
+ */
+typedef void (*I2CCallback)(void* context, const I2CRequest& request, bool ok);
+
+struct I2CRequest {
+    uint8_t address;            // 7-bit device address
+    uint8_t reg;                // First register
+    uint16_t length;            // Bytes to read
+    uint8_t flags;              // I2C_READ_*
+    uint8_t* buffer;            // Destination, `length` bytes
+    I2CCallback callback;       // nullptr: none
+    void* context;
+    uint32_t queuedUs;          // Bus clock at submit()
+};
+
+struct I2CStats {
+    uint32_t requests;          // Submitted
+    uint32_t transactions;      // Run on the bus
+    uint32_t merged;            // Requests that rode along in another's burst
+    uint32_t failed;            // Completed with ok = false
+    uint32_t rejected;          // Queue full
+    uint32_t minLatencyUs;      // Submit to completion
+    uint32_t maxLatencyUs;
+    float meanLatencyUs;
+    float meanTransactionUs;    // Bus time of one transaction
+    float utilization;          // Bus time / window, 0..1
+    uint32_t windowUs;          // Time since resetStats()
+};
+
+
+// ============================================================================
+// I2C Scheduler Class
+// ============================================================================
+
+class I2CScheduler {
+public:
+    I2CScheduler() : _bus(nullptr), _count(0) {
+        resetStats();
+    }
+
+    void begin(I2CBus& bus) {
+        _bus = &bus;
+        _count = 0;
+        resetStats();
+    }
+
+    /**
+     * Queue a register read.
+     *
+     * @return false if the queue is full (counted) or the request is empty
+     */
+    bool submit(uint8_t address, uint8_t reg, uint8_t* buffer, uint16_t length,
+                uint8_t flags, I2CCallback callback, void* context) {
+        if (!_bus || !buffer || length == 0) {
+            return false;
+        }
+        if (_count >= I2C_SCHED_QUEUE) {
+            _rejected++;
+            return false;
+        }
+        I2CRequest& request = _queue[_count++];
+        request.address = address;
+        request.reg = reg;
+        request.length = length;
+        request.flags = flags;
+        request.buffer = buffer;
+        request.callback = callback;
+        request.context = context;
+        request.queuedUs = _bus->nowMicros();
+        _requests++;
+        return true;
+    }
+
+    /**
+     * Run the queue, including reads submitted by the callbacks, until it
+     * is empty.
+     *
+     * @return Bus transactions run
+     */
+    int process() {
+        int transactions = 0;
+        while (_count > 0) {
+            int merged = takeBatch(_batch);
+            bool ok = runBatch(_batch, merged);
+            transactions++;
+
+            for (int i = 0; i < merged; i++) {
+                if (_batch[i].callback) {
+                    _batch[i].callback(_batch[i].context, _batch[i], ok);
+                }
+            }
+        }
+        return transactions;
+    }
+
+    int pending() const { return _count; }
+
+    /**
+     * Requests that can still be queued (a driver checks before queuing
+     * a group of reads).
+     */
+    int space() const { return I2C_SCHED_QUEUE - _count; }
+
+    // ---- Statistics ----
+
+    void resetStats() {
+        _requests = 0;
+        _transactions = 0;
+        _merged = 0;
+        _failed = 0;
+        _rejected = 0;
+        _completed = 0;
+        _latencySumUs = 0;
+        _latencyMinUs = UINT32_MAX;
+        _latencyMaxUs = 0;
+        _busyUs = 0;
+        _statsStartUs = _bus ? _bus->nowMicros() : 0;
+    }
+
+    I2CStats getStats() const {
+        I2CStats stats;
+        stats.requests = _requests;
+        stats.transactions = _transactions;
+        stats.merged = _merged;
+        stats.failed = _failed;
+        stats.rejected = _rejected;
+        stats.minLatencyUs = _completed > 0 ? _latencyMinUs : 0;
+        stats.maxLatencyUs = _latencyMaxUs;
+        stats.meanLatencyUs = _completed > 0 ? (float)((double)_latencySumUs / _completed) : 0.0f;
+        stats.meanTransactionUs = _transactions > 0 ? (float)_busyUs / _transactions : 0.0f;
+        stats.windowUs = _bus ? _bus->nowMicros() - _statsStartUs : 0;
+        stats.utilization = stats.windowUs > 0 ? (float)_busyUs / stats.windowUs : 0.0f;
+        return stats;
+    }
+
+private:
+    I2CBus* _bus;
+    I2CRequest _queue[I2C_SCHED_QUEUE];     // Submission order
+    int _count;
+    I2CRequest _batch[I2C_SCHED_QUEUE];     // Transaction being run
+    uint8_t _burst[I2C_SCHED_MAX_BURST];
+
+    uint32_t _requests;
+    uint32_t _transactions;
+    uint32_t _merged;
+    uint32_t _failed;
+    uint32_t _rejected;
+    uint32_t _completed;
+    uint64_t _latencySumUs;
+    uint32_t _latencyMinUs;
+    uint32_t _latencyMaxUs;
+    uint32_t _busyUs;
+    uint32_t _statsStartUs;
+
+    static bool mergeable(const I2CRequest& request) {
+        return (request.flags & I2C_READ_STREAM) == 0 && request.length <= I2C_SCHED_MAX_BURST;
+    }
+
+    void remove(int index) {
+        for (int i = index + 1; i < _count; i++) {
+            _queue[i - 1] = _queue[i];
+        }
+        _count--;
+    }
+
+    /**
+     * Move the oldest request and the reads that continue it into `batch`.
+     *
+     * @return Requests taken
+     */
+    int takeBatch(I2CRequest* batch) {
+        batch[0] = _queue[0];
+        remove(0);
+        if (!mergeable(batch[0])) {
+            return 1;
+        }
+
+        int taken = 1;
+        uint32_t next = (uint32_t)batch[0].reg + batch[0].length;
+        uint32_t total = batch[0].length;
+        for (int i = 0; i < _count; i++) {
+            const I2CRequest& candidate = _queue[i];
+            if (candidate.address != batch[0].address) {
+                continue;
+            }
+            if (!mergeable(candidate) || candidate.reg != next ||
+                total + candidate.length > I2C_SCHED_MAX_BURST) {
+                break;      // Keeps this device's reads in order
+            }
+            batch[taken++] = candidate;
+            next += candidate.length;
+            total += candidate.length;
+            remove(i--);
+        }
+        return taken;
+    }
+
+    /**
+     * One bus transaction for `count` contiguous requests.
+     */
+    bool runBatch(I2CRequest* batch, int count) {
+        const I2CRequest& first = batch[0];
+        uint32_t start = _bus->nowMicros();
+        bool ok;
+        if (count == 1) {
+            ok = _bus->readRegisters(first.address, first.reg, first.buffer, first.length);
+        } else {
+            uint16_t total = 0;
+            for (int i = 0; i < count; i++) total += batch[i].length;
+            ok = _bus->readRegisters(first.address, first.reg, _burst, total);
+            uint16_t offset = 0;
+            for (int i = 0; ok && i < count; i++) {
+                memcpy(batch[i].buffer, _burst + offset, batch[i].length);
+                offset += batch[i].length;
+            }
+        }
+        uint32_t end = _bus->nowMicros();
+
+        _transactions++;
+        _merged += (uint32_t)(count - 1);
+        _busyUs += end - start;
+        for (int i = 0; i < count; i++) {
+            if (!ok) _failed++;
+            uint32_t latency = end - batch[i].queuedUs;
+            _latencySumUs += latency;
+            _latencyMinUs = latency < _latencyMinUs ? latency : _latencyMinUs;
+            _latencyMaxUs = latency > _latencyMaxUs ? latency : _latencyMaxUs;
+            _completed++;
+        }
+        return ok;
+    }
+};
+
+#endif // I2C_SCHEDULER_H
@@ -3,6 +3,21 @@
  * ===========================
  * 
  * Driver for the MPU6050 6-axis accelerometer/gyroscope.
+ * 
+ * With ENABLE_IMU_FIFO the sensor queues its samples in its 1 KB FIFO
+ * (accelerometer only, or with the gyroscope for IMU_FIFO_GYRO) and the
+ * data-ready pulse on MPU6050_INT_PIN only bumps a counter in an ISR. Once
+ * IMU_FIFO_BURST samples are waiting, readBurst() drains them with one
+ * FIFO count read, one burst read per 255 bytes and one temperature read,
+ * instead of two transactions per sample. The MPU6050 has no FIFO
+ * watermark interrupt, hence the counter. Timestamps are rebuilt from the
+ * output data rate, anchored at the newest data-ready pulse so the
+ * sensor's clock error does not accumulate. With ENABLE_SENSOR_TASK the
+ * ISR also wakes the acquisition task once per burst, and with
+ * ENABLE_I2C_SCHEDULER the task drains through requestBurst(): FIFO count
+ * and temperature reads on the shared scheduler, then from the count's
+ * completion one read of the queued frames. A FIFO restart found
+ * necessary there waits for finishBurst(), after the scheduler returns.
  */
 
 #ifndef IMU_SENSOR_H
@@ -13,6 +28,60 @@
 #include <MPU6050.h>
 #include "../include/config.h"
 
+#if ENABLE_SENSOR_TASK
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+#if ENABLE_I2C_SCHEDULER
+#if !ENABLE_SENSOR_TASK
+#error "ENABLE_I2C_SCHEDULER needs ENABLE_SENSOR_TASK"
+#endif
+#include "i2c_scheduler.h"
+#endif
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+// Output data rate: 8 kHz gyro rate (DLPF off) / (1 + divider)
+#define IMU_RATE_DIVIDER        (8000 / IMU_SAMPLE_RATE_HZ - 1)
+#define IMU_SAMPLE_PERIOD_US    ((IMU_RATE_DIVIDER + 1) * 125UL)
+
+#define IMU_FIFO_SIZE           1024    // Bytes
+#define IMU_FIFO_FRAME          (IMU_FIFO_GYRO ? 12 : 6)
+#define IMU_FIFO_READ_MAX       (255 / IMU_FIFO_FRAME * IMU_FIFO_FRAME)  // Per getFIFOBytes()
+
+// MPU6050 registers read through the I2C scheduler
+#define IMU_I2C_ADDRESS         0x68    // MPU6050_DEFAULT_ADDRESS (AD0 low)
+#define IMU_REG_TEMP_OUT        0x41
+#define IMU_REG_FIFO_COUNT      0x72
+#define IMU_REG_FIFO_DATA       0x74
+
+#if ENABLE_IMU_FIFO
+// Data-ready pulses since begin(), and the time of the newest; written by
+// the ISR only
+static volatile uint32_t imuReadyCount = 0;
+static volatile uint32_t imuReadyMillis = 0;
+
+#if ENABLE_SENSOR_TASK
+// Task notified every IMU_FIFO_BURST pulses (sensor_task.h), nullptr: none
+static TaskHandle_t imuBurstTask = nullptr;
+#endif
+
+static void IRAM_ATTR imuDataReadyISR() {
+    imuReadyMillis = millis();
+    imuReadyCount = imuReadyCount + 1;
+    #if ENABLE_SENSOR_TASK
+    if (imuBurstTask && imuReadyCount % IMU_FIFO_BURST == 0) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(imuBurstTask, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+    #endif
+}
+#endif
+
 /**
  * IMU data structure
  */
@@ -32,7 +101,12 @@ struct IMUData {
  */
 class IMUSensor {
 public:
-    IMUSensor() : _initialized(false), _mpu() {}
+    IMUSensor() : _initialized(false), _mpu(), _drained(0), _overflows(0)
+                  #if ENABLE_I2C_SCHEDULER
+                  , _burstPending(false), _restartPending(false), _burstCount(0),
+                    _burstTemperature(0.0f)
+                  #endif
+                  {}
     
     /**
      * Initialize the sensor
@@ -55,11 +129,28 @@ public:
         // Set sample rate divider (if needed)
         // Default is 8kHz internal, divider = 8000/rate - 1
         // For 32Hz: divider = 249
-        _mpu.setRate(250 - 1);  // ~32 Hz
+        _mpu.setRate(IMU_RATE_DIVIDER);
         
         // Enable data ready interrupt (optional)
         _mpu.setIntDataReadyEnabled(true);
         
+        #if ENABLE_IMU_FIFO
+        // 50 us active-high pulse per sample; nothing to clear
+        _mpu.setInterruptMode(false);
+        _mpu.setInterruptDrive(false);
+        _mpu.setInterruptLatch(false);
+        
+        _mpu.setFIFOEnabled(false);
+        _mpu.setAccelFIFOEnabled(true);
+        _mpu.setXGyroFIFOEnabled(IMU_FIFO_GYRO);
+        _mpu.setYGyroFIFOEnabled(IMU_FIFO_GYRO);
+        _mpu.setZGyroFIFOEnabled(IMU_FIFO_GYRO);
+        restartFIFO();
+        
+        pinMode(MPU6050_INT_PIN, INPUT);
+        attachInterrupt(digitalPinToInterrupt(MPU6050_INT_PIN), imuDataReadyISR, RISING);
+        #endif
+        
         _initialized = true;
         return true;
     }
@@ -71,6 +162,121 @@ public:
         return _initialized;
     }
     
+    #if ENABLE_IMU_FIFO
+    /**
+     * Whether IMU_FIFO_BURST samples are waiting in the FIFO (no I2C).
+     */
+    bool burstReady() const {
+        return _initialized && imuReadyCount - _drained >= IMU_FIFO_BURST;
+    }
+    
+    /**
+     * Drain the FIFO, oldest sample first. After an overflow the FIFO is
+     * restarted and its contents dropped (getOverflows()).
+     * 
+     * @param out Room for `maxSamples` samples; older ones stay queued
+     * @return Samples read
+     */
+    int readBurst(IMUData* out, int maxSamples) {
+        if (!_initialized || maxSamples <= 0) {
+            return 0;
+        }
+        
+        uint32_t ready, readyMs;
+        snapshotReady(ready, readyMs);
+        
+        uint16_t bytes = _mpu.getFIFOCount();
+        if (bytes > IMU_FIFO_SIZE - IMU_FIFO_FRAME) {
+            // Full: frames were lost and the newest may be torn
+            _overflows++;
+            restartFIFO();
+            Serial.println("[IMU] FIFO overflow, samples dropped");
+            return 0;
+        }
+        
+        int queued = bytes / IMU_FIFO_FRAME;
+        int count = queued < maxSamples ? queued : maxSamples;
+        float temperature = _mpu.getTemperature() / 340.0f + 36.53f;
+        
+        uint8_t frames[IMU_FIFO_READ_MAX];
+        int done = 0;
+        while (done < count) {
+            int chunk = count - done;
+            if (chunk > IMU_FIFO_READ_MAX / IMU_FIFO_FRAME) chunk = IMU_FIFO_READ_MAX / IMU_FIFO_FRAME;
+            _mpu.getFIFOBytes(frames, (uint8_t)(chunk * IMU_FIFO_FRAME));
+            decodeFrames(frames, done, chunk, queued, readyMs, temperature, out + done);
+            done += chunk;
+        }
+        
+        // Pulses of frames still queued are not drained yet
+        _drained = ready - (uint32_t)(queued - count);
+        return count;
+    }
+    
+    /**
+     * FIFO overflows since begin() (the loop drained too late).
+     */
+    uint32_t getOverflows() const { return _overflows; }
+    
+    #if ENABLE_I2C_SCHEDULER
+    /**
+     * Queue a drain on `scheduler`, like readBurst(): FIFO count and
+     * temperature, then (from the count's completion) the queued frames.
+     * Samples go to `out`; getBurstCount() has their number once
+     * scheduler.process() has returned. Then call finishBurst().
+     * 
+     * @param maxSamples At most IMU_FIFO_BURST * 2
+     * @return false if not initialized, a drain is pending or the queue
+     *         has no room
+     */
+    bool requestBurst(I2CScheduler& scheduler, IMUData* out, int maxSamples) {
+        if (!_initialized || maxSamples <= 0 || _burstPending || scheduler.space() < 2) {
+            return false;
+        }
+        snapshotReady(_burstReady, _burstReadyMs);
+        _scheduler = &scheduler;
+        _burstOut = out;
+        _burstMax = maxSamples < IMU_FIFO_BURST * 2 ? maxSamples : IMU_FIFO_BURST * 2;
+        _burstCount = 0;
+        _burstPending = true;
+        
+        scheduler.submit(IMU_I2C_ADDRESS, IMU_REG_FIFO_COUNT, _countBytes, 2, 0, onCount, this);
+        scheduler.submit(IMU_I2C_ADDRESS, IMU_REG_TEMP_OUT, _tempBytes, 2, 0, onTemperature, this);
+        return true;
+    }
+    
+    bool isBurstPending() const { return _burstPending; }
+    
+    /**
+     * Restart the FIFO if the last requestBurst() found it overflowed or
+     * lost track of it. Call once scheduler.process() has returned: the
+     * restart is blocking Wire writes, which must not run inside the
+     * scheduler's callbacks.
+     */
+    void finishBurst() {
+        if (_restartPending) {
+            _restartPending = false;
+            restartFIFO();
+        }
+    }
+    
+    /**
+     * Samples of the last completed requestBurst().
+     */
+    int getBurstCount() const { return _burstCount; }
+    #endif
+    
+    #if ENABLE_SENSOR_TASK
+    /**
+     * Notify `task` from the data-ready interrupt whenever a burst is
+     * due (nullptr: stop).
+     */
+    void setBurstNotify(TaskHandle_t task) {
+        imuBurstTask = task;
+    }
+    #endif
+    #endif
+    
     /**
      * Read sensor data
      */
@@ -84,27 +290,7 @@ public:
         
         int16_t ax, ay, az, gx, gy, gz;
         _mpu.getMotion6(&ax, &ay, &az, &gx, &gy, &gz);
-        
-        // Convert to physical units
-        // Accelerometer: LSB/g depends on range
-        // Range 0 (±2g): 16384 LSB/g
-        // Range 1 (±4g): 8192 LSB/g
-        // Range 2 (±8g): 4096 LSB/g
-        // Range 3 (±16g): 2048 LSB/g
-        float accelScale = 16384.0f / (1 << IMU_ACCEL_RANGE);
-        data.accelX = ax / accelScale;
-        data.accelY = ay / accelScale;
-        data.accelZ = az / accelScale;
-        
-        // Gyroscope: LSB/(deg/s) depends on range
-        // Range 0 (±250°/s): 131 LSB/(°/s)
-        // Range 1 (±500°/s): 65.5 LSB/(°/s)
-        // Range 2 (±1000°/s): 32.8 LSB/(°/s)
-        // Range 3 (±2000°/s): 16.4 LSB/(°/s)
-        float gyroScale = 131.0f / (1 << IMU_GYRO_RANGE);
-        data.gyroX = gx / gyroScale;
-        data.gyroY = gy / gyroScale;
-        data.gyroZ = gz / gyroScale;
+        convert(ax, ay, az, gx, gy, gz, data);
         
         // Temperature
         data.temperature = _mpu.getTemperature() / 340.0f + 36.53f;
@@ -136,6 +322,10 @@ public:
     void wake() {
         if (_initialized) {
             _mpu.setSleepEnabled(false);
+            #if ENABLE_IMU_FIFO
+            // Samples from before the sleep are stale
+            restartFIFO();
+            #endif
         }
     }
     
@@ -179,6 +369,148 @@ public:
 private:
     bool _initialized;
     MPU6050 _mpu;
+    uint32_t _drained;              // Data-ready pulses read out of the FIFO
+    uint32_t _overflows;
+    
+    #if ENABLE_I2C_SCHEDULER
+    // requestBurst() in flight
+    I2CScheduler* _scheduler;
+    bool _burstPending;
+    bool _restartPending;           // For finishBurst()
+    IMUData* _burstOut;
+    int _burstMax;
+    int _burstCount;
+    int _burstQueued;
+    uint32_t _burstReady;
+    uint32_t _burstReadyMs;
+    float _burstTemperature;        // Kept when a read fails
+    uint8_t _countBytes[2];
+    uint8_t _tempBytes[2];
+    uint8_t _frames[IMU_FIFO_BURST * 2 * IMU_FIFO_FRAME];
+    
+    static void onCount(void* context, const I2CRequest& request, bool ok) {
+        IMUSensor* self = (IMUSensor*)context;
+        (void)request;
+        if (!ok) {
+            self->_burstPending = false;
+            return;
+        }
+        
+        uint16_t bytes = (uint16_t)((self->_countBytes[0] << 8) | self->_countBytes[1]);
+        if (bytes > IMU_FIFO_SIZE - IMU_FIFO_FRAME) {
+            self->_overflows++;
+            self->_restartPending = true;
+            Serial.println("[IMU] FIFO overflow, samples dropped");
+            self->_burstPending = false;
+            return;
+        }
+        
+        self->_burstQueued = bytes / IMU_FIFO_FRAME;
+        int count = self->_burstQueued < self->_burstMax ? self->_burstQueued : self->_burstMax;
+        // Queued behind the temperature read, so that completes first
+        if (count == 0 ||
+            !self->_scheduler->submit(IMU_I2C_ADDRESS, IMU_REG_FIFO_DATA, self->_frames,
+                                      (uint16_t)(count * IMU_FIFO_FRAME), I2C_READ_STREAM,
+                                      onFrames, self)) {
+            self->_burstPending = false;
+        }
+    }
+    
+    static void onTemperature(void* context, const I2CRequest& request, bool ok) {
+        IMUSensor* self = (IMUSensor*)context;
+        (void)request;
+        if (ok) {
+            self->_burstTemperature = be16(self->_tempBytes) / 340.0f + 36.53f;
+        }
+    }
+    
+    static void onFrames(void* context, const I2CRequest& request, bool ok) {
+        IMUSensor* self = (IMUSensor*)context;
+        int count = request.length / IMU_FIFO_FRAME;
+        self->_burstPending = false;
+        if (!ok) {
+            // Unknown how much left the FIFO
+            self->_restartPending = true;
+            return;
+        }
+        
+        decodeFrames(self->_frames, 0, count, self->_burstQueued, self->_burstReadyMs,
+                     self->_burstTemperature, self->_burstOut);
+        self->_drained = self->_burstReady - (uint32_t)(self->_burstQueued - count);
+        self->_burstCount = count;
+    }
+    #endif
+    
+    /**
+     * Raw readings to physical units.
+     */
+    static void convert(int16_t ax, int16_t ay, int16_t az,
+                        int16_t gx, int16_t gy, int16_t gz, IMUData& data) {
+        // Accelerometer: LSB/g depends on range
+        // Range 0 (±2g): 16384 LSB/g
+        // Range 1 (±4g): 8192 LSB/g
+        // Range 2 (±8g): 4096 LSB/g
+        // Range 3 (±16g): 2048 LSB/g
+        float accelScale = 16384.0f / (1 << IMU_ACCEL_RANGE);
+        data.accelX = ax / accelScale;
+        data.accelY = ay / accelScale;
+        data.accelZ = az / accelScale;
+        
+        // Gyroscope: LSB/(deg/s) depends on range
+        // Range 0 (±250°/s): 131 LSB/(°/s)
+        // Range 1 (±500°/s): 65.5 LSB/(°/s)
+        // Range 2 (±1000°/s): 32.8 LSB/(°/s)
+        // Range 3 (±2000°/s): 16.4 LSB/(°/s)
+        float gyroScale = 131.0f / (1 << IMU_GYRO_RANGE);
+        data.gyroX = gx / gyroScale;
+        data.gyroY = gy / gyroScale;
+        data.gyroZ = gz / gyroScale;
+    }
+    
+    static int16_t be16(const uint8_t* p) {
+        return (int16_t)((p[0] << 8) | p[1]);
+    }
+    
+    #if ENABLE_IMU_FIFO
+    /**
+     * The data-ready count and the time of its newest pulse, consistent.
+     */
+    static void snapshotReady(uint32_t& ready, uint32_t& readyMs) {
+        do {
+            ready = imuReadyCount;
+            readyMs = imuReadyMillis;
+        } while (ready != imuReadyCount);
+    }
+    
+    /**
+     * FIFO frames `first`..`first + count - 1` of a drain of `queued` to
+     * samples; the newest queued frame is the newest pulse's.
+     */
+    static void decodeFrames(const uint8_t* frames, int first, int count, int queued,
+                             uint32_t readyMs, float temperature, IMUData* out) {
+        for (int i = 0; i < count; i++) {
+            const uint8_t* f = frames + i * IMU_FIFO_FRAME;
+            IMUData& data = out[i];
+            uint32_t age = (uint32_t)(queued - 1 - (first + i));
+            data.timestamp = readyMs - age * IMU_SAMPLE_PERIOD_US / 1000;
+            convert(be16(f), be16(f + 2), be16(f + 4),
+                    IMU_FIFO_GYRO ? be16(f + 6) : 0,
+                    IMU_FIFO_GYRO ? be16(f + 8) : 0,
+                    IMU_FIFO_GYRO ? be16(f + 10) : 0, data);
+            data.temperature = temperature;
+        }
+    }
+    
+    /**
+     * Empty the FIFO and count from the pulses so far.
+     */
+    void restartFIFO() {
+        _mpu.setFIFOEnabled(false);
+        _mpu.resetFIFO();
+        _drained = imuReadyCount;
+        _mpu.setFIFOEnabled(true);
+    }
+    #endif
 };
 
 #endif // IMU_SENSOR_H
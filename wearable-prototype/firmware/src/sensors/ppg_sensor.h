@@ -3,6 +3,25 @@
  * ============================
  * 
  * Driver for the MAX30102 pulse oximeter and heart rate sensor.
+ * 
+ * readBatch() drains the sensor's 32-sample FIFO directly (pointer
+ * registers, then burst reads of FIFO_DATA) into the caller's array, so
+ * no sample is lost between polls as long as the FIFO is drained within
+ * 32 sample periods. Timestamps follow the output data rate from a sample
+ * clock that is re-anchored to millis() only when it drifts by more than
+ * PPG_RESYNC_PERIODS, or after an overflow; samples lost to an overflow
+ * are counted (getOverflows()), as are failed reads (getReadErrors()),
+ * which keep the frames received before the failure. The beat detector runs on every drained
+ * sample with these timestamps and marks each beat with its inter-beat
+ * interval.
+ * 
+ * With ENABLE_I2C_SCHEDULER the acquisition task drains through
+ * requestBatch() instead: the three pointer registers as separate reads
+ * (the scheduler merges them into one burst), then from their completion
+ * one read of every queued frame.
+ * 
+ * The sensor samples at PPG_SAMPLE_RATE_HZ * PPG_SAMPLE_AVERAGE and
+ * averages down, so the FIFO delivers PPG_SAMPLE_RATE_HZ.
  */
 
 #ifndef PPG_SENSOR_H
@@ -14,6 +33,35 @@
 #include "heartRate.h"
 #include "../include/config.h"
 
+#if ENABLE_I2C_SCHEDULER
+#include "i2c_scheduler.h"
+#endif
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+// ADC rate before the FIFO's sample averaging
+#define PPG_ADC_RATE_HZ         (PPG_SAMPLE_RATE_HZ * PPG_SAMPLE_AVERAGE)
+#define PPG_SAMPLE_PERIOD_US    (1000000UL / PPG_SAMPLE_RATE_HZ)
+
+#if PPG_ADC_RATE_HZ != 50 && PPG_ADC_RATE_HZ != 100 && PPG_ADC_RATE_HZ != 200 && \
+    PPG_ADC_RATE_HZ != 400 && PPG_ADC_RATE_HZ != 800 && PPG_ADC_RATE_HZ != 1000 && \
+    PPG_ADC_RATE_HZ != 1600 && PPG_ADC_RATE_HZ != 3200
+#error "PPG_SAMPLE_RATE_HZ * PPG_SAMPLE_AVERAGE is not a MAX30102 sample rate"
+#endif
+
+// MAX30102 FIFO registers
+#define PPG_REG_FIFO_WR_PTR     0x04
+#define PPG_REG_OVF_COUNTER     0x05
+#define PPG_REG_FIFO_RD_PTR     0x06
+#define PPG_REG_FIFO_DATA       0x07
+#define PPG_FIFO_DEPTH          32
+#define PPG_FIFO_FRAME          (3 * PPG_LED_MODE)              // 18 bits per LED in 3 bytes
+#define PPG_I2C_CHUNK           (32 / PPG_FIFO_FRAME * PPG_FIFO_FRAME)  // Wire buffer
+
+#define PPG_RESYNC_PERIODS      3       // Sample clock error that re-anchors it
+
 /**
  * PPG data structure
  */
@@ -22,6 +70,7 @@ struct PPGData {
     uint32_t red;           // Red LED reading
     uint32_t ir;            // IR LED reading
     uint32_t green;         // Green LED reading (if available)
+    uint16_t ibiMs;         // Inter-beat interval ending at this sample, 0: no beat
 };
 
 /**
@@ -29,7 +78,13 @@ struct PPGData {
  */
 class PPGSensor {
 public:
-    PPGSensor() : _initialized(false), _lastHeartRate(0), _lastSpO2(0) {}
+    PPGSensor() : _initialized(false), _lastHeartRate(0), _lastSpO2(0),
+                  _clockMs(0), _clockSamples(0), _overflows(0),
+                  _readErrors(0), _readDropped(0), _lastIR(0)
+                  #if ENABLE_I2C_SCHEDULER
+                  , _batchPending(false), _batchCount(0)
+                  #endif
+                  {}
     
     /**
      * Initialize the sensor
@@ -45,7 +100,7 @@ public:
         byte ledBrightness = PPG_LED_BRIGHTNESS;  // 0-255
         byte sampleAverage = PPG_SAMPLE_AVERAGE;  // 1, 2, 4, 8, 16, 32
         byte ledMode = PPG_LED_MODE;              // 1=Red only, 2=Red+IR, 3=Red+IR+Green
-        int sampleRate = PPG_SAMPLE_RATE_HZ;      // 50, 100, 200, 400, 800, 1000, 1600, 3200
+        int sampleRate = PPG_ADC_RATE_HZ;         // 50, 100, 200, 400, 800, 1000, 1600, 3200
         int pulseWidth = 411;                      // 69, 118, 215, 411
         int adcRange = PPG_ADC_RANGE;             // 2048, 4096, 8192, 16384
         
@@ -60,6 +115,11 @@ public:
         }
         _rateSpot = 0;
         _beatAvg = 0;
+        _lastBeat = 0;
+        
+        // Start the sample clock on an empty FIFO
+        _sensor.clearFIFO();
+        resyncClock(millis(), 0);
         
         _initialized = true;
         return true;
@@ -73,31 +133,110 @@ public:
     }
     
     /**
-     * Read sensor data
+     * Drain the FIFO, oldest sample first. Each sample also goes through
+     * the beat detector.
+     * 
+     * @param out Room for `maxSamples` (PPG_FIFO_DEPTH drains everything);
+     *            newer samples stay queued
+     * @return Samples read
      */
-    PPGData read() {
-        PPGData data;
-        data.timestamp = millis();
+    int readBatch(PPGData* out, int maxSamples) {
+        if (!_initialized || maxSamples <= 0) {
+            return 0;
+        }
         
-        if (!_initialized) {
-            return data;
+        uint8_t pointers[3];        // Write pointer, overflow counter, read pointer
+        if (readRegisters(PPG_REG_FIFO_WR_PTR, pointers, sizeof(pointers)) != (int)sizeof(pointers)) {
+            return 0;
         }
+        int count = startBatch(pointers, maxSamples);
         
-        // Read available samples
-        _sensor.check();
+        uint8_t frames[PPG_I2C_CHUNK];
+        int done = 0;
+        while (done < count) {
+            int chunk = count - done;
+            if (chunk > PPG_I2C_CHUNK / PPG_FIFO_FRAME) chunk = PPG_I2C_CHUNK / PPG_FIFO_FRAME;
+            int received = readRegisters(PPG_REG_FIFO_DATA, frames, chunk * PPG_FIFO_FRAME);
+            int whole = received / PPG_FIFO_FRAME;
+            decodeFrames(frames, whole, out + done);
+            done += whole;
+            if (whole < chunk) {
+                // Keep what arrived; a torn frame has left the FIFO, the
+                // unread ones wait for the next drain
+                _readErrors++;
+                if (received % PPG_FIFO_FRAME) {
+                    _clockSamples++;
+                    _readDropped++;
+                }
+                break;
+            }
+        }
         
-        while (_sensor.available()) {
-            data.red = _sensor.getRed();
-            data.ir = _sensor.getIR();
-            data.green = _sensor.getGreen();
-            
-            // Process for heart rate detection
-            _processHeartRate(data.ir);
-            
-            _sensor.nextSample();
+        return done;
+    }
+    
+    #if ENABLE_I2C_SCHEDULER
+    /**
+     * Queue a drain on `scheduler`, like readBatch(): the pointer
+     * registers, then (from their completion) the queued frames. Samples
+     * go to `out`; getBatchCount() has their number once
+     * scheduler.process() has returned.
+     * 
+     * @param maxSamples At most PPG_FIFO_DEPTH
+     * @return false if not initialized, a drain is pending or the queue
+     *         has no room
+     */
+    bool requestBatch(I2CScheduler& scheduler, PPGData* out, int maxSamples) {
+        if (!_initialized || maxSamples <= 0 || _batchPending || scheduler.space() < 3) {
+            return false;
         }
+        _scheduler = &scheduler;
+        _batchOut = out;
+        _batchMax = maxSamples < PPG_FIFO_DEPTH ? maxSamples : PPG_FIFO_DEPTH;
+        _batchCount = 0;
+        _pointersOk = true;
+        _batchPending = true;
         
-        return data;
+        scheduler.submit(MAX30105_ADDRESS, PPG_REG_FIFO_WR_PTR, &_pointers[0], 1, 0, onPointer, this);
+        scheduler.submit(MAX30105_ADDRESS, PPG_REG_OVF_COUNTER, &_pointers[1], 1, 0, onPointer, this);
+        scheduler.submit(MAX30105_ADDRESS, PPG_REG_FIFO_RD_PTR, &_pointers[2], 1, 0, onPointer, this);
+        return true;
+    }
+    
+    bool isBatchPending() const { return _batchPending; }
+    
+    /**
+     * Samples of the last completed requestBatch().
+     */
+    int getBatchCount() const { return _batchCount; }
+    #endif
+    
+    /**
+     * Samples lost to FIFO overflows since begin() (drained too late).
+     */
+    uint32_t getOverflows() const { return _overflows; }
+    
+    /**
+     * Failed FIFO reads since begin(), and the samples they lost. Frames
+     * received whole before a failure are still returned.
+     */
+    uint32_t getReadErrors() const { return _readErrors; }
+    uint32_t getReadDropped() const { return _readDropped; }
+    
+    /**
+     * Read sensor data: drains the FIFO and returns the newest sample
+     * (the others still reach the beat detector). Use readBatch() to keep
+     * every sample.
+     */
+    PPGData read() {
+        PPGData batch[PPG_FIFO_DEPTH];
+        int count = readBatch(batch, PPG_FIFO_DEPTH);
+        if (count == 0) {
+            PPGData data = {};
+            data.timestamp = millis();
+            return data;
+        }
+        return batch[count - 1];
     }
     
     /**
@@ -106,6 +245,22 @@ public:
     float calculateHeartRate(PPGData* buffer, uint16_t count) {
         if (count < 10) return 0;
         
+        float heartRate = heartRateFromPeaks(buffer, count);
+        if (heartRate > 0) {
+            _lastHeartRate = heartRate;
+        }
+        return _lastHeartRate;
+    }
+    
+    /**
+     * Heart rate from the IR peaks of a buffer of samples, without touching
+     * the sensor (for samples taken from the acquisition task).
+     * 
+     * @return Beats per minute, 0 if the buffer holds fewer than two peaks
+     */
+    static float heartRateFromPeaks(const PPGData* buffer, uint16_t count) {
+        if (count < 10) return 0;
+        
         // Simple peak detection for heart rate
         int peaks = 0;
         uint32_t threshold = 0;
@@ -131,11 +286,10 @@ public:
         // Calculate heart rate
         float duration = (buffer[count-1].timestamp - buffer[0].timestamp) / 1000.0f;
         if (duration > 0 && peaks > 1) {
-            _lastHeartRate = (peaks - 1) * 60.0f / duration;
-            return _lastHeartRate;
+            return (peaks - 1) * 60.0f / duration;
         }
         
-        return _lastHeartRate;
+        return 0;
     }
     
     /**
@@ -166,8 +320,9 @@ public:
     bool isFingerDetected() {
         if (!_initialized) return false;
         
-        // Check if IR reading is above minimum threshold
-        return _sensor.getIR() > 50000;
+        // Check if the latest IR reading is above minimum threshold
+        // (the library's getIR() would drain the FIFO behind readBatch())
+        return _lastIR > 50000;
     }
     
     /**
@@ -185,6 +340,8 @@ public:
     void wake() {
         if (_initialized) {
             _sensor.wakeUp();
+            _sensor.clearFIFO();
+            resyncClock(millis(), 0);
         }
     }
 
@@ -198,16 +355,70 @@ private:
     static const int RATE_SIZE = 4;
     byte _rates[RATE_SIZE];
     byte _rateSpot;
-    long _lastBeat;
+    uint32_t _lastBeat;
     float _beatAvg;
     
+    // Sample clock: sample n of the current anchor was taken at
+    // _clockMs + n * PPG_SAMPLE_PERIOD_US / 1000
+    uint32_t _clockMs;
+    uint32_t _clockSamples;         // Samples drained since the anchor
+    uint32_t _overflows;
+    uint32_t _readErrors;
+    uint32_t _readDropped;
+    uint32_t _lastIR;
+    
+    #if ENABLE_I2C_SCHEDULER
+    // requestBatch() in flight
+    I2CScheduler* _scheduler;
+    bool _batchPending;
+    PPGData* _batchOut;
+    int _batchMax;
+    int _batchCount;
+    bool _pointersOk;
+    uint8_t _pointers[3];
+    uint8_t _frames[PPG_FIFO_DEPTH * PPG_FIFO_FRAME];
+    
+    static void onPointer(void* context, const I2CRequest& request, bool ok) {
+        PPGSensor* self = (PPGSensor*)context;
+        self->_pointersOk = self->_pointersOk && ok;
+        if (request.reg != PPG_REG_FIFO_RD_PTR) {
+            return;         // The read pointer's completion comes last
+        }
+        
+        int count = self->_pointersOk ? self->startBatch(self->_pointers, self->_batchMax) : 0;
+        if (count == 0 ||
+            !self->_scheduler->submit(MAX30105_ADDRESS, PPG_REG_FIFO_DATA, self->_frames,
+                                      (uint16_t)(count * PPG_FIFO_FRAME), I2C_READ_STREAM,
+                                      onFrames, self)) {
+            self->_batchPending = false;
+        }
+    }
+    
+    static void onFrames(void* context, const I2CRequest& request, bool ok) {
+        PPGSensor* self = (PPGSensor*)context;
+        self->_batchPending = false;
+        if (ok) {
+            int count = request.length / PPG_FIFO_FRAME;
+            self->decodeFrames(self->_frames, count, self->_batchOut);
+            self->_batchCount = count;
+        } else {
+            // How far the failed read got is unknown: the drift check of
+            // the next drain re-anchors the clock if samples were lost
+            self->_readErrors++;
+        }
+    }
+    #endif
+    
     /**
      * Process IR reading for heart rate detection
+     * 
+     * @param timestamp Sample time (ms)
+     * @return Inter-beat interval in ms if this sample is a plausible beat, else 0
      */
-    void _processHeartRate(uint32_t irValue) {
+    uint16_t _processHeartRate(uint32_t irValue, uint32_t timestamp) {
         if (checkForBeat(irValue)) {
-            long delta = millis() - _lastBeat;
-            _lastBeat = millis();
+            uint32_t delta = timestamp - _lastBeat;
+            _lastBeat = timestamp;
             
             float beatsPerMinute = 60 / (delta / 1000.0);
             
@@ -221,8 +432,92 @@ private:
                     _beatAvg += _rates[i];
                 }
                 _beatAvg /= RATE_SIZE;
+                return (uint16_t)delta;
             }
         }
+        return 0;
+    }
+    
+    /**
+     * Samples to drain from the pointer registers (write pointer, overflow
+     * counter, read pointer); counts overflows and re-anchors the sample
+     * clock when needed.
+     */
+    int startBatch(const uint8_t* pointers, int maxSamples) {
+        uint32_t now = millis();
+        int queued = (pointers[0] - pointers[2]) & (PPG_FIFO_DEPTH - 1);
+        if (pointers[1] > 0) {
+            // Rolled over: the FIFO is full and older samples are gone
+            queued = PPG_FIFO_DEPTH;
+            _overflows += pointers[1];
+        }
+        if (queued == 0) {
+            return 0;
+        }
+        
+        // The newest queued sample is from about now
+        uint32_t expected = clockTime(_clockSamples + queued - 1);
+        int32_t drift = (int32_t)(now - expected);
+        if (pointers[1] > 0 || drift > (int32_t)(PPG_RESYNC_PERIODS * PPG_SAMPLE_PERIOD_US / 1000) ||
+            drift < -(int32_t)(PPG_RESYNC_PERIODS * PPG_SAMPLE_PERIOD_US / 1000)) {
+            resyncClock(now, queued);
+        }
+        return queued < maxSamples ? queued : maxSamples;
+    }
+    
+    /**
+     * FIFO frames to samples on the sample clock, through the beat detector.
+     */
+    void decodeFrames(const uint8_t* frames, int count, PPGData* out) {
+        for (int i = 0; i < count; i++) {
+            const uint8_t* f = frames + i * PPG_FIFO_FRAME;
+            PPGData& data = out[i];
+            data.timestamp = clockTime(_clockSamples++);
+            data.red = sample18(f);
+            data.ir = PPG_LED_MODE >= 2 ? sample18(f + 3) : 0;
+            data.green = PPG_LED_MODE >= 3 ? sample18(f + 6) : 0;
+            data.ibiMs = _processHeartRate(data.ir, data.timestamp);
+            _lastIR = data.ir;
+        }
+    }
+    
+    uint32_t clockTime(uint32_t sample) const {
+        return _clockMs + (uint32_t)((uint64_t)sample * PPG_SAMPLE_PERIOD_US / 1000);
+    }
+    
+    /**
+     * Re-anchor the sample clock so the newest of `queued` samples is at `now`.
+     */
+    void resyncClock(uint32_t now, int queued) {
+        _clockMs = now - clockSpan(queued);
+        _clockSamples = 0;
+    }
+    
+    static uint32_t clockSpan(int queued) {
+        return queued > 1 ? (uint32_t)((queued - 1) * PPG_SAMPLE_PERIOD_US / 1000) : 0;
+    }
+    
+    static uint32_t sample18(const uint8_t* p) {
+        return (((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2]) & 0x3FFFF;
+    }
+    
+    /**
+     * Burst read starting at `reg` (FIFO_DATA does not advance the address).
+     * 
+     * @return Bytes received (`length` unless the read failed)
+     */
+    int readRegisters(uint8_t reg, uint8_t* out, int length) {
+        Wire.beginTransmission(MAX30105_ADDRESS);
+        Wire.write(reg);
+        if (Wire.endTransmission(false) != 0) {
+            return 0;
+        }
+        int received = Wire.requestFrom((uint8_t)MAX30105_ADDRESS, (uint8_t)length);
+        if (received > length) received = length;
+        for (int i = 0; i < received; i++) {
+            out[i] = (uint8_t)Wire.read();
+        }
+        return received;
     }
 };
 
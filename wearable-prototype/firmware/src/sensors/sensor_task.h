@@ -0,0 +1,231 @@
+/**
+ * Sensor Acquisition Task
+ * =======================
+ *
+ * Moves FIFO draining out of the main loop, so sample timing no longer
+ * depends on inference, flash writes or BLE work there. A FreeRTOS task
+ * pinned to SENSOR_TASK_CORE sleeps on a task notification and wakes
+ *
+ *   from the MPU6050 data-ready ISR, once IMU_FIFO_BURST samples are queued
+ *   on its own every PPG_FIFO_DRAIN_MS (the MAX30102 FIFO holds 320 ms)
+ *
+ * then drains both sensors (readBurst() / readBatch(), timestamps rebuilt
+ * by the drivers) and pushes the samples into lock-free SPSC rings
+ * (spsc_ring.h). The main loop takes them in batches with takeIMU() /
+ * takePPG(). I2C cannot run inside an ISR on the ESP32, hence the task
+ * between the interrupt and the rings.
+ *
+ * With ENABLE_I2C_SCHEDULER both drivers only queue their reads
+ * (requestBurst() / requestBatch()) on one I2CScheduler, which the task
+ * then runs to completion; the drivers' callbacks queue the follow-up
+ * FIFO reads. The scheduler's statistics are published every
+ * I2C_STATS_WINDOW_MS (takeI2CStats()) and restarted.
+ *
+ * Once started, the task is the only user of both sensors until end().
+ * The beat detector runs in the task as well; it publishes the averaged
+ * heart rate after each drain (getHeartRate()).
+ * A full ring drops the newest samples and counts them
+ * (getIMUOverruns() / getPPGOverruns()); FIFO overflows in the sensors
+ * are still counted by the drivers.
+ */
+
+#ifndef SENSOR_TASK_H
+#define SENSOR_TASK_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "../include/config.h"
+#include "imu_sensor.h"
+#include "ppg_sensor.h"
+#include "spsc_ring.h"
+
+#if ENABLE_I2C_SCHEDULER
+#include "i2c_bus.h"
+#include "i2c_scheduler.h"
+#endif
+
+#if !ENABLE_IMU_FIFO
+#error "ENABLE_SENSOR_TASK needs ENABLE_IMU_FIFO"
+#endif
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define SENSOR_TASK_STACK       3072    // Bytes
+#define SENSOR_TASK_STOP_MS     500     // end() waits this long for the task
+
+
+// ============================================================================
+// Sensor Task Class
+// ============================================================================
+
+class SensorTask {
+public:
+    SensorTask() : _imu(nullptr), _ppg(nullptr), _task(nullptr), _stop(false),
+                   _heartRate(0.0f) {}
+
+    /**
+     * Start draining the sensors that are ready.
+     *
+     * @return false if the task could not be created (or already runs)
+     */
+    bool begin(IMUSensor& imu, PPGSensor& ppg) {
+        if (_task) return false;
+        _imu = &imu;
+        _ppg = &ppg;
+        _stop = false;
+        #if ENABLE_I2C_SCHEDULER
+        _bus.begin(I2C_FREQUENCY);
+        _scheduler.begin(_bus);
+        #endif
+
+        TaskHandle_t task = nullptr;
+        if (xTaskCreatePinnedToCore(taskMain, "sensors", SENSOR_TASK_STACK, this,
+                                    SENSOR_TASK_PRIORITY, &task, SENSOR_TASK_CORE) != pdPASS) {
+            return false;
+        }
+        _task = task;
+        if (_imu->isReady()) {
+            _imu->setBurstNotify(task);
+        }
+        return true;
+    }
+
+    /**
+     * Stop the task and return the sensors to the caller (e.g. before
+     * deep sleep). Samples already in the rings can still be taken.
+     *
+     * @return false if the task has not stopped within SENSOR_TASK_STOP_MS
+     *         (stuck on the bus): it still owns the sensors, leave them alone
+     */
+    bool end() {
+        if (!_task) return true;
+        _imu->setBurstNotify(nullptr);
+        _stop = true;
+        xTaskNotifyGive(_task);
+
+        unsigned long start = millis();
+        while (_task && millis() - start < SENSOR_TASK_STOP_MS) {
+            delay(1);
+        }
+        return _task == nullptr;
+    }
+
+    bool isRunning() const { return _task != nullptr; }
+
+    // ---- Consumer (main loop) ----
+
+    /**
+     * Take up to `maxSamples` IMU samples, oldest first.
+     */
+    int takeIMU(IMUData* out, int maxSamples) {
+        return _imuRing.popBatch(out, maxSamples);
+    }
+
+    /**
+     * Take up to `maxSamples` PPG samples, oldest first.
+     */
+    int takePPG(PPGData* out, int maxSamples) {
+        return _ppgRing.popBatch(out, maxSamples);
+    }
+
+    /**
+     * Samples dropped because the main loop fell SENSOR_IMU_RING /
+     * SENSOR_PPG_RING samples behind.
+     */
+    uint32_t getIMUOverruns() const { return _imuRing.getOverruns(); }
+    uint32_t getPPGOverruns() const { return _ppgRing.getOverruns(); }
+
+    /**
+     * Averaged heart rate from the beat detector as of the last drain
+     * (bpm, 0 until a beat). Use this instead of the PPG driver while the
+     * task runs.
+     */
+    float getHeartRate() const { return _heartRate; }
+
+    #if ENABLE_I2C_SCHEDULER
+    /**
+     * The newest I2C statistics window not taken yet.
+     * 
+     * @return false if no window has completed since the last call
+     */
+    bool takeI2CStats(I2CStats& stats) {
+        bool taken = false;
+        while (_i2cStats.pop(stats)) {
+            taken = true;
+        }
+        return taken;
+    }
+    #endif
+
+private:
+    IMUSensor* _imu;
+    PPGSensor* _ppg;
+    TaskHandle_t volatile _task;
+    volatile bool _stop;
+    volatile float _heartRate;      // Written by the task (one aligned word)
+
+    SPSCRing<IMUData, SENSOR_IMU_RING> _imuRing;
+    SPSCRing<PPGData, SENSOR_PPG_RING> _ppgRing;
+
+    // Drain scratch, used by the task only
+    IMUData _imuScratch[IMU_FIFO_BURST * 2];
+    PPGData _ppgScratch[PPG_FIFO_DEPTH];
+
+    #if ENABLE_I2C_SCHEDULER
+    I2CBus _bus;
+    I2CScheduler _scheduler;
+    SPSCRing<I2CStats, 4> _i2cStats;
+    #endif
+
+    static void taskMain(void* arg) {
+        SensorTask* self = (SensorTask*)arg;
+        while (!self->_stop) {
+            self->acquire();
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PPG_FIFO_DRAIN_MS));
+        }
+        self->_task = nullptr;
+        vTaskDelete(nullptr);
+    }
+
+    /**
+     * One wake-up: whatever both FIFOs hold goes into the rings.
+     */
+    void acquire() {
+        #if ENABLE_I2C_SCHEDULER
+        bool imu = _imu->burstReady() &&
+                   _imu->requestBurst(_scheduler, _imuScratch, IMU_FIFO_BURST * 2);
+        bool ppg = _ppg->isReady() &&
+                   _ppg->requestBatch(_scheduler, _ppgScratch, PPG_FIFO_DEPTH);
+        _scheduler.process();
+        if (imu) {
+            _imuRing.pushBatch(_imuScratch, _imu->getBurstCount());
+            _imu->finishBurst();
+        }
+        if (ppg) {
+            _ppgRing.pushBatch(_ppgScratch, _ppg->getBatchCount());
+            _heartRate = _ppg->getLastHeartRate();
+        }
+
+        I2CStats stats = _scheduler.getStats();
+        if (stats.windowUs >= I2C_STATS_WINDOW_MS * 1000UL) {
+            _i2cStats.push(stats);
+            _scheduler.resetStats();
+        }
+        #else
+        if (_imu->burstReady()) {
+            int count = _imu->readBurst(_imuScratch, IMU_FIFO_BURST * 2);
+            _imuRing.pushBatch(_imuScratch, count);
+        }
+        if (_ppg->isReady()) {
+            int count = _ppg->readBatch(_ppgScratch, PPG_FIFO_DEPTH);
+            _ppgRing.pushBatch(_ppgScratch, count);
+            _heartRate = _ppg->getLastHeartRate();
+        }
+        #endif
+    }
+};
+
+#endif // SENSOR_TASK_H
@@ -0,0 +1,150 @@
+/**
+ * Lock-Free Single-Producer / Single-Consumer Ring
+ * ================================================
+ *
+ * Hands sensor samples from the acquisition side (the sensor task, woken
+ * by data-ready interrupts and a timer) to the processing side (the main
+ * loop) without locks or disabled interrupts. Exactly one context may
+ * push and exactly one may pop:
+ *
+ *   producer   push(): writes the slot, then publishes it by advancing
+ *              `_head` with release order
+ *   consumer   popBatch(): reads `_head` with acquire order, copies the
+ *              slots out, then frees them by advancing `_tail` with
+ *              release order
+ *
+ * Head and tail are free-running 32-bit counters (size = head - tail,
+ * wrap-safe), indexed modulo the power-of-two capacity, and sit on their
+ * own cache lines. A push into a full ring drops the new sample and
+ * counts an overrun; the consumer decides what a gap means.
+ *
+ * Arduino-free (std::atomic), so the same code runs in the host stress
+ * test (test/test_spsc_ring) with real threads.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <atomic>
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+#define SPSC_CACHE_LINE     64
+
+
+// ============================================================================
+// SPSC Ring Class
+// ============================================================================
+
+/**
+ * @tparam T Trivially copyable element
+ * @tparam N Capacity, a power of two
+ */
+template <typename T, uint32_t N>
+class SPSCRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SPSCRing capacity must be a power of two");
+
+public:
+    SPSCRing() : _head(0), _overruns(0), _tail(0) {}
+
+    // ---- Producer ----
+
+    /**
+     * Append one element.
+     *
+     * @return false if the ring was full (the element is dropped and
+     *         counted as an overrun)
+     */
+    bool push(const T& value) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= N) {
+            _overruns.store(_overruns.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+            return false;
+        }
+        _slots[head & (N - 1)] = value;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Append up to `count` elements, published together.
+     *
+     * @return Elements appended; the rest are dropped and counted
+     */
+    int pushBatch(const T* values, int count) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        uint32_t space = N - (head - _tail.load(std::memory_order_acquire));
+        int accepted = count < (int)space ? count : (int)space;
+        for (int i = 0; i < accepted; i++) {
+            _slots[(head + i) & (N - 1)] = values[i];
+        }
+        if (accepted < count) {
+            _overruns.store(_overruns.load(std::memory_order_relaxed) + (count - accepted),
+                            std::memory_order_relaxed);
+        }
+        _head.store(head + accepted, std::memory_order_release);
+        return accepted;
+    }
+
+    // ---- Consumer ----
+
+    /**
+     * Take the oldest element.
+     *
+     * @return false if the ring is empty
+     */
+    bool pop(T& value) {
+        return popBatch(&value, 1) == 1;
+    }
+
+    /**
+     * Take up to `maxCount` elements, oldest first, freeing their slots in
+     * one step.
+     *
+     * @return Elements taken
+     */
+    int popBatch(T* out, int maxCount) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t available = _head.load(std::memory_order_acquire) - tail;
+        int count = (int)available < maxCount ? (int)available : maxCount;
+        for (int i = 0; i < count; i++) {
+            out[i] = _slots[(tail + i) & (N - 1)];
+        }
+        _tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // ---- Either side ----
+
+    /**
+     * Elements waiting (a snapshot; exact only from the consumer's side).
+     */
+    uint32_t size() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    static constexpr uint32_t capacity() { return N; }
+
+    /**
+     * Elements dropped because the ring was full.
+     */
+    uint32_t getOverruns() const {
+        return _overruns.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Written by the producer
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _overruns;
+    // Written by the consumer
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> _tail;
+    alignas(SPSC_CACHE_LINE) T _slots[N];
+};
+
+#endif // SPSC_RING_H
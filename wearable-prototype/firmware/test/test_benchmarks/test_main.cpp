@@ -0,0 +1,1805 @@
+/**
+ * Processing Benchmarks
+ * =====================
+ *
+ * Correctness checks and cost-per-epoch timings for the Arduino-free
+ * processing modules. Runs on the host and on the device:
+ *
+ *   pio test -e native -f test_benchmarks
+ *   pio test -e esp32-s3-devkitc-1 -f test_benchmarks
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "processing/int_stats.h"
+#include "processing/entropy_features.h"
+#include "processing/lifting_wavelet.h"
+#include "processing/pulse_morphology.h"
+#include "processing/resp_estimator.h"
+#include "processing/int8_mlp.h"
+#include "processing/input_quantizer.h"
+#include "processing/hmm_smoother.h"
+#include "transition_params.h"
+#include "processing/imu_gate.h"
+#include "processing/actigraphy_scorer.h"
+#include "processing/inference_profiler.h"
+#include "processing/memory_planner.h"
+#include "processing/tree_ensemble.h"
+#include "processing/running_stats.h"
+#include "processing/shadow_monitor.h"
+#include "processing/adaptive_normalizer.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static uint32_t nowMicros() { return micros(); }
+#else
+#include <chrono>
+static uint32_t nowMicros() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(
+        steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// Epoch sizes (30 s at the configured rates)
+static const int IMU_EPOCH = 960;
+static const int PPG_EPOCH = 3000;
+static const int IBI_EPOCH = 40;
+static const int FFT_SIZE = 4096;
+static const int BENCH_REPEATS = 10;
+static const int MLP_REPEATS = 1000;
+
+static float g_mag[IMU_EPOCH];
+static float g_ibi[IBI_EPOCH];
+static int32_t g_ppg[PPG_EPOCH];
+static int32_t g_ppgWork[PPG_EPOCH];
+static float g_ppgFloat[PPG_EPOCH];
+static float g_fftRe[FFT_SIZE];
+static float g_fftIm[FFT_SIZE];
+static uint32_t g_ppgPulse[PPG_EPOCH];
+static int32_t g_ppgExact[PPG_EPOCH];
+
+// Synthetic 72 -> 64 -> 32 -> 16 -> 4 int8 network
+static const int MLP_LAYERS = 4;
+static const int MLP_SIZES[MLP_LAYERS + 1] = {72, 64, 32, 16, 4};
+static int8_t g_mlpWeights[MLP_LAYERS][64 * 72];
+static int32_t g_mlpBias[MLP_LAYERS][64];
+static float g_mlpFilterScale[MLP_LAYERS][64];
+static float g_mlpOutScale[MLP_LAYERS];
+static int32_t g_mlpOutZero[MLP_LAYERS];
+static int8_t g_mlpInput[72];
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static uint32_t g_rng = 12345;
+
+static float randUniform() {
+    g_rng = g_rng * 1664525u + 1013904223u;
+    return (g_rng >> 8) / 16777216.0f;
+}
+
+static void fillSignals() {
+    for (int i = 0; i < IMU_EPOCH; i++) {
+        g_mag[i] = 1.0f + 0.02f * sinf(i * 0.05f) + 0.01f * (randUniform() - 0.5f);
+    }
+    for (int i = 0; i < IBI_EPOCH; i++) {
+        g_ibi[i] = 900.0f + 40.0f * sinf(i * 0.7f) + 20.0f * (randUniform() - 0.5f);
+    }
+    for (int i = 0; i < PPG_EPOCH; i++) {
+        g_ppg[i] = 100000 + (int32_t)(2000.0f * sinf(i * 0.069f)) +
+                   (int32_t)(400.0f * (randUniform() - 0.5f));
+    }
+}
+
+/**
+ * Synthetic reflective PPG: systolic and diastolic waves (inverted on the IR
+ * DC level), respiratory baseline wander and noise. 0.9 s beat period.
+ */
+static void fillPulseSignal() {
+    const float period = 0.9f;
+    for (int i = 0; i < PPG_EPOCH; i++) {
+        float t = i / 100.0f;
+        float phase = fmodf(t, period) / period;
+        float sys = (phase - 0.2f) / 0.07f;
+        float dia = (phase - 0.5f) / 0.08f;
+        float pulse = expf(-sys * sys) + 0.4f * expf(-dia * dia);
+        g_ppgPulse[i] = (uint32_t)(100000.0f - 1500.0f * pulse +
+                                   200.0f * sinf(2.0f * (float)M_PI * 0.25f * t) +
+                                   20.0f * (randUniform() - 0.5f));
+    }
+}
+
+/**
+ * Integer-only PPG epoch (no libm), so the input itself is identical on
+ * every target: sawtooth pulse, triangular respiration, LCG noise.
+ */
+static void fillIntegerPPG() {
+    uint32_t rng = 2024;
+    for (int i = 0; i < PPG_EPOCH; i++) {
+        int32_t phase = i % 90;
+        int32_t pulse = phase < 20 ? phase * 75
+                      : phase < 60 ? 1500 - (phase - 20) * 30
+                      : 300 - (phase - 60) * 10;
+        int32_t tri = i % 400;
+        int32_t resp = (tri < 200 ? tri : 400 - tri) - 100;
+        rng = rng * 1664525u + 1013904223u;
+        int32_t noise = (int32_t)(rng >> 24) - 128;
+        g_ppgExact[i] = 100000 - pulse + resp + noise;
+    }
+}
+
+/**
+ * Random int8 network with per-channel filter scales, and an engine built
+ * from it. Hidden layers use ReLU; the logit layer has no activation.
+ */
+static void buildSyntheticMLP(Int8MLP& mlp) {
+    mlp.reset();
+    float inScale = 0.05f;
+    int32_t inZero = -3;
+    for (int l = 0; l < MLP_LAYERS; l++) {
+        int in = MLP_SIZES[l], out = MLP_SIZES[l + 1];
+        for (int i = 0; i < in * out; i++) {
+            g_mlpWeights[l][i] = (int8_t)(randUniform() * 254.0f - 127.0f);
+        }
+        for (int o = 0; o < out; o++) {
+            g_mlpBias[l][o] = (int32_t)(randUniform() * 40000.0f) - 20000;
+            g_mlpFilterScale[l][o] = 0.002f + 0.018f * randUniform();
+        }
+        g_mlpOutScale[l] = 0.05f + 0.15f * randUniform();
+        g_mlpOutZero[l] = l < MLP_LAYERS - 1 ? -128 : 5;
+        mlp.addFullyConnected(g_mlpWeights[l], g_mlpBias[l], in, out, inScale, inZero,
+                              g_mlpFilterScale[l], out, g_mlpOutScale[l], g_mlpOutZero[l],
+                              l < MLP_LAYERS - 1 ? TFL_ACT_RELU : TFL_ACT_NONE);
+        inScale = g_mlpOutScale[l];
+        inZero = g_mlpOutZero[l];
+    }
+}
+
+/**
+ * Straight transcription of TFLM's int8 FULLY_CONNECTED reference kernel
+ * (zero point inside the loop, multiplier derived per call).
+ */
+static void referenceMLP(const int8_t* input, int8_t* logits) {
+    int8_t a[64], b[64];
+    const int8_t* x = input;
+    int8_t* y = a;
+    float inScale = 0.05f;
+    int32_t inZero = -3;
+    for (int l = 0; l < MLP_LAYERS; l++) {
+        int in = MLP_SIZES[l], out = MLP_SIZES[l + 1];
+        for (int o = 0; o < out; o++) {
+            int32_t acc = g_mlpBias[l][o];
+            for (int i = 0; i < in; i++) {
+                acc += g_mlpWeights[l][o * in + i] * (x[i] - inZero);
+            }
+            int32_t multiplier;
+            int shift;
+            quantizeMultiplier((double)inScale * g_mlpFilterScale[l][o] / g_mlpOutScale[l],
+                               &multiplier, &shift);
+            acc = multiplyByQuantizedMultiplier(acc, multiplier, shift) + g_mlpOutZero[l];
+            int32_t lo = l < MLP_LAYERS - 1 ? g_mlpOutZero[l] : -128;
+            y[o] = (int8_t)(acc < lo ? lo : acc > 127 ? 127 : acc);
+        }
+        inScale = g_mlpOutScale[l];
+        inZero = g_mlpOutZero[l];
+        x = y;
+        y = (y == a) ? b : a;
+    }
+    memcpy(logits, x, MLP_SIZES[MLP_LAYERS]);
+}
+
+static void randomMLPInput() {
+    for (int i = 0; i < 72; i++) g_mlpInput[i] = (int8_t)(randUniform() * 256.0f - 128.0f);
+}
+
+static void report(const char* name, uint32_t totalUs, int repeats,
+                   const char* unit = "epoch") {
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%s: %.2f us/%s", name, (float)totalUs / repeats, unit);
+    TEST_MESSAGE(msg);
+}
+
+/**
+ * Direct O(n^2) sample entropy, used as the reference implementation.
+ */
+static float naiveSampleEntropy(const float* x, int n, int m, float r) {
+    uint32_t countA = 0, countB = 0;
+    for (int i = 0; i < n - m; i++) {
+        for (int j = i + 1; j < n - m; j++) {
+            if (templatesMatch(x, i, j, m, r)) {
+                countB++;
+                if (fabsf(x[i + m] - x[j + m]) <= r) countA++;
+            }
+        }
+    }
+    if (countA == 0 || countB == 0) {
+        return logf((float)(n - m) * (n - m - 1) / 2.0f);
+    }
+    return -logf((float)countA / countB);
+}
+
+/**
+ * In-place radix-2 complex FFT, the cost baseline for spectral features.
+ */
+static void referenceFFT(float* re, float* im, int n) {
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        float angle = -2.0f * (float)M_PI / len;
+        float wRe = cosf(angle), wIm = sinf(angle);
+        for (int i = 0; i < n; i += len) {
+            float curRe = 1.0f, curIm = 0.0f;
+            for (int k = 0; k < len / 2; k++) {
+                int a = i + k, b = i + k + len / 2;
+                float tRe = re[b] * curRe - im[b] * curIm;
+                float tIm = re[b] * curIm + im[b] * curRe;
+                re[b] = re[a] - tRe; im[b] = im[a] - tIm;
+                re[a] += tRe; im[a] += tIm;
+                float nextRe = curRe * wRe - curIm * wIm;
+                curIm = curRe * wIm + curIm * wRe;
+                curRe = nextRe;
+            }
+        }
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================================================
+// Exact PPG Statistics
+// ============================================================================
+
+/**
+ * Bit patterns of the 12 PPG stat features for fillIntegerPPG(). Every
+ * target (native x86-64, ESP32-S3) must reproduce these exactly.
+ */
+static const uint32_t GOLDEN_PPG_STATS[N_INT_STAT_FEATURES] = {
+    0x47C2195E,     // mean      99378.7344
+    0x43EAF603,     // std       469.921967
+    0x47BFFD80,     // min       98299
+    0x47C3AF00,     // max       100190
+    0x44EC6000,     // range     1891
+    0x47C24200,     // median    99460
+    0x444F8000,     // iqr       830
+    0xBEAD108A,     // skewness  -0.338016808
+    0xBF940CC9,     // kurtosis  -1.15664017
+    0x55D7946D,     // energy    2.96290605e13
+    0x47C219EC,     // rms       99379.8438
+    0x43130000,     // zero crossings 147
+};
+
+void test_integer_ppg_stats_are_bit_exact() {
+    fillIntegerPPG();
+    float out[N_INT_STAT_FEATURES];
+    computeStatFeatures(g_ppgExact, PPG_EPOCH, out);
+
+    uint32_t bits[N_INT_STAT_FEATURES];
+    memcpy(bits, out, sizeof(bits));
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(GOLDEN_PPG_STATS, bits, N_INT_STAT_FEATURES);
+}
+
+void test_integer_ppg_stats_handle_full_scale() {
+    // Full-range 18-bit square wave: moments take the shifted path
+    for (int i = 0; i < PPG_EPOCH; i++) {
+        g_ppgExact[i] = (i & 1) ? (1 << INT_STATS_MAX_SAMPLE_BITS) - 1 : 0;
+    }
+    float out[N_INT_STAT_FEATURES];
+    computeStatFeatures(g_ppgExact, PPG_EPOCH, out);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 0.0f, out[7]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, -2.0f, out[8]);
+    TEST_ASSERT_EQUAL_FLOAT(PPG_EPOCH / 2 * 262143.0f * 262143.0f, out[9]);
+}
+
+void bench_integer_ppg_stats_per_epoch() {
+    fillIntegerPPG();
+    float out[N_INT_STAT_FEATURES];
+    volatile float sink = 0.0f;
+
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+        computeStatFeatures(g_ppgExact, PPG_EPOCH, out);
+        sink += out[9];
+    }
+    report("int64 PPG stats (3000 PPG)", nowMicros() - t0, BENCH_REPEATS);
+
+    (void)sink;
+}
+
+// ============================================================================
+// Native Int8 MLP
+// ============================================================================
+
+static Int8MLP g_mlp;
+
+void test_int8_mlp_matches_reference() {
+    buildSyntheticMLP(g_mlp);
+    TEST_ASSERT_EQUAL(4, g_mlp.getLayerCount());
+    TEST_ASSERT_EQUAL(72, g_mlp.getInputSize());
+
+    for (int t = 0; t < 200; t++) {
+        randomMLPInput();
+        int8_t expected[4];
+        referenceMLP(g_mlpInput, expected);
+        const int8_t* logits = g_mlp.invoke(g_mlpInput);
+        TEST_ASSERT_EQUAL_INT8_ARRAY(expected, logits, 4);
+    }
+
+    float probs[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    g_mlp.softmax(probs);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, probs[0] + probs[1] + probs[2] + probs[3]);
+    TEST_ASSERT_TRUE(probs[g_mlp.argmax()] >= 0.25f);
+}
+
+void bench_int8_mlp_inference() {
+    buildSyntheticMLP(g_mlp);
+    randomMLPInput();
+    int8_t logits[4];
+    volatile int sink = 0;
+
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < MLP_REPEATS; rep++) {
+        g_mlpInput[rep % 72] ^= 1;
+        sink += g_mlp.invoke(g_mlpInput)[0];
+    }
+    report("native int8 MLP (72-64-32-16-4)", nowMicros() - t0, MLP_REPEATS, "inference");
+
+    t0 = nowMicros();
+    for (int rep = 0; rep < MLP_REPEATS; rep++) {
+        g_mlpInput[rep % 72] ^= 1;
+        referenceMLP(g_mlpInput, logits);
+        sink += logits[0];
+    }
+    report("reference int8 FC kernel", nowMicros() - t0, MLP_REPEATS, "inference");
+
+    (void)sink;
+}
+
+// ============================================================================
+// Fused Input Quantizer
+// ============================================================================
+
+static const int QUANT_FEATURES = 72;
+static const float QUANT_SCALE = 0.05f;
+static const int32_t QUANT_ZERO = -3;
+
+static float g_featMean[QUANT_FEATURES];
+static float g_featScale[QUANT_FEATURES];
+static float g_features[QUANT_FEATURES];
+static int8_t g_quantized[QUANT_FEATURES];
+
+static void fillScalerAndFeatures() {
+    for (int i = 0; i < QUANT_FEATURES; i++) {
+        g_featMean[i] = randUniform() * 200.0f - 100.0f;
+        g_featScale[i] = 0.5f + randUniform() * 50.0f;
+        g_features[i] = g_featMean[i] + g_featScale[i] * (randUniform() * 6.0f - 3.0f);
+    }
+}
+
+/**
+ * The classifier's previous input path: float scaled copy, two divides
+ * per feature, truncating cast.
+ */
+static void scaleThenQuantize(const float* x, int8_t* q) {
+    float scaled[QUANT_FEATURES];
+    for (int i = 0; i < QUANT_FEATURES; i++) {
+        scaled[i] = (x[i] - g_featMean[i]) / g_featScale[i];
+    }
+    for (int i = 0; i < QUANT_FEATURES; i++) {
+        int32_t v = (int32_t)(scaled[i] / QUANT_SCALE) + QUANT_ZERO;
+        q[i] = (int8_t)(v < -128 ? -128 : (v > 127 ? 127 : v));
+    }
+}
+
+/**
+ * The previous path with the fused path's semantics: non-finite guard,
+ * float clamp, round to nearest. This is the like-for-like baseline.
+ */
+static void scaleThenQuantizeRounded(const float* x, int8_t* q) {
+    float scaled[QUANT_FEATURES];
+    for (int i = 0; i < QUANT_FEATURES; i++) {
+        scaled[i] = isfinite(x[i]) ? (x[i] - g_featMean[i]) / g_featScale[i] : 0.0f;
+    }
+    for (int i = 0; i < QUANT_FEATURES; i++) {
+        float v = scaled[i] / QUANT_SCALE + QUANT_ZERO;
+        v = v < -128.0f ? -128.0f : v;
+        v = v > 127.0f ? 127.0f : v;
+        q[i] = (int8_t)((int32_t)(v + 128.5f) - 128);
+    }
+}
+
+void test_fused_quantizer_matches_reference() {
+    InputQuantizer quantizer;
+    int8_t q[QUANT_FEATURES];
+    int mismatches = 0;
+    for (int t = 0; t < 200; t++) {
+        fillScalerAndFeatures();
+        TEST_ASSERT_TRUE(quantizer.begin(g_featMean, g_featScale, QUANT_FEATURES,
+                                         QUANT_SCALE, QUANT_ZERO));
+        quantizer.quantize(g_features, q);
+        for (int i = 0; i < QUANT_FEATURES; i++) {
+            double v = ((double)g_features[i] - g_featMean[i]) / g_featScale[i] / QUANT_SCALE;
+            double r = v >= 0.0 ? floor(v + 0.5) : -floor(-v + 0.5);
+            r += QUANT_ZERO;
+            r = r < -128 ? -128 : (r > 127 ? 127 : r);
+            // Float rounding of the fused form can only move exact ties
+            TEST_ASSERT_INT_WITHIN(1, (int)r, q[i]);
+            if (q[i] != (int)r) mismatches++;
+        }
+    }
+    TEST_ASSERT_LESS_THAN(QUANT_FEATURES * 200 / 1000, mismatches);
+
+    // Saturation, including values far outside the int32 range
+    float extreme[QUANT_FEATURES];
+    for (int i = 0; i < QUANT_FEATURES; i++) extreme[i] = (i & 1) ? 1e30f : -1e30f;
+    quantizer.quantize(extreme, q);
+    TEST_ASSERT_EQUAL_INT8(-128, q[0]);
+    TEST_ASSERT_EQUAL_INT8(127, q[1]);
+
+    // Non-finite features read as the mean: the zero point
+    extreme[0] = NAN;
+    extreme[1] = -NAN;
+    extreme[2] = INFINITY;
+    extreme[3] = -INFINITY;
+    quantizer.quantize(extreme, q);
+    for (int i = 0; i < 4; i++) TEST_ASSERT_EQUAL_INT8(QUANT_ZERO, q[i]);
+    TEST_ASSERT_EQUAL_INT8(127, q[5]);
+
+    int8_t logits[4] = {-5, 17, 17, -128};
+    TEST_ASSERT_EQUAL(1, argmaxInt8(logits, 4));
+}
+
+typedef void (*QuantizePath)(const float* x, int8_t* q, const InputQuantizer& quantizer);
+
+static void runTruncating(const float* x, int8_t* q, const InputQuantizer&) {
+    scaleThenQuantize(x, q);
+}
+
+static void runRounded(const float* x, int8_t* q, const InputQuantizer&) {
+    scaleThenQuantizeRounded(x, q);
+}
+
+static void runFused(const float* x, int8_t* q, const InputQuantizer& quantizer) {
+    quantizer.quantize(x, q);
+}
+
+/**
+ * Best of five rounds of MLP_REPEATS * 10 epochs, in us.
+ */
+static uint32_t timeQuantizePath(QuantizePath path, const InputQuantizer& quantizer) {
+    volatile int sink = 0;
+    uint32_t best = UINT32_MAX;
+    for (int round = 0; round < 5; round++) {
+        uint32_t t0 = nowMicros();
+        for (int rep = 0; rep < MLP_REPEATS * 10; rep++) {
+            g_features[rep % QUANT_FEATURES] += 0.01f;
+            path(g_features, g_quantized, quantizer);
+            sink += g_quantized[rep % QUANT_FEATURES];
+        }
+        uint32_t us = nowMicros() - t0;
+        if (us < best) best = us;
+    }
+    (void)sink;
+    return best;
+}
+
+/**
+ * The truncating path is listed for reference only: it does less work
+ * (no rounding, no non-finite guard), and on x86 at -O2 GCC vectorizes its
+ * fixed-count divides. The S3 has neither vector floats nor a
+ * single-instruction divide, so there the divides are the cost.
+ */
+void bench_fused_input_quantizer() {
+    InputQuantizer quantizer;
+    fillScalerAndFeatures();
+    quantizer.begin(g_featMean, g_featScale, QUANT_FEATURES, QUANT_SCALE, QUANT_ZERO);
+
+    uint32_t truncUs = timeQuantizePath(runTruncating, quantizer);
+    uint32_t roundedUs = timeQuantizePath(runRounded, quantizer);
+    uint32_t fusedUs = timeQuantizePath(runFused, quantizer);
+
+    report("scale copy + divide + truncate (72, reference)", truncUs, MLP_REPEATS * 10, "epoch");
+    report("scale copy + divide + round/clamp (72)", roundedUs, MLP_REPEATS * 10, "epoch");
+    report("fused multiply-add-clamp (72)", fusedUs, MLP_REPEATS * 10, "epoch");
+
+    // Same output, one pass: must not lose to the two-pass form (5% noise)
+    TEST_ASSERT_TRUE_MESSAGE(fusedUs <= roundedUs + roundedUs / 20,
+                             "fused quantizer slower than scale + quantize");
+}
+
+// ============================================================================
+// Batch Classification
+// ============================================================================
+
+static const int BATCH_EPOCHS = 1024;
+static float g_batchFeatures[BATCH_EPOCHS][72];
+static int8_t g_batchInputs[BATCH_EPOCHS * 72];
+static int8_t g_batchLogits[BATCH_EPOCHS * 4];
+static float g_batchProbs[BATCH_EPOCHS][4];
+
+void test_int8_mlp_batch_matches_invoke() {
+    buildSyntheticMLP(g_mlp);
+    for (int i = 0; i < BATCH_EPOCHS * 72; i++) {
+        g_batchInputs[i] = (int8_t)(randUniform() * 256.0f - 128.0f);
+    }
+
+    // Partial tiles and blocks, and the widest batch
+    const int counts[] = {1, 3, 4, 7, 9, 13, BATCH_EPOCHS};
+    for (int c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++) {
+        memset(g_batchLogits, 0x55, sizeof(g_batchLogits));
+        g_mlp.invokeBatch(g_batchInputs, counts[c], g_batchLogits);
+        for (int e = 0; e < counts[c]; e++) {
+            const int8_t* logits = g_mlp.invoke(g_batchInputs + e * 72);
+            TEST_ASSERT_EQUAL_INT8_ARRAY(logits, g_batchLogits + e * 4, 4);
+        }
+        // Nothing written past the batch
+        if (counts[c] < BATCH_EPOCHS) {
+            TEST_ASSERT_EQUAL_INT8(0x55, g_batchLogits[counts[c] * 4]);
+        }
+    }
+
+    float single[4], batched[4];
+    g_mlp.invoke(g_batchInputs);
+    g_mlp.softmax(single);
+    g_mlp.softmax(g_batchLogits, batched);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(single, batched, 4);
+}
+
+/**
+ * Whole night (scale, quantize, MLP, softmax): one epoch at a time as
+ * classify() does, then as one classifyBatch()-style batch. Single thread,
+ * so the rates are per core.
+ */
+void bench_int8_mlp_batch_throughput() {
+    buildSyntheticMLP(g_mlp);
+    InputQuantizer quantizer;
+    fillScalerAndFeatures();
+    quantizer.begin(g_featMean, g_featScale, QUANT_FEATURES, QUANT_SCALE, QUANT_ZERO);
+    for (int e = 0; e < BATCH_EPOCHS; e++) {
+        for (int i = 0; i < 72; i++) {
+            g_batchFeatures[e][i] = g_featMean[i] + g_featScale[i] * (randUniform() * 6.0f - 3.0f);
+        }
+    }
+    const int nights = 20;
+    volatile float sink = 0.0f;
+
+    // Best of five rounds each, so one scheduler hiccup does not decide
+    uint32_t singleUs = UINT32_MAX, batchUs = UINT32_MAX;
+    for (int round = 0; round < 5; round++) {
+        uint32_t t0 = nowMicros();
+        for (int n = 0; n < nights; n++) {
+            for (int e = 0; e < BATCH_EPOCHS; e++) {
+                int8_t input[72];
+                quantizer.quantize(g_batchFeatures[e], input);
+                g_mlp.invoke(input);
+                g_mlp.softmax(g_batchProbs[e]);
+            }
+            sink += g_batchProbs[n][0];
+        }
+        uint32_t us = nowMicros() - t0;
+        if (us < singleUs) singleUs = us;
+
+        t0 = nowMicros();
+        for (int n = 0; n < nights; n++) {
+            for (int e = 0; e < BATCH_EPOCHS; e++) {
+                quantizer.quantize(g_batchFeatures[e], g_batchInputs + e * 72);
+            }
+            g_mlp.invokeBatch(g_batchInputs, BATCH_EPOCHS, g_batchLogits);
+            for (int e = 0; e < BATCH_EPOCHS; e++) {
+                g_mlp.softmax(g_batchLogits + e * 4, g_batchProbs[e]);
+            }
+            sink += g_batchProbs[n][0];
+        }
+        us = nowMicros() - t0;
+        if (us < batchUs) batchUs = us;
+    }
+
+    char msg[128];
+    double epochs = (double)nights * BATCH_EPOCHS;
+    snprintf(msg, sizeof(msg), "single-epoch loop: %.0f epochs/s/core",
+             epochs * 1e6 / (singleUs ? singleUs : 1));
+    TEST_MESSAGE(msg);
+    #if defined(__AVX2__)
+    snprintf(msg, sizeof(msg), "batched (block %d, tile %d): %.0f epochs/s/core",
+             MLP_BATCH_BLOCK, MLP_BATCH_TILE, epochs * 1e6 / (batchUs ? batchUs : 1));
+    #else
+    snprintf(msg, sizeof(msg), "batched (no SIMD tile, per epoch): %.0f epochs/s/core",
+             epochs * 1e6 / (batchUs ? batchUs : 1));
+    #endif
+    TEST_MESSAGE(msg);
+
+    // The batch path must not lose to the loop it replaces. Without the
+    // tile both run the same per-epoch code and only noise separates them.
+    #if defined(__AVX2__)
+    uint32_t slack = singleUs / 20;
+    #else
+    uint32_t slack = singleUs / 10;
+    #endif
+    TEST_ASSERT_TRUE_MESSAGE(batchUs <= singleUs + slack,
+                             "invokeBatch() slower than invoke() per epoch");
+    (void)sink;
+}
+
+// ============================================================================
+// Tree Ensembles
+// ============================================================================
+
+static const int TREE_FEATURES = 72;
+static const int TREE_MAX_NODES = 12000;
+static TreeNode g_treeNodes[TREE_MAX_NODES];
+static uint32_t g_treeRoots[512];
+static uint32_t g_treeLeafBase[512];
+static uint8_t g_treeClass[512];
+static float g_treeLeafValues[TREE_MAX_NODES * 4];
+static float g_treeBase[4];
+static uint32_t g_treeNodeCount;
+static uint32_t g_treeLeafCount;
+
+/**
+ * Random ensemble in the exporter's layout (breadth-first, children
+ * adjacent), of at most `depth` levels of splits per tree.
+ */
+static void buildSyntheticTrees(int kind, int trees, int depth, int classes) {
+    g_treeNodeCount = 0;
+    g_treeLeafCount = 0;
+    for (int t = 0; t < trees; t++) {
+        g_treeRoots[t] = g_treeNodeCount;
+        g_treeLeafBase[t] = g_treeLeafCount;
+        g_treeClass[t] = (uint8_t)(t % classes);
+
+        int levels[TREE_MAX_NODES / 8];
+        int queued = 1, head = 0, leaves = 0;
+        levels[0] = 0;
+        while (head < queued) {
+            int level = levels[head++];
+            TreeNode& node = g_treeNodes[g_treeNodeCount++];
+            node.reserved = 0;
+            if (level == depth || (level > 1 && randUniform() < 0.15f)) {
+                node.feature = TREE_LEAF;
+                node.threshold = 0.0f;
+                node.next = (uint16_t)leaves++;
+                float* value = g_treeLeafValues + g_treeLeafCount *
+                               (kind == TREE_KIND_FOREST ? classes : 1);
+                float sum = 0.0f;
+                for (int c = 0; c < (kind == TREE_KIND_FOREST ? classes : 1); c++) {
+                    value[c] = randUniform();
+                    sum += value[c];
+                }
+                if (kind == TREE_KIND_FOREST) {
+                    for (int c = 0; c < classes; c++) value[c] /= sum;
+                } else {
+                    value[0] = (value[0] - 0.5f) * 0.2f;
+                }
+                g_treeLeafCount++;
+            } else {
+                node.feature = (uint8_t)(randUniform() * TREE_FEATURES);
+                node.threshold = randUniform() * 2.0f - 1.0f;
+                node.next = (uint16_t)queued;
+                levels[queued++] = level + 1;
+                levels[queued++] = level + 1;
+            }
+        }
+    }
+    for (int c = 0; c < classes; c++) g_treeBase[c] = randUniform() - 0.5f;
+}
+
+static bool beginSyntheticTrees(TreeEnsemble& ensemble, int kind, int trees, int classes) {
+    return ensemble.begin(kind, g_treeNodes, g_treeNodeCount, g_treeRoots, g_treeLeafBase,
+                          g_treeClass, trees, g_treeLeafValues, g_treeLeafCount,
+                          g_treeBase, classes, TREE_FEATURES);
+}
+
+/**
+ * One tree at a time, with an if per split.
+ */
+static int referenceTrees(int kind, int trees, int classes, const float* x, float* probs) {
+    double scores[4];
+    for (int c = 0; c < classes; c++) scores[c] = kind == TREE_KIND_BOOSTED ? g_treeBase[c] : 0.0;
+    for (int t = 0; t < trees; t++) {
+        const TreeNode* tree = g_treeNodes + g_treeRoots[t];
+        const TreeNode* node = tree;
+        while (node->feature != TREE_LEAF) {
+            if (x[node->feature] <= node->threshold) node = tree + node->next;
+            else node = tree + node->next + 1;
+        }
+        uint32_t leaf = g_treeLeafBase[t] + node->next;
+        if (kind == TREE_KIND_FOREST) {
+            for (int c = 0; c < classes; c++) scores[c] += g_treeLeafValues[leaf * classes + c];
+        } else {
+            scores[g_treeClass[t]] += g_treeLeafValues[leaf];
+        }
+    }
+    int best = 0;
+    for (int c = 1; c < classes; c++) if (scores[c] > scores[best]) best = c;
+    double sum = 0.0;
+    for (int c = 0; c < classes; c++) {
+        probs[c] = kind == TREE_KIND_FOREST ? (float)(scores[c] / trees)
+                                            : (float)exp(scores[c] - scores[best]);
+        sum += probs[c];
+    }
+    if (kind == TREE_KIND_BOOSTED) for (int c = 0; c < classes; c++) probs[c] /= (float)sum;
+    return best;
+}
+
+static void randomTreeInput(float* x) {
+    for (int i = 0; i < TREE_FEATURES; i++) x[i] = randUniform() * 2.2f - 1.1f;
+}
+
+void test_tree_ensemble_matches_reference() {
+    const int kinds[2] = {TREE_KIND_FOREST, TREE_KIND_BOOSTED};
+    const int counts[2] = {30, 101};    // Odd count: a partial interleave group
+    for (int k = 0; k < 2; k++) {
+        buildSyntheticTrees(kinds[k], counts[k], kinds[k] == TREE_KIND_FOREST ? 8 : 4, 4);
+        TreeEnsemble ensemble;
+        TEST_ASSERT_TRUE(beginSyntheticTrees(ensemble, kinds[k], counts[k], 4));
+
+        for (int e = 0; e < 200; e++) {
+            float x[TREE_FEATURES], expected[4], probs[4];
+            randomTreeInput(x);
+            int expectedClass = referenceTrees(kinds[k], counts[k], 4, x, expected);
+            TEST_ASSERT_EQUAL(expectedClass, ensemble.predict(x, probs));
+            for (int c = 0; c < 4; c++) TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected[c], probs[c]);
+        }
+    }
+
+    // A child pointing back at its parent would never reach a leaf
+    TreeEnsemble ensemble;
+    g_treeNodes[g_treeRoots[3]].next = 0;
+    TEST_ASSERT_FALSE(beginSyntheticTrees(ensemble, TREE_KIND_BOOSTED, counts[1], 4));
+    TEST_ASSERT_FALSE(ensemble.isLoaded());
+}
+
+/**
+ * Latency and flash of typical exported ensembles against the int8 MLP.
+ */
+void bench_tree_ensemble_vs_mlp() {
+    const int kinds[2] = {TREE_KIND_FOREST, TREE_KIND_BOOSTED};
+    const int counts[2] = {30, 200};
+    const int depths[2] = {8, 4};
+    const char* names[2] = {"random forest (30 x depth 8)", "boosted (50 rounds x 4 x depth 4)"};
+    float x[TREE_FEATURES], probs[4];
+    volatile int sink = 0;
+    char msg[128];
+
+    for (int k = 0; k < 2; k++) {
+        buildSyntheticTrees(kinds[k], counts[k], depths[k], 4);
+        TreeEnsemble ensemble;
+        TEST_ASSERT_TRUE(beginSyntheticTrees(ensemble, kinds[k], counts[k], 4));
+        randomTreeInput(x);
+
+        uint32_t t0 = nowMicros();
+        for (int rep = 0; rep < MLP_REPEATS; rep++) {
+            x[rep % TREE_FEATURES] = -x[rep % TREE_FEATURES];
+            sink += ensemble.predict(x, probs);
+        }
+        report(names[k], nowMicros() - t0, MLP_REPEATS, "inference");
+        snprintf(msg, sizeof(msg), "  %u nodes, %u leaves, %u bytes of flash",
+                 (unsigned)ensemble.getNodeCount(), (unsigned)ensemble.getLeafCount(),
+                 (unsigned)ensemble.getModelBytes());
+        TEST_MESSAGE(msg);
+    }
+
+    buildSyntheticMLP(g_mlp);
+    randomMLPInput();
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < MLP_REPEATS; rep++) {
+        g_mlpInput[rep % 72] ^= 1;
+        g_mlp.invoke(g_mlpInput);
+        g_mlp.softmax(probs);
+        sink += g_mlp.argmax();
+    }
+    report("int8 MLP (72-64-32-16-4) + softmax", nowMicros() - t0, MLP_REPEATS, "inference");
+    size_t mlpBytes = 0;
+    for (int l = 0; l < MLP_LAYERS; l++) {
+        mlpBytes += MLP_SIZES[l] * MLP_SIZES[l + 1] + 4 * MLP_SIZES[l + 1];
+    }
+    snprintf(msg, sizeof(msg), "  %u bytes of weights and biases", (unsigned)mlpBytes);
+    TEST_MESSAGE(msg);
+    (void)sink;
+}
+
+// ============================================================================
+// Entropy
+// ============================================================================
+
+void test_permutation_entropy_monotonic_is_zero() {
+    PermutationEntropy pe;
+    for (int i = 0; i < 100; i++) pe.addSample((float)i);
+    TEST_ASSERT_EQUAL(100 - ENTROPY_PE_ORDER + 1, pe.getPatternCount());
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.0f, pe.compute());
+}
+
+void test_permutation_entropy_noise_is_high() {
+    PermutationEntropy pe;
+    for (int i = 0; i < 5000; i++) pe.addSample(randUniform());
+    TEST_ASSERT_GREATER_THAN(0.98f, pe.compute());
+}
+
+void test_bucketed_sample_entropy_matches_naive() {
+    fillSignals();
+    const int n = 240;
+    float r = 0.2f * 0.015f;
+    float fast = sampleEntropy(g_mag, n, ENTROPY_SAMPEN_M, r);
+    float naive = naiveSampleEntropy(g_mag, n, ENTROPY_SAMPEN_M, r);
+    TEST_ASSERT_EQUAL_FLOAT(naive, fast);
+
+    fast = sampleEntropy(g_ibi, IBI_EPOCH, ENTROPY_SAMPEN_M, 8.0f);
+    naive = naiveSampleEntropy(g_ibi, IBI_EPOCH, ENTROPY_SAMPEN_M, 8.0f);
+    TEST_ASSERT_EQUAL_FLOAT(naive, fast);
+}
+
+void bench_entropy_per_epoch() {
+    fillSignals();
+    volatile float sink = 0.0f;
+
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+        PermutationEntropy pe;
+        for (int i = 0; i < IMU_EPOCH; i++) pe.addSample(g_mag[i]);
+        sink += pe.compute();
+    }
+    report("permutation entropy (960 IMU)", nowMicros() - t0, BENCH_REPEATS);
+
+    t0 = nowMicros();
+    for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+        sink += decimatedSampleEntropy(g_mag, IMU_EPOCH);
+    }
+    report("bucketed sample entropy (960 IMU -> 240)", nowMicros() - t0, BENCH_REPEATS);
+
+    t0 = nowMicros();
+    for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+        sink += decimatedSampleEntropy(g_ibi, IBI_EPOCH);
+    }
+    report("bucketed sample entropy (40 IBI)", nowMicros() - t0, BENCH_REPEATS);
+
+    t0 = nowMicros();
+    sink += naiveSampleEntropy(g_mag, IMU_EPOCH, ENTROPY_SAMPEN_M, 0.2f * 0.015f);
+    report("naive sample entropy (960 IMU)", nowMicros() - t0, 1);
+
+    (void)sink;
+}
+
+// ============================================================================
+// Pulse Morphology
+// ============================================================================
+
+void test_pulse_segmenter_finds_every_beat() {
+    fillPulseSignal();
+    PulseMorphology pm;
+    for (int i = 0; i < PPG_EPOCH; i++) pm.addSample(g_ppgPulse[i]);   // Settle filters
+    float out[N_PULSE_FEATURES_BLOCK];
+    pm.finishEpoch(out);
+
+    for (int i = 0; i < PPG_EPOCH; i++) pm.addSample(g_ppgPulse[i]);
+    TEST_ASSERT_INT_WITHIN(1, 33, pm.getBeatCount());
+
+    const PulseRecord* r = pm.getRecords();
+    for (int i = 1; i < pm.getBeatCount(); i++) {
+        TEST_ASSERT_INT_WITHIN(20, 900, r[i].ibiMs);
+        TEST_ASSERT_INT_WITHIN(40, 120, r[i].riseMs);
+    }
+
+    pm.finishEpoch(out);
+    TEST_ASSERT_FLOAT_WITHIN(0.003f, 0.0135f, out[0]);   // ~1350 / 100000
+    TEST_ASSERT_TRUE(out[1] < 0.1f);
+    TEST_ASSERT_EQUAL(0, pm.getBeatCount());
+}
+
+void bench_pulse_morphology_per_epoch() {
+    fillPulseSignal();
+    float out[N_PULSE_FEATURES_BLOCK];
+    volatile float sink = 0.0f;
+
+    PulseMorphology pm;
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+        for (int i = 0; i < PPG_EPOCH; i++) pm.addSample(g_ppgPulse[i]);
+        pm.finishEpoch(out);
+        sink += out[0];
+    }
+    report("pulse morphology (3000 PPG)", nowMicros() - t0, BENCH_REPEATS);
+
+    (void)sink;
+}
+
+// ============================================================================
+// Respiratory Rate
+// ============================================================================
+
+/**
+ * Mean rate over 6 epochs of an IR baseline carrying breathing plus a
+ * cardiac pulse `cardiacRatio` times larger (2 settling epochs skipped).
+ */
+static float synthRespRate(float respBpm, float heartBpm, float cardiacRatio) {
+    RespiratoryEstimator resp;
+    float out[N_RESP_FEATURES_BLOCK];
+    float sum = 0.0f;
+    for (int epoch = 0; epoch < 8; epoch++) {
+        for (int i = 0; i < PPG_EPOCH; i++) {
+            float t = (epoch * PPG_EPOCH + i) / (float)PPG_SAMPLE_RATE_HZ;
+            float x = 100000.0f
+                    + 300.0f * sinf(2.0f * (float)M_PI * respBpm / 60.0f * t)
+                    + cardiacRatio * 300.0f * sinf(2.0f * (float)M_PI * heartBpm / 60.0f * t)
+                    + 60.0f * (randUniform() - 0.5f);
+            resp.addSample((uint32_t)x);
+        }
+        resp.finishEpoch(out);
+        if (epoch >= 2) sum += out[0];
+    }
+    return sum / 6.0f;
+}
+
+void test_resp_rate_rejects_cardiac_band() {
+    const float respRates[] = {6.0f, 10.0f, 15.0f, 24.0f};
+    const float heartRates[] = {48.0f, 60.0f, 75.0f};
+    const float ratios[] = {2.7f, 5.0f};
+    char msg[96];
+    for (float ratio : ratios) {
+        for (float hr : heartRates) {
+            for (float rr : respRates) {
+                float rate = synthRespRate(rr, hr, ratio);
+                snprintf(msg, sizeof(msg), "resp %.0f bpm, heart %.0f bpm x%.1f: %.1f",
+                         rr, hr, ratio, rate);
+                TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.5f, rr, rate, msg);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Lifting Wavelet
+// ============================================================================
+
+void test_integer_lifting_is_reversible() {
+    fillSignals();
+    for (int i = 0; i < PPG_EPOCH; i++) g_ppgWork[i] = g_ppg[i];
+    liftingForward(g_ppgWork, PPG_EPOCH, WAVELET_LEVELS);
+    liftingInverse(g_ppgWork, PPG_EPOCH, WAVELET_LEVELS);
+    TEST_ASSERT_EQUAL_MEMORY(g_ppg, g_ppgWork, sizeof(g_ppg));
+}
+
+void test_wavelet_features_are_distribution() {
+    fillSignals();
+    float out[N_WAVELET_CHANNEL_FEATURES];
+    for (int i = 0; i < PPG_EPOCH; i++) g_ppgWork[i] = g_ppg[i];
+    computeWaveletFeatures(g_ppgWork, PPG_EPOCH, out);
+
+    float total = 0.0f;
+    for (int j = 0; j < WAVELET_LEVELS; j++) total += out[j];
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1.0f, total);
+    TEST_ASSERT_TRUE(out[WAVELET_LEVELS] >= 0.0f && out[WAVELET_LEVELS] <= 1.0f);
+}
+
+// Energies of pywt.wavedec(x, 'bior2.2', mode='reflect', level=4) for the
+// signals of fillWaveletReference(): approximation, then details level 1..4
+static const double PYWT_PPG_ENERGY[WAVELET_LEVELS + 1] = {
+    30704445511851.86, 15213457.749999896, 15530822.519531582,
+    16630104.950439403, 60034802.548580654
+};
+static const double PYWT_IMU_ENERGY[WAVELET_LEVELS + 1] = {
+    1022.9307492223322, 0.011693275824654884, 0.011600108880884393,
+    0.00748790755747562, 0.006724636970675464
+};
+static const double PYWT_SHORT_ENERGY[WAVELET_LEVELS + 1] = {
+    260097350.1193693, 300861.9999999996, 246628.71093749997,
+    51902.853515625, 73960.85260009747
+};
+static const int WAVELET_SHORT = 37;     // Odd, and boundary-dominated by level 4
+static const double WAVELET_PARITY_RTOL = 1e-4;
+
+static int triangleWave(int i, int period, int amplitude) {
+    int phase = i % period;
+    int v = phase < period / 2 ? phase : period - phase;
+    return v * 4 * amplitude / period - amplitude;
+}
+
+/**
+ * Integer-exact signals (reproducible bit for bit in Python): PPG counts
+ * into g_ppg, IMU magnitude in 1/65536 g steps into g_mag.
+ */
+static void fillWaveletReference() {
+    uint32_t g = 12345;
+    for (int i = 0; i < PPG_EPOCH; i++) {
+        g = (g * 1103515245u + 12345u) & 0x7fffffffu;
+        g_ppg[i] = 100000 + triangleWave(i, 91, 2000) + triangleWave(i, 400, 300) +
+                   (int32_t)((g >> 16) % 401) - 200;
+    }
+    for (int i = 0; i < IMU_EPOCH; i++) {
+        g = (g * 1103515245u + 12345u) & 0x7fffffffu;
+        g_mag[i] = (65536 + triangleWave(i, 97, 1300) + (int)((g >> 16) % 1311) - 655) / 65536.0f;
+    }
+}
+
+template <typename T>
+static void assertPywtEnergies(T* x, int length, const double* reference) {
+    float detail[WAVELET_LEVELS];
+    float approx;
+    waveletDecompose(x, length, WAVELET_LEVELS, detail, &approx);
+
+    TEST_ASSERT_FLOAT_WITHIN((float)(WAVELET_PARITY_RTOL * reference[0]),
+                             (float)reference[0], approx);
+    for (int j = 0; j < WAVELET_LEVELS; j++) {
+        TEST_ASSERT_FLOAT_WITHIN((float)(WAVELET_PARITY_RTOL * reference[j + 1]),
+                                 (float)reference[j + 1], detail[j]);
+    }
+}
+
+void test_wavelet_energies_match_pywt() {
+    fillWaveletReference();
+
+    for (int i = 0; i < PPG_EPOCH; i++) g_ppgWork[i] = g_ppg[i];
+    assertPywtEnergies(g_ppgWork, PPG_EPOCH, PYWT_PPG_ENERGY);
+    for (int i = 0; i < PPG_EPOCH; i++) g_ppgFloat[i] = (float)g_ppg[i];
+    assertPywtEnergies(g_ppgFloat, PPG_EPOCH, PYWT_PPG_ENERGY);
+
+    assertPywtEnergies(g_mag, IMU_EPOCH, PYWT_IMU_ENERGY);
+
+    // Baseline removed, so float rounding does not hide boundary errors
+    for (int i = 0; i < WAVELET_SHORT; i++) g_ppgWork[i] = g_ppg[i] - 100000;
+    assertPywtEnergies(g_ppgWork, WAVELET_SHORT, PYWT_SHORT_ENERGY);
+    for (int i = 0; i < WAVELET_SHORT; i++) g_ppgFloat[i] = (float)(g_ppg[i] - 100000);
+    assertPywtEnergies(g_ppgFloat, WAVELET_SHORT, PYWT_SHORT_ENERGY);
+}
+
+void bench_wavelet_vs_fft_per_epoch() {
+    fillSignals();
+    float out[N_WAVELET_CHANNEL_FEATURES];
+    volatile float sink = 0.0f;
+
+    uint32_t total = 0;
+    for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+        for (int i = 0; i < PPG_EPOCH; i++) g_ppgWork[i] = g_ppg[i];
+        uint32_t t0 = nowMicros();
+        computeWaveletFeatures(g_ppgWork, PPG_EPOCH, out);
+        total += nowMicros() - t0;
+        sink += out[0];
+    }
+    report("integer lifting features (3000 PPG)", total, BENCH_REPEATS);
+
+    total = 0;
+    for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+        for (int i = 0; i < PPG_EPOCH; i++) g_ppgFloat[i] = (float)g_ppg[i];
+        uint32_t t0 = nowMicros();
+        computeWaveletFeatures(g_ppgFloat, PPG_EPOCH, out);
+        total += nowMicros() - t0;
+        sink += out[0];
+    }
+    report("float lifting features (3000 PPG)", total, BENCH_REPEATS);
+
+    total = 0;
+    for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+        for (int i = 0; i < FFT_SIZE; i++) {
+            g_fftRe[i] = i < PPG_EPOCH ? (float)g_ppg[i] : 0.0f;
+            g_fftIm[i] = 0.0f;
+        }
+        uint32_t t0 = nowMicros();
+        referenceFFT(g_fftRe, g_fftIm, FFT_SIZE);
+        total += nowMicros() - t0;
+        sink += g_fftRe[1];
+    }
+    report("radix-2 FFT (4096, PPG zero-padded)", total, BENCH_REPEATS);
+
+    (void)sink;
+}
+
+// ============================================================================
+// HMM Stage Smoothing
+// ============================================================================
+
+static const int HMM_EPOCHS = 120;
+static const int HMM_TEST_LAG = 4;
+
+static float g_posteriors[HMM_EPOCHS][HMM_N_STATES];
+
+/**
+ * Noisy classifier output around a true stage.
+ */
+static void fillPosteriors(const int* stages, int count, float noise) {
+    for (int t = 0; t < count; t++) {
+        float sum = 0.0f;
+        for (int s = 0; s < HMM_N_STATES; s++) {
+            g_posteriors[t][s] = (s == stages[t] ? 1.0f : 0.0f) + noise * randUniform() + 0.01f;
+            sum += g_posteriors[t][s];
+        }
+        for (int s = 0; s < HMM_N_STATES; s++) g_posteriors[t][s] /= sum;
+    }
+}
+
+/**
+ * Full Viterbi over epochs [0, end], in double; returns the state at `at`.
+ */
+static int offlineViterbi(int end, int at) {
+    static uint8_t back[HMM_EPOCHS][HMM_N_STATES];
+    double delta[HMM_N_STATES];
+    for (int t = 0; t <= end; t++) {
+        double next[HMM_N_STATES];
+        for (int s = 0; s < HMM_N_STATES; s++) {
+            double e = log((double)(g_posteriors[t][s] > HMM_MIN_EMISSION ? g_posteriors[t][s]
+                                                                          : HMM_MIN_EMISSION)
+                           / HMM_CLASS_PRIOR[s]);
+            if (t == 0) {
+                next[s] = log((double)HMM_INITIAL[s]) + e;
+                continue;
+            }
+            int from = 0;
+            for (int i = 1; i < HMM_N_STATES; i++) {
+                if (delta[i] + log((double)HMM_TRANSITION[i][s]) >
+                    delta[from] + log((double)HMM_TRANSITION[from][s])) from = i;
+            }
+            back[t][s] = (uint8_t)from;
+            next[s] = delta[from] + log((double)HMM_TRANSITION[from][s]) + e;
+        }
+        for (int s = 0; s < HMM_N_STATES; s++) delta[s] = next[s];
+    }
+    int state = 0;
+    for (int s = 1; s < HMM_N_STATES; s++) if (delta[s] > delta[state]) state = s;
+    for (int t = end; t > at; t--) state = back[t][state];
+    return state;
+}
+
+void test_hmm_smoother_removes_flicker() {
+    HMMSmoother smoother;
+    TEST_ASSERT_TRUE(smoother.begin(&HMM_TRANSITION[0][0], HMM_INITIAL, HMM_CLASS_PRIOR,
+                                    HMM_N_STATES, HMM_TEST_LAG));
+
+    // Deep sleep with one epoch the classifier calls Wake at 55 %
+    const float deep[HMM_N_STATES] = {0.05f, 0.10f, 0.80f, 0.05f};
+    const float blip[HMM_N_STATES] = {0.55f, 0.10f, 0.30f, 0.05f};
+    float filtered[HMM_N_STATES];
+    for (int t = 0; t < 10; t++) smoother.update(deep, filtered);
+    TEST_ASSERT_EQUAL(2, smoother.update(blip, filtered));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, filtered[0] + filtered[1] + filtered[2] + filtered[3]);
+    for (int t = 0; t < HMM_TEST_LAG; t++) smoother.update(deep, filtered);
+    TEST_ASSERT_EQUAL(2, smoother.getLaggedStage());    // The blip epoch, in hindsight
+
+    // A sustained change still comes through
+    const float wake[HMM_N_STATES] = {0.90f, 0.05f, 0.03f, 0.02f};
+    int stage = -1;
+    for (int t = 0; t < 4; t++) stage = smoother.update(wake, filtered);
+    TEST_ASSERT_EQUAL(0, stage);
+}
+
+void test_hmm_fixed_lag_matches_offline_viterbi() {
+    int stages[HMM_EPOCHS];
+    int stage = 0;
+    for (int t = 0; t < HMM_EPOCHS; t++) {
+        if (randUniform() < 0.1f) stage = (int)(randUniform() * HMM_N_STATES) % HMM_N_STATES;
+        stages[t] = stage;
+    }
+    fillPosteriors(stages, HMM_EPOCHS, 1.5f);
+
+    HMMSmoother smoother;
+    smoother.begin(&HMM_TRANSITION[0][0], HMM_INITIAL, HMM_CLASS_PRIOR,
+                   HMM_N_STATES, HMM_TEST_LAG);
+    for (int t = 0; t < HMM_EPOCHS; t++) {
+        smoother.update(g_posteriors[t], nullptr);
+        if (t < HMM_TEST_LAG) {
+            TEST_ASSERT_EQUAL(-1, smoother.getLaggedStage());
+        } else {
+            TEST_ASSERT_EQUAL(offlineViterbi(t, t - HMM_TEST_LAG), smoother.getLaggedStage());
+        }
+    }
+}
+
+void test_hmm_preview_leaves_state_alone() {
+    HMMSmoother smoother;
+    smoother.begin(&HMM_TRANSITION[0][0], HMM_INITIAL, HMM_CLASS_PRIOR,
+                   HMM_N_STATES, HMM_TEST_LAG);
+    const float deep[HMM_N_STATES] = {0.05f, 0.10f, 0.80f, 0.05f};
+    const float wake[HMM_N_STATES] = {0.90f, 0.05f, 0.03f, 0.02f};
+    float filtered[HMM_N_STATES];
+    for (int t = 0; t < 6; t++) smoother.update(deep, filtered);
+
+    // Previews of any evidence, then the real epoch: same as update() alone
+    float previewed[HMM_N_STATES];
+    int previewStage = smoother.preview(wake, previewed);
+    smoother.preview(deep, filtered);
+    TEST_ASSERT_EQUAL(6, (int)smoother.getEpochCount());
+
+    HMMSmoother reference;
+    reference.begin(&HMM_TRANSITION[0][0], HMM_INITIAL, HMM_CLASS_PRIOR,
+                    HMM_N_STATES, HMM_TEST_LAG);
+    for (int t = 0; t < 6; t++) reference.update(deep, nullptr);
+    float expected[HMM_N_STATES];
+    int expectedStage = reference.update(wake, expected);
+
+    TEST_ASSERT_EQUAL(expectedStage, previewStage);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected, previewed, HMM_N_STATES);
+    TEST_ASSERT_EQUAL(expectedStage, smoother.update(wake, filtered));
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected, filtered, HMM_N_STATES);
+    TEST_ASSERT_EQUAL(reference.getLaggedStage(), smoother.getLaggedStage());
+}
+
+void bench_hmm_smoother_per_epoch() {
+    int stages[HMM_EPOCHS];
+    for (int t = 0; t < HMM_EPOCHS; t++) stages[t] = (t / 20) % HMM_N_STATES;
+    fillPosteriors(stages, HMM_EPOCHS, 1.0f);
+
+    HMMSmoother smoother;
+    smoother.begin(&HMM_TRANSITION[0][0], HMM_INITIAL, HMM_CLASS_PRIOR,
+                   HMM_N_STATES, HMM_TEST_LAG);
+    float filtered[HMM_N_STATES];
+    volatile int sink = 0;
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < MLP_REPEATS; rep++) {
+        sink += smoother.update(g_posteriors[rep % HMM_EPOCHS], filtered);
+        sink += smoother.getLaggedStage();
+    }
+    report("HMM forward + fixed-lag Viterbi (K=4, lag 4)", nowMicros() - t0, MLP_REPEATS);
+    (void)sink;
+}
+
+// ============================================================================
+// IMU Gate (Cascade First Stage)
+// ============================================================================
+
+static const int GATE_TEST_FEATURES = 50;
+static const int GATE_TEST_CLASSES = 4;
+
+static float g_gateWeights[GATE_TEST_CLASSES * GATE_TEST_FEATURES];
+static float g_gateBias[GATE_TEST_CLASSES];
+static float g_gateFeatures[GATE_TEST_FEATURES];
+
+/**
+ * Class c responds to feature c only.
+ */
+static void fillGate() {
+    memset(g_gateWeights, 0, sizeof(g_gateWeights));
+    for (int c = 0; c < GATE_TEST_CLASSES; c++) {
+        g_gateWeights[c * GATE_TEST_FEATURES + c] = 1.0f;
+        g_gateBias[c] = 0.0f;
+    }
+}
+
+void test_imu_gate_decides_only_confident_epochs() {
+    fillGate();
+    IMUGate gate;
+    TEST_ASSERT_TRUE(gate.begin(g_gateWeights, g_gateBias, GATE_TEST_FEATURES,
+                                GATE_TEST_CLASSES, 0.9f));
+    float probs[GATE_TEST_CLASSES];
+
+    // Clearly class 2: decided, probabilities sum to 1
+    memset(g_gateFeatures, 0, sizeof(g_gateFeatures));
+    g_gateFeatures[2] = 8.0f;
+    TEST_ASSERT_EQUAL(2, gate.classify(g_gateFeatures, probs));
+    float sum = 0.0f;
+    for (int c = 0; c < GATE_TEST_CLASSES; c++) sum += probs[c];
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, sum);
+    TEST_ASSERT_TRUE(probs[2] > 0.99f);
+
+    // Split between classes 0 and 3: left to the full model
+    memset(g_gateFeatures, 0, sizeof(g_gateFeatures));
+    g_gateFeatures[0] = 4.0f;
+    g_gateFeatures[3] = 4.0f;
+    TEST_ASSERT_EQUAL(-1, gate.classify(g_gateFeatures, probs));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, probs[0], probs[3]);
+
+    // A threshold above 1 disables the gate
+    gate.begin(g_gateWeights, g_gateBias, GATE_TEST_FEATURES, GATE_TEST_CLASSES, 2.0f);
+    g_gateFeatures[3] = 40.0f;
+    TEST_ASSERT_EQUAL(-1, gate.classify(g_gateFeatures, probs));
+}
+
+void bench_imu_gate_per_epoch() {
+    fillGate();
+    for (int i = 0; i < GATE_TEST_FEATURES; i++) g_gateFeatures[i] = randUniform();
+    IMUGate gate;
+    gate.begin(g_gateWeights, g_gateBias, GATE_TEST_FEATURES, GATE_TEST_CLASSES, 0.9f);
+    float probs[GATE_TEST_CLASSES];
+    volatile int sink = 0;
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < MLP_REPEATS; rep++) {
+        g_gateFeatures[rep % GATE_TEST_FEATURES] += 0.001f;
+        sink += gate.classify(g_gateFeatures, probs);
+    }
+    report("IMU gate (50 features, 4 classes)", nowMicros() - t0, MLP_REPEATS);
+    (void)sink;
+}
+
+// ============================================================================
+// Running Statistics (Provisional Stages)
+// ============================================================================
+
+void test_running_stats_match_epoch_stats() {
+    fillSignals();
+    RunningStats stats;
+    for (int i = 0; i < IMU_EPOCH; i++) stats.add(g_mag[i]);
+    float out[N_RUNNING_STAT_FEATURES];
+    stats.snapshot(out, IMU_EPOCH);
+
+    // Two-pass double reference
+    double mean = 0.0, energy = 0.0;
+    float minVal = g_mag[0], maxVal = g_mag[0];
+    for (int i = 0; i < IMU_EPOCH; i++) {
+        mean += g_mag[i];
+        energy += (double)g_mag[i] * g_mag[i];
+        if (g_mag[i] < minVal) minVal = g_mag[i];
+        if (g_mag[i] > maxVal) maxVal = g_mag[i];
+    }
+    mean /= IMU_EPOCH;
+    double m2 = 0.0, m3 = 0.0, m4 = 0.0;
+    for (int i = 0; i < IMU_EPOCH; i++) {
+        double d = g_mag[i] - mean;
+        m2 += d * d;
+        m3 += d * d * d;
+        m4 += d * d * d * d;
+    }
+    m2 /= IMU_EPOCH;
+    m3 /= IMU_EPOCH;
+    m4 /= IMU_EPOCH;
+    double std = sqrt(m2);
+
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, (float)mean, out[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f * std, (float)std, out[1]);
+    TEST_ASSERT_EQUAL_FLOAT(minVal, out[2]);
+    TEST_ASSERT_EQUAL_FLOAT(maxVal, out[3]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-2f, (float)(m3 / (m2 * std)), out[7]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-2f, (float)(m4 / (m2 * m2) - 3.0), out[8]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f * energy, (float)energy, out[9]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, (float)sqrt(energy / IMU_EPOCH), out[10]);
+
+    // A third of an epoch reads in full-epoch units
+    stats.reset();
+    for (int i = 0; i < IMU_EPOCH / 3; i++) stats.add(g_mag[i]);
+    stats.snapshot(out, IMU_EPOCH);
+    TEST_ASSERT_EQUAL(IMU_EPOCH / 3, stats.getCount());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f * energy, (float)energy, out[9]);
+
+    // A step up stays above the running mean: no crossing at the start
+    stats.reset();
+    stats.add(0.0f);
+    for (int i = 1; i < 50; i++) stats.add(1.0f);
+    stats.snapshot(out, IMU_EPOCH);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, out[11]);
+}
+
+void bench_running_stats_per_epoch() {
+    fillSignals();
+    RunningStats stats[4];
+    float out[N_RUNNING_STAT_FEATURES];
+    volatile float sink = 0.0f;
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+        for (int a = 0; a < 4; a++) stats[a].reset();
+        // Four channels per sample, a snapshot every 5 s
+        for (int i = 0; i < IMU_EPOCH; i++) {
+            for (int a = 0; a < 4; a++) stats[a].add(g_mag[i] + a);
+            if ((i + 1) % 160 == 0) {
+                for (int a = 0; a < 4; a++) stats[a].snapshot(out, IMU_EPOCH);
+                sink += out[1];
+            }
+        }
+    }
+    report("Running IMU stats (4 channels, 6 snapshots)", nowMicros() - t0, BENCH_REPEATS);
+    (void)sink;
+}
+
+// ============================================================================
+// Shadow Model Monitor
+// ============================================================================
+
+void test_shadow_monitor_logs_and_budgets() {
+    ShadowMonitor monitor;
+    TEST_ASSERT_TRUE(monitor.begin(4, 2.0f, 3.5f, 3));
+
+    // Agree, disagree, disagree (cheap)
+    TEST_ASSERT_TRUE(monitor.shouldRun());
+    monitor.record(1, 0.80f, 1, 0.70f, 0.5f);
+    monitor.record(2, 0.60f, 3, 0.65f, 0.5f);
+    monitor.record(0, 0.90f, 1, 0.40f, 0.5f);
+    TEST_ASSERT_EQUAL(3, (int)monitor.getCompared());
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.0f / 3.0f, monitor.getAgreement());
+    TEST_ASSERT_EQUAL(1, monitor.getCount(2, 3));
+    TEST_ASSERT_EQUAL(3, monitor.getRecord(1).shadowStage());
+    TEST_ASSERT_EQUAL(5, monitor.getRecord(1).confidenceDelta);
+    TEST_ASSERT_EQUAL(-50, monitor.getRecord(2).confidenceDelta);
+
+    uint8_t record[SHADOW_RECORD_MAX];
+    size_t length = monitor.serialize(record);
+    TEST_ASSERT_EQUAL(SHADOW_HEADER_SIZE + 4 * 4 * 2 + 3 * 2, (int)length);
+    TEST_ASSERT_EQUAL(3, record[3]);
+    TEST_ASSERT_EQUAL(3, record[4]);
+    TEST_ASSERT_EQUAL(1, record[SHADOW_HEADER_SIZE + (1 * 4 + 1) * 2]);   // counts[1][1]
+    TEST_ASSERT_EQUAL(0x23, record[length - 4]);                          // Second record
+
+    // Over budget: sits out 3 epochs, then gets one probe
+    for (int i = 0; i < 10; i++) monitor.record(1, 0.5f, 1, 0.5f, 20.0f);
+    TEST_ASSERT_TRUE(monitor.isBackingOff());
+    for (int i = 0; i < 3; i++) TEST_ASSERT_FALSE(monitor.shouldRun());
+    TEST_ASSERT_TRUE(monitor.shouldRun());
+    TEST_ASSERT_EQUAL(3, (int)monitor.getSkippedCpu());
+
+    // Low battery stops it until the voltage clears the hysteresis
+    monitor.setBatteryVoltage(3.4f);
+    TEST_ASSERT_FALSE(monitor.shouldRun());
+    monitor.setBatteryVoltage(3.55f);
+    TEST_ASSERT_FALSE(monitor.shouldRun());
+    monitor.setBatteryVoltage(3.7f);
+    TEST_ASSERT_TRUE(monitor.shouldRun());
+    TEST_ASSERT_EQUAL(2, (int)monitor.getSkippedBattery());
+
+    // The ring keeps the latest SHADOW_LOG_EPOCHS, oldest first
+    monitor.reset();
+    for (int i = 0; i < SHADOW_LOG_EPOCHS + 5; i++) {
+        monitor.record(i % 4, 0.5f, 0, 0.5f, 0.1f);
+    }
+    TEST_ASSERT_EQUAL(SHADOW_LOG_EPOCHS, monitor.getLogSize());
+    TEST_ASSERT_EQUAL(5 % 4, monitor.getRecord(0).activeStage());
+}
+
+// ============================================================================
+// Adaptive Normalization
+// ============================================================================
+
+static const char* NORM_STATE_FILE = "/tmp/test_adaptive_norm.bin";
+
+void test_adaptive_norm_tracks_user_and_persists() {
+    const float popMean[3] = {0.0f, 10.0f, -3.0f};
+    const float popScale[3] = {1.0f, 2.0f, 0.5f};
+    remove(NORM_STATE_FILE);
+
+    // Weight 0 leaves the features alone however far off the wearer is
+    AdaptiveNormalizer off;
+    TEST_ASSERT_TRUE(off.begin(popMean, popScale, 3, 10.0f, 0.0f, nullptr, 0));
+    const float epoch[3] = {5.0f, 30.0f, 1.0f};
+    for (int i = 0; i < 50; i++) off.update(epoch, 3);
+    float out[3];
+    off.apply(epoch, out, 3);
+    for (int i = 0; i < 3; i++) TEST_ASSERT_FLOAT_WITHIN(1e-5f, epoch[i], out[i]);
+
+    // A wearer at 5 +- 0.5 on feature 0 ends up on the population's 0 +- 1;
+    // feature 2 is never valid and keeps the population
+    AdaptiveNormalizer norm;
+    TEST_ASSERT_TRUE(norm.begin(popMean, popScale, 3, 10.0f, 1.0f, NORM_STATE_FILE, 0));
+    for (int i = 0; i < 400; i++) {
+        const float x[3] = {i % 2 ? 5.5f : 4.5f, 10.0f, 99.0f};
+        norm.update(x, 2);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 5.0f, norm.getUserMean(0));
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 0.5f, norm.getUserStd(0));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.5f, norm.getUserStd(1));   // Floor: 0.25 * 2
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, -3.0f, norm.getUserMean(2));
+    const float probe[3] = {5.5f, 10.0f, -2.5f};
+    norm.apply(probe, out, 3);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 1.0f, out[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 10.0f, out[1]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, -2.5f, out[2]);
+
+    // An artifact moves the mean by at most alpha * ADAPTIVE_NORM_CLIP_STD * std
+    float before = norm.getUserMean(0);
+    const float artifact[3] = {1000.0f, 10.0f, -3.0f};
+    norm.update(artifact, 3);
+    float alpha = 1.0f - powf(2.0f, -1.0f / 10.0f);
+    TEST_ASSERT_TRUE(norm.getUserMean(0) - before <= alpha * ADAPTIVE_NORM_CLIP_STD * 0.55f);
+
+    // Next night: begin() picks up the stored statistics for the same layout only
+    TEST_ASSERT_TRUE(norm.persist());
+    AdaptiveNormalizer nextNight;
+    TEST_ASSERT_TRUE(nextNight.begin(popMean, popScale, 3, 10.0f, 1.0f, NORM_STATE_FILE, 0));
+    TEST_ASSERT_EQUAL_UINT32(norm.getUpdates(), nextNight.getUpdates());
+    TEST_ASSERT_EQUAL_FLOAT(norm.getUserMean(0), nextNight.getUserMean(0));
+    AdaptiveNormalizer otherLayout;
+    TEST_ASSERT_TRUE(otherLayout.begin(popMean, popScale, 2, 10.0f, 1.0f, NORM_STATE_FILE, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, otherLayout.getUpdates());
+
+    // New wearer
+    nextNight.reset();
+    AdaptiveNormalizer newWearer;
+    TEST_ASSERT_TRUE(newWearer.begin(popMean, popScale, 3, 10.0f, 1.0f, NORM_STATE_FILE, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, newWearer.getUpdates());
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.0f, newWearer.getUserMean(0));
+
+    const float badScale[3] = {1.0f, 0.0f, 1.0f};
+    TEST_ASSERT_FALSE(newWearer.begin(popMean, badScale, 3, 10.0f, 1.0f, nullptr, 0));
+    remove(NORM_STATE_FILE);
+}
+
+void bench_adaptive_norm_per_epoch() {
+    float mean[QUANT_FEATURES], scale[QUANT_FEATURES], epoch[QUANT_FEATURES];
+    for (int i = 0; i < QUANT_FEATURES; i++) {
+        mean[i] = (float)i;
+        scale[i] = 1.0f + 0.01f * i;
+        epoch[i] = mean[i] + 0.3f;
+    }
+    AdaptiveNormalizer norm;
+    norm.begin(mean, scale, QUANT_FEATURES, 480.0f, 0.5f, nullptr, 0);
+
+    float out[QUANT_FEATURES];
+    volatile float sink = 0.0f;
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < MLP_REPEATS; rep++) {
+        norm.apply(epoch, out, QUANT_FEATURES);
+        norm.update(epoch, QUANT_FEATURES);
+        sink += out[0];
+    }
+    report("Adaptive normalization (apply + update, 72 features)", nowMicros() - t0, MLP_REPEATS);
+    (void)sink;
+}
+
+// ============================================================================
+// Actigraphy Fallback Scorer
+// ============================================================================
+
+void test_cole_kripke_matches_formula() {
+    // a[-4..+2] in raw counts; /100 and capped at 300 inside
+    const float counts[7] = {0.0f, 100.0f, 200.0f, 0.0f, 400.0f, 50000.0f, 0.0f};
+    float expected = 0.001f * (54.0f * 1.0f + 58.0f * 2.0f + 230.0f * 4.0f + 74.0f * 300.0f);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expected, ActigraphyScorer::coleKripke(counts));
+
+    // Still minutes score as sleep, then activity turns the scored minute to wake
+    ActigraphyScorer scorer;
+    TEST_ASSERT_TRUE(scorer.begin(ACTIGRAPHY_COLE_KRIPKE, 2));
+    for (int epoch = 0; epoch < 2 * (ACTIGRAPHY_CK_LAG + 1) - 1; epoch++) {
+        TEST_ASSERT_FALSE(scorer.addEpoch(0.0f));
+    }
+    TEST_ASSERT_TRUE(scorer.addEpoch(0.0f));
+    TEST_ASSERT_TRUE(scorer.isAsleep());
+    TEST_ASSERT_TRUE(scorer.getWakeProbability() < 0.5f);
+
+    for (int epoch = 0; epoch < 2 * (ACTIGRAPHY_CK_LAG + 1); epoch++) scorer.addEpoch(1000.0f);
+    TEST_ASSERT_FALSE(scorer.isAsleep());
+    TEST_ASSERT_TRUE(scorer.getWakeProbability() > 0.5f);
+}
+
+void test_sadeh_matches_formula() {
+    float counts[ACTIGRAPHY_WINDOW];
+    for (int i = 0; i < ACTIGRAPHY_WINDOW; i++) counts[i] = (float)(i * 20);
+
+    float mw5 = 0.0f, mean6 = 0.0f, var6 = 0.0f;
+    int nat = 0;
+    for (int i = 0; i < ACTIGRAPHY_WINDOW; i++) {
+        mw5 += counts[i] / ACTIGRAPHY_WINDOW;
+        if (counts[i] >= 50.0f && counts[i] < 100.0f) nat++;
+    }
+    for (int i = 0; i < 6; i++) mean6 += counts[i] / 6.0f;
+    for (int i = 0; i < 6; i++) var6 += (counts[i] - mean6) * (counts[i] - mean6);
+    float expected = 7.601f - 0.065f * mw5 - 1.08f * nat - 0.056f * sqrtf(var6 / 5.0f)
+                     - 0.703f * logf(counts[5] + 1.0f);
+    TEST_ASSERT_EQUAL(2, nat);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, expected, ActigraphyScorer::sadeh(counts));
+}
+
+void bench_actigraphy_per_minute() {
+    ActigraphyScorer ck, sadeh;
+    ck.begin(ACTIGRAPHY_COLE_KRIPKE, 1);
+    sadeh.begin(ACTIGRAPHY_SADEH, 1);
+    volatile int sink = 0;
+
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < MLP_REPEATS; rep++) {
+        sink += ck.addEpoch(randUniform() * 400.0f);
+    }
+    report("Cole-Kripke scorer", nowMicros() - t0, MLP_REPEATS, "minute");
+
+    t0 = nowMicros();
+    for (int rep = 0; rep < MLP_REPEATS; rep++) {
+        sink += sadeh.addEpoch(randUniform() * 400.0f);
+    }
+    report("Sadeh scorer", nowMicros() - t0, MLP_REPEATS, "minute");
+    (void)sink;
+}
+
+// ============================================================================
+// Inference Profiler
+// ============================================================================
+
+static uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void test_profiler_records_each_layer() {
+    buildSyntheticMLP(g_mlp);
+    InferenceProfiler profiler;
+    for (int t = 0; t < 200; t++) {
+        randomMLPInput();
+        profiler.beginInvoke();
+        g_mlp.invoke(g_mlpInput, &profiler);
+        profiler.endInvoke(g_mlp.getMemoryUsed());
+    }
+
+    // Whole invocation + one slot per FULLY_CONNECTED layer
+    TEST_ASSERT_EQUAL(5, profiler.getEventCount());
+    TEST_ASSERT_EQUAL_UINT32(200, profiler.getInvocations());
+    TEST_ASSERT_EQUAL_UINT32(g_mlp.getMemoryUsed(), profiler.getArenaPeak());
+    TEST_ASSERT_EQUAL_UINT32(0, profiler.getDropped());
+    uint32_t layersMean = 0;
+    for (int i = 0; i < profiler.getEventCount(); i++) {
+        const ProfilerEventStats& event = profiler.getEvent(i);
+        TEST_ASSERT_EQUAL_UINT32(200, event.count);
+        TEST_ASSERT_TRUE(event.minCycles <= profiler.getMean(i));
+        TEST_ASSERT_TRUE(profiler.getMean(i) <= event.maxCycles);
+        TEST_ASSERT_TRUE(event.minCycles <= profiler.getPercentile(i, 0.99f));
+        TEST_ASSERT_TRUE(profiler.getPercentile(i, 0.99f) <= event.maxCycles);
+        TEST_ASSERT_TRUE(profiler.getPercentile(i, 0.5f) <= profiler.getPercentile(i, 0.99f));
+        if (i > 0) {
+            TEST_ASSERT_EQUAL(0, strcmp("FULLY_CONNE", event.tag));
+            layersMean += profiler.getMean(i);
+        }
+    }
+    // Layers run inside the invocation
+    TEST_ASSERT_TRUE(layersMean <= profiler.getMean(0));
+
+    // Binary record: header, then slot 0
+    uint8_t record[PROFILER_RECORD_MAX];
+    size_t length = profiler.serialize(record);
+    TEST_ASSERT_EQUAL(PROFILER_HEADER_SIZE + 5 * PROFILER_EVENT_SIZE, (int)length);
+    TEST_ASSERT_EQUAL(PROFILER_RECORD_VERSION, record[0]);
+    TEST_ASSERT_EQUAL(5, record[1]);
+    TEST_ASSERT_EQUAL_UINT32(200, readU32(record + 4));
+    TEST_ASSERT_EQUAL_UINT32(g_mlp.getMemoryUsed(), readU32(record + 8));
+    const uint8_t* invoke = record + PROFILER_HEADER_SIZE;
+    TEST_ASSERT_EQUAL(0, strcmp("invoke", (const char*)invoke));
+    TEST_ASSERT_EQUAL_UINT32(profiler.getEvent(0).minCycles, readU32(invoke + PROFILER_TAG_LEN));
+    TEST_ASSERT_EQUAL_UINT32(profiler.getMean(0), readU32(invoke + PROFILER_TAG_LEN + 4));
+    TEST_ASSERT_EQUAL_UINT32(profiler.getPercentile(0, 0.99f), readU32(invoke + PROFILER_TAG_LEN + 8));
+    TEST_ASSERT_EQUAL_UINT32(profiler.getEvent(0).maxCycles, readU32(invoke + PROFILER_TAG_LEN + 12));
+}
+
+void test_profiler_restarts_slots_of_new_model() {
+    InferenceProfiler profiler;
+    profiler.beginInvoke();
+    profiler.endEvent(profiler.beginEvent("FULLY_CONNECTED"));
+    profiler.endEvent(profiler.beginEvent("SOFTMAX"));
+    profiler.endInvoke(100);
+
+    // Different op in slot 2, and more ops than slots
+    profiler.beginInvoke();
+    profiler.endEvent(profiler.beginEvent("FULLY_CONNECTED"));
+    profiler.endEvent(profiler.beginEvent("LOGISTIC"));
+    for (int i = 0; i < PROFILER_MAX_EVENTS; i++) {
+        profiler.endEvent(profiler.beginEvent("TANH"));
+    }
+    profiler.endInvoke(50);
+
+    TEST_ASSERT_EQUAL(PROFILER_MAX_EVENTS, profiler.getEventCount());
+    TEST_ASSERT_EQUAL_UINT32(2, profiler.getEvent(1).count);
+    TEST_ASSERT_EQUAL(0, strcmp("LOGISTIC", profiler.getEvent(2).tag));
+    TEST_ASSERT_EQUAL_UINT32(1, profiler.getEvent(2).count);
+    TEST_ASSERT_EQUAL_UINT32(3, profiler.getDropped());
+    TEST_ASSERT_EQUAL_UINT32(100, profiler.getArenaPeak());
+
+    uint8_t record[PROFILER_RECORD_MAX];
+    TEST_ASSERT_EQUAL(PROFILER_RECORD_MAX, (int)profiler.serialize(record));
+    TEST_ASSERT_TRUE(PROFILER_RECORD_MAX <= 512);   // One BLE attribute
+
+    profiler.reset();
+    TEST_ASSERT_EQUAL(1, profiler.getEventCount());
+    TEST_ASSERT_EQUAL_UINT32(0, profiler.getInvocations());
+}
+
+void bench_profiler_overhead() {
+    buildSyntheticMLP(g_mlp);
+    randomMLPInput();
+    InferenceProfiler profiler;
+    volatile int sink = 0;
+
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < MLP_REPEATS; rep++) {
+        g_mlpInput[rep % 72] ^= 1;
+        sink += g_mlp.invoke(g_mlpInput)[0];
+    }
+    report("int8 MLP, profiler off", nowMicros() - t0, MLP_REPEATS, "inference");
+
+    t0 = nowMicros();
+    for (int rep = 0; rep < MLP_REPEATS; rep++) {
+        g_mlpInput[rep % 72] ^= 1;
+        profiler.beginInvoke();
+        sink += g_mlp.invoke(g_mlpInput, &profiler)[0];
+        profiler.endInvoke(0);
+    }
+    report("int8 MLP, per-layer profiling", nowMicros() - t0, MLP_REPEATS, "inference");
+
+    (void)sink;
+}
+
+// ============================================================================
+// Shared Memory Planner
+// ============================================================================
+
+void test_memory_planner_overlaps_only_disjoint_lifetimes() {
+    // The firmware's pipeline: epoch buffers, extraction scratch, TFLM arena
+    MemoryPlanner planner;
+    const uint8_t S = MEMORY_PHASE_SAMPLE, E = MEMORY_PHASE_EXTRACT, I = MEMORY_PHASE_INFER;
+    for (int axis = 0; axis < 4; axis++) planner.request("imu", 960 * 4, S, E);
+    planner.request("ppg", 3000 * 4, S, E);
+    planner.request("hr", 3000 * 4, S, E);
+    planner.request("ibi", 256 * 4, S, E);
+    planner.request("scratch", 3000 * 4, E, E);
+    int arena = planner.request("tensor arena", 32 * 1024, I, I);
+    TEST_ASSERT_EQUAL(-1, planner.request("bad", 16, I, S));
+
+    TEST_ASSERT_EQUAL_UINT32(4 * 3840 + 3 * 12000 + 1024 + 32768, planner.getSeparateSize());
+    // Everything live while extracting is stacked; the arena reuses it
+    TEST_ASSERT_EQUAL_UINT32(4 * 3840 + 3 * 12000 + 1024, planner.getRequiredSize());
+
+    for (int a = 0; a < planner.getBufferCount(); a++) {
+        TEST_ASSERT_EQUAL(0, (int)(planner.getOffset(a) % PLANNER_ALIGNMENT));
+        for (int b = a + 1; b < planner.getBufferCount(); b++) {
+            bool together = planner.getFirstPhase(a) <= planner.getLastPhase(b) &&
+                            planner.getFirstPhase(b) <= planner.getLastPhase(a);
+            bool overlap = planner.getOffset(a) < planner.getOffset(b) + planner.getSize(b) &&
+                           planner.getOffset(b) < planner.getOffset(a) + planner.getSize(a);
+            TEST_ASSERT_FALSE(together && overlap);
+        }
+    }
+
+    TEST_ASSERT_NULL(planner.get(arena));
+    TEST_ASSERT_TRUE(planner.allocate());
+    TEST_ASSERT_EQUAL(0, (int)((uintptr_t)planner.get(arena) % PLANNER_ALIGNMENT));
+    TEST_ASSERT_EQUAL(-1, planner.request("late", 16, S, S));
+}
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+int runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_integer_ppg_stats_are_bit_exact);
+    RUN_TEST(test_integer_ppg_stats_handle_full_scale);
+    RUN_TEST(bench_integer_ppg_stats_per_epoch);
+    RUN_TEST(test_int8_mlp_matches_reference);
+    RUN_TEST(bench_int8_mlp_inference);
+    RUN_TEST(test_fused_quantizer_matches_reference);
+    RUN_TEST(bench_fused_input_quantizer);
+    RUN_TEST(test_int8_mlp_batch_matches_invoke);
+    RUN_TEST(bench_int8_mlp_batch_throughput);
+    RUN_TEST(test_tree_ensemble_matches_reference);
+    RUN_TEST(bench_tree_ensemble_vs_mlp);
+    RUN_TEST(test_permutation_entropy_monotonic_is_zero);
+    RUN_TEST(test_permutation_entropy_noise_is_high);
+    RUN_TEST(test_bucketed_sample_entropy_matches_naive);
+    RUN_TEST(bench_entropy_per_epoch);
+    RUN_TEST(test_pulse_segmenter_finds_every_beat);
+    RUN_TEST(bench_pulse_morphology_per_epoch);
+    RUN_TEST(test_resp_rate_rejects_cardiac_band);
+    RUN_TEST(test_integer_lifting_is_reversible);
+    RUN_TEST(test_wavelet_features_are_distribution);
+    RUN_TEST(test_wavelet_energies_match_pywt);
+    RUN_TEST(bench_wavelet_vs_fft_per_epoch);
+    RUN_TEST(test_hmm_smoother_removes_flicker);
+    RUN_TEST(test_hmm_fixed_lag_matches_offline_viterbi);
+    RUN_TEST(test_hmm_preview_leaves_state_alone);
+    RUN_TEST(bench_hmm_smoother_per_epoch);
+    RUN_TEST(test_imu_gate_decides_only_confident_epochs);
+    RUN_TEST(bench_imu_gate_per_epoch);
+    RUN_TEST(test_running_stats_match_epoch_stats);
+    RUN_TEST(bench_running_stats_per_epoch);
+    RUN_TEST(test_shadow_monitor_logs_and_budgets);
+    RUN_TEST(test_adaptive_norm_tracks_user_and_persists);
+    RUN_TEST(bench_adaptive_norm_per_epoch);
+    RUN_TEST(test_cole_kripke_matches_formula);
+    RUN_TEST(test_sadeh_matches_formula);
+    RUN_TEST(bench_actigraphy_per_minute);
+    RUN_TEST(test_profiler_records_each_layer);
+    RUN_TEST(test_profiler_restarts_slots_of_new_model);
+    RUN_TEST(bench_profiler_overhead);
+    RUN_TEST(test_memory_planner_overlaps_only_disjoint_lifetimes);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    delay(2000);  // Wait for the serial monitor
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    return runTests();
+}
+#endif
@@ -0,0 +1,22 @@
+/**
+ * Golden Vectors for model_compiled.h (Placeholder)
+ * ==================================================
+ *
+ * Generated by model-training/scripts/compile_model.py (--golden) together
+ * with include/model_compiled.h. Replace both files from the same run.
+ */
+
+#ifndef GOLDEN_VECTORS_H
+#define GOLDEN_VECTORS_H
+
+#include <stdint.h>
+
+#define GOLDEN_MODEL_CRC32      0x00000000UL
+#define GOLDEN_VECTOR_COUNT     0
+#define GOLDEN_INPUTS           72
+#define GOLDEN_OUTPUTS          4
+
+constexpr float GOLDEN_FEATURES[1] = {0.0f};
+constexpr int8_t GOLDEN_LOGITS[1] = {0};
+
+#endif // GOLDEN_VECTORS_H
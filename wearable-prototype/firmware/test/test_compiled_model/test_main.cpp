@@ -0,0 +1,169 @@
+/**
+ * Compiled Model Golden-Vector Test
+ * =================================
+ *
+ * Checks include/model_compiled.h against the golden vectors written by
+ * compile_model.py in the same run, and against the runtime engine
+ * (Int8MLP on model_data.h) when both headers come from the same .tflite.
+ * Skipped while the headers are placeholders.
+ *
+ *   pio test -e native -f test_compiled_model
+ *   pio test -e esp32-s3-devkitc-1 -f test_compiled_model
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "model_compiled.h"
+#include "model_data.h"
+#include "processing/int8_mlp.h"
+#include "golden_vectors.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static uint32_t nowMicros() { return micros(); }
+#else
+#include <chrono>
+static uint32_t nowMicros() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(
+        steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+static const int BENCH_REPEATS = 10000;
+
+static Int8MLP g_mlp;
+
+// Benchmark input r (the placeholder has no vectors; never called then)
+static const float* goldenFeatures(int r) {
+    const int count = GOLDEN_VECTOR_COUNT > 0 ? GOLDEN_VECTOR_COUNT : 1;
+    return &GOLDEN_FEATURES[(r % count) * GOLDEN_INPUTS];
+}
+
+static uint32_t crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * True if model_data.h holds the model model_compiled.h was built from.
+ */
+static bool runtimeModelMatches() {
+    return sleep_model_tflite_len > 16 &&
+           crc32(sleep_model_tflite, sleep_model_tflite_len) == COMPILED_MODEL_CRC32;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+void test_compiled_model_matches_golden_vectors() {
+    if (!COMPILED_MODEL_AVAILABLE || GOLDEN_VECTOR_COUNT == 0) {
+        TEST_IGNORE_MESSAGE("model_compiled.h / golden_vectors.h are placeholders");
+    }
+    TEST_ASSERT_EQUAL_HEX32(COMPILED_MODEL_CRC32, GOLDEN_MODEL_CRC32);
+    TEST_ASSERT_EQUAL(COMPILED_MODEL_INPUTS, GOLDEN_INPUTS);
+    TEST_ASSERT_EQUAL(COMPILED_MODEL_OUTPUTS, GOLDEN_OUTPUTS);
+
+    for (int v = 0; v < GOLDEN_VECTOR_COUNT; v++) {
+        int8_t logits[COMPILED_MODEL_OUTPUTS];
+        compiledModelInvoke(&GOLDEN_FEATURES[v * GOLDEN_INPUTS], logits);
+        TEST_ASSERT_EQUAL_INT8_ARRAY(&GOLDEN_LOGITS[v * GOLDEN_OUTPUTS], logits,
+                                     COMPILED_MODEL_OUTPUTS);
+
+        float probabilities[COMPILED_MODEL_OUTPUTS];
+        compiledModelSoftmax(logits, probabilities);
+        float sum = 0.0f;
+        for (int c = 0; c < COMPILED_MODEL_OUTPUTS; c++) sum += probabilities[c];
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, sum);
+    }
+}
+
+void test_compiled_model_matches_runtime_engine() {
+    if (!COMPILED_MODEL_AVAILABLE || !runtimeModelMatches()) {
+        TEST_IGNORE_MESSAGE("model_data.h is not the model that was compiled");
+    }
+    TEST_ASSERT_TRUE_MESSAGE(g_mlp.load(sleep_model_tflite, sleep_model_tflite_len),
+                             g_mlp.getError());
+
+    for (int v = 0; v < GOLDEN_VECTOR_COUNT; v++) {
+        const float* features = &GOLDEN_FEATURES[v * GOLDEN_INPUTS];
+        int8_t q[COMPILED_MODEL_INPUTS];
+        int8_t logits[COMPILED_MODEL_OUTPUTS];
+        compiledModelQuantize(features, q);
+        compiledModelInvoke(features, logits);
+        TEST_ASSERT_EQUAL_INT8_ARRAY(g_mlp.invoke(q), logits, COMPILED_MODEL_OUTPUTS);
+    }
+}
+
+void bench_compiled_vs_runtime_engine() {
+    if (!COMPILED_MODEL_AVAILABLE || GOLDEN_VECTOR_COUNT == 0) {
+        TEST_IGNORE_MESSAGE("model_compiled.h / golden_vectors.h are placeholders");
+    }
+
+    int8_t logits[COMPILED_MODEL_OUTPUTS];
+    volatile int sink = 0;
+    compiledModelInvoke(GOLDEN_FEATURES, logits);   // Warm the caches
+    uint32_t t0 = nowMicros();
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        compiledModelInvoke(goldenFeatures(r), logits);
+        sink += logits[0];
+    }
+    float compiledUs = (float)(nowMicros() - t0) / BENCH_REPEATS;
+
+    char msg[120];
+    if (runtimeModelMatches() && g_mlp.load(sleep_model_tflite, sleep_model_tflite_len)) {
+        int8_t q[COMPILED_MODEL_INPUTS];
+        compiledModelQuantize(GOLDEN_FEATURES, q);
+        g_mlp.invoke(q);
+        t0 = nowMicros();
+        for (int r = 0; r < BENCH_REPEATS; r++) {
+            compiledModelQuantize(goldenFeatures(r), q);
+            sink += g_mlp.invoke(q)[0];
+        }
+        float runtimeUs = (float)(nowMicros() - t0) / BENCH_REPEATS;
+        snprintf(msg, sizeof(msg), "compiled: %.2f us | Int8MLP: %.2f us (%d B RAM) | %.1fx",
+                 compiledUs, runtimeUs, (int)g_mlp.getMemoryUsed(), runtimeUs / compiledUs);
+    } else {
+        snprintf(msg, sizeof(msg), "compiled: %.2f us/inference", compiledUs);
+    }
+    TEST_MESSAGE(msg);
+    (void)sink;
+}
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+int runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_compiled_model_matches_golden_vectors);
+    RUN_TEST(test_compiled_model_matches_runtime_engine);
+    RUN_TEST(bench_compiled_vs_runtime_engine);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    delay(2000);  // Wait for the serial monitor
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    return runTests();
+}
+#endif
@@ -0,0 +1,284 @@
+/**
+ * I2C Scheduler Test
+ * ==================
+ *
+ * Runs I2CScheduler on the mock bus backend (i2c_bus.h without ARDUINO):
+ * an MPU6050-like and a MAX30102-like device with FIFO ports. Checks that
+ * adjacent reads merge into one burst and FIFO reads never do, that each
+ * device's reads keep their order when devices interleave, that callbacks
+ * can chain the next read the way the drivers do, failure and queue-full
+ * handling, and the latency / utilization statistics against the mock's
+ * wire timing at 400 kHz.
+ *
+ * Host only (the device build has the ESP-IDF backend, not the mock):
+ *
+ *   pio test -e native -f test_i2c_scheduler
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "sensors/i2c_scheduler.h"
+
+static const uint8_t IMU_ADDR = 0x68;
+static const uint8_t PPG_ADDR = 0x57;
+static const uint8_t IMU_FIFO_COUNT = 0x72;
+static const uint8_t IMU_FIFO_DATA = 0x74;
+static const uint8_t PPG_WR_PTR = 0x04;
+static const uint8_t PPG_OVF = 0x05;
+static const uint8_t PPG_RD_PTR = 0x06;
+static const uint8_t PPG_FIFO_DATA = 0x07;
+static const int PPG_FRAME = 9;
+
+static I2CBus g_bus;
+static I2CScheduler g_scheduler;
+
+struct Completion {
+    int calls;
+    bool ok;
+    uint8_t reg;
+};
+
+static void record(void* context, const I2CRequest& request, bool ok) {
+    Completion* completion = (Completion*)context;
+    completion->calls++;
+    completion->ok = ok;
+    completion->reg = request.reg;
+}
+
+void setUp() {
+    g_bus = I2CBus();
+    g_bus.begin(400000);
+    g_bus.addDevice(IMU_ADDR);
+    g_bus.addDevice(PPG_ADDR);
+    g_bus.setFifoPort(IMU_ADDR, IMU_FIFO_DATA);
+    g_bus.setFifoPort(PPG_ADDR, PPG_FIFO_DATA);
+    g_scheduler.begin(g_bus);
+}
+
+void tearDown() {}
+
+// ============================================================================
+// Merging and Order
+// ============================================================================
+
+void test_adjacent_reads_merge_into_one_burst() {
+    g_bus.setRegister(PPG_ADDR, PPG_WR_PTR, 12);
+    g_bus.setRegister(PPG_ADDR, PPG_OVF, 0);
+    g_bus.setRegister(PPG_ADDR, PPG_RD_PTR, 4);
+
+    uint8_t wr = 0xFF, ovf = 0xFF, rd = 0xFF;
+    Completion done[3] = {};
+    TEST_ASSERT_TRUE(g_scheduler.submit(PPG_ADDR, PPG_WR_PTR, &wr, 1, 0, record, &done[0]));
+    TEST_ASSERT_TRUE(g_scheduler.submit(PPG_ADDR, PPG_OVF, &ovf, 1, 0, record, &done[1]));
+    TEST_ASSERT_TRUE(g_scheduler.submit(PPG_ADDR, PPG_RD_PTR, &rd, 1, 0, record, &done[2]));
+
+    TEST_ASSERT_EQUAL_INT(1, g_scheduler.process());
+    TEST_ASSERT_EQUAL_INT(1, g_bus.getTransactions());
+    TEST_ASSERT_EQUAL_UINT8(PPG_WR_PTR, g_bus.getTransaction(0).reg);
+    TEST_ASSERT_EQUAL_UINT16(3, g_bus.getTransaction(0).length);
+
+    TEST_ASSERT_EQUAL_UINT8(12, wr);
+    TEST_ASSERT_EQUAL_UINT8(0, ovf);
+    TEST_ASSERT_EQUAL_UINT8(4, rd);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_INT(1, done[i].calls);
+        TEST_ASSERT_TRUE(done[i].ok);
+    }
+
+    I2CStats stats = g_scheduler.getStats();
+    TEST_ASSERT_EQUAL_UINT32(3, stats.requests);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.transactions);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.merged);
+}
+
+void test_fifo_reads_and_gaps_are_not_merged() {
+    uint8_t frames[2 * PPG_FRAME];
+    for (int i = 0; i < (int)sizeof(frames); i++) frames[i] = (uint8_t)(0xA0 + i);
+    g_bus.pushFifo(PPG_ADDR, frames, sizeof(frames));
+
+    uint8_t pointers[3], data[2 * PPG_FRAME], temperature[2];
+    TEST_ASSERT_TRUE(g_scheduler.submit(PPG_ADDR, PPG_WR_PTR, pointers, 3, 0, nullptr, nullptr));
+    // Starts right after the pointers, but is a FIFO port
+    TEST_ASSERT_TRUE(g_scheduler.submit(PPG_ADDR, PPG_FIFO_DATA, data, sizeof(data),
+                                        I2C_READ_STREAM, nullptr, nullptr));
+    // Same device, not adjacent
+    TEST_ASSERT_TRUE(g_scheduler.submit(IMU_ADDR, IMU_FIFO_COUNT, pointers, 2, 0, nullptr, nullptr));
+    TEST_ASSERT_TRUE(g_scheduler.submit(IMU_ADDR, 0x41, temperature, 2, 0, nullptr, nullptr));
+
+    TEST_ASSERT_EQUAL_INT(4, g_scheduler.process());
+    TEST_ASSERT_EQUAL_UINT8(PPG_FIFO_DATA, g_bus.getTransaction(1).reg);
+    TEST_ASSERT_EQUAL_UINT16(2 * PPG_FRAME, g_bus.getTransaction(1).length);
+    TEST_ASSERT_EQUAL_MEMORY(frames, data, sizeof(data));
+    TEST_ASSERT_EQUAL_UINT32(0, g_scheduler.getStats().merged);
+}
+
+void test_devices_interleave_but_keep_their_own_order() {
+    uint8_t count[2], fifo[6], wr, ovf, rd;
+    g_scheduler.submit(IMU_ADDR, IMU_FIFO_COUNT, count, 2, 0, nullptr, nullptr);
+    g_scheduler.submit(PPG_ADDR, PPG_WR_PTR, &wr, 1, 0, nullptr, nullptr);
+    g_scheduler.submit(IMU_ADDR, IMU_FIFO_DATA, fifo, 6, I2C_READ_STREAM, nullptr, nullptr);
+    g_scheduler.submit(PPG_ADDR, PPG_OVF, &ovf, 1, 0, nullptr, nullptr);
+    g_scheduler.submit(PPG_ADDR, PPG_RD_PTR, &rd, 1, 0, nullptr, nullptr);
+
+    // The PPG pointers merge across the IMU's FIFO read; the IMU's count
+    // (adjacent to its FIFO port) does not swallow the FIFO read
+    TEST_ASSERT_EQUAL_INT(3, g_scheduler.process());
+    TEST_ASSERT_EQUAL_UINT8(IMU_ADDR, g_bus.getTransaction(0).address);
+    TEST_ASSERT_EQUAL_UINT8(IMU_FIFO_COUNT, g_bus.getTransaction(0).reg);
+    TEST_ASSERT_EQUAL_UINT8(PPG_ADDR, g_bus.getTransaction(1).address);
+    TEST_ASSERT_EQUAL_UINT16(3, g_bus.getTransaction(1).length);
+    TEST_ASSERT_EQUAL_UINT8(IMU_FIFO_DATA, g_bus.getTransaction(2).reg);
+}
+
+void test_out_of_order_register_is_not_pulled_forward() {
+    uint8_t a, b, c;
+    g_scheduler.submit(PPG_ADDR, PPG_WR_PTR, &a, 1, 0, nullptr, nullptr);
+    g_scheduler.submit(PPG_ADDR, PPG_RD_PTR, &b, 1, 0, nullptr, nullptr);   // Gap
+    g_scheduler.submit(PPG_ADDR, PPG_OVF, &c, 1, 0, nullptr, nullptr);      // Adjacent to the first
+
+    // OVF may not jump ahead of RD_PTR
+    TEST_ASSERT_EQUAL_INT(3, g_scheduler.process());
+    TEST_ASSERT_EQUAL_UINT8(PPG_WR_PTR, g_bus.getTransaction(0).reg);
+    TEST_ASSERT_EQUAL_UINT8(PPG_RD_PTR, g_bus.getTransaction(1).reg);
+    TEST_ASSERT_EQUAL_UINT8(PPG_OVF, g_bus.getTransaction(2).reg);
+}
+
+// ============================================================================
+// Callbacks and Failures
+// ============================================================================
+
+// A driver-like drain: pointers first, then the queued frames
+struct PPGDrain {
+    uint8_t pointers[3];
+    uint8_t frames[32 * PPG_FRAME];
+    int samples;
+    bool finished;
+};
+
+static void onDrainPointer(void* context, const I2CRequest& request, bool ok) {
+    PPGDrain* drain = (PPGDrain*)context;
+    if (request.reg != PPG_RD_PTR) return;
+    int queued = (drain->pointers[0] - drain->pointers[2]) & 31;
+    if (!ok || queued == 0) {
+        drain->finished = true;
+        return;
+    }
+    drain->samples = queued;
+    g_scheduler.submit(PPG_ADDR, PPG_FIFO_DATA, drain->frames, (uint16_t)(queued * PPG_FRAME),
+                       I2C_READ_STREAM, [](void* c, const I2CRequest&, bool) {
+                           ((PPGDrain*)c)->finished = true;
+                       }, drain);
+}
+
+void test_callbacks_chain_the_fifo_read() {
+    uint8_t frames[5 * PPG_FRAME];
+    for (int i = 0; i < (int)sizeof(frames); i++) frames[i] = (uint8_t)i;
+    g_bus.pushFifo(PPG_ADDR, frames, sizeof(frames));
+    g_bus.setRegister(PPG_ADDR, PPG_WR_PTR, 2);
+    g_bus.setRegister(PPG_ADDR, PPG_RD_PTR, 29);     // Wrapped: 5 queued
+
+    PPGDrain drain = {};
+    g_scheduler.submit(PPG_ADDR, PPG_WR_PTR, &drain.pointers[0], 1, 0, onDrainPointer, &drain);
+    g_scheduler.submit(PPG_ADDR, PPG_OVF, &drain.pointers[1], 1, 0, onDrainPointer, &drain);
+    g_scheduler.submit(PPG_ADDR, PPG_RD_PTR, &drain.pointers[2], 1, 0, onDrainPointer, &drain);
+
+    TEST_ASSERT_EQUAL_INT(2, g_scheduler.process());
+    TEST_ASSERT_TRUE(drain.finished);
+    TEST_ASSERT_EQUAL_INT(5, drain.samples);
+    TEST_ASSERT_EQUAL_MEMORY(frames, drain.frames, sizeof(frames));
+    TEST_ASSERT_EQUAL_INT(0, g_scheduler.pending());
+}
+
+void test_missing_device_fails_its_requests() {
+    uint8_t a, b;
+    Completion done[2] = {};
+    g_scheduler.submit(0x3C, 0x00, &a, 1, 0, record, &done[0]);
+    g_scheduler.submit(0x3C, 0x01, &b, 1, 0, record, &done[1]);
+
+    TEST_ASSERT_EQUAL_INT(1, g_scheduler.process());
+    TEST_ASSERT_EQUAL_INT(1, done[0].calls);
+    TEST_ASSERT_FALSE(done[0].ok);
+    TEST_ASSERT_FALSE(done[1].ok);
+    TEST_ASSERT_EQUAL_UINT32(2, g_scheduler.getStats().failed);
+}
+
+void test_full_queue_rejects() {
+    uint8_t byte;
+    for (int i = 0; i < I2C_SCHED_QUEUE; i++) {
+        TEST_ASSERT_TRUE(g_scheduler.submit(IMU_ADDR, IMU_FIFO_DATA, &byte, 1,
+                                            I2C_READ_STREAM, nullptr, nullptr));
+    }
+    TEST_ASSERT_EQUAL_INT(0, g_scheduler.space());
+    TEST_ASSERT_FALSE(g_scheduler.submit(IMU_ADDR, IMU_FIFO_DATA, &byte, 1,
+                                         I2C_READ_STREAM, nullptr, nullptr));
+    TEST_ASSERT_FALSE(g_scheduler.submit(IMU_ADDR, IMU_FIFO_DATA, nullptr, 1, 0, nullptr, nullptr));
+    TEST_ASSERT_EQUAL_UINT32(1, g_scheduler.getStats().rejected);
+
+    TEST_ASSERT_EQUAL_INT(I2C_SCHED_QUEUE, g_scheduler.process());
+    TEST_ASSERT_EQUAL_INT(I2C_SCHED_QUEUE, g_scheduler.space());
+}
+
+// ============================================================================
+// Statistics
+// ============================================================================
+
+void test_latency_and_utilization_follow_bus_time() {
+    uint8_t pointers[3], frames[8 * PPG_FRAME];
+    uint32_t pointerUs = g_bus.transactionMicros(3);
+    uint32_t framesUs = g_bus.transactionMicros(sizeof(frames));
+
+    // A PPG drain every 100 ms for one second
+    for (int i = 0; i < 10; i++) {
+        g_scheduler.submit(PPG_ADDR, PPG_WR_PTR, pointers, 3, 0, nullptr, nullptr);
+        g_scheduler.submit(PPG_ADDR, PPG_FIFO_DATA, frames, sizeof(frames),
+                           I2C_READ_STREAM, nullptr, nullptr);
+        g_scheduler.process();
+        g_bus.advance(100000 - pointerUs - framesUs);
+    }
+
+    I2CStats stats = g_scheduler.getStats();
+    TEST_ASSERT_EQUAL_UINT32(1000000, stats.windowUs);
+    TEST_ASSERT_EQUAL_UINT32(20, stats.transactions);
+    TEST_ASSERT_EQUAL_UINT32(pointerUs, stats.minLatencyUs);
+    // The frame read waited for the pointer read
+    TEST_ASSERT_EQUAL_UINT32(pointerUs + framesUs, stats.maxLatencyUs);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, (pointerUs + pointerUs + framesUs) / 2.0f, stats.meanLatencyUs);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, (pointerUs + framesUs) / 2.0f, stats.meanTransactionUs);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 10.0f * (pointerUs + framesUs) / 1e6f, stats.utilization);
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "400 kHz: 3 B read %u us, %u B FIFO read %u us, %.2f%% bus at 10 drains/s",
+             (unsigned)pointerUs, (unsigned)sizeof(frames), (unsigned)framesUs,
+             stats.utilization * 100.0f);
+    TEST_MESSAGE(msg);
+
+    g_scheduler.resetStats();
+    stats = g_scheduler.getStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.transactions);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.windowUs);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.minLatencyUs);
+}
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+int runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_adjacent_reads_merge_into_one_burst);
+    RUN_TEST(test_fifo_reads_and_gaps_are_not_merged);
+    RUN_TEST(test_devices_interleave_but_keep_their_own_order);
+    RUN_TEST(test_out_of_order_register_is_not_pulled_forward);
+    RUN_TEST(test_callbacks_chain_the_fifo_read);
+    RUN_TEST(test_missing_device_fails_its_requests);
+    RUN_TEST(test_full_queue_rejects);
+    RUN_TEST(test_latency_and_utilization_follow_bus_time);
+    return UNITY_END();
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,169 @@
+/**
+ * Native Int8 MLP vs TFLite Micro Parity
+ * ======================================
+ *
+ * Runs the deployed model (include/model_data.h) through both the TFLM
+ * interpreter and the native engine on the same quantized inputs, and
+ * reports the per-inference latency and memory of each. Device only (needs
+ * TFLM); skipped while model_data.h is the placeholder.
+ *
+ *   pio test -e esp32-s3-devkitc-1 -f test_int8_mlp
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include "model_data.h"
+#include "processing/int8_mlp.h"
+
+#define PARITY_ARENA_SIZE   (32 * 1024)
+#define PARITY_VECTORS      500
+
+// TFLM's int8 softmax is fixed-point, the native one is an exp table:
+// allow one output LSB (1/256) of disagreement, plus rounding
+#define PROB_TOLERANCE      (1.5f / 256.0f)
+
+static uint8_t* g_arena = nullptr;
+static tflite::MicroInterpreter* g_interpreter = nullptr;
+static Int8MLP g_mlp;
+static uint32_t g_rng = 42;
+
+static int8_t randomInt8() {
+    g_rng = g_rng * 1664525u + 1013904223u;
+    return (int8_t)(g_rng >> 24);
+}
+
+static bool modelPresent() {
+    return sleep_model_tflite_len > 16;
+}
+
+static bool setUpTFLM() {
+    if (g_interpreter) return true;
+
+    g_arena = (uint8_t*)malloc(PARITY_ARENA_SIZE);
+    const tflite::Model* model = tflite::GetModel(sleep_model_tflite);
+
+    static tflite::MicroMutableOpResolver<10> resolver;
+    resolver.AddFullyConnected();
+    resolver.AddRelu();
+    resolver.AddSoftmax();
+    resolver.AddReshape();
+    resolver.AddQuantize();
+    resolver.AddDequantize();
+
+    static tflite::MicroInterpreter interpreter(model, resolver, g_arena, PARITY_ARENA_SIZE);
+    if (interpreter.AllocateTensors() != kTfLiteOk) return false;
+    g_interpreter = &interpreter;
+    return true;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+void test_native_engine_loads_model() {
+    if (!modelPresent()) TEST_IGNORE_MESSAGE("model_data.h is the placeholder");
+    TEST_ASSERT_TRUE_MESSAGE(g_mlp.load(sleep_model_tflite, sleep_model_tflite_len),
+                             g_mlp.getError());
+    TEST_ASSERT_TRUE(setUpTFLM());
+}
+
+void test_native_engine_matches_tflm() {
+    if (!modelPresent()) TEST_IGNORE_MESSAGE("model_data.h is the placeholder");
+    TEST_ASSERT_TRUE(g_mlp.isLoaded() && setUpTFLM());
+
+    TfLiteTensor* input = g_interpreter->input(0);
+    TfLiteTensor* output = g_interpreter->output(0);
+    int n = g_mlp.getInputSize();
+    int classes = g_mlp.getOutputSize();
+
+    int8_t x[MLP_MAX_WIDTH];
+    float native[MLP_MAX_WIDTH];
+    int argmaxMismatches = 0;
+    float worst = 0.0f;
+
+    for (int t = 0; t < PARITY_VECTORS; t++) {
+        for (int i = 0; i < n; i++) x[i] = randomInt8();
+
+        // Same quantized vector into both engines
+        if (input->type == kTfLiteInt8) {
+            memcpy(input->data.int8, x, n);
+        } else {
+            for (int i = 0; i < n; i++) {
+                input->data.f[i] = (x[i] - g_mlp.getInputZeroPoint()) * g_mlp.getInputScale();
+            }
+        }
+        TEST_ASSERT_EQUAL(kTfLiteOk, g_interpreter->Invoke());
+
+        g_mlp.invoke(x);
+        g_mlp.softmax(native);
+
+        int tflmBest = 0;
+        for (int c = 0; c < classes; c++) {
+            float p = output->type == kTfLiteInt8
+                ? (output->data.int8[c] - output->params.zero_point) * output->params.scale
+                : output->data.f[c];
+            float diff = fabsf(p - native[c]);
+            if (diff > worst) worst = diff;
+            float best = output->type == kTfLiteInt8
+                ? (output->data.int8[tflmBest] - output->params.zero_point) * output->params.scale
+                : output->data.f[tflmBest];
+            if (p > best) tflmBest = c;
+        }
+        // Ties in the quantized output can legitimately break either way
+        if (tflmBest != g_mlp.argmax() && fabsf(native[tflmBest] - native[g_mlp.argmax()]) > PROB_TOLERANCE) {
+            argmaxMismatches++;
+        }
+    }
+
+    char msg[80];
+    snprintf(msg, sizeof(msg), "max |p_tflm - p_native| = %.5f", worst);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL(0, argmaxMismatches);
+    TEST_ASSERT_TRUE(worst <= PROB_TOLERANCE);
+}
+
+void bench_native_vs_tflm() {
+    if (!modelPresent()) TEST_IGNORE_MESSAGE("model_data.h is the placeholder");
+    TEST_ASSERT_TRUE(g_mlp.isLoaded() && setUpTFLM());
+
+    int8_t x[MLP_MAX_WIDTH];
+    for (int i = 0; i < g_mlp.getInputSize(); i++) x[i] = randomInt8();
+    const int repeats = 200;
+
+    uint32_t t0 = micros();
+    for (int r = 0; r < repeats; r++) g_interpreter->Invoke();
+    float tflmUs = (float)(micros() - t0) / repeats;
+
+    t0 = micros();
+    for (int r = 0; r < repeats; r++) g_mlp.invoke(x);
+    float nativeUs = (float)(micros() - t0) / repeats;
+
+    char msg[120];
+    snprintf(msg, sizeof(msg), "TFLM: %.1f us, %d B arena | native: %.1f us, %d B | %.1fx",
+             tflmUs, (int)g_interpreter->arena_used_bytes(),
+             nativeUs, (int)g_mlp.getMemoryUsed(), tflmUs / nativeUs);
+    TEST_MESSAGE(msg);
+}
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+void setup() {
+    delay(2000);  // Wait for the serial monitor
+    UNITY_BEGIN();
+    RUN_TEST(test_native_engine_loads_model);
+    RUN_TEST(test_native_engine_matches_tflm);
+    RUN_TEST(bench_native_vs_tflm);
+    UNITY_END();
+}
+
+void loop() {}
@@ -0,0 +1,238 @@
+/**
+ * A/B Model Store Test
+ * ====================
+ *
+ * Writes packages through ModelStore's update path and checks which slot
+ * the loader picks. On the host the slots are temporary files; on the
+ * device they are the real model partitions, so this test erases any
+ * model stored there.
+ *
+ *   pio test -e native -f test_model_store
+ *   pio test -e esp32-s3-devkitc-1 -f test_model_store
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "processing/model_store.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static const char* SLOT_A = MODEL_PARTITION_A;
+static const char* SLOT_B = MODEL_PARTITION_B;
+#else
+static const char* SLOT_A = "/tmp/test_model_store_a.bin";
+static const char* SLOT_B = "/tmp/test_model_store_b.bin";
+#endif
+
+static const int MODEL_BYTES = 1001;    // Not a multiple of 4: exercises padding
+static const int SCALER_COUNT = 3;
+
+static uint8_t g_package[2048];
+static ModelStore g_store;
+
+/**
+ * Package a fake .tflite (TFL3 identifier, byte pattern from `seed`).
+ */
+static size_t buildPackage(uint8_t seed, bool withScaler) {
+    ModelPackageHeader pkg;
+    memset(&pkg, 0, sizeof(pkg));
+    pkg.magic = MODEL_PACKAGE_MAGIC;
+    pkg.modelLength = MODEL_BYTES;
+    pkg.scalerCount = withScaler ? SCALER_COUNT : 0;
+    memcpy(g_package, &pkg, sizeof(pkg));
+
+    uint8_t* model = g_package + sizeof(pkg);
+    for (int i = 0; i < MODEL_BYTES; i++) model[i] = (uint8_t)(seed + i * 7);
+    memcpy(model + 4, "TFL3", 4);
+    size_t length = sizeof(pkg) + ((MODEL_BYTES + 3) & ~3);
+    memset(g_package + sizeof(pkg) + MODEL_BYTES, 0, length - sizeof(pkg) - MODEL_BYTES);
+
+    if (withScaler) {
+        float scaler[2 * SCALER_COUNT] = {1.0f, 2.0f, 3.0f, 0.5f, 0.25f, 0.125f};
+        memcpy(g_package + length, scaler, sizeof(scaler));
+        length += sizeof(scaler);
+    }
+    return length;
+}
+
+/**
+ * Write a package in out-of-order, partly repeated chunks.
+ */
+static int storePackage(size_t length, int activeSlot, uint32_t crc) {
+    int slot = g_store.beginUpdate(length, activeSlot);
+    if (slot < 0) return -1;
+    const size_t chunk = 244;
+    for (size_t off = chunk; off < length; off += chunk) {
+        size_t n = length - off < chunk ? length - off : chunk;
+        if (!g_store.writeUpdate(off, g_package + off, n)) return -1;
+    }
+    size_t n = length < chunk ? length : chunk;
+    if (!g_store.writeUpdate(0, g_package, n)) return -1;
+    if (!g_store.writeUpdate(0, g_package, n)) return -1;     // Resent chunk
+    return g_store.finishUpdate(crc);
+}
+
+void setUp() {
+    TEST_ASSERT_TRUE(g_store.begin(SLOT_A, SLOT_B));
+    // Invalidate both slots
+    for (int s = 0; s < MODEL_SLOT_COUNT; s++) {
+        TEST_ASSERT_EQUAL(s, g_store.beginUpdate(sizeof(ModelPackageHeader), 1 - s));
+        g_store.abortUpdate();
+    }
+}
+
+void tearDown() {
+    g_store.release(0);
+    g_store.release(1);
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+void test_crc32_matches_zlib() {
+    const uint8_t text[] = "123456789";
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926u, crc32Update(0, text, 9));
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926u, crc32Update(crc32Update(0, text, 4), text + 4, 5));
+}
+
+void test_empty_store_has_no_model() {
+    TEST_ASSERT_EQUAL(-1, g_store.newestSlot());
+    ModelImage image;
+    TEST_ASSERT_FALSE(g_store.map(0, &image));
+    TEST_ASSERT_FALSE(g_store.map(1, &image));
+}
+
+void test_package_maps_in_place() {
+    size_t length = buildPackage(11, false);
+    int slot = storePackage(length, -1, crc32Update(0, g_package, length));
+    TEST_ASSERT_EQUAL(0, slot);
+    TEST_ASSERT_EQUAL(0, g_store.newestSlot());
+
+    ModelImage image;
+    TEST_ASSERT_TRUE(g_store.map(slot, &image));
+    TEST_ASSERT_EQUAL(MODEL_BYTES, (int)image.modelLength);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(g_package + sizeof(ModelPackageHeader), image.model, MODEL_BYTES);
+    TEST_ASSERT_EQUAL(0, image.scalerCount);
+    TEST_ASSERT_NULL(image.mean);
+    TEST_ASSERT_EQUAL_UINT32(1, image.sequence);
+    // Model is 4-byte aligned in the mapping (flatbuffer reads need it)
+    TEST_ASSERT_EQUAL(0, (int)((uintptr_t)image.model & 3));
+}
+
+void test_second_update_goes_to_other_slot() {
+    size_t length = buildPackage(11, false);
+    TEST_ASSERT_EQUAL(0, storePackage(length, -1, crc32Update(0, g_package, length)));
+    length = buildPackage(99, true);
+    TEST_ASSERT_EQUAL(1, storePackage(length, 0, crc32Update(0, g_package, length)));
+    TEST_ASSERT_EQUAL(1, g_store.newestSlot());
+
+    ModelImage image;
+    TEST_ASSERT_TRUE(g_store.map(1, &image));
+    TEST_ASSERT_EQUAL_UINT32(2, image.sequence);
+    TEST_ASSERT_EQUAL(SCALER_COUNT, image.scalerCount);
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, image.mean[2]);
+    TEST_ASSERT_EQUAL_FLOAT(0.125f, image.scale[2]);
+
+    // The older slot stays readable until it is overwritten
+    ModelImage older;
+    TEST_ASSERT_TRUE(g_store.map(0, &older));
+    TEST_ASSERT_EQUAL_UINT32(1, older.sequence);
+}
+
+void test_bad_crc_keeps_previous_model() {
+    size_t length = buildPackage(11, false);
+    TEST_ASSERT_EQUAL(0, storePackage(length, -1, crc32Update(0, g_package, length)));
+    length = buildPackage(99, false);
+    TEST_ASSERT_EQUAL(-1, storePackage(length, 0, crc32Update(0, g_package, length) ^ 1));
+    TEST_ASSERT_EQUAL(0, g_store.newestSlot());
+
+    ModelImage image;
+    TEST_ASSERT_FALSE(g_store.map(1, &image));
+}
+
+void test_unfinished_update_keeps_previous_model() {
+    size_t length = buildPackage(11, false);
+    TEST_ASSERT_EQUAL(0, storePackage(length, -1, crc32Update(0, g_package, length)));
+
+    length = buildPackage(99, false);
+    TEST_ASSERT_EQUAL(1, g_store.beginUpdate(length, 0));
+    TEST_ASSERT_TRUE(g_store.writeUpdate(0, g_package, length / 2));
+    TEST_ASSERT_FALSE(g_store.writeUpdate(length - 4, g_package, 8));    // Past the end
+    TEST_ASSERT_EQUAL(0, g_store.newestSlot());
+
+    // Connection lost: reopen as after a reboot
+    g_store.abortUpdate();
+    TEST_ASSERT_TRUE(g_store.begin(SLOT_A, SLOT_B));
+    TEST_ASSERT_EQUAL(0, g_store.newestSlot());
+}
+
+void test_wrapping_package_header_is_rejected() {
+    // Sizes that wrap to a 24-byte package in 32-bit arithmetic:
+    // (0xFFFFFFFD + 3) & ~3 == 0 and 0x20000001 * 8 == 8
+    ModelPackageHeader pkg;
+    memset(&pkg, 0, sizeof(pkg));
+    pkg.magic = MODEL_PACKAGE_MAGIC;
+    pkg.modelLength = 0xFFFFFFFDu;
+    pkg.scalerCount = 0x20000001u;
+    memset(g_package, 0, 24);
+    memcpy(g_package, &pkg, sizeof(pkg));
+    memcpy(g_package + sizeof(pkg) + 4, "TFL3", 4);
+    TEST_ASSERT_EQUAL(-1, storePackage(24, -1, crc32Update(0, g_package, 24)));
+
+    // A scaler longer than any feature vector
+    pkg.modelLength = 8;
+    pkg.scalerCount = MODEL_SCALER_MAX_FEATURES + 1;
+    size_t length = sizeof(pkg) + 8 + pkg.scalerCount * 2 * sizeof(float);
+    memset(g_package, 0, length);
+    memcpy(g_package, &pkg, sizeof(pkg));
+    memcpy(g_package + sizeof(pkg) + 4, "TFL3", 4);
+    TEST_ASSERT_EQUAL(-1, storePackage(length, -1, crc32Update(0, g_package, length)));
+
+    TEST_ASSERT_EQUAL(-1, g_store.newestSlot());
+    TEST_ASSERT_EQUAL(0, g_store.beginUpdate(64, -1));
+    TEST_ASSERT_FALSE(g_store.writeUpdate((size_t)-8, g_package, 16));     // Offset wraps
+    g_store.abortUpdate();
+}
+
+void test_oversized_update_is_rejected() {
+    TEST_ASSERT_EQUAL(-1, g_store.beginUpdate(g_store.getCapacity() + 1, -1));
+    TEST_ASSERT_FALSE(g_store.isUpdating());
+}
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+int runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32_matches_zlib);
+    RUN_TEST(test_empty_store_has_no_model);
+    RUN_TEST(test_package_maps_in_place);
+    RUN_TEST(test_second_update_goes_to_other_slot);
+    RUN_TEST(test_bad_crc_keeps_previous_model);
+    RUN_TEST(test_unfinished_update_keeps_previous_model);
+    RUN_TEST(test_wrapping_package_header_is_rejected);
+    RUN_TEST(test_oversized_update_is_rejected);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    delay(2000);  // Wait for the serial monitor
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    int failures = runTests();
+    remove(SLOT_A);
+    remove(SLOT_B);
+    return failures;
+}
+#endif
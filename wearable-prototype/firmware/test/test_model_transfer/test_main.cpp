@@ -0,0 +1,390 @@
+/**
+ * BLE Model Transfer Test
+ * =======================
+ *
+ * Drives ModelTransfer with a simulated central: a package is split into
+ * MTU-sized DATA packets and written into a ModelStore, with disconnects,
+ * lost packets and corrupt images. On the host the store is backed by
+ * temporary files; on the device by the model partitions (erased here).
+ *
+ *   pio test -e native -f test_model_transfer
+ *   pio test -e esp32-s3-devkitc-1 -f test_model_transfer
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "ble/model_transfer.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static uint32_t nowMicros() { return micros(); }
+static const char* SLOT_A = MODEL_PARTITION_A;
+static const char* SLOT_B = MODEL_PARTITION_B;
+#else
+#include <chrono>
+static uint32_t nowMicros() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(
+        steady_clock::now().time_since_epoch()).count();
+}
+static const char* SLOT_A = "/tmp/test_model_transfer_a.bin";
+static const char* SLOT_B = "/tmp/test_model_transfer_b.bin";
+#endif
+
+static const size_t CHUNK = MODEL_XFER_MAX_PACKET - MODEL_XFER_DATA_HEADER;
+static const size_t SMALL_MODEL = 12 * 1024;
+static const size_t LARGE_MODEL = 50 * 1024;
+
+// Link model for the throughput estimate: 7.5 ms connection interval,
+// 4 write-without-response packets per connection event
+static const float CONN_INTERVAL_MS = 7.5f;
+static const int PACKETS_PER_EVENT = 4;
+
+static uint8_t g_package[LARGE_MODEL + 64];
+static ModelStore g_store;
+static ModelTransfer g_transfer;
+
+// ============================================================================
+// Simulated Central
+// ============================================================================
+
+struct CentralStatus {
+    uint8_t state;
+    uint8_t error;
+    uint32_t nextOffset;
+    uint32_t length;
+};
+
+static int g_notifications;
+static int g_packets;
+
+static uint32_t readU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void writeU32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static CentralStatus readStatus() {
+    uint8_t raw[MODEL_XFER_STATUS_SIZE];
+    g_transfer.getStatus(raw);
+    CentralStatus status;
+    status.state = raw[0];
+    status.error = raw[1];
+    status.nextOffset = readU32(raw + 4);
+    status.length = readU32(raw + 8);
+    return status;
+}
+
+/**
+ * Write one packet; true if the device notified its status.
+ */
+static bool send(const uint8_t* packet, size_t length, int activeSlot = -1) {
+    g_packets++;
+    bool notified = g_transfer.handlePacket(packet, length, activeSlot);
+    if (notified) g_notifications++;
+    return notified;
+}
+
+static CentralStatus sendBegin(size_t length, uint32_t crc, int activeSlot = -1) {
+    uint8_t packet[9] = {MODEL_XFER_OP_BEGIN};
+    writeU32(packet + 1, (uint32_t)length);
+    writeU32(packet + 5, crc);
+    send(packet, sizeof(packet), activeSlot);
+    return readStatus();
+}
+
+static bool sendChunk(size_t offset, size_t length) {
+    uint8_t packet[MODEL_XFER_MAX_PACKET];
+    packet[0] = MODEL_XFER_OP_DATA;
+    size_t n = length - offset < CHUNK ? length - offset : CHUNK;
+    writeU32(packet + 1, (uint32_t)offset);
+    memcpy(packet + MODEL_XFER_DATA_HEADER, g_package + offset, n);
+    return send(packet, MODEL_XFER_DATA_HEADER + n);
+}
+
+static CentralStatus sendOp(uint8_t op) {
+    send(&op, 1);
+    return readStatus();
+}
+
+/**
+ * Stream [offset, stopAt) and rewind to nextOffset when the device reports
+ * a gap. `dropEvery` > 0 loses every n-th DATA packet on the air.
+ */
+static uint32_t stream(size_t offset, size_t length, size_t stopAt, int dropEvery) {
+    int sent = 0;
+    while (offset < stopAt) {
+        sent++;
+        bool lost = dropEvery > 0 && sent % dropEvery == 0;
+        bool notified = lost ? false : sendChunk(offset, length);
+        offset += CHUNK;
+        if (notified) {
+            CentralStatus status = readStatus();
+            if (status.error == XFER_ERR_GAP) offset = status.nextOffset;
+        }
+        if (offset >= stopAt && readStatus().nextOffset < stopAt) {
+            offset = readStatus().nextOffset;     // Tail packet lost
+        }
+    }
+    return readStatus().nextOffset;
+}
+
+/**
+ * Package with a fake .tflite body of `modelBytes`.
+ */
+static size_t buildPackage(size_t modelBytes, uint8_t seed) {
+    ModelPackageHeader pkg;
+    memset(&pkg, 0, sizeof(pkg));
+    pkg.magic = MODEL_PACKAGE_MAGIC;
+    pkg.modelLength = (uint32_t)modelBytes;
+    memcpy(g_package, &pkg, sizeof(pkg));
+
+    uint8_t* model = g_package + sizeof(pkg);
+    for (size_t i = 0; i < modelBytes; i++) model[i] = (uint8_t)(seed + i * 13 + (i >> 8));
+    memcpy(model + 4, "TFL3", 4);
+    size_t padded = (modelBytes + 3) & ~(size_t)3;
+    memset(model + modelBytes, 0, padded - modelBytes);
+    return sizeof(pkg) + padded;
+}
+
+// Stand-in for the classifier: a swap to a committed slot is staged but
+// not applied yet (SleepClassifier::beginModelUpdate() drops it)
+struct PendingSwap {
+    bool pending;
+    int slot;
+    ModelImage image;
+    int calls;
+    bool erasedFirst;           // Slot already being rewritten at the drop
+};
+
+static PendingSwap g_swap;
+
+static int beginUpdateDroppingSwap(void* context, size_t packageLength) {
+    PendingSwap* swap = (PendingSwap*)context;
+    swap->calls++;
+    if (swap->pending) {
+        swap->erasedFirst = g_store.isUpdating();
+        swap->pending = false;
+        g_store.release(swap->slot);
+    }
+    return g_store.beginUpdate(packageLength, 0);
+}
+
+static void assertStoredModel(int slot, size_t length) {
+    ModelImage image;
+    TEST_ASSERT_TRUE(g_store.map(slot, &image));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(g_package + sizeof(ModelPackageHeader), image.model,
+                                  image.modelLength);
+    TEST_ASSERT_EQUAL((int)(length - sizeof(ModelPackageHeader)),
+                      (int)((image.modelLength + 3) & ~(size_t)3));
+    g_store.release(slot);
+}
+
+void setUp() {
+    TEST_ASSERT_TRUE(g_store.begin(SLOT_A, SLOT_B));
+    for (int s = 0; s < MODEL_SLOT_COUNT; s++) {
+        g_store.beginUpdate(sizeof(ModelPackageHeader), 1 - s);
+        g_store.abortUpdate();
+    }
+    g_transfer = ModelTransfer();
+    g_transfer.begin(&g_store);
+    g_notifications = 0;
+    g_packets = 0;
+}
+
+void tearDown() {}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+void test_full_transfer_commits_to_inactive_slot() {
+    size_t length = buildPackage(SMALL_MODEL, 1);
+    uint32_t crc = crc32Update(0, g_package, length);
+
+    CentralStatus status = sendBegin(length, crc, 0);     // Running from slot 0
+    TEST_ASSERT_EQUAL(XFER_RECEIVING, status.state);
+    TEST_ASSERT_EQUAL(0, (int)status.nextOffset);
+
+    TEST_ASSERT_EQUAL((int)length, (int)stream(0, length, length, 0));
+    status = sendOp(MODEL_XFER_OP_COMMIT);
+    TEST_ASSERT_EQUAL(XFER_COMMITTED, status.state);
+    TEST_ASSERT_EQUAL(1, g_transfer.takeCommittedSlot());
+    TEST_ASSERT_EQUAL(-1, g_transfer.takeCommittedSlot());
+    TEST_ASSERT_EQUAL(1, g_store.newestSlot());
+    assertStoredModel(1, length);
+
+    // Progress notifications roughly every MODEL_XFER_ACK_BYTES, not per packet
+    TEST_ASSERT_LESS_OR_EQUAL((int)(length / MODEL_XFER_ACK_BYTES) + 3, g_notifications);
+}
+
+void test_transfer_resumes_after_disconnect() {
+    size_t length = buildPackage(SMALL_MODEL, 2);
+    uint32_t crc = crc32Update(0, g_package, length);
+
+    sendBegin(length, crc);
+    uint32_t received = stream(0, length, length / 2, 0);
+    TEST_ASSERT_TRUE(received >= length / 2);
+
+    // Reconnect: the same BEGIN reports where to continue
+    CentralStatus status = sendBegin(length, crc);
+    TEST_ASSERT_EQUAL(XFER_RECEIVING, status.state);
+    TEST_ASSERT_EQUAL((int)received, (int)status.nextOffset);
+
+    stream(status.nextOffset, length, length, 0);
+    TEST_ASSERT_EQUAL(XFER_COMMITTED, sendOp(MODEL_XFER_OP_COMMIT).state);
+    assertStoredModel(g_store.newestSlot(), length);
+}
+
+void test_lost_packets_are_resent() {
+    size_t length = buildPackage(SMALL_MODEL, 3);
+    uint32_t crc = crc32Update(0, g_package, length);
+
+    sendBegin(length, crc);
+    TEST_ASSERT_EQUAL((int)length, (int)stream(0, length, length, 7));
+    TEST_ASSERT_EQUAL(XFER_COMMITTED, sendOp(MODEL_XFER_OP_COMMIT).state);
+    assertStoredModel(g_store.newestSlot(), length);
+}
+
+void test_early_commit_is_refused() {
+    size_t length = buildPackage(SMALL_MODEL, 4);
+    sendBegin(length, crc32Update(0, g_package, length));
+    stream(0, length, length / 2, 0);
+
+    CentralStatus status = sendOp(MODEL_XFER_OP_COMMIT);
+    TEST_ASSERT_EQUAL(XFER_RECEIVING, status.state);
+    TEST_ASSERT_EQUAL(XFER_ERR_INCOMPLETE, status.error);
+    TEST_ASSERT_EQUAL(-1, g_store.newestSlot());
+}
+
+void test_corrupt_image_keeps_running_model() {
+    size_t length = buildPackage(SMALL_MODEL, 5);
+    sendBegin(length, crc32Update(0, g_package, length));
+    stream(0, length, length, 0);
+    TEST_ASSERT_EQUAL(XFER_COMMITTED, sendOp(MODEL_XFER_OP_COMMIT).state);
+    int running = g_store.newestSlot();
+
+    length = buildPackage(SMALL_MODEL, 6);
+    sendBegin(length, crc32Update(0, g_package, length) ^ 0x80000000u, running);
+    stream(0, length, length, 0);
+    CentralStatus status = sendOp(MODEL_XFER_OP_COMMIT);
+    TEST_ASSERT_EQUAL(XFER_FAILED, status.state);
+    TEST_ASSERT_EQUAL(XFER_ERR_VERIFY, status.error);
+    TEST_ASSERT_EQUAL(running, g_store.newestSlot());
+}
+
+void test_oversized_and_malformed_packets() {
+    CentralStatus status = sendBegin(g_store.getCapacity() + 1, 0);
+    TEST_ASSERT_EQUAL(XFER_FAILED, status.state);
+    TEST_ASSERT_EQUAL(XFER_ERR_SIZE, status.error);
+
+    uint8_t bad[3] = {MODEL_XFER_OP_BEGIN, 1, 2};
+    send(bad, sizeof(bad));
+    TEST_ASSERT_EQUAL(XFER_ERR_PACKET, readStatus().error);
+
+    uint8_t data[8] = {MODEL_XFER_OP_DATA, 0, 0, 0, 0, 1, 2, 3};
+    send(data, sizeof(data));                        // No transfer running
+    TEST_ASSERT_EQUAL(XFER_ERR_PACKET, readStatus().error);
+
+    TEST_ASSERT_EQUAL(XFER_IDLE, sendOp(MODEL_XFER_OP_ABORT).state);
+}
+
+void test_begin_drops_pending_swap_before_erasing() {
+    // Running from slot 0; a model committed to slot 1 waits for the epoch
+    size_t length = buildPackage(SMALL_MODEL, 8);
+    sendBegin(length, crc32Update(0, g_package, length), 0);
+    stream(0, length, length, 0);
+    TEST_ASSERT_EQUAL(XFER_COMMITTED, sendOp(MODEL_XFER_OP_COMMIT).state);
+
+    memset(&g_swap, 0, sizeof(g_swap));
+    TEST_ASSERT_TRUE(g_store.map(1, &g_swap.image));
+    g_swap.pending = true;
+    g_swap.slot = 1;
+    g_transfer.begin(&g_store, beginUpdateDroppingSwap, &g_swap);
+
+    // The next package goes into slot 1 again: the swap must go first
+    length = buildPackage(SMALL_MODEL, 9);
+    uint32_t crc = crc32Update(0, g_package, length);
+    CentralStatus status = sendBegin(length, crc, 0);
+    TEST_ASSERT_EQUAL(XFER_RECEIVING, status.state);
+    TEST_ASSERT_EQUAL(1, g_swap.calls);
+    TEST_ASSERT_FALSE(g_swap.pending);
+    TEST_ASSERT_FALSE(g_swap.erasedFirst);
+    TEST_ASSERT_EQUAL(-1, g_store.newestSlot());     // Slot 1 erased after the drop
+
+    // A resume erases nothing and does not call the hook again
+    stream(0, length, length / 2, 0);
+    TEST_ASSERT_EQUAL(XFER_RECEIVING, sendBegin(length, crc, 0).state);
+    TEST_ASSERT_EQUAL(1, g_swap.calls);
+
+    stream(readStatus().nextOffset, length, length, 0);
+    TEST_ASSERT_EQUAL(XFER_COMMITTED, sendOp(MODEL_XFER_OP_COMMIT).state);
+    assertStoredModel(1, length);
+}
+
+void bench_transfer_throughput() {
+    size_t length = buildPackage(LARGE_MODEL, 7);
+    uint32_t crc = crc32Update(0, g_package, length);
+
+    uint32_t t0 = nowMicros();
+    sendBegin(length, crc);
+    uint32_t tErase = nowMicros();
+    stream(0, length, length, 0);
+    uint32_t tWrite = nowMicros();
+    CentralStatus status = sendOp(MODEL_XFER_OP_COMMIT);
+    uint32_t tCommit = nowMicros();
+    TEST_ASSERT_EQUAL(XFER_COMMITTED, status.state);
+
+    float writeMs = (tWrite - tErase) / 1000.0f;
+    float totalMs = (tCommit - t0) / 1000.0f;
+    float airMs = ((g_packets + PACKETS_PER_EVENT - 1) / PACKETS_PER_EVENT) * CONN_INTERVAL_MS;
+
+    char msg[200];
+    snprintf(msg, sizeof(msg),
+             "%u B in %d packets: device %.1f ms (erase %.1f, write %.1f = %.0f KB/s, "
+             "commit %.1f) | link @%.1f ms x%d: %.0f ms = %.1f KB/s",
+             (unsigned)length, g_packets, totalMs, (tErase - t0) / 1000.0f,
+             writeMs, length / 1.024f / writeMs, (tCommit - tWrite) / 1000.0f,
+             CONN_INTERVAL_MS, PACKETS_PER_EVENT, airMs, length / 1.024f / airMs);
+    TEST_MESSAGE(msg);
+}
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+int runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_full_transfer_commits_to_inactive_slot);
+    RUN_TEST(test_transfer_resumes_after_disconnect);
+    RUN_TEST(test_lost_packets_are_resent);
+    RUN_TEST(test_early_commit_is_refused);
+    RUN_TEST(test_corrupt_image_keeps_running_model);
+    RUN_TEST(test_oversized_and_malformed_packets);
+    RUN_TEST(test_begin_drops_pending_swap_before_erasing);
+    RUN_TEST(bench_transfer_throughput);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    delay(2000);  // Wait for the serial monitor
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    int failures = runTests();
+    remove(SLOT_A);
+    remove(SLOT_B);
+    return failures;
+}
+#endif
@@ -0,0 +1,318 @@
+/**
+ * Sequence Model Test
+ * ===================
+ *
+ * Checks the incremental GRU step against a double-precision reference,
+ * and that a night interrupted by a deep sleep or a reboot continues
+ * from the saved state exactly as if it had never stopped, while a state
+ * left from an earlier night is dropped. On the device
+ * the state goes to the real NVS namespace, so this test clears it.
+ *
+ *   pio test -e native -f test_sequence_model
+ *   pio test -e esp32-s3-devkitc-1 -f test_sequence_model
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "config.h"
+#include "processing/gru_step.h"
+#include "processing/recurrent_state.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static const char* STATE_NAME = SEQUENCE_STATE_NAMESPACE;
+static uint32_t nowMicros() { return micros(); }
+#else
+#include <chrono>
+static const char* STATE_NAME = "/tmp/test_sequence_state.bin";
+static uint32_t nowMicros() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(
+        steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// Deployed size: 72 features, 24 units, 4 classes
+static const int INPUTS = 72;
+static const int UNITS = 24;
+
+// Clock in seconds: the night starts at 1000 s, one epoch every 30 s
+static const uint32_t NIGHT_START = 1000;
+static const uint32_t EPOCH_SEC = 30;
+static const uint32_t MAX_GAP_SEC = 7200;
+static const int CLASSES = 4;
+static const int EPOCHS = 40;
+static const uint32_t MODEL_ID = 0x5EC0DE01u;
+
+static float g_kernel[INPUTS * 3 * UNITS];
+static float g_recurrent[UNITS * 3 * UNITS];
+static float g_inputBias[3 * UNITS];
+static float g_recurrentBias[3 * UNITS];
+static float g_dense[UNITS * CLASSES];
+static float g_denseBias[CLASSES];
+static float g_features[EPOCHS][INPUTS];
+
+static uint32_t g_rng = 12345;
+
+static float randSymmetric(float range) {
+    g_rng = g_rng * 1664525u + 1013904223u;
+    return ((g_rng >> 8) / 16777216.0f * 2.0f - 1.0f) * range;
+}
+
+static void fillModel() {
+    for (size_t i = 0; i < sizeof(g_kernel) / sizeof(float); i++) g_kernel[i] = randSymmetric(0.2f);
+    for (size_t i = 0; i < sizeof(g_recurrent) / sizeof(float); i++) g_recurrent[i] = randSymmetric(0.3f);
+    for (int i = 0; i < 3 * UNITS; i++) {
+        g_inputBias[i] = randSymmetric(0.1f);
+        g_recurrentBias[i] = randSymmetric(0.1f);
+    }
+    for (int i = 0; i < UNITS * CLASSES; i++) g_dense[i] = randSymmetric(1.0f);
+    for (int c = 0; c < CLASSES; c++) g_denseBias[c] = randSymmetric(0.1f);
+    for (int t = 0; t < EPOCHS; t++) {
+        for (int i = 0; i < INPUTS; i++) g_features[t][i] = randSymmetric(2.0f);
+    }
+}
+
+static void beginModel(GRUStep& gru) {
+    TEST_ASSERT_TRUE(gru.begin(g_kernel, g_recurrent, g_inputBias, g_recurrentBias,
+                               g_dense, g_denseBias, INPUTS, UNITS, CLASSES));
+}
+
+/**
+ * Keras GRU(reset_after=True) step in double.
+ */
+static void referenceStep(double* h, const float* x, double* probabilities) {
+    const int g = 3 * UNITS;
+    double xw[3 * UNITS], hu[3 * UNITS];
+    for (int j = 0; j < g; j++) {
+        xw[j] = g_inputBias[j];
+        hu[j] = g_recurrentBias[j];
+        for (int i = 0; i < INPUTS; i++) xw[j] += (double)x[i] * g_kernel[i * g + j];
+        for (int i = 0; i < UNITS; i++) hu[j] += h[i] * g_recurrent[i * g + j];
+    }
+    for (int j = 0; j < UNITS; j++) {
+        double z = 1.0 / (1.0 + exp(-(xw[j] + hu[j])));
+        double r = 1.0 / (1.0 + exp(-(xw[UNITS + j] + hu[UNITS + j])));
+        double candidate = tanh(xw[2 * UNITS + j] + r * hu[2 * UNITS + j]);
+        h[j] = z * h[j] + (1.0 - z) * candidate;
+    }
+    double sum = 0.0;
+    for (int c = 0; c < CLASSES; c++) {
+        double logit = g_denseBias[c];
+        for (int i = 0; i < UNITS; i++) logit += h[i] * g_dense[i * CLASSES + c];
+        probabilities[c] = exp(logit);
+        sum += probabilities[c];
+    }
+    for (int c = 0; c < CLASSES; c++) probabilities[c] /= sum;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+void test_gru_step_matches_reference() {
+    GRUStep gru;
+    beginModel(gru);
+    double h[UNITS] = {0};
+    double expected[CLASSES];
+    float probabilities[CLASSES];
+
+    for (int t = 0; t < EPOCHS; t++) {
+        int best = gru.step(g_features[t], probabilities);
+        referenceStep(h, g_features[t], expected);
+        int expectedBest = 0;
+        for (int c = 0; c < CLASSES; c++) {
+            TEST_ASSERT_FLOAT_WITHIN(1e-4f, (float)expected[c], probabilities[c]);
+            if (expected[c] > expected[expectedBest]) expectedBest = c;
+        }
+        TEST_ASSERT_EQUAL(expectedBest, best);
+    }
+    for (int i = 0; i < UNITS; i++) {
+        TEST_ASSERT_FLOAT_WITHIN(1e-4f, (float)h[i], gru.getState()[i]);
+    }
+}
+
+/**
+ * Run the night in one go, and again with an interruption after `split`
+ * epochs; `reboot` also loses the RTC copy, so the state comes from NVS.
+ */
+static void checkResume(int split, bool reboot) {
+    GRUStep uninterrupted;
+    beginModel(uninterrupted);
+    float expected[CLASSES];
+    for (int t = 0; t < EPOCHS; t++) uninterrupted.step(g_features[t], expected);
+
+    RecurrentStateStore store;
+    TEST_ASSERT_TRUE(store.begin(STATE_NAME, 5, MAX_GAP_SEC));
+    store.clear();
+
+    GRUStep before;
+    beginModel(before);
+    float probabilities[CLASSES];
+    for (int t = 0; t < split; t++) {
+        before.step(g_features[t], probabilities);
+        store.save(before.getState(), UNITS, MODEL_ID, (uint32_t)(t + 1),
+                   NIGHT_START + t * EPOCH_SEC);
+    }
+    if (reboot) {
+        TEST_ASSERT_TRUE(store.persist());
+        RecurrentStateStore::clearRetained();
+    }
+
+    GRUStep after;
+    beginModel(after);
+    RecurrentStateStore restored;
+    restored.begin(STATE_NAME, 5, MAX_GAP_SEC);
+    float state[GRU_MAX_UNITS];
+    uint32_t epochs = 0;
+    uint32_t wake = NIGHT_START + split * EPOCH_SEC + 600;     // 10 minutes later
+    TEST_ASSERT_TRUE(restored.restore(state, UNITS, MODEL_ID, wake, &epochs));
+    TEST_ASSERT_EQUAL_UINT32(split, epochs);
+    after.setState(state);
+    for (int t = split; t < EPOCHS; t++) after.step(g_features[t], probabilities);
+
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected, probabilities, CLASSES);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(uninterrupted.getState(), after.getState(), UNITS);
+}
+
+void test_state_resumes_after_deep_sleep() {
+    checkResume(17, false);
+}
+
+void test_state_resumes_after_reboot() {
+    checkResume(23, true);
+}
+
+void test_state_of_other_model_is_rejected() {
+    RecurrentStateStore store;
+    store.begin(STATE_NAME, 1, MAX_GAP_SEC);
+    float state[UNITS];
+    for (int i = 0; i < UNITS; i++) state[i] = 0.5f;
+    store.save(state, UNITS, MODEL_ID, 1, NIGHT_START);
+
+    float restored[UNITS] = {0};
+    TEST_ASSERT_FALSE(store.restore(restored, UNITS, MODEL_ID + 1, NIGHT_START, nullptr));
+    TEST_ASSERT_FALSE(store.restore(restored, UNITS - 1, MODEL_ID, NIGHT_START, nullptr));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, restored[0]);
+
+    store.clear();
+    TEST_ASSERT_FALSE(store.restore(restored, UNITS, MODEL_ID, NIGHT_START, nullptr));
+}
+
+void test_state_of_earlier_night_is_dropped() {
+    RecurrentStateStore store;
+    store.begin(STATE_NAME, 1, MAX_GAP_SEC);
+    float state[UNITS];
+    for (int i = 0; i < UNITS; i++) state[i] = 0.5f;
+    float restored[UNITS] = {0};
+
+    // Just inside the gap: same night
+    store.save(state, UNITS, MODEL_ID, 40, NIGHT_START);
+    TEST_ASSERT_TRUE(store.restore(restored, UNITS, MODEL_ID, NIGHT_START + MAX_GAP_SEC, nullptr));
+
+    // Past it: next evening, both copies go
+    memset(restored, 0, sizeof(restored));
+    TEST_ASSERT_FALSE(store.restore(restored, UNITS, MODEL_ID,
+                                    NIGHT_START + MAX_GAP_SEC + 1, nullptr));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, restored[0]);
+    RecurrentStateStore::clearRetained();
+    TEST_ASSERT_FALSE(store.restore(restored, UNITS, MODEL_ID, NIGHT_START, nullptr));
+
+    // Power-on: the clock restarted behind the record, its age is unknown
+    store.save(state, UNITS, MODEL_ID, 40, NIGHT_START);
+    TEST_ASSERT_TRUE(store.persist());
+    RecurrentStateStore::clearRetained();
+    TEST_ASSERT_FALSE(store.restore(restored, UNITS, MODEL_ID, 5, nullptr));
+}
+
+void test_non_finite_features_do_not_poison_state() {
+    GRUStep clean;
+    GRUStep dirty;
+    beginModel(clean);
+    beginModel(dirty);
+    float probabilities[CLASSES];
+    float features[INPUTS];
+
+    // A non-finite feature steps like a zero
+    memcpy(features, g_features[0], sizeof(features));
+    features[3] = NAN;
+    features[7] = INFINITY;
+    dirty.step(features, probabilities);
+    features[3] = 0.0f;
+    features[7] = 0.0f;
+    clean.step(features, probabilities);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(clean.getState(), dirty.getState(), UNITS);
+    for (int c = 0; c < CLASSES; c++) TEST_ASSERT_TRUE(isfinite(probabilities[c]));
+
+    // A non-finite state is not saved over the last good one
+    RecurrentStateStore store;
+    store.begin(STATE_NAME, 0, MAX_GAP_SEC);
+    store.clear();
+    store.save(dirty.getState(), UNITS, MODEL_ID, 1, NIGHT_START);
+    float bad[UNITS];
+    memcpy(bad, dirty.getState(), sizeof(bad));
+    bad[0] = NAN;
+    store.save(bad, UNITS, MODEL_ID, 2, NIGHT_START + EPOCH_SEC);
+
+    float restored[UNITS];
+    uint32_t epochs = 0;
+    TEST_ASSERT_TRUE(store.restore(restored, UNITS, MODEL_ID, NIGHT_START + EPOCH_SEC, &epochs));
+    TEST_ASSERT_EQUAL_UINT32(1, epochs);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(dirty.getState(), restored, UNITS);
+}
+
+void bench_gru_step_per_epoch() {
+    GRUStep gru;
+    beginModel(gru);
+    float probabilities[CLASSES];
+    const int repeats = 1000;
+    volatile int sink = 0;
+    uint32_t t0 = nowMicros();
+    for (int rep = 0; rep < repeats; rep++) {
+        sink += gru.step(g_features[rep % EPOCHS], probabilities);
+    }
+    char msg[96];
+    snprintf(msg, sizeof(msg), "GRU step (72 -> 24 units -> 4): %.2f us/epoch, %d weight bytes",
+             (float)(nowMicros() - t0) / repeats, (int)gru.getWeightBytes());
+    TEST_MESSAGE(msg);
+    (void)sink;
+}
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+int runTests() {
+    fillModel();
+    UNITY_BEGIN();
+    RUN_TEST(test_gru_step_matches_reference);
+    RUN_TEST(test_state_resumes_after_deep_sleep);
+    RUN_TEST(test_state_resumes_after_reboot);
+    RUN_TEST(test_state_of_other_model_is_rejected);
+    RUN_TEST(test_state_of_earlier_night_is_dropped);
+    RUN_TEST(test_non_finite_features_do_not_poison_state);
+    RUN_TEST(bench_gru_step_per_epoch);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    delay(2000);  // Wait for the serial monitor
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    int failures = runTests();
+    remove(STATE_NAME);
+    return failures;
+}
+#endif
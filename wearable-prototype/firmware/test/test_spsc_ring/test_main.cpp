@@ -0,0 +1,275 @@
+/**
+ * SPSC Ring Test
+ * ==============
+ *
+ * Single-threaded checks of SPSCRing (order across index wrap, batches,
+ * overrun counting), then a stress run with a real producer and consumer
+ * thread: every element carries its sequence number and a payload derived
+ * from it, so a lost, duplicated, reordered or torn element is caught.
+ * The lossless run waits for room; the lossy one drops like the
+ * sensor task does and checks received + overruns == produced.
+ *
+ * The thread stress runs on the host only:
+ *
+ *   pio test -e native -f test_spsc_ring
+ *   pio test -e esp32-s3-devkitc-1 -f test_spsc_ring
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "sensors/spsc_ring.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <atomic>
+#include <chrono>
+#include <thread>
+#endif
+
+// 32 bytes, like IMUData
+struct Sample {
+    uint32_t seq;
+    uint32_t payload[7];
+};
+
+static Sample makeSample(uint32_t seq) {
+    Sample s;
+    s.seq = seq;
+    for (int i = 0; i < 7; i++) {
+        s.payload[i] = seq * 2654435761u + (uint32_t)i;
+    }
+    return s;
+}
+
+static bool isIntact(const Sample& s) {
+    for (int i = 0; i < 7; i++) {
+        if (s.payload[i] != s.seq * 2654435761u + (uint32_t)i) return false;
+    }
+    return true;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================================================
+// Single Thread
+// ============================================================================
+
+void test_ring_keeps_order_across_wrap() {
+    static SPSCRing<Sample, 8> ring;
+    uint32_t next = 0, expect = 0;
+
+    // 5 in, 5 out: the indices wrap every few rounds
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 5; i++) {
+            TEST_ASSERT_TRUE(ring.push(makeSample(next++)));
+        }
+        TEST_ASSERT_EQUAL_UINT32(5, ring.size());
+        Sample s;
+        for (int i = 0; i < 5; i++) {
+            TEST_ASSERT_TRUE(ring.pop(s));
+            TEST_ASSERT_EQUAL_UINT32(expect++, s.seq);
+        }
+        TEST_ASSERT_TRUE(ring.empty());
+    }
+    Sample s;
+    TEST_ASSERT_FALSE(ring.pop(s));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.getOverruns());
+}
+
+void test_ring_counts_overruns_when_full() {
+    static SPSCRing<Sample, 16> ring;
+    for (uint32_t i = 0; i < 16; i++) {
+        TEST_ASSERT_TRUE(ring.push(makeSample(i)));
+    }
+
+    // The new samples are dropped, the queued ones kept
+    TEST_ASSERT_FALSE(ring.push(makeSample(16)));
+    TEST_ASSERT_FALSE(ring.push(makeSample(17)));
+    TEST_ASSERT_EQUAL_UINT32(2, ring.getOverruns());
+    TEST_ASSERT_EQUAL_UINT32(16, ring.size());
+
+    Sample out[16];
+    TEST_ASSERT_EQUAL_INT(16, ring.popBatch(out, 16));
+    for (uint32_t i = 0; i < 16; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i, out[i].seq);
+    }
+    TEST_ASSERT_TRUE(ring.push(makeSample(18)));
+    TEST_ASSERT_EQUAL_UINT32(2, ring.getOverruns());
+}
+
+void test_ring_batches_are_partial_at_the_edges() {
+    static SPSCRing<Sample, 16> ring;
+    Sample in[12], out[12];
+    for (uint32_t i = 0; i < 12; i++) in[i] = makeSample(i);
+
+    TEST_ASSERT_EQUAL_INT(12, ring.pushBatch(in, 12));
+    TEST_ASSERT_EQUAL_INT(4, ring.pushBatch(in, 12));      // 4 slots left
+    TEST_ASSERT_EQUAL_UINT32(8, ring.getOverruns());
+
+    TEST_ASSERT_EQUAL_INT(12, ring.popBatch(out, 12));
+    TEST_ASSERT_EQUAL_UINT32(11, out[11].seq);
+    TEST_ASSERT_EQUAL_INT(4, ring.popBatch(out, 12));      // Only 4 queued
+    TEST_ASSERT_EQUAL_UINT32(3, out[3].seq);
+    TEST_ASSERT_EQUAL_INT(0, ring.popBatch(out, 12));
+
+    // A batch that straddles the end of the slot array
+    TEST_ASSERT_EQUAL_INT(12, ring.pushBatch(in, 12));
+    TEST_ASSERT_EQUAL_INT(12, ring.popBatch(out, 12));
+    for (uint32_t i = 0; i < 12; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i, out[i].seq);
+        TEST_ASSERT_TRUE(isIntact(out[i]));
+    }
+}
+
+#ifndef ARDUINO
+// ============================================================================
+// Producer / Consumer Threads
+// ============================================================================
+
+static const uint32_t STRESS_SAMPLES = 2000000;
+static const int STRESS_BATCH = 32;
+
+struct StressResult {
+    uint32_t received;
+    uint32_t outOfOrder;
+    uint32_t torn;
+    uint32_t overruns;
+    double seconds;
+};
+
+/**
+ * @param lossless Producer waits for room instead of dropping
+ * @param consumerStallEvery Consumer pauses after this many batches
+ *                           (0: never), so a lossy ring overruns
+ */
+template <uint32_t N>
+static StressResult runStress(bool lossless, int consumerStallEvery) {
+    SPSCRing<Sample, N> ring;
+
+    std::atomic<bool> done(false);
+    StressResult result = {0, 0, 0, 0, 0.0};
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread producer([&]() {
+        Sample batch[STRESS_BATCH];
+        uint32_t seq = 0;
+        while (seq < STRESS_SAMPLES) {
+            // Alternate single pushes and batches, as ISR and task would
+            if ((seq / STRESS_BATCH) % 2 == 0) {
+                while (lossless && ring.size() >= N) std::this_thread::yield();
+                ring.push(makeSample(seq));
+                seq++;
+            } else {
+                int count = 0;
+                while (count < STRESS_BATCH && seq + count < STRESS_SAMPLES) {
+                    batch[count] = makeSample(seq + count);
+                    count++;
+                }
+                // size() only shrinks under the producer, so the room stays
+                while (lossless && ring.size() + count > N) std::this_thread::yield();
+                ring.pushBatch(batch, count);
+                seq += count;
+                // Paced like a sensor: one burst per wake-up
+                if (!lossless) std::this_thread::yield();
+            }
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    std::thread consumer([&]() {
+        Sample batch[STRESS_BATCH];
+        uint32_t lastSeq = 0;
+        bool first = true;
+        int batches = 0;
+        for (;;) {
+            bool finished = done.load(std::memory_order_acquire);
+            int want = 1 + (batches * 7) % STRESS_BATCH;    // Varying sizes
+            int count = ring.popBatch(batch, want);
+            for (int i = 0; i < count; i++) {
+                if (!first && batch[i].seq <= lastSeq) result.outOfOrder++;
+                if (lossless && batch[i].seq != (first ? 0 : lastSeq + 1)) result.outOfOrder++;
+                if (!isIntact(batch[i])) result.torn++;
+                lastSeq = batch[i].seq;
+                first = false;
+            }
+            result.received += count;
+            if (count == 0) {
+                if (finished) break;
+                std::this_thread::yield();
+            }
+            batches++;
+            if (consumerStallEvery > 0 && batches % consumerStallEvery == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+    });
+
+    producer.join();
+    consumer.join();
+    result.overruns = ring.getOverruns();
+    result.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void test_threads_lossless_transfer() {
+    StressResult r = runStress<64>(true, 0);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_SAMPLES, r.received);
+    TEST_ASSERT_EQUAL_UINT32(0, r.outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(0, r.torn);
+    TEST_ASSERT_EQUAL_UINT32(0, r.overruns);
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%u samples of %u B in %.0f ms = %.1f M samples/s",
+             (unsigned)STRESS_SAMPLES, (unsigned)sizeof(Sample), r.seconds * 1000.0,
+             STRESS_SAMPLES / r.seconds / 1e6);
+    TEST_MESSAGE(msg);
+}
+
+void test_threads_overruns_account_for_every_sample() {
+    StressResult r = runStress<128>(false, 4096);
+    TEST_ASSERT_EQUAL_UINT32(0, r.outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(0, r.torn);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_SAMPLES, r.received + r.overruns);
+    TEST_ASSERT_TRUE(r.overruns > 0);
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%u received, %u overruns with a stalling consumer",
+             (unsigned)r.received, (unsigned)r.overruns);
+    TEST_MESSAGE(msg);
+}
+#endif
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+int runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_ring_keeps_order_across_wrap);
+    RUN_TEST(test_ring_counts_overruns_when_full);
+    RUN_TEST(test_ring_batches_are_partial_at_the_edges);
+    #ifndef ARDUINO
+    RUN_TEST(test_threads_lossless_transfer);
+    RUN_TEST(test_threads_overruns_account_for_every_sample);
+    #endif
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    delay(2000);  // Wait for the serial monitor
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    return runTests();
+}
+#endif
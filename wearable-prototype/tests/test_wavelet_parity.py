@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""
+Wavelet Parity Test for Sleep Monitor Firmware
+
+Compiles the firmware's lifting wavelet (firmware/src/processing/lifting_wavelet.h)
+for the host and checks its per-level energies against PyWavelets
+('bior2.2' is the CDF 5/3 filter pair) on synthetic PPG and IMU signals.
+
+Requirements:
+    pip install numpy PyWavelets
+    A host C++ compiler (g++ or clang++)
+
+Usage:
+    python test_wavelet_parity.py
+"""
+
+import shutil
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+try:
+    import numpy as np
+    import pywt
+except ImportError:
+    print("Error: numpy and PyWavelets are required")
+    print("Install with: pip install numpy PyWavelets")
+    exit(1)
+
+FIRMWARE_DIR = Path(__file__).resolve().parent.parent / 'firmware'
+LEVELS = 4  # Must match WAVELET_LEVELS
+
+# waveletDecompose() reproduces pywt's coefficient layout (mirrored ends and
+# decimation phase included), so only float rounding separates the two
+DETAIL_RTOL = 1e-4
+APPROX_RTOL = 1e-4
+
+DRIVER_SOURCE = r"""
+#include "processing/lifting_wavelet.h"
+#include <stdio.h>
+#include <vector>
+
+int main(int argc, char** argv) {
+    bool integer = argc > 1;
+    std::vector<float> xf;
+    float v;
+    while (scanf("%f", &v) == 1) xf.push_back(v);
+    int n = (int)xf.size();
+
+    float detail[WAVELET_LEVELS];
+    float approx;
+    if (integer) {
+        std::vector<int32_t> xi(xf.begin(), xf.end());
+        waveletDecompose(xi.data(), n, WAVELET_LEVELS, detail, &approx);
+    } else {
+        waveletDecompose(xf.data(), n, WAVELET_LEVELS, detail, &approx);
+    }
+
+    // Same order as pywt.wavedec: approximation, then coarsest detail first
+    printf("%.9g", approx);
+    for (int j = WAVELET_LEVELS - 1; j >= 0; j--) printf(" %.9g", detail[j]);
+    printf("\n");
+    return 0;
+}
+"""
+
+
+def build_driver(workdir: Path) -> Path:
+    """Compile the C++ driver against the firmware headers."""
+    compiler = shutil.which('g++') or shutil.which('clang++')
+    if compiler is None:
+        print("Error: no host C++ compiler found")
+        exit(1)
+
+    source = workdir / 'wavelet_driver.cpp'
+    binary = workdir / 'wavelet_driver'
+    source.write_text(DRIVER_SOURCE)
+
+    subprocess.run([
+        compiler, '-std=gnu++11', '-O2',
+        f'-I{FIRMWARE_DIR / "src"}', f'-I{FIRMWARE_DIR / "include"}',
+        str(source), '-o', str(binary)
+    ], check=True)
+    return binary
+
+
+def firmware_energies(binary: Path, signal: np.ndarray, integer: bool) -> np.ndarray:
+    """Run the firmware transform and return per-level energies."""
+    args = [str(binary)] + (['int'] if integer else [])
+    data = ' '.join(repr(float(v)) for v in signal)
+    result = subprocess.run(args, input=data, capture_output=True, text=True, check=True)
+    return np.array([float(v) for v in result.stdout.split()])
+
+
+def pywt_energies(signal: np.ndarray) -> np.ndarray:
+    """Per-level energies from PyWavelets (whole-sample symmetric extension)."""
+    coeffs = pywt.wavedec(signal.astype(np.float64), 'bior2.2', mode='reflect', level=LEVELS)
+    return np.array([np.sum(c ** 2) for c in coeffs])
+
+
+def make_signals() -> dict:
+    """Synthetic 30 s epochs at the firmware sample rates."""
+    rng = np.random.default_rng(42)
+
+    t_ppg = np.arange(3000) / 100.0
+    ppg = (100000
+           + 2000 * np.sin(2 * np.pi * 1.1 * t_ppg)
+           + 300 * np.sin(2 * np.pi * 0.25 * t_ppg)
+           + 50 * np.sin(2 * np.pi * 12.0 * t_ppg)
+           + rng.integers(-200, 200, size=t_ppg.size))
+    ppg = np.floor(ppg)
+
+    t_imu = np.arange(960) / 32.0
+    mag = (1.0
+           + 0.02 * np.sin(2 * np.pi * 0.3 * t_imu)
+           + 0.01 * rng.standard_normal(t_imu.size))
+
+    return {
+        'ppg (integer)': (ppg, True),
+        'ppg (float)': (ppg, False),
+        'imu magnitude (float)': (mag, False),
+    }
+
+
+def main():
+    print("=" * 50)
+    print("Lifting Wavelet vs PyWavelets Parity")
+    print("=" * 50)
+
+    failures = 0
+    workdir = Path(tempfile.mkdtemp())
+    try:
+        binary = build_driver(workdir)
+
+        for name, (signal, integer) in make_signals().items():
+            fw = firmware_energies(binary, signal, integer)
+            ref = pywt_energies(signal)
+            rel = np.abs(fw - ref) / ref
+            tol = np.array([APPROX_RTOL] + [DETAIL_RTOL] * LEVELS)
+            ok = bool(np.all(rel <= tol))
+            failures += 0 if ok else 1
+
+            print(f"\n{name}: {'✓' if ok else '✗'}")
+            labels = [f'a{LEVELS}'] + [f'd{j}' for j in range(LEVELS, 0, -1)]
+            for label, f, r, e in zip(labels, fw, ref, rel):
+                print(f"  {label}: firmware={f:.6g}  pywt={r:.6g}  rel_err={e:.3%}")
+    finally:
+        shutil.rmtree(workdir, ignore_errors=True)
+
+    print("\n" + "=" * 50)
+    if failures == 0:
+        print("RESULT: ALL TESTS PASSED ✓")
+    else:
+        print(f"RESULT: {failures} SIGNAL(S) FAILED ✗")
+    print("=" * 50)
+    return failures
+
+
+if __name__ == "__main__":
+    sys.exit(1 if main() else 0)